@@ -0,0 +1,136 @@
+// Оценка сжатия ответов: сколько байт экономит gzip/deflate и сколько процессорного
+// времени тратится на сжатие для каждого API-эндпоинта и статического файла.
+//
+//  compression_bench <config.json> <www-root> [players] [iterations]
+
+#include "../src/db/in_memory.h"
+#include "../src/http/compression.h"
+#include "../src/http/request_handler.h"
+#include "../src/json/json_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+namespace http = boost::beast::http;
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Payload {
+    std::string name;
+    std::string body;
+};
+
+http::request<http::string_body> MakeGetRequest(std::string_view target, const app::Token* token = nullptr) {
+    http::request<http::string_body> req{http::verb::get, target, 11};
+    if (token) {
+        req.set(http::field::authorization, "Bearer "s + **token);
+    }
+    return req;
+}
+
+std::vector<Payload> MakeApiPayloads(const fs::path& config_path, size_t players) {
+    auto [game, extra_data] = json_loader::LoadGame(json_loader::LoadJsonData(config_path));
+    app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+    app.TimeTickerUsed();
+    const auto& map_id = game.GetMaps().front().GetId();
+    std::optional<app::Token> token;
+    for (size_t i = 0; i < players; ++i) {
+        auto result = app.JoinPlayer(map_id, "Dog #"s + std::to_string(i));
+        if (!token) {
+            token = result->first;
+        }
+    }
+    // Несколько тиков, чтобы на карте появились трофеи
+    for (int i = 0; i < 10; ++i) {
+        app.Tick(1000ms);
+    }
+
+    http_handler::ApiHandler api_handler{app, extra_data};
+    std::vector<Payload> payloads;
+    auto add = [&](std::string name, http::request<http::string_body> req) {
+        payloads.push_back({std::move(name), api_handler.HandleRequest(req).body()});
+    };
+    add("/api/v1/maps"s, MakeGetRequest("/api/v1/maps"sv));
+    const std::string map_target = "/api/v1/maps/"s + *map_id;
+    add(map_target, MakeGetRequest(map_target));
+    add("/api/v1/game/players"s, MakeGetRequest("/api/v1/game/players"sv, &*token));
+    add("/api/v1/game/state"s, MakeGetRequest("/api/v1/game/state"sv, &*token));
+    add("/api/v1/game/records"s, MakeGetRequest("/api/v1/game/records"sv));
+    return payloads;
+}
+
+std::vector<Payload> MakeStaticPayloads(const fs::path& root) {
+    std::vector<Payload> payloads;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char ch) { return std::tolower(ch); });
+        if (http_handler::IsPrecompressedContentType(http_handler::ContentType::FromFileExt(ext))) {
+            continue;
+        }
+        std::ifstream file(entry.path(), std::ios::binary);
+        payloads.push_back({
+            "/"s + fs::relative(entry.path(), root).generic_string(),
+            {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()}
+        });
+    }
+    return payloads;
+}
+
+void Report(const Payload& payload, size_t iterations) {
+    using http_handler::ContentEncoding;
+    std::cout << std::left << std::setw(40) << payload.name << std::right << std::setw(10) << payload.body.size();
+    for (int level : {1, 6, 9}) {
+        size_t compressed_size = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            compressed_size = http_handler::Compress(payload.body, ContentEncoding::GZIP, level).size();
+        }
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+        const double saved = payload.body.empty() ? 0. : 100. * (1. - double(compressed_size) / payload.body.size());
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(10) << compressed_size << std::setw(7) << saved << '%' << std::setw(10) << us;
+    }
+    std::cout << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: compression_bench <config.json> <www-root> [players] [iterations]"sv << std::endl;
+        return EXIT_FAILURE;
+    }
+    const size_t players = argc > 3 ? std::stoul(argv[3]) : 200;
+    const size_t iterations = argc > 4 ? std::stoul(argv[4]) : 20;
+    try {
+        std::cout << "gzip, players: "sv << players << ", iterations: "sv << iterations << '\n'
+                  << std::left << std::setw(40) << "endpoint"sv << std::right << std::setw(10) << "bytes"sv;
+        for (int level : {1, 6, 9}) {
+            std::cout << std::setw(10) << ("l"s + std::to_string(level) + " bytes"s)
+                      << std::setw(8) << "saved"sv << std::setw(10) << "us"sv;
+        }
+        std::cout << std::endl;
+        for (const auto& payload : MakeApiPayloads(argv[1], players)) {
+            Report(payload, iterations);
+        }
+        for (const auto& payload : MakeStaticPayloads(argv[2])) {
+            Report(payload, iterations);
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,234 @@
+// Сравнение сериализации ответов через дерево boost::json и потоковый JsonWriter:
+// число выделений памяти и время на один ответ.
+//
+//  json_writer_bench [players] [iterations]
+
+#include "../src/json/json_writer.h"
+
+#include <boost/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+namespace json = boost::json;
+
+struct Player {
+    uint64_t id;
+    double x, y, vx, vy;
+    std::string_view dir;
+    std::vector<std::pair<size_t, size_t>> bag;
+    size_t score;
+};
+
+struct LootObject {
+    uint64_t id;
+    size_t type;
+    double x, y;
+};
+
+struct Record {
+    std::string name;
+    size_t score;
+    size_t play_time_ms;
+};
+
+struct State {
+    std::vector<Player> players;
+    std::vector<LootObject> loot_objects;
+    std::vector<Record> records;
+};
+
+State MakeState(size_t players_count) {
+    std::mt19937_64 rng{42};
+    std::uniform_real_distribution<double> coord{0., 100.};
+    std::uniform_int_distribution<size_t> small{0, 5};
+    constexpr std::string_view dirs[] = {"U"sv, "D"sv, "L"sv, "R"sv};
+    State state;
+    for (size_t i = 0; i < players_count; ++i) {
+        Player player{i, coord(rng), coord(rng), small(rng) * 0.5, 0., dirs[i % 4], {}, small(rng) * 10};
+        for (size_t j = small(rng); j > 0; --j) {
+            player.bag.emplace_back(i * 10 + j, small(rng));
+        }
+        state.players.push_back(std::move(player));
+        state.loot_objects.push_back({i, small(rng), coord(rng), coord(rng)});
+    }
+    for (size_t i = 0; i < 100; ++i) {
+        state.records.push_back({"Dog #"s + std::to_string(i), 1000 - i, 1234 * i});
+    }
+    return state;
+}
+
+std::string StateWithDom(const State& state) {
+    json::object json_players;
+    for (const auto& player : state.players) {
+        json::object json_player;
+        json_player.emplace("pos"sv, json::array{player.x, player.y});
+        json_player.emplace("speed"sv, json::array{player.vx, player.vy});
+        json_player.emplace("dir"sv, player.dir);
+        json::array json_bag;
+        for (auto [id, type] : player.bag) {
+            json::object json_loot_item;
+            json_loot_item.emplace("id"sv, id);
+            json_loot_item.emplace("type"sv, type);
+            json_bag.emplace_back(std::move(json_loot_item));
+        }
+        json_player.emplace("bag"sv, std::move(json_bag));
+        json_player.emplace("score"sv, player.score);
+        json_players.emplace(std::to_string(player.id), std::move(json_player));
+    }
+    json::object json_loot_objects;
+    for (const auto& loot_object : state.loot_objects) {
+        json::object json_loot_object;
+        json_loot_object.emplace("type"sv, loot_object.type);
+        json_loot_object.emplace("pos"sv, json::array{loot_object.x, loot_object.y});
+        json_loot_objects.emplace(std::to_string(loot_object.id), json_loot_object);
+    }
+    json::object json_state;
+    json_state.emplace("players"sv, std::move(json_players));
+    json_state.emplace("lostObjects"sv, std::move(json_loot_objects));
+    return json::serialize(json_state);
+}
+
+std::string StateWithWriter(const State& state) {
+    std::string body;
+    body.reserve(64 + state.players.size() * 128 + state.loot_objects.size() * 64);
+    json_writer::JsonWriter writer{body};
+    writer.StartObject().Key("players"sv).StartObject();
+    for (const auto& player : state.players) {
+        writer.Key(player.id).StartObject();
+        writer.Key("pos"sv).Pair(player.x, player.y);
+        writer.Key("speed"sv).Pair(player.vx, player.vy);
+        writer.Key("dir"sv).Value(player.dir);
+        writer.Key("bag"sv).StartArray();
+        for (auto [id, type] : player.bag) {
+            writer.StartObject().Key("id"sv).Value(id).Key("type"sv).Value(type).EndObject();
+        }
+        writer.EndArray();
+        writer.Key("score"sv).Value(player.score);
+        writer.EndObject();
+    }
+    writer.EndObject().Key("lostObjects"sv).StartObject();
+    for (const auto& loot_object : state.loot_objects) {
+        writer.Key(loot_object.id).StartObject()
+            .Key("type"sv).Value(loot_object.type)
+            .Key("pos"sv).Pair(loot_object.x, loot_object.y)
+            .EndObject();
+    }
+    writer.EndObject().EndObject();
+    return body;
+}
+
+std::string RecordsWithDom(const State& state) {
+    json::array json_players;
+    for (const auto& record : state.records) {
+        json::object json_player;
+        json_player.emplace("name"sv, record.name);
+        json_player.emplace("score"sv, record.score);
+        json_player.emplace("playTime"sv, record.play_time_ms * 1. / 1000);
+        json_players.push_back(std::move(json_player));
+    }
+    return json::serialize(json_players);
+}
+
+std::string RecordsWithWriter(const State& state) {
+    std::string body;
+    json_writer::JsonWriter writer{body};
+    writer.StartArray();
+    for (const auto& record : state.records) {
+        writer.StartObject()
+            .Key("name"sv).Value(record.name)
+            .Key("score"sv).Value(record.score)
+            .Key("playTime"sv).Value(record.play_time_ms * 1. / 1000)
+            .EndObject();
+    }
+    writer.EndArray();
+    return body;
+}
+
+struct Measurement {
+    double allocations_per_call;
+    double microseconds_per_call;
+    size_t bytes;
+};
+
+template <typename Fn>
+Measurement Measure(Fn&& fn, const State& state, size_t iterations) {
+    size_t bytes = fn(state).size();
+    const size_t allocations_before = allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        bytes = fn(state).size();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return {
+        static_cast<double>(allocations.load() - allocations_before) / iterations,
+        std::chrono::duration<double, std::micro>(elapsed).count() / iterations,
+        bytes
+    };
+}
+
+template <typename DomFn, typename WriterFn>
+bool Compare(std::string_view name, DomFn&& dom, WriterFn&& writer, const State& state, size_t iterations) {
+    if (dom(state) != writer(state)) {
+        std::cerr << name << ": outputs differ"sv << std::endl;
+        return false;
+    }
+    const auto dom_result = Measure(dom, state, iterations);
+    const auto writer_result = Measure(writer, state, iterations);
+    std::cout << std::fixed << std::setprecision(1)
+              << std::setw(10) << name << std::setw(10) << dom_result.bytes
+              << std::setw(14) << dom_result.allocations_per_call << std::setw(14) << writer_result.allocations_per_call
+              << std::setw(12) << dom_result.microseconds_per_call << std::setw(12) << writer_result.microseconds_per_call
+              << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t players = argc > 1 ? std::stoul(argv[1]) : 1000;
+    const size_t iterations = argc > 2 ? std::stoul(argv[2]) : 200;
+    const State state = MakeState(players);
+
+    std::cout << "players: "sv << players << ", iterations: "sv << iterations << '\n'
+              << std::setw(10) << "response"sv << std::setw(10) << "bytes"sv
+              << std::setw(14) << "dom allocs"sv << std::setw(14) << "writer allocs"sv
+              << std::setw(12) << "dom us"sv << std::setw(12) << "writer us"sv << std::endl;
+
+    bool ok = Compare("state"sv, StateWithDom, StateWithWriter, state, iterations);
+    ok = Compare("records"sv, RecordsWithDom, RecordsWithWriter, state, iterations) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
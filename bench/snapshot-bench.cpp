@@ -0,0 +1,146 @@
+// Скорость сохранения и восстановления состояния игры в текстовом архиве, двоичном и отображаемом в память снимках,
+// без сжатия и со сжатием gzip (строки ".gz<уровень>"), на синтетическом состоянии: собаки с трофеями в рюкзаках,
+// распределённые по нескольким картам.
+// stall ms - время, на которое фоновое автосохранение задерживает тик (копирование состояния).
+//
+//  snapshot_bench [dogs] [maps] [iterations]
+
+#include "../src/db/in_memory.h"
+#include "../src/model/model_serialization.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+namespace {
+
+model::Game MakeGame(size_t maps) {
+    model::Game game;
+    game.SetLootGeneratorParams(5., 0.5);
+    game.SetDogRetirementTime(60'000);
+    for (size_t i = 0; i < maps; ++i) {
+        model::Map map(model::Map::Id{"map"s + std::to_string(i)}, "Map "s + std::to_string(i));
+        map.SetDogSpeed(3.).SetDogBagCapacity(3);
+        map.AddLootTypeWorth(10);
+        map.AddLootTypeWorth(30);
+        map.AddRoad(model::Road(model::Road::HORIZONTAL, {0, 0}, 100));
+        map.AddRoad(model::Road(model::Road::VERTICAL, {100, 0}, 100));
+        game.AddMap(std::move(map));
+    }
+    return game;
+}
+
+void Populate(app::Application& app, model::Game& game, size_t dogs) {
+    const auto& maps = game.GetMaps();
+    for (size_t i = 0; i < dogs; ++i) {
+        const auto& map_id = maps[i % maps.size()].GetId();
+        auto joined = app.JoinPlayer(map_id, "Dog #"s + std::to_string(i));
+        auto* dog = game.GetGameSessionByMapId(map_id)->GetDogById(joined->second);
+        dog->SetDirection(static_cast<model::Dog::Direction>(i % 4));
+        dog->SetSpeed(3.);
+        dog->AddScore(i % 100);
+        for (size_t j = 0; j < i % 3; ++j) {
+            dog->AddLootObjectToBagpack({model::LootObject::Id{i * 3 + j}, j % 2, j % 2 ? 30u : 10u});
+        }
+    }
+    // Несколько тиков, чтобы собаки сдвинулись с целых координат и появились трофеи
+    for (int i = 0; i < 5; ++i) {
+        app.Tick(1234ms);
+    }
+}
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Report(std::string_view name, serialization::SnapshotFormat format, int compression_level, const fs::path& path,
+            app::Application& app, model::Game& game, size_t dogs, size_t maps, size_t iterations) {
+    serialization::AppSerializator saver(app, game, path.string(), true, format);
+    saver.SetCompressionLevel(compression_level);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        saver.Serialize();
+    }
+    const double save = Seconds(start) / iterations;
+    const double size_mb = fs::file_size(path) / 1e6;
+
+    // При автосохранении тик задерживается только на копирование состояния
+    double stall = 0.;
+    for (size_t i = 0; i < iterations; ++i) {
+        start = std::chrono::steady_clock::now();
+        saver.SerializeInBackground();
+        stall += Seconds(start);
+        saver.Wait();
+    }
+    stall /= iterations;
+
+    double restore = 0.;
+    for (size_t i = 0; i < iterations; ++i) {
+        auto restored_game = MakeGame(maps);
+        app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        serialization::AppSerializator loader(restored_app, restored_game, path.string(), true);
+        start = std::chrono::steady_clock::now();
+        loader.Restore();
+        restore += Seconds(start);
+    }
+    restore /= iterations;
+
+    std::cout << std::left << std::setw(11) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << size_mb
+              << std::setw(10) << save * 1000 << std::setw(12) << size_mb / save << std::setw(14) << dogs / save
+              << std::setw(10) << stall * 1000
+              << std::setw(10) << restore * 1000 << std::setw(12) << size_mb / restore << std::setw(14) << dogs / restore
+              << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t dogs = argc > 1 ? std::stoul(argv[1]) : 100'000;
+    const size_t maps = argc > 2 ? std::stoul(argv[2]) : 10;
+    const size_t iterations = argc > 3 ? std::stoul(argv[3]) : 3;
+    try {
+        auto game = MakeGame(maps);
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        app.TimeTickerUsed();
+        Populate(app, game, dogs);
+
+        const auto dir = fs::temp_directory_path();
+        std::cout << "dogs: "sv << dogs << ", maps: "sv << maps << ", iterations: "sv << iterations << '\n'
+                  << std::left << std::setw(11) << "format"sv << std::right << std::setw(10) << "MB"sv
+                  << std::setw(10) << "save ms"sv << std::setw(12) << "save MB/s"sv << std::setw(14) << "save dogs/s"sv
+                  << std::setw(10) << "stall ms"sv
+                  << std::setw(10) << "load ms"sv << std::setw(12) << "load MB/s"sv << std::setw(14) << "load dogs/s"sv
+                  << std::endl;
+        const struct {
+            std::string_view name;
+            serialization::SnapshotFormat format;
+            int compression_level;
+            const char* file_name;
+        } rows[] = {
+            {"text"sv, serialization::SnapshotFormat::TEXT, 0, "snapshot_bench.txt"},
+            {"text.gz1"sv, serialization::SnapshotFormat::TEXT, 1, "snapshot_bench.txt.gz1"},
+            {"text.gz6"sv, serialization::SnapshotFormat::TEXT, 6, "snapshot_bench.txt.gz6"},
+            {"binary"sv, serialization::SnapshotFormat::BINARY, 0, "snapshot_bench.bin"},
+            {"binary.gz1"sv, serialization::SnapshotFormat::BINARY, 1, "snapshot_bench.bin.gz1"},
+            {"binary.gz6"sv, serialization::SnapshotFormat::BINARY, 6, "snapshot_bench.bin.gz6"},
+            {"mapped"sv, serialization::SnapshotFormat::MAPPED, 0, "snapshot_bench.map"},
+            {"mapped.gz6"sv, serialization::SnapshotFormat::MAPPED, 6, "snapshot_bench.map.gz6"},
+        };
+        for (const auto& row : rows) {
+            Report(row.name, row.format, row.compression_level, dir / row.file_name, app, game, dogs, maps, iterations);
+            fs::remove(dir / row.file_name);
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
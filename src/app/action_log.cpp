@@ -0,0 +1,420 @@
+#include "action_log.h"
+
+#include "../model/binary_io.h"
+#include "../util/durable_file.h"
+
+#include "app.h"
+
+#include <boost/crc.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace app {
+
+using namespace std::literals;
+
+namespace {
+
+using serialization::BinaryReader;
+using serialization::BinaryWriter;
+
+// Типы записей в порядке альтернатив LogRecord
+enum class RecordType : uint64_t {
+    JOIN,
+    MOVE,
+    STOP,
+    TICK,
+    RETIRE,
+};
+
+uint32_t Checksum(std::string_view data) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+}
+
+void WriteFields(BinaryWriter& out, const log_record::Join& join) {
+    out.String(*join.map_id);
+    out.Uint(*join.session_id);
+    out.String(*join.token);
+    out.Uint(*join.dog_id);
+    out.String(join.name);
+    out.Point(join.spawn_point);
+}
+
+void WriteFields(BinaryWriter& out, const log_record::Move& move) {
+    out.String(*move.token);
+    out.Uint(static_cast<uint64_t>(move.direction));
+}
+
+void WriteFields(BinaryWriter& out, const log_record::Stop& stop) {
+    out.String(*stop.token);
+}
+
+void WriteFields(BinaryWriter& out, const log_record::Tick& tick) {
+    out.String(*tick.map_id);
+    out.Uint(tick.delta.count());
+    out.Uint(tick.spawned_loot.size());
+    for (const auto& loot : tick.spawned_loot) {
+        out.Uint(*loot.id);
+        out.Uint(loot.type);
+        out.Point(loot.coords);
+    }
+}
+
+void WriteFields(BinaryWriter& out, const log_record::Retire& retire) {
+    out.String(*retire.map_id);
+    out.Uint(*retire.dog_id);
+}
+
+LogRecord ReadFields(RecordType type, BinaryReader& in) {
+    switch (type) {
+    case RecordType::JOIN: {
+        log_record::Join join;
+        join.map_id = model::Map::Id{in.String()};
+        join.session_id = model::GameSession::Id{in.Uint()};
+        join.token = Token{in.String()};
+        join.dog_id = model::Dog::Id{in.Uint()};
+        join.name = in.String();
+        join.spawn_point = in.Point();
+        return join;
+    }
+    case RecordType::MOVE: {
+        log_record::Move move;
+        move.token = Token{in.String()};
+        const auto direction = in.Uint();
+        if (direction > static_cast<uint64_t>(model::Dog::Direction::EAST)) {
+            throw std::runtime_error("Corrupted action log: invalid dog direction");
+        }
+        move.direction = static_cast<model::Dog::Direction>(direction);
+        return move;
+    }
+    case RecordType::STOP:
+        return log_record::Stop{Token{in.String()}};
+    case RecordType::TICK: {
+        log_record::Tick tick;
+        tick.map_id = model::Map::Id{in.String()};
+        tick.delta = std::chrono::milliseconds{in.Uint()};
+        const auto count = in.Uint();
+        in.Reserve(tick.spawned_loot, count);
+        for (auto i = count; i > 0; --i) {
+            auto& loot = tick.spawned_loot.emplace_back();
+            loot.id = model::LootObject::Id{in.Uint()};
+            loot.type = in.Uint();
+            loot.coords = in.Point();
+        }
+        return tick;
+    }
+    case RecordType::RETIRE: {
+        log_record::Retire retire;
+        retire.map_id = model::Map::Id{in.String()};
+        retire.dog_id = model::Dog::Id{in.Uint()};
+        return retire;
+    }
+    }
+    throw std::runtime_error("Corrupted action log: unknown record type");
+}
+
+}  // namespace
+
+ActionLogMetrics::ActionLogMetrics(metrics::Registry& registry)
+    : records{registry.AddCounter("game_action_log_records_total"sv, "Number of records appended to the action log"sv)}
+    , commits{registry.AddCounter("game_action_log_commits_total"sv, "Number of action log group commits"sv)}
+    , bytes{registry.AddCounter("game_action_log_bytes_total"sv, "Number of bytes written to the action log"sv)}
+    , errors{registry.AddCounter("game_action_log_errors_total"sv, "Number of failed action log writes"sv)}
+    , commit_seconds{registry.AddGauge("game_action_log_commit_seconds"sv,
+        "Duration of the last action log write and fdatasync"sv)} {
+}
+
+ActionLog::ActionLog(const std::filesystem::path& state_file_path, metrics::Registry* registry)
+    : dir_{state_file_path.has_parent_path() ? state_file_path.parent_path() : std::filesystem::path{"."}}
+    , prefix_{state_file_path.stem().string().append("_log_")} {
+    if (registry) {
+        metrics_.emplace(*registry);
+    }
+}
+
+ActionLog::~ActionLog() {
+    if (writer_.joinable()) {
+        writer_.request_stop();
+        writer_.join();
+    }
+}
+
+std::filesystem::path ActionLog::GetSegmentPath(uint64_t segment) const {
+    return dir_ / (prefix_ + std::to_string(segment));
+}
+
+std::vector<std::pair<uint64_t, std::filesystem::path>> ActionLog::ListSegments() const {
+    std::vector<std::pair<uint64_t, std::filesystem::path>> segments;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+        const auto name = entry.path().filename().string();
+        if (!name.starts_with(prefix_) || name.size() == prefix_.size()) {
+            continue;
+        }
+        const auto number = std::string_view{name}.substr(prefix_.size());
+        if (!std::all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        segments.emplace_back(std::stoull(std::string{number}), entry.path());
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+size_t ActionLog::Recover(Application& app, uint64_t first_segment) {
+    size_t replayed = 0;
+    segment_ = first_segment;
+    for (const auto& [segment, path] : ListSegments()) {
+        if (segment < first_segment) {
+            // Действия уже вошли в файл состояния
+            std::filesystem::remove(path);
+            continue;
+        }
+        std::ifstream in(path, std::ios::binary);
+        const std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        const auto records = ReadSegment(data);
+        app.Replay(records);
+        replayed += records.size();
+        // Новые записи пишутся в новый сегмент, а не после возможно недописанного хвоста
+        segment_ = segment + 1;
+    }
+    truncated_before_ = first_segment;
+    return replayed;
+}
+
+void ActionLog::Start() {
+    writer_ = std::jthread([this](std::stop_token stop) {
+        RunWriter(std::move(stop));
+    });
+}
+
+std::string ActionLog::EncodeRecord(const LogRecord& record) {
+    std::string payload;
+    BinaryWriter out{payload};
+    out.Uint(record.index());
+    out.Record(RECORD_VERSION, [&record](BinaryWriter& fields) {
+        std::visit([&fields](const auto& value) {
+            WriteFields(fields, value);
+        }, record);
+    });
+
+    std::string frame;
+    BinaryWriter frame_out{frame};
+    frame_out.Uint(payload.size());
+    const auto checksum = Checksum(payload);
+    for (int i = 0; i < 4; ++i) {
+        frame.push_back(static_cast<char>(checksum >> (8 * i)));
+    }
+    frame.append(payload);
+    return frame;
+}
+
+std::vector<LogRecord> ActionLog::ReadSegment(std::string_view data) {
+    std::vector<LogRecord> records;
+    if (data.size() < SIGNATURE.size() && SIGNATURE.starts_with(data)) {
+        // Сбой при создании сегмента
+        return records;
+    }
+    if (!data.starts_with(SIGNATURE)) {
+        throw std::runtime_error("Not an action log");
+    }
+    BinaryReader in{data.substr(SIGNATURE.size())};
+    uint64_t version = 0;
+    try {
+        version = in.Uint();
+    } catch (const std::runtime_error&) {
+        // Сбой при записи заголовка
+        return records;
+    }
+    if (version > FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported action log format version "s + std::to_string(version));
+    }
+    while (!in.Empty()) {
+        std::string_view payload;
+        try {
+            const auto size = in.Uint();
+            const auto checksum_bytes = in.Bytes(4);
+            uint32_t checksum = 0;
+            for (int i = 0; i < 4; ++i) {
+                checksum |= static_cast<uint32_t>(static_cast<uint8_t>(checksum_bytes[i])) << (8 * i);
+            }
+            payload = in.Bytes(size);
+            if (Checksum(payload) != checksum) {
+                break;
+            }
+        } catch (const std::runtime_error&) {
+            // Запись недописана при сбое
+            break;
+        }
+        BinaryReader record{payload};
+        const auto type = record.Uint();
+        if (type >= std::variant_size_v<LogRecord>) {
+            throw std::runtime_error("Corrupted action log: unknown record type");
+        }
+        record.Record(RECORD_VERSION, [&records, type](uint64_t, BinaryReader& fields) {
+            records.push_back(ReadFields(static_cast<RecordType>(type), fields));
+        });
+    }
+    return records;
+}
+
+void ActionLog::Append(const LogRecord& record) {
+    const auto frame = EncodeRecord(record);
+    {
+        std::lock_guard lock{mutex_};
+        buffer_.append(frame);
+    }
+    if (metrics_) {
+        metrics_->records.Add();
+    }
+}
+
+void ActionLog::Commit() {
+    {
+        std::lock_guard lock{mutex_};
+        if (buffer_.empty() && sealed_.empty()) {
+            return;
+        }
+        commit_requested_ = true;
+    }
+    cv_.notify_one();
+}
+
+uint64_t ActionLog::Rotate() {
+    std::unique_lock lock{mutex_};
+    if (!buffer_.empty()) {
+        sealed_.push_back({segment_, std::move(buffer_)});
+        buffer_.clear();
+        commit_requested_ = true;
+    }
+    const auto segment = ++segment_;
+    lock.unlock();
+    cv_.notify_one();
+    return segment;
+}
+
+void ActionLog::Truncate(uint64_t segment) {
+    {
+        std::lock_guard lock{mutex_};
+        truncate_before_ = std::max(truncate_before_, segment);
+    }
+    cv_.notify_one();
+}
+
+void ActionLog::RunWriter(std::stop_token stop) {
+    std::unique_lock lock{mutex_};
+    while (true) {
+        const bool woken = cv_.wait(lock, stop, [this] {
+            return commit_requested_ || truncate_before_ > truncated_before_;
+        });
+        // Перед остановкой записываются все накопленные записи
+        auto batches = std::move(sealed_);
+        sealed_.clear();
+        if (!buffer_.empty()) {
+            batches.push_back({segment_, std::move(buffer_)});
+            buffer_.clear();
+        }
+        commit_requested_ = false;
+        const auto truncate_before = truncate_before_;
+        const bool truncate = truncate_before > truncated_before_;
+        lock.unlock();
+
+        const auto written = Write(batches);
+        if (truncate) {
+            RemoveSegmentsBefore(truncate_before);
+        }
+
+        lock.lock();
+        if (truncate) {
+            truncated_before_ = truncate_before;
+        }
+        // Группы, не попавшие на диск, записываются при следующей фиксации раньше новых записей.
+        // Действия удалённых сегментов уже вошли в файл состояния.
+        batches.erase(batches.begin(), batches.begin() + written);
+        std::erase_if(batches, [this](const Batch& batch) {
+            return batch.segment < truncated_before_;
+        });
+        sealed_.insert(sealed_.begin(), std::make_move_iterator(batches.begin()),
+                       std::make_move_iterator(batches.end()));
+        if (!woken) {
+            break;
+        }
+    }
+}
+
+size_t ActionLog::Write(const std::vector<Batch>& batches) {
+    if (batches.empty()) {
+        return 0;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t bytes = 0;
+    uint64_t unsynced = 0;
+    size_t written = 0;
+    try {
+        for (size_t i = 0; i < batches.size(); ++i) {
+            const auto& batch = batches[i];
+            if (!file_ || file_segment_ != batch.segment) {
+                file_.reset();
+                const auto path = GetSegmentPath(batch.segment);
+                std::error_code ec;
+                const auto size = std::filesystem::file_size(path, ec);
+                const bool created = ec || size == 0;
+                file_segment_ = batch.segment;
+                synced_size_ = created ? 0 : size;
+                file_ = std::make_unique<util::AppendFile>(path);
+                if (created) {
+                    std::string header{SIGNATURE};
+                    BinaryWriter{header}.Uint(FORMAT_VERSION);
+                    file_->Append(header);
+                    unsynced += header.size();
+                    util::SyncDirectory(path);
+                }
+            }
+            file_->Append(batch.data);
+            unsynced += batch.data.size();
+            bytes += batch.data.size();
+            // Сегмент сбрасывается на диск перед переходом к следующему
+            if (i + 1 == batches.size() || batches[i + 1].segment != batch.segment) {
+                file_->Sync();
+                synced_size_ += unsynced;
+                unsynced = 0;
+                written = i + 1;
+            }
+        }
+    } catch (...) {
+        // Повторная запись продолжит сегмент с последней целой записи, а не после недописанной
+        file_.reset();
+        std::error_code ec;
+        std::filesystem::resize_file(GetSegmentPath(file_segment_), synced_size_, ec);
+        if (metrics_) {
+            metrics_->errors.Add();
+        }
+        return written;
+    }
+    if (metrics_) {
+        metrics_->commits.Add();
+        metrics_->bytes.Add(bytes);
+        metrics_->commit_seconds.Set(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return written;
+}
+
+void ActionLog::RemoveSegmentsBefore(uint64_t segment) {
+    if (file_ && file_segment_ < segment) {
+        file_.reset();
+    }
+    for (const auto& [number, path] : ListSegments()) {
+        if (number < segment) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+    }
+    util::SyncDirectory(GetSegmentPath(segment));
+}
+
+}  // namespace app
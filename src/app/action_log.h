@@ -0,0 +1,174 @@
+#pragma once
+
+#include "../metrics/metrics.h"
+#include "../model/model.h"
+
+#include "player.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace util {
+
+class AppendFile;
+
+}  // namespace util
+
+namespace app {
+
+class Application;
+
+// Записи журнала действий. Случайные величины (токен, точка появления собаки, появившиеся трофеи)
+// записываются вместе с действием, поэтому воспроизведение журнала детерминировано.
+namespace log_record {
+
+struct Join {
+    model::Map::Id map_id{""};
+    model::GameSession::Id session_id{0u};
+    Token token{""};
+    model::Dog::Id dog_id{0u};
+    std::string name;
+    geom::PointDouble spawn_point;
+};
+
+struct Move {
+    Token token{""};
+    model::Dog::Direction direction;
+};
+
+struct Stop {
+    Token token{""};
+};
+
+struct Tick {
+    model::Map::Id map_id{""};
+    std::chrono::milliseconds delta;
+    model::GameSession::SpawnedLoots spawned_loot;
+};
+
+struct Retire {
+    model::Map::Id map_id{""};
+    model::Dog::Id dog_id{0u};
+};
+
+}  // namespace log_record
+
+using LogRecord = std::variant<log_record::Join, log_record::Move, log_record::Stop,
+                               log_record::Tick, log_record::Retire>;
+
+// Метрики журнала действий
+struct ActionLogMetrics {
+    explicit ActionLogMetrics(metrics::Registry& registry);
+
+    metrics::Counter& records;
+    metrics::Counter& commits;
+    metrics::Counter& bytes;
+    metrics::Counter& errors;
+    metrics::Gauge& commit_seconds;
+};
+
+// Журнал действий между сохранениями состояния: вход игроков, перемещение и остановка собак,
+// тики сессий и уход на покой. Записи накапливаются в памяти, а фоновый поток дописывает их в файл
+// одним вызовом write и fdatasync на группу (групповая фиксация после каждого тика),
+// поэтому при сбое теряются только действия последнего тика.
+//
+// Журнал разбит на сегменты <файл состояния>_log_<номер>. При снятии копии состояния начинается новый сегмент,
+// номер которого сохраняется в файле состояния, а после записи файла предыдущие сегменты удаляются.
+// При запуске сервер загружает файл состояния и воспроизводит сегменты с сохранённым номером.
+//
+// Каждая запись сегмента хранит длину и CRC-32, поэтому запись, недописанная при сбое, и всё после неё отбрасываются.
+// Если write или fdatasync завершились ошибкой, сегмент обрезается до последнего сброшенного на диск размера,
+// а группа записывается снова при следующей фиксации.
+class ActionLog {
+public:
+    static constexpr std::string_view SIGNATURE = "DGLOG\n";
+    static constexpr uint64_t FORMAT_VERSION = 1;
+    static constexpr uint64_t RECORD_VERSION = 1;
+
+    explicit ActionLog(const std::filesystem::path& state_file_path, metrics::Registry* registry = nullptr);
+
+    ActionLog(const ActionLog&) = delete;
+    ActionLog& operator=(const ActionLog&) = delete;
+
+    // Дописывает накопленные записи
+    ~ActionLog();
+
+    // Воспроизводит сегменты, начиная с first_segment, и удаляет более старые. Вызывается до Start.
+    // Возвращает число воспроизведённых записей. Бросает std::runtime_error, если журнал расходится с моделью.
+    size_t Recover(Application& app, uint64_t first_segment);
+
+    void Start();
+
+    // Можно вызывать из любого потока. Записи одной сессии добавляются в её strand
+    // (или под исключительной блокировкой), поэтому их порядок совпадает с порядком действий.
+    void Append(const LogRecord& record);
+
+    // Будит фоновый поток, чтобы он записал накопленные записи
+    void Commit();
+
+    // Начинает новый сегмент и возвращает его номер. Вызывается при снятии копии состояния,
+    // когда модель не изменяется.
+    uint64_t Rotate();
+
+    // Удаляет сегменты с номерами меньше segment после записи файла состояния
+    void Truncate(uint64_t segment);
+
+    // Записи сегмента до первой повреждённой записи
+    static std::vector<LogRecord> ReadSegment(std::string_view data);
+
+    static std::string EncodeRecord(const LogRecord& record);
+
+private:
+    struct Batch {
+        uint64_t segment;
+        std::string data;
+    };
+
+    std::filesystem::path GetSegmentPath(uint64_t segment) const;
+
+    // Номера и пути существующих сегментов по возрастанию номера
+    std::vector<std::pair<uint64_t, std::filesystem::path>> ListSegments() const;
+
+    void RunWriter(std::stop_token stop);
+
+    // Возвращает число групп, сброшенных на диск. После ошибки недописанный хвост сегмента отрезается.
+    size_t Write(const std::vector<Batch>& batches);
+
+    void RemoveSegmentsBefore(uint64_t segment);
+
+    std::filesystem::path dir_;
+    std::string prefix_;
+    std::optional<ActionLogMetrics> metrics_;
+
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    // Записи текущего сегмента, ещё не переданные фоновому потоку
+    std::string buffer_;
+    uint64_t segment_ = 0;
+    // Незаписанные записи завершённых сегментов и группы, запись которых не удалась
+    std::vector<Batch> sealed_;
+    bool commit_requested_ = false;
+    uint64_t truncate_before_ = 0;
+
+    // Используются только фоновым потоком
+    std::unique_ptr<util::AppendFile> file_;
+    uint64_t file_segment_ = 0;
+    // Размер сегмента file_segment_ после последнего успешного fdatasync
+    uint64_t synced_size_ = 0;
+    uint64_t truncated_before_ = 0;
+
+    std::jthread writer_;
+};
+
+}  // namespace app
@@ -8,6 +8,7 @@ model::GameSession& Player::GetGameSession() const noexcept {
 
 // PlayerTokens
 const Token& PlayerTokens::AddPlayer(const Player& player) {
+    std::unique_lock lock{mutex_};
     Player* player_ptr = const_cast<Player*>(&player);
     auto [it, inserted] = token_to_player_.emplace(Token{get_token_()}, player_ptr);
     while (!inserted) {
@@ -18,6 +19,7 @@ const Token& PlayerTokens::AddPlayer(const Player& player) {
 }
 
 void PlayerTokens::AddPlayer(const Player& player, Token token) {
+    std::unique_lock lock{mutex_};
     Player* player_ptr = const_cast<Player*>(&player);
     auto [it, inserted] = token_to_player_.emplace(std::move(token), player_ptr);
     if (!inserted) {
@@ -27,20 +29,32 @@ void PlayerTokens::AddPlayer(const Player& player, Token token) {
 }
 
 void PlayerTokens::ErasePlayer(const Player* player) {
+    std::unique_lock lock{mutex_};
     const Token* token = player_to_token_.at(player);
     token_to_player_.erase(*token);
     player_to_token_.erase(player);
 }
 
 Player* PlayerTokens::FindPlayerByToken(const Token& token) const {
-    if (token_to_player_.contains(token)) {
-        return token_to_player_.at(token);
+    std::shared_lock lock{mutex_};
+    if (auto it = token_to_player_.find(token); it != token_to_player_.end()) {
+        return it->second;
     }
     return nullptr;
 }
 
+std::optional<model::Map::Id> PlayerTokens::FindPlayerMap(const Token& token) const {
+    std::shared_lock lock{mutex_};
+    if (auto it = token_to_player_.find(token); it != token_to_player_.end()) {
+        return it->second->GetGameSession().GetMap().GetId();
+    }
+    return std::nullopt;
+}
+
 PlayersState PlayerTokens::GetPlayersState() const {
+    std::shared_lock lock{mutex_};
     PlayersState content;
+    content.reserve(token_to_player_.size());
     for (auto [token, player] : token_to_player_) {
         content.emplace_back(
             std::move(token),
@@ -52,8 +66,17 @@ PlayersState PlayerTokens::GetPlayersState() const {
     return content;
 }
 
+const Token* PlayerTokens::FindToken(const Player* player) const {
+    std::shared_lock lock{mutex_};
+    if (auto it = player_to_token_.find(player); it != player_to_token_.end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
 // Players
 Player& Players::AddPlayer(model::Dog* dog, model::GameSession* session) {
+    std::lock_guard lock{mutex_};
     auto [it, inserted] = players_.emplace(
         std::make_pair(dog->GetId(), session->GetMap().GetId()),
         Player{dog, session}
@@ -65,6 +88,7 @@ Player& Players::AddPlayer(model::Dog* dog, model::GameSession* session) {
 }
 
 Player* Players::FindByDogIdAndMapId(model::Dog::Id dog_id, const model::Map::Id& map_id) {
+    std::lock_guard lock{mutex_};
     if (auto it = players_.find({dog_id, map_id}); it != players_.end()) {
         return &it->second;
     }
@@ -72,6 +96,7 @@ Player* Players::FindByDogIdAndMapId(model::Dog::Id dog_id, const model::Map::Id
 }
 
 void Players::ErasePlayer(model::Dog::Id dog_id, const model::Map::Id& map_id) {
+    std::lock_guard lock{mutex_};
     players_.erase({dog_id, map_id});
 }
 
@@ -95,12 +120,26 @@ PlayerTokens& UseCaseBase::GetPlayerTokens() const noexcept{
     return app_->player_tokens_;
 }
 
+SessionSnapshots& UseCaseBase::GetSnapshots() const noexcept{
+    return app_->snapshots_;
+}
+
 bool UseCaseBase::TimeTickerUsed() {
     return app_->time_ticker_used_;
 }
 
-postgres::UnitOfWorkFactoryImpl& UseCaseBase::GetUnitOfWorkFactory() {
-    return app_->db_.GetUnitOfWorkFactory();
+UnitOfWorkFactory& UseCaseBase::GetUnitOfWorkFactory() {
+    return *app_->unit_factory_;
+}
+
+void UseCaseBase::LogAction(const LogRecord& record) {
+    if (app_->action_log_) {
+        app_->action_log_->Append(record);
+    }
+}
+
+bool UseCaseBase::IsReplaying() const noexcept {
+    return app_->replaying_;
 }
 
 //Use Cases
@@ -112,56 +151,199 @@ UseCaseJoinPlayer::Result UseCaseJoinPlayer::operator()(const model::Map::Id& ma
     model::Dog* dog = session->NewDog(std::move(dog_name));
     Player& player = GetPlayers().AddPlayer(dog, session);
     Token token = GetPlayerTokens().AddPlayer(player);
+    LogAction(log_record::Join{map_id, session->GetId(), token, dog->GetId(), dog->GetName(), dog->GetCoorginates()});
+    // Игрок сразу после входа запрашивает состояние, и в снимке уже должна быть его собака
+    app_->PublishSnapshot(map_id);
     return std::make_pair(std::move(token), player.GetDog().GetId());
 }
 
-UseCaseGetPlayers::Result UseCaseGetPlayers::operator()(const Token& player_token) {
-    Result result = std::nullopt;
-    if (Player* player = GetPlayerTokens().FindPlayerByToken(player_token)) {
-        const auto& dogs = player->GetGameSession().GetDogs();
-        result.emplace().reserve(dogs.size());
-        for (const auto& dog : dogs) {
-            result->emplace_back(dog.GetId(), dog.GetName());
+static UseCaseGetGameState::PlayerState MakePlayerState(const model::Dog& dog) {
+    UseCaseGetGameState::PlayerState::Bag player_bag;
+    player_bag.reserve(dog.GetBagpack().size());
+    for (const auto& loot_item : dog.GetBagpack()) {
+        player_bag.emplace_back(*loot_item.GetId(), loot_item.GetType());
+    }
+    return {
+        dog.GetId(),
+        dog.GetCoorginates(),
+        dog.GetSpeed(),
+        dog.GetDirection(),
+        std::move(player_bag),
+        dog.GetScore()
+    };
+}
+
+static UseCaseGetGameState::GameState MakeSessionState(const model::GameSession& session) {
+    UseCaseGetGameState::GameState state;
+    const auto& dogs = session.GetDogs();
+    state.players.reserve(dogs.size());
+    for (const auto& dog : dogs) {
+        state.players.push_back(MakePlayerState(dog));
+    }
+    const auto& loot_oblects = session.GetLootObjects();
+    state.loot_objects.reserve(loot_oblects.size());
+    for (const auto& [obj_id, obj] : loot_oblects ) {
+        state.loot_objects.emplace_back(obj_id, obj.GetType(), session.GetLootCoordsById(obj_id));
+    }
+    return state;
+}
+
+static UseCaseGetGameStateDelta::GameStateDelta MakeSessionDelta(const model::GameSession& session, size_t since) {
+    UseCaseGetGameStateDelta::GameStateDelta delta;
+    delta.seq = session.GetTickSeq();
+    auto changes = session.GetChangesSince(since);
+    if (!changes.has_value()) {
+        auto state = MakeSessionState(session);
+        delta.full = true;
+        delta.players = std::move(state.players);
+        delta.loot_objects = std::move(state.loot_objects);
+        return delta;
+    }
+    delta.players.reserve(changes->changed_dogs.size());
+    for (const auto& dog_id : changes->changed_dogs) {
+        if (const model::Dog* dog = session.GetDogById(dog_id)) {
+            delta.players.push_back(MakePlayerState(*dog));
         }
     }
-    return result;
+    const auto& loot_objects = session.GetLootObjects();
+    delta.loot_objects.reserve(changes->spawned_loot.size());
+    for (const auto& obj_id : changes->spawned_loot) {
+        if (auto it = loot_objects.find(obj_id); it != loot_objects.end()) {
+            delta.loot_objects.emplace_back(obj_id, it->second.GetType(), session.GetLootCoordsById(obj_id));
+        }
+    }
+    delta.retired_players.assign(changes->retired_dogs.begin(), changes->retired_dogs.end());
+    delta.removed_loot_objects.assign(changes->removed_loot.begin(), changes->removed_loot.end());
+    return delta;
 }
 
 UseCaseGetGameState::Result UseCaseGetGameState::operator()(const Token& player_token) {
     Result result = std::nullopt;
     if (Player* player = GetPlayerTokens().FindPlayerByToken(player_token)) {
-        const auto& dogs = player->GetGameSession().GetDogs();
-        result.emplace().players.reserve(dogs.size());
-        for (const auto& dog : dogs) {
-            UseCaseGetGameState::PlayerState::Bag player_bag;
-            for (const auto& loot_item : dog.GetBagpack()) {
-                player_bag.emplace_back(*loot_item.GetId(), loot_item.GetType());
-            }
-            result->players.emplace_back(
-                dog.GetId(),
-                dog.GetCoorginates(),
-                dog.GetSpeed(),
-                dog.GetDirection(),
-                std::move(player_bag),
-                dog.GetScore()
-            );
+        result = MakeSessionState(player->GetGameSession());
+    }
+    return result;
+}
+
+UseCaseGetGameState::Result UseCaseGetGameState::operator()(const model::Map::Id& map_id) {
+    Result result = std::nullopt;
+    if (!GetGame().FindMap(map_id)) {
+        return result;
+    }
+    if (const model::GameSession* session = GetGame().FindGameSession(map_id)) {
+        result = MakeSessionState(*session);
+    } else {
+        result.emplace();
+    }
+    return result;
+}
+
+UseCaseGetGameState::Result UseCaseGetGameState::operator()(const Token& player_token, double aoi_radius) {
+    Result result = std::nullopt;
+    Player* player = GetPlayerTokens().FindPlayerByToken(player_token);
+    if (!player) {
+        return result;
+    }
+    const auto& session = player->GetGameSession();
+    const model::Dog& own_dog = player->GetDog();
+    auto dog_ids = session.FindDogsInRadius(own_dog.GetCoorginates(), aoi_radius);
+    result.emplace().players.reserve(dog_ids.size() + 1);
+    result->players.push_back(MakePlayerState(own_dog));
+    for (const auto& dog_id : dog_ids) {
+        if (dog_id == own_dog.GetId()) {
+            continue;
         }
-        const auto& session = player->GetGameSession();
-        const auto& loot_oblects = session.GetLootObjects();
-        result->loot_objects.reserve(loot_oblects.size());
-        for (const auto& [obj_id, obj] : loot_oblects ) {
-            result->loot_objects.emplace_back(obj_id, obj.GetType(), session.GetLootCoordsById(obj_id));
+        if (const model::Dog* dog = session.GetDogById(dog_id)) {
+            result->players.push_back(MakePlayerState(*dog));
         }
     }
+    auto loot_ids = session.FindLootObjectsInRadius(own_dog.GetCoorginates(), aoi_radius);
+    const auto& loot_objects = session.GetLootObjects();
+    result->loot_objects.reserve(loot_ids.size());
+    for (const auto& obj_id : loot_ids) {
+        result->loot_objects.emplace_back(obj_id, loot_objects.at(obj_id).GetType(), session.GetLootCoordsById(obj_id));
+    }
+    return result;
+}
+
+UseCaseGetGameStateDelta::Result UseCaseGetGameStateDelta::operator()(const Token& player_token, size_t since) {
+    Result result = std::nullopt;
+    if (Player* player = GetPlayerTokens().FindPlayerByToken(player_token)) {
+        result = MakeSessionDelta(player->GetGameSession(), since);
+    }
+    return result;
+}
+
+UseCaseGetGameStateDelta::Result UseCaseGetGameStateDelta::operator()(const model::Map::Id& map_id, size_t since) {
+    Result result = std::nullopt;
+    if (!GetGame().FindMap(map_id)) {
+        return result;
+    }
+    if (const model::GameSession* session = GetGame().FindGameSession(map_id)) {
+        result = MakeSessionDelta(*session, since);
+    } else {
+        // Сессия ещё не создана: пустое полное состояние
+        result.emplace().full = true;
+    }
+    return result;
+}
+
+// SessionSnapshots
+SessionSnapshots::SessionSnapshots(const model::Game::Maps& maps) {
+    for (const auto& map : maps) {
+        snapshots_.try_emplace(map.GetId());
+    }
+}
+
+SessionSnapshots::Ptr SessionSnapshots::Load(const model::Map::Id& map_id) const {
+    if (auto it = snapshots_.find(map_id); it != snapshots_.end()) {
+        return it->second.load(std::memory_order_acquire);
+    }
+    return nullptr;
+}
+
+void SessionSnapshots::Store(const model::Map::Id& map_id, Ptr snapshot) {
+    snapshots_.at(map_id).store(std::move(snapshot), std::memory_order_release);
+}
+
+UseCaseGetSnapshot::Result UseCaseGetSnapshot::operator()(const Token& player_token) {
+    if (auto map_id = GetPlayerTokens().FindPlayerMap(player_token)) {
+        return GetSnapshots().Load(*map_id);
+    }
+    return nullptr;
+}
+
+UseCaseGetSnapshot::Result UseCaseGetSnapshot::operator()(const model::Map::Id& map_id) {
+    return GetSnapshots().Load(map_id);
+}
+
+static UseCaseGetStateVersion::Result MakeStateVersion(const SessionSnapshots::Ptr& snapshot) {
+    UseCaseGetStateVersion::Result result = std::nullopt;
+    if (snapshot) {
+        result.emplace(snapshot->session_id, snapshot->version, snapshot->tick_seq);
+    }
     return result;
 }
 
+UseCaseGetStateVersion::Result UseCaseGetStateVersion::operator()(const Token& player_token) {
+    if (auto map_id = GetPlayerTokens().FindPlayerMap(player_token)) {
+        return MakeStateVersion(GetSnapshots().Load(*map_id));
+    }
+    return std::nullopt;
+}
+
+UseCaseGetStateVersion::Result UseCaseGetStateVersion::operator()(const model::Map::Id& map_id) {
+    return MakeStateVersion(GetSnapshots().Load(map_id));
+}
+
 UseCaseMovePlayer::Result UseCaseMovePlayer::operator()(const Token& player_token, model::Dog::Direction dir) {
     Result result = false;
     if (Player* player = GetPlayerTokens().FindPlayerByToken(player_token)) {
         const auto speed = player->GetGameSession().GetMap().GetDogSpeed();
         player->GetDog().SetDirection(dir);
         player->GetDog().SetSpeed(speed);
+        player->GetGameSession().MarkDogChanged(player->GetDog().GetId());
+        LogAction(log_record::Move{player_token, dir});
         result = true;
     }
     return result;
@@ -171,6 +353,8 @@ UseCaseStopPlayer::Result UseCaseStopPlayer::operator()(const Token& player_toke
     Result result = false;
     if (Player* player = GetPlayerTokens().FindPlayerByToken(player_token)) {
         player->GetDog().Stop();
+        player->GetGameSession().MarkDogChanged(player->GetDog().GetId());
+        LogAction(log_record::Stop{player_token});
         result = true;
     }
     return result;
@@ -189,10 +373,14 @@ bool UseCaseDogRetire::operator()(model::Dog::Id dog_id, const model::Map::Id& m
     auto unit = GetUnitOfWorkFactory().CreateUnitOfWork();
     Player* player = GetPlayers().FindByDogIdAndMapId(dog_id, map_id);
     model::Dog& dog = player->GetDog();
-    unit->PlayerRepository().Save({RetiredPlayerId::New(), dog.GetName(), dog.GetScore(), dog.GetTimeInGame()});
-    unit->Commit();
+    // При воспроизведении журнала рекорд уже сохранён до сбоя
+    if (!IsReplaying()) {
+        unit->PlayerRepository().Save({RetiredPlayerId::New(), dog.GetName(), dog.GetScore(), dog.GetTimeInGame()});
+        unit->Commit();
+    }
     GetPlayers().ErasePlayer(dog_id, map_id);
     GetPlayerTokens().ErasePlayer(player);
+    LogAction(log_record::Retire{map_id, dog_id});
     return true;
 }
 
@@ -202,17 +390,20 @@ std::vector<RetiredPlayer> UseCaseRecords::operator()(int offset, int limit) {
 }
 
 // Application
-Application::Application(model::Game& game, const AppConfig& config)
-    : game_{game}
-    , db_{config.num_threads, config.db_url}
+Application::Application(model::Game& game, std::unique_ptr<UnitOfWorkFactory> unit_factory)
+    : GetGameState{this}
+    , GetSnapshot{this}
+    , GetStateVersion{this}
+    , GetGameStateDelta{this}
     , JoinPlayer{this}
-    , GetPlayers{this}
-    , GetGameState{this}
     , MovePlayer{this}
     , StopPlayer{this}
     , TimeTick{this}
     , DogRetire{this}
-    , Records{this} {
+    , Records{this}
+    , game_{game}
+    , snapshots_{game.GetMaps()}
+    , unit_factory_{std::move(unit_factory)} {
     game_.SetRetireListener([this](model::Dog::Id dog, const model::Map::Id& map) {this->DogRetire(dog, map);});
     }
 
@@ -225,10 +416,129 @@ const model::Map* Application::FindMap(const model::Map::Id& id) const noexcept
 }
 
 void Application::Tick(std::chrono::milliseconds time_delta) {
+    auto lock = LockAllSessions();
+    if (ticks_suspended_) {
+        return;
+    }
     game_.OnTick(time_delta);
-    if (listener_) {
-        listener_->OnTick(time_delta);
+    if (action_log_) {
+        for (const auto& map : game_.GetMaps()) {
+            LogTick(map.GetId(), time_delta);
+        }
     }
+    PublishSnapshots();
+    NotifyListeners(time_delta);
+}
+
+void Application::Tick(const TickSchedule::DueSessions& due, std::chrono::milliseconds time_delta) {
+    auto lock = LockAllSessions();
+    if (ticks_suspended_) {
+        return;
+    }
+    for (const auto& session : due) {
+        game_.OnTick(session.map_id, session.delta);
+        LogTick(session.map_id, session.delta);
+        PublishSnapshot(session.map_id);
+    }
+    NotifyListeners(time_delta);
+}
+
+void Application::TickSession(const model::Map::Id& map_id, std::chrono::milliseconds time_delta) {
+    if (ticks_suspended_) {
+        return;
+    }
+    game_.OnTick(map_id, time_delta);
+    LogTick(map_id, time_delta);
+    PublishSnapshot(map_id);
+}
+
+void Application::LogTick(const model::Map::Id& map_id, std::chrono::milliseconds time_delta) {
+    if (!action_log_) {
+        return;
+    }
+    if (const model::GameSession* session = game_.FindGameSession(map_id)) {
+        action_log_->Append(log_record::Tick{map_id, time_delta, session->GetLastSpawnedLoot()});
+    }
+}
+
+void Application::CompleteTick(std::chrono::milliseconds time_delta) {
+    auto lock = LockAllSessions();
+    if (ticks_suspended_) {
+        return;
+    }
+    NotifyListeners(time_delta);
+}
+
+void Application::NotifyListeners(std::chrono::milliseconds time_delta) {
+    for (const auto& listener : listeners_) {
+        listener->OnTick(time_delta);
+    }
+    // Групповая фиксация: действия за тик записываются вместе
+    if (action_log_) {
+        action_log_->Commit();
+    }
+}
+
+std::shared_lock<std::shared_mutex> Application::LockSession() const {
+    return std::shared_lock{sessions_mutex_};
+}
+
+std::unique_lock<std::shared_mutex> Application::LockAllSessions() const {
+    return std::unique_lock{sessions_mutex_};
+}
+
+bool Application::IsSnapshotStale(const model::Map::Id& map_id) const {
+    const model::GameSession* session = game_.FindGameSession(map_id);
+    if (!session) {
+        return false;
+    }
+    const auto snapshot = snapshots_.Load(map_id);
+    return !snapshot || snapshot->session_id != session->GetId() || snapshot->version != session->GetStateVersion();
+}
+
+void Application::PublishSnapshot(const model::Map::Id& map_id) {
+    if (!IsSnapshotStale(map_id)) {
+        return;
+    }
+    const model::GameSession& session = *game_.FindGameSession(map_id);
+    auto snapshot = std::make_shared<SessionSnapshot>();
+    snapshot->map_id = map_id;
+    snapshot->session_id = session.GetId();
+    snapshot->version = session.GetStateVersion();
+    snapshot->tick_seq = session.GetTickSeq();
+    snapshot->players.reserve(session.GetDogs().size());
+    for (const auto& dog : session.GetDogs()) {
+        snapshot->players.emplace_back(dog.GetId(), dog.GetName());
+    }
+    snapshot->state = MakeSessionState(session);
+    snapshots_.Store(map_id, std::move(snapshot));
+}
+
+void Application::PublishSnapshots() {
+    for (const auto& map : game_.GetMaps()) {
+        PublishSnapshot(map.GetId());
+    }
+}
+
+void Application::SetLoadShedding(bool active) {
+    game_.GetLoadShedding().max_loot_per_tick = active ? LOAD_SHEDDING_MAX_LOOT_PER_TICK : 0;
+    load_shedding_ = active;
+}
+
+void Application::SetTicksSuspended(bool suspended) {
+    ticks_suspended_ = suspended;
+}
+
+bool Application::IsLoadShedding() const noexcept {
+    return load_shedding_.load(std::memory_order_relaxed);
+}
+
+uint64_t Application::TakeShedLoot() {
+    return game_.GetLoadShedding().shed_loot.exchange(0);
+}
+
+std::optional<model::Map::Id> Application::FindPlayerMap(const Token& token) const {
+    return player_tokens_.FindPlayerMap(token);
 }
 
 void Application::TimeTickerUsed() {
@@ -239,6 +549,20 @@ PlayersState Application::GetPlayersState() const {
     return player_tokens_.GetPlayersState();
 }
 
+PlayersState Application::GetPlayersState(const model::GameSession& session) {
+    const auto& map_id = session.GetMap().GetId();
+    PlayersState content;
+    content.reserve(session.GetDogs().size());
+    for (const auto& dog : session.GetDogs()) {
+        const Player* player = players_.FindByDogIdAndMapId(dog.GetId(), map_id);
+        const Token* token = player ? player_tokens_.FindToken(player) : nullptr;
+        if (token) {
+            content.emplace_back(*token, map_id, session.GetId(), dog.GetId());
+        }
+    }
+    return content;
+}
+
 void Application::AddPlayer(Token token, const model::Map::Id& map_id,
     model::GameSession::Id session_id, model::Dog::Id dog_id) {
     model::GameSession* session =  game_.GetGameSessionByMapId(map_id);
@@ -254,7 +578,72 @@ void Application::AddPlayer(Token token, const model::Map::Id& map_id,
 }
 
 void Application::AddListener(std::unique_ptr<ApplicationListener> listener) {
-    listener_ = std::move(listener);
+    listeners_.push_back(std::move(listener));
+}
+
+void Application::SetActionLog(ActionLog* action_log) {
+    action_log_ = action_log;
+}
+
+void Application::Replay(const std::vector<LogRecord>& records) {
+    replaying_ = true;
+    try {
+        std::vector<log_record::Retire> retirements;
+        for (const auto& record : records) {
+            Replay(record, retirements);
+        }
+    } catch (...) {
+        replaying_ = false;
+        throw;
+    }
+    replaying_ = false;
+}
+
+void Application::Replay(const LogRecord& record, std::vector<log_record::Retire>& retirements) {
+    using namespace std::literals;
+    const auto diverged = [](std::string_view what) {
+        return std::runtime_error("Action log diverges from the game state: "s.append(what));
+    };
+    if (const auto* join = std::get_if<log_record::Join>(&record)) {
+        model::GameSession* session = game_.FindGameSession(join->map_id)
+            ? game_.GetGameSessionByMapId(join->map_id)
+            : game_.AddGameSession(join->map_id, *join->session_id);
+        if (!session || session->GetId() != join->session_id) {
+            throw diverged("session of joined player not found"sv);
+        }
+        const model::Dog* dog = session->NewDog(join->name, join->spawn_point);
+        if (dog->GetId() != join->dog_id) {
+            throw diverged("unexpected dog id"sv);
+        }
+        AddPlayer(join->token, join->map_id, join->session_id, join->dog_id);
+    } else if (const auto* move = std::get_if<log_record::Move>(&record)) {
+        if (!MovePlayer(move->token, move->direction)) {
+            throw diverged("moved player not found"sv);
+        }
+    } else if (const auto* stop = std::get_if<log_record::Stop>(&record)) {
+        if (!StopPlayer(stop->token)) {
+            throw diverged("stopped player not found"sv);
+        }
+    } else if (const auto* tick = std::get_if<log_record::Tick>(&record)) {
+        model::GameSession* session = game_.FindGameSession(tick->map_id)
+            ? game_.GetGameSessionByMapId(tick->map_id) : nullptr;
+        if (!session) {
+            throw diverged("ticked session not found"sv);
+        }
+        session->OnTick(tick->delta, tick->spawned_loot);
+        for (const auto& retire : retirements) {
+            if (retire.map_id == tick->map_id && players_.FindByDogIdAndMapId(retire.dog_id, retire.map_id)) {
+                throw diverged("retired player is still in game"sv);
+            }
+        }
+        std::erase_if(retirements, [&tick](const log_record::Retire& retire) {
+            return retire.map_id == tick->map_id;
+        });
+    } else if (const auto* retire = std::get_if<log_record::Retire>(&record)) {
+        // Уход на покой выполняется в тике и записывается раньше самого тика,
+        // поэтому запись только проверяется после воспроизведения тика
+        retirements.push_back(*retire);
+    }
 }
 
 } //namespace app
\ No newline at end of file
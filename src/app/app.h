@@ -1,14 +1,19 @@
 #pragma once
 
 #include "../model/model.h"
-#include "../db/postgres.h"
 
+#include "action_log.h"
 #include "player.h"
+#include "tick_schedule.h"
 #include "unit_of_work.h"
 
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <random>
+#include <shared_mutex>
 #include <unordered_map>
 
 namespace app {
@@ -23,6 +28,8 @@ public:
     virtual ~ApplicationListener() = default;
 };
 
+// Поиск игрока по токену выполняется при каждом запросе из разных потоков,
+// а добавление и удаление игроков редки, поэтому таблица защищена shared_mutex
 class PlayerTokens {
 public:
     const Token& AddPlayer(const Player& player);
@@ -31,11 +38,17 @@ public:
 
     Player* FindPlayerByToken(const Token& token) const;
 
+    // Карта, на которой играет игрок. Не обращается к сессии и может вызываться в любом потоке.
+    std::optional<model::Map::Id> FindPlayerMap(const Token& token) const;
+
     PlayersState GetPlayersState() const;
 
+    const Token* FindToken(const Player* player) const;
+
     void ErasePlayer(const Player* player);
 
 private:
+    mutable std::shared_mutex mutex_;
 
     std::unordered_map<Token, Player*, util::TaggedHasher<Token>> token_to_player_;
     std::unordered_map<const Player*, const Token*> player_to_token_;
@@ -57,11 +70,13 @@ private:
     struct Hasher{size_t operator()(const std::pair<model::Dog::Id, model::Map::Id>& item) const;};
 
     using DogIdAndMapIdToPlayer = std::unordered_map<std::pair<model::Dog::Id, model::Map::Id>, Player, Hasher>;
+    std::mutex mutex_;
     DogIdAndMapIdToPlayer players_;
 };
 
 // Use Cases
 class Application;
+class SessionSnapshots;
 class UseCaseBase {
 public:
     explicit UseCaseBase(Application* app);
@@ -70,9 +85,13 @@ protected:
     model::Game& GetGame() const noexcept;
     Players& GetPlayers() const noexcept ;
     PlayerTokens& GetPlayerTokens() const noexcept ;
+    SessionSnapshots& GetSnapshots() const noexcept;
     bool TimeTickerUsed();
+    // Добавляет запись в журнал действий, если он включён
+    void LogAction(const LogRecord& record);
+    bool IsReplaying() const noexcept;
     Application* app_;
-    postgres::UnitOfWorkFactoryImpl& GetUnitOfWorkFactory();
+    UnitOfWorkFactory& GetUnitOfWorkFactory();
 };
 
 class UseCaseJoinPlayer : public UseCaseBase {
@@ -83,14 +102,7 @@ public:
     Result operator()(const model::Map::Id& map_id, std::string dog_name);
 };
 
-class UseCaseGetPlayers : public UseCaseBase {
-public:
-    using UseCaseBase::UseCaseBase;
-
-    using Result = std::optional<std::vector<std::pair<model::Dog::Id, std::string_view>>>;
-    Result operator()(const Token& player_token);
-};
-
+// Состояние по данным самой сессии. Вызывается в strand сессии.
 class UseCaseGetGameState : public UseCaseBase {
 public:
     using UseCaseBase::UseCaseBase;
@@ -117,6 +129,87 @@ public:
     };
     using Result = std::optional<GameState>;
     Result operator()(const Token& player_token);
+
+    // Состояние в области интереса игрока: собаки и трофеи на расстоянии
+    // не больше aoi_radius от его собаки. Собака игрока включается всегда.
+    Result operator()(const Token& player_token, double aoi_radius);
+
+    // Состояние сессии на карте для зрителей. nullopt, если карта не найдена.
+    Result operator()(const model::Map::Id& map_id);
+};
+
+class UseCaseGetGameStateDelta : public UseCaseBase {
+public:
+    using UseCaseBase::UseCaseBase;
+    // Изменения сессии после тика seq. Если история изменений не покрывает seq,
+    // возвращается полное состояние с флагом full.
+    struct GameStateDelta {
+        size_t seq = 0;
+        bool full = false;
+        std::vector<UseCaseGetGameState::PlayerState> players;
+        std::vector<UseCaseGetGameState::LootObjectState> loot_objects;
+        std::vector<model::Dog::Id> retired_players;
+        std::vector<model::LootObject::Id> removed_loot_objects;
+    };
+    using Result = std::optional<GameStateDelta>;
+    Result operator()(const Token& player_token, size_t since);
+
+    // Изменения сессии на карте для зрителей. nullopt, если карта не найдена.
+    Result operator()(const model::Map::Id& map_id, size_t since);
+};
+
+// Неизменяемый снимок состояния сессии. Публикуется в strand сессии после её изменения
+// и читается из любого потока без синхронизации с симуляцией.
+struct SessionSnapshot {
+    model::Map::Id map_id{""};
+    model::GameSession::Id session_id{0};
+    size_t version = 0;
+    size_t tick_seq = 0;
+    std::vector<std::pair<model::Dog::Id, std::string>> players;
+    UseCaseGetGameState::GameState state;
+};
+
+// Последние снимки сессий по картам. Список карт не меняется после загрузки,
+// поэтому таблица заполняется в конструкторе, а снимки заменяются атомарно.
+// Старый снимок освобождается, когда его отпустит последний читатель.
+class SessionSnapshots {
+public:
+    using Ptr = std::shared_ptr<const SessionSnapshot>;
+
+    explicit SessionSnapshots(const model::Game::Maps& maps);
+
+    // nullptr, если карта не найдена или снимок ещё не опубликован
+    Ptr Load(const model::Map::Id& map_id) const;
+
+    void Store(const model::Map::Id& map_id, Ptr snapshot);
+
+private:
+    std::unordered_map<model::Map::Id, std::atomic<Ptr>, util::TaggedHasher<model::Map::Id>> snapshots_;
+};
+
+// Снимок сессии игрока или сессии на карте. Можно вызывать из любого потока.
+class UseCaseGetSnapshot : public UseCaseBase {
+public:
+    using UseCaseBase::UseCaseBase;
+    using Result = SessionSnapshots::Ptr;
+    Result operator()(const Token& player_token);
+    Result operator()(const model::Map::Id& map_id);
+};
+
+// Версия состояния по последнему опубликованному снимку. Можно вызывать из любого потока.
+class UseCaseGetStateVersion : public UseCaseBase {
+public:
+    using UseCaseBase::UseCaseBase;
+    struct StateVersion {
+        model::GameSession::Id session_id;
+        size_t version;
+        size_t tick_seq;
+    };
+    using Result = std::optional<StateVersion>;
+    Result operator()(const Token& player_token);
+
+    // Версия сессии на карте. nullopt, если сессия ещё не создана.
+    Result operator()(const model::Map::Id& map_id);
 };
 
 class UseCaseMovePlayer : public UseCaseBase {
@@ -160,25 +253,83 @@ struct AppConfig {
 class Application {
     friend UseCaseBase;
 public:
-    explicit Application(model::Game& game, const AppConfig& config);
+    explicit Application(model::Game& game, std::unique_ptr<UnitOfWorkFactory> unit_factory);
 
     const model::Game::Maps& GetMaps() const noexcept;
 
     const model::Map* FindMap(const model::Map::Id& id) const noexcept;
 
+    // Тик всех сессий и обработчики тика под исключительной блокировкой
     void Tick(std::chrono::milliseconds time_delta);
 
+    // Тик сессий, срок которых наступил по расписанию, и обработчики тика под исключительной блокировкой
+    void Tick(const TickSchedule::DueSessions& due, std::chrono::milliseconds time_delta);
+
+    // Тик одной сессии. Вызывается в strand сессии под разделяемой блокировкой.
+    void TickSession(const model::Map::Id& map_id, std::chrono::milliseconds time_delta);
+
+    // Вызывает обработчики тика после того, как тик завершился во всех сессиях
+    void CompleteTick(std::chrono::milliseconds time_delta);
+
+    // Операции над одной сессией выполняются в её strand под разделяемой блокировкой,
+    // поэтому операции над разными сессиями идут параллельно. Операции над всеми сессиями
+    // (обработчики тика, сохранение состояния) берут исключительную блокировку и выполняются
+    // между операциями над сессиями.
+    [[nodiscard]] std::shared_lock<std::shared_mutex> LockSession() const;
+
+    [[nodiscard]] std::unique_lock<std::shared_mutex> LockAllSessions() const;
+
+    std::optional<model::Map::Id> FindPlayerMap(const Token& token) const;
+
     void TimeTickerUsed();
 
     PlayersState GetPlayersState() const;
 
+    // Игроки одной сессии: обходятся только её собаки. Вызывается, когда модель не изменяется.
+    PlayersState GetPlayersState(const model::GameSession& session);
+
     void AddPlayer(Token token, const model::Map::Id& map_id,
         model::GameSession::Id session_id, model::Dog::Id dog_id);
 
     void AddListener(std::unique_ptr<ApplicationListener> listener);
 
+    // Снимок устарел, если сессия изменилась после его публикации. Вызывается в strand сессии.
+    bool IsSnapshotStale(const model::Map::Id& map_id) const;
+
+    // Публикует снимок сессии на карте, если он устарел. Вызывается в strand сессии.
+    void PublishSnapshot(const model::Map::Id& map_id);
+
+    // Публикует снимки всех сессий. Вызывается под исключительной блокировкой или до запуска сервера.
+    void PublishSnapshots();
+
+    // Трофеев, появляющихся в сессии за тик под нагрузкой
+    static constexpr unsigned LOAD_SHEDDING_MAX_LOOT_PER_TICK = 1;
+
+    // Под нагрузкой сессии не создают трофеи пачками, а запросы изменений состояния отклоняются.
+    // Можно вызывать из любого потока.
+    void SetLoadShedding(bool active);
+
+    bool IsLoadShedding() const noexcept;
+
+    // Сколько трофеев не появилось под нагрузкой с прошлого вызова
+    uint64_t TakeShedLoot();
+
+    // Действия игроков и тики записываются в журнал, записи фиксируются после каждого тика.
+    // Вызывается до запуска сервера или под исключительной блокировкой.
+    void SetActionLog(ActionLog* action_log);
+
+    // Пока тики приостановлены, они пропускаются: модель не изменяется по времени и не записывает
+    // ушедших на покой игроков (при передаче работы новому процессу). Можно вызывать из любого потока.
+    void SetTicksSuspended(bool suspended);
+
+    // Применяет записи журнала действий при восстановлении после сбоя. Ушедшие на покой игроки
+    // не сохраняются повторно. Бросает std::runtime_error, если журнал расходится с моделью.
+    void Replay(const std::vector<LogRecord>& records);
+
     UseCaseGetGameState GetGameState;
-    UseCaseGetPlayers GetPlayers;
+    UseCaseGetSnapshot GetSnapshot;
+    UseCaseGetStateVersion GetStateVersion;
+    UseCaseGetGameStateDelta GetGameStateDelta;
     UseCaseJoinPlayer JoinPlayer;
     UseCaseMovePlayer MovePlayer;
     UseCaseStopPlayer StopPlayer;
@@ -190,9 +341,23 @@ private:
     model::Game& game_;
     Players players_;
     PlayerTokens player_tokens_;
+    SessionSnapshots snapshots_;
     bool time_ticker_used_ = false;
-    postgres::Database db_;
-    std::unique_ptr<ApplicationListener> listener_;
+    std::atomic<bool> load_shedding_{false};
+    std::atomic<bool> ticks_suspended_{false};
+    std::unique_ptr<UnitOfWorkFactory> unit_factory_;
+    std::vector<std::unique_ptr<ApplicationListener>> listeners_;
+    mutable std::shared_mutex sessions_mutex_;
+    ActionLog* action_log_ = nullptr;
+    bool replaying_ = false;
+
+    void NotifyListeners(std::chrono::milliseconds time_delta);
+
+    // Записывает тик сессии и появившиеся в нём трофеи
+    void LogTick(const model::Map::Id& map_id, std::chrono::milliseconds time_delta);
+
+    // retirements - записи об уходе на покой, которые проверяются после тика их сессии
+    void Replay(const LogRecord& record, std::vector<log_record::Retire>& retirements);
 };
 
 } //namespace app
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "simulation.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace app {
+
+namespace {
+
+void PinCurrentThread(unsigned cpu) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    // Если привязать поток не удалось, симуляция продолжает работать без привязки
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+    (void)cpu;
+#endif
+}
+
+}  // namespace
+
+Simulation::Simulation(Application& app, std::chrono::milliseconds period, std::optional<unsigned> cpu,
+                       metrics::Registry* registry)
+    : app_{app}
+    , period_{period}
+    , cpu_{cpu}
+    , schedule_{app.GetMaps(), period} {
+    if (registry) {
+        metrics_.emplace(*registry);
+    }
+}
+
+Simulation::~Simulation() {
+    Stop();
+}
+
+void Simulation::Start() {
+    thread_ = std::jthread([this](std::stop_token stop) {
+        Run(std::move(stop));
+    });
+}
+
+void Simulation::Stop() {
+    if (thread_.joinable()) {
+        thread_.request_stop();
+        thread_.join();
+    }
+}
+
+void Simulation::Push(Command command) {
+    commands_.Push(std::move(command));
+}
+
+void Simulation::Run(std::stop_token stop) {
+    using namespace std::chrono;
+    using Clock = steady_clock;
+
+    if (cpu_) {
+        PinCurrentThread(*cpu_);
+    }
+    auto last_tick = Clock::now();
+    auto next_tick = last_tick + period_;
+    while (!stop.stop_requested()) {
+        std::this_thread::sleep_until(next_tick);
+        const auto this_tick = Clock::now();
+        ApplyCommands();
+        // Остаток от округления до миллисекунд переходит в следующий тик
+        const auto delta = duration_cast<milliseconds>(Clock::now() - last_tick);
+        last_tick += delta;
+        try {
+            app_.Tick(schedule_.Advance(delta), delta);
+        } catch (...) {
+            // Ошибка в тике не должна останавливать симуляцию
+        }
+        const auto now = Clock::now();
+        if (metrics_) {
+            metrics_->OnTick(this_tick - next_tick, now - this_tick);
+        }
+        next_tick += period_;
+        // Если тик не уложился в период, пропущенные тики не догоняются: их время войдёт в следующий тик
+        if (next_tick <= now) {
+            const auto missed = (now - next_tick) / period_ + 1;
+            next_tick += missed * period_;
+            if (metrics_) {
+                metrics_->missed_deadlines.Add(missed);
+            }
+        }
+    }
+    ApplyCommands();
+}
+
+void Simulation::ApplyCommands() {
+    while (auto command = commands_.TryPop()) {
+        try {
+            (*command)();
+        } catch (...) {
+            // Команда сама отвечает об ошибке, остальные команды пачки должны примениться
+        }
+    }
+}
+
+}  // namespace app
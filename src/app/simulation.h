@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../metrics/metrics.h"
+#include "../util/mpsc_queue.h"
+
+#include "app.h"
+#include "tick_schedule.h"
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <thread>
+
+namespace app {
+
+// Симуляция игры в отдельном потоке, которому принадлежит модель игры.
+// Команды (вход, перемещение и остановка игроков, запросы к сессиям) передаются
+// через очередь без блокировок и применяются пачкой в начале каждого тика, после чего выполняется тик.
+// Начало тика определяется только периодом и не зависит от очереди задач ввода-вывода.
+// Сессии карт с собственным периодом тиков обновляются по расписанию TickSchedule.
+class Simulation {
+public:
+    using Command = std::function<void()>;
+
+    // cpu - номер процессора, к которому привязывается поток (только Linux)
+    Simulation(Application& app, std::chrono::milliseconds period, std::optional<unsigned> cpu = std::nullopt,
+               metrics::Registry* registry = nullptr);
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    ~Simulation();
+
+    void Start();
+
+    // Останавливает поток после текущего тика. Команды, оставшиеся в очереди, применяются.
+    void Stop();
+
+    // Можно вызывать из любого потока. Ответ команда отправляет сама.
+    void Push(Command command);
+
+    bool IsRunningInThisThread() const noexcept {
+        return thread_.get_id() == std::this_thread::get_id();
+    }
+
+private:
+    void Run(std::stop_token stop);
+
+    void ApplyCommands();
+
+    Application& app_;
+    const std::chrono::milliseconds period_;
+    const std::optional<unsigned> cpu_;
+    std::optional<metrics::TickMetrics> metrics_;
+    TickSchedule schedule_;
+    util::MpscQueue<Command> commands_;
+    std::jthread thread_;
+};
+
+}  // namespace app
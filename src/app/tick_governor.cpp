@@ -0,0 +1,67 @@
+#include "tick_governor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace app {
+
+using namespace std::literals;
+
+TickGovernor::Metrics::Metrics(metrics::Registry& registry)
+    : period_seconds{registry.AddGauge("game_tick_period_seconds"sv, "Current tick period"sv)}
+    , period_changes{registry.AddCounter("game_tick_period_changes_total"sv,
+        "Number of tick period changes made by the adaptive tick rate"sv)}
+    , shedding{registry.AddGauge("game_load_shedding"sv, "1 while optional work is shed under load"sv)}
+    , shed_loot{registry.AddCounter("game_shed_loot_total"sv, "Number of loot objects not spawned under load"sv)} {
+}
+
+TickGovernor::TickGovernor(Application& app, Config config, metrics::Registry* registry)
+    : app_{app}
+    , config_{config}
+    , period_{config.min_period} {
+    if (config_.min_period <= 0ms || config_.max_period < config_.min_period) {
+        throw std::invalid_argument("Invalid adaptive tick period bounds");
+    }
+    if (registry) {
+        metrics_.emplace(*registry);
+        metrics_->period_seconds.Set(std::chrono::duration<double>(period_).count());
+    }
+}
+
+std::chrono::milliseconds TickGovernor::OnTick(std::chrono::milliseconds duration, size_t queue_depth) {
+    const double load = std::chrono::duration<double>(duration) / std::chrono::duration<double>(period_);
+    if (load > config_.high_load || queue_depth > config_.max_queue_depth) {
+        calm_ticks_ = 0;
+        // Период растёт в полтора раза, но не меньше чем на 1 мс
+        SetPeriod(std::min(config_.max_period, std::max(period_ * 3 / 2, period_ + 1ms)));
+        app_.SetLoadShedding(true);
+    } else if (load < config_.low_load && queue_depth <= config_.max_queue_depth / 2) {
+        if (++calm_ticks_ >= config_.recovery_ticks) {
+            calm_ticks_ = 0;
+            SetPeriod(std::max(config_.min_period, period_ * 4 / 5));
+            if (period_ == config_.min_period) {
+                app_.SetLoadShedding(false);
+            }
+        }
+    } else {
+        calm_ticks_ = 0;
+    }
+    if (metrics_) {
+        metrics_->shedding.Set(app_.IsLoadShedding() ? 1. : 0.);
+        metrics_->shed_loot.Add(app_.TakeShedLoot());
+    }
+    return period_;
+}
+
+void TickGovernor::SetPeriod(std::chrono::milliseconds period) {
+    if (period == period_) {
+        return;
+    }
+    period_ = period;
+    if (metrics_) {
+        metrics_->period_changes.Add();
+        metrics_->period_seconds.Set(std::chrono::duration<double>(period_).count());
+    }
+}
+
+}  // namespace app
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../metrics/metrics.h"
+
+#include "app.h"
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+namespace app {
+
+// Адаптивный период тиков. После каждого тика получает его длительность (от запуска до завершения
+// во всех сессиях, включая ожидание в очередях strand) и число задач в очередях сессий.
+// Под нагрузкой удлиняет период в заданных пределах и включает сброс необязательной работы,
+// после спада нагрузки постепенно возвращает период к минимальному и выключает сброс.
+class TickGovernor {
+public:
+    struct Config {
+        std::chrono::milliseconds min_period;
+        std::chrono::milliseconds max_period;
+        // Доля периода, занятая тиком, выше которой сервер перегружен
+        double high_load = 0.8;
+        // Доля периода, ниже которой период можно сокращать
+        double low_load = 0.4;
+        // Число задач в очередях сессий, выше которого сервер перегружен
+        size_t max_queue_depth = 1000;
+        // Сколько спокойных тиков подряд нужно для сокращения периода
+        size_t recovery_ticks = 10;
+    };
+
+    TickGovernor(Application& app, Config config, metrics::Registry* registry = nullptr);
+
+    // Учитывает завершившийся тик и возвращает период следующего тика
+    std::chrono::milliseconds OnTick(std::chrono::milliseconds duration, size_t queue_depth);
+
+    std::chrono::milliseconds GetPeriod() const noexcept {
+        return period_;
+    }
+
+private:
+    struct Metrics {
+        explicit Metrics(metrics::Registry& registry);
+
+        metrics::Gauge& period_seconds;
+        metrics::Counter& period_changes;
+        metrics::Gauge& shedding;
+        metrics::Counter& shed_loot;
+    };
+
+    void SetPeriod(std::chrono::milliseconds period);
+
+    Application& app_;
+    const Config config_;
+    std::optional<Metrics> metrics_;
+    std::chrono::milliseconds period_;
+    size_t calm_ticks_ = 0;
+};
+
+}  // namespace app
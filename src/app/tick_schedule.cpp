@@ -0,0 +1,41 @@
+#include "tick_schedule.h"
+
+#include <unordered_map>
+#include <utility>
+
+namespace app {
+
+TickSchedule::TickSchedule(const model::Game::Maps& maps, std::chrono::milliseconds base_period)
+    : base_period_{base_period} {
+    // Номер следующей карты среди карт с тем же делителем задаёт её сдвиг
+    std::unordered_map<size_t, size_t> maps_per_divisor;
+    entries_.reserve(maps.size());
+    for (const auto& map : maps) {
+        const size_t divisor = map.GetTickDivisor(base_period_);
+        const size_t phase = maps_per_divisor[divisor]++ % divisor;
+        entries_.push_back(Entry{map.GetId(), divisor, phase});
+    }
+}
+
+size_t TickSchedule::GetDivisor(const model::Map::Id& map_id) const noexcept {
+    for (const auto& entry : entries_) {
+        if (entry.map_id == map_id) {
+            return entry.divisor;
+        }
+    }
+    return 0;
+}
+
+TickSchedule::DueSessions TickSchedule::Advance(std::chrono::milliseconds delta) {
+    ++base_ticks_;
+    DueSessions due;
+    for (auto& entry : entries_) {
+        entry.accumulated += delta;
+        if ((base_ticks_ + entry.phase) % entry.divisor == 0) {
+            due.push_back(DueSession{entry.map_id, std::exchange(entry.accumulated, std::chrono::milliseconds{0})});
+        }
+    }
+    return due;
+}
+
+}  // namespace app
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../model/model.h"
+
+#include <chrono>
+#include <vector>
+
+namespace app {
+
+// Расписание тиков сессий с разным периодом по одному общему таймеру с базовым периодом.
+// Сессия карты обновляется раз в несколько базовых тиков и получает всё время, накопленное с её прошлого тика.
+// Карты с одинаковым делителем распределены по разным базовым тикам, чтобы нагрузка не приходилась на один тик.
+class TickSchedule {
+public:
+    struct DueSession {
+        model::Map::Id map_id;
+        std::chrono::milliseconds delta;
+    };
+    using DueSessions = std::vector<DueSession>;
+
+    TickSchedule(const model::Game::Maps& maps, std::chrono::milliseconds base_period);
+
+    std::chrono::milliseconds GetBasePeriod() const noexcept {
+        return base_period_;
+    }
+
+    // Через сколько базовых тиков обновляется сессия карты. 0, если карта не найдена.
+    size_t GetDivisor(const model::Map::Id& map_id) const noexcept;
+
+    // Учитывает прошедший базовый тик длительностью delta и возвращает сессии, срок которых наступил
+    DueSessions Advance(std::chrono::milliseconds delta);
+
+private:
+    struct Entry {
+        model::Map::Id map_id;
+        size_t divisor;
+        size_t phase;
+        std::chrono::milliseconds accumulated{0};
+    };
+
+    std::chrono::milliseconds base_period_;
+    std::vector<Entry> entries_;
+    size_t base_ticks_ = 0;
+};
+
+}  // namespace app
@@ -16,8 +16,7 @@ public:
 class UnitOfWorkFactory {
 public:
     virtual std::unique_ptr<UnitOfWork> CreateUnitOfWork() = 0;
-protected:
-    ~UnitOfWorkFactory() = default;
+    virtual ~UnitOfWorkFactory() = default;
 };
 
 } // namespace app
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "in_memory.h"
+
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace in_memory {
+
+using namespace std::literals;
+
+// RetiredPlayersStorage
+RetiredPlayersStorage::RetiredPlayersStorage(std::optional<std::filesystem::path> journal_path /* = std::nullopt */) {
+    if (!journal_path) {
+        return;
+    }
+    LoadJournal(*journal_path);
+    journal_.open(*journal_path, std::ios::app);
+    if (!journal_) {
+        throw std::runtime_error("Failed to open records file "s + journal_path->string());
+    }
+}
+
+bool RetiredPlayersStorage::Order::operator()(const app::RetiredPlayer& lhs, const app::RetiredPlayer& rhs) const {
+    if (lhs.GetScore() != rhs.GetScore()) {
+        return lhs.GetScore() > rhs.GetScore();
+    }
+    if (lhs.PlayTime() != rhs.PlayTime()) {
+        return lhs.PlayTime() < rhs.PlayTime();
+    }
+    return lhs.GetName() < rhs.GetName();
+}
+
+void RetiredPlayersStorage::Append(std::vector<app::RetiredPlayer> players) {
+    std::unique_lock lock{mutex_};
+    for (auto& player : players) {
+        if (journal_.is_open()) {
+            WriteToJournal(player);
+        }
+        players_.emplace(std::move(player));
+    }
+    if (journal_.is_open()) {
+        journal_.flush();
+    }
+}
+
+std::vector<app::RetiredPlayer> RetiredPlayersStorage::GetRange(int offset, int limit) const {
+    std::vector<app::RetiredPlayer> result;
+    std::shared_lock lock{mutex_};
+    if (offset < 0 || limit <= 0 || static_cast<size_t>(offset) >= players_.size()) {
+        return result;
+    }
+    result.reserve(std::min(static_cast<size_t>(limit), players_.size() - offset));
+    auto it = std::next(players_.begin(), offset);
+    for (; it != players_.end() && result.size() < static_cast<size_t>(limit); ++it) {
+        result.push_back(*it);
+    }
+    return result;
+}
+
+size_t RetiredPlayersStorage::Size() const {
+    std::shared_lock lock{mutex_};
+    return players_.size();
+}
+
+void RetiredPlayersStorage::LoadJournal(const std::filesystem::path& journal_path) {
+    if (std::error_code ec; !std::filesystem::exists(journal_path, ec)) {
+        return;
+    }
+    std::ifstream journal(journal_path);
+    std::string id, name;
+    size_t score, play_time;
+    // Недописанная последняя строка (например, после аварийного завершения) пропускается
+    while (journal >> id >> score >> play_time >> std::quoted(name)) {
+        players_.emplace(app::RetiredPlayerId::FromString(id), std::move(name), score, play_time);
+    }
+}
+
+void RetiredPlayersStorage::WriteToJournal(const app::RetiredPlayer& player) {
+    journal_ << player.GetId().ToString() << ' ' << player.GetScore() << ' '
+             << player.PlayTime() << ' ' << std::quoted(player.GetName()) << '\n';
+}
+
+// RetiredPlayerRepoImpl
+RetiredPlayerRepoImpl::RetiredPlayerRepoImpl(const RetiredPlayersStorage& storage)
+    : storage_{storage} {
+}
+
+void RetiredPlayerRepoImpl::Save(const app::RetiredPlayer& player) {
+    pending_.push_back(player);
+}
+
+std::vector<app::RetiredPlayer> RetiredPlayerRepoImpl::GetSavedRetiredPlayers(int offset, int limit) {
+    return storage_.GetRange(offset, limit);
+}
+
+std::vector<app::RetiredPlayer> RetiredPlayerRepoImpl::ExtractPending() {
+    return std::exchange(pending_, {});
+}
+
+// UnitOfWorkImpl
+UnitOfWorkImpl::UnitOfWorkImpl(RetiredPlayersStorage& storage)
+    : storage_{storage} {
+}
+
+app::RetiredPlayerRepository& UnitOfWorkImpl::PlayerRepository() {
+    return player_rep_;
+}
+
+void UnitOfWorkImpl::Commit() {
+    storage_.Append(player_rep_.ExtractPending());
+}
+
+// UnitOfWorkFactoryImpl
+UnitOfWorkFactoryImpl::UnitOfWorkFactoryImpl(std::optional<std::filesystem::path> journal_path /* = std::nullopt */)
+    : storage_{std::move(journal_path)} {
+}
+
+std::unique_ptr<app::UnitOfWork> UnitOfWorkFactoryImpl::CreateUnitOfWork() {
+    return std::make_unique<UnitOfWorkImpl>(storage_);
+}
+
+} // namespace in_memory
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../app/unit_of_work.h"
+#include "../app/player.h"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <vector>
+
+namespace in_memory {
+
+// Упорядоченное хранилище ушедших на покой игроков.
+// Порядок совпадает с индексом score_play_time_idx в Postgres.
+// Если задан journal_path, каждая зафиксированная запись дописывается в конец файла,
+// а при создании хранилища записи восстанавливаются из него.
+class RetiredPlayersStorage {
+public:
+    explicit RetiredPlayersStorage(std::optional<std::filesystem::path> journal_path = std::nullopt);
+
+    RetiredPlayersStorage(const RetiredPlayersStorage&) = delete;
+    RetiredPlayersStorage& operator=(const RetiredPlayersStorage&) = delete;
+
+    void Append(std::vector<app::RetiredPlayer> players);
+
+    std::vector<app::RetiredPlayer> GetRange(int offset, int limit) const;
+
+    size_t Size() const;
+
+private:
+    struct Order {
+        bool operator()(const app::RetiredPlayer& lhs, const app::RetiredPlayer& rhs) const;
+    };
+
+    void LoadJournal(const std::filesystem::path& journal_path);
+
+    void WriteToJournal(const app::RetiredPlayer& player);
+
+    mutable std::shared_mutex mutex_;
+    std::multiset<app::RetiredPlayer, Order> players_;
+    std::ofstream journal_;
+};
+
+class RetiredPlayerRepoImpl : public app::RetiredPlayerRepository {
+public:
+    explicit RetiredPlayerRepoImpl(const RetiredPlayersStorage& storage);
+
+    void Save(const app::RetiredPlayer& player) override;
+
+    std::vector<app::RetiredPlayer> GetSavedRetiredPlayers(int offset, int limit) override;
+
+    std::vector<app::RetiredPlayer> ExtractPending();
+
+private:
+    const RetiredPlayersStorage& storage_;
+    std::vector<app::RetiredPlayer> pending_;
+};
+
+class UnitOfWorkImpl : public app::UnitOfWork {
+public:
+    explicit UnitOfWorkImpl(RetiredPlayersStorage& storage);
+
+    app::RetiredPlayerRepository& PlayerRepository() override;
+
+    void Commit() override;
+
+private:
+    RetiredPlayersStorage& storage_;
+    RetiredPlayerRepoImpl player_rep_{storage_};
+};
+
+class UnitOfWorkFactoryImpl : public app::UnitOfWorkFactory {
+public:
+    explicit UnitOfWorkFactoryImpl(std::optional<std::filesystem::path> journal_path = std::nullopt);
+
+    std::unique_ptr<app::UnitOfWork> CreateUnitOfWork() override;
+
+private:
+    RetiredPlayersStorage storage_;
+};
+
+} // namespace in_memory
@@ -50,17 +50,7 @@ void UnitOfWorkImpl::Commit() {
 }
 
 // UnitOfWorkFactoryImpl::
-UnitOfWorkFactoryImpl::UnitOfWorkFactoryImpl(size_t thread_num, const std::string& db_url)
-    : conn_pool_{thread_num, [db_url] {return std::make_shared<pqxx::connection>(db_url);}} {
-    }
-
-std::unique_ptr<app::UnitOfWork> UnitOfWorkFactoryImpl::CreateUnitOfWork() {
-    return std::make_unique<UnitOfWorkImpl>(conn_pool_.GetConnection());
-}
-
-//Database
-Database::Database(size_t thread_num, const std::string& db_url)
-    : unit_factory_{thread_num, db_url} {
+static void PrepareDatabase(const std::string& db_url) {
     pqxx::connection conn(db_url);
     pqxx::work work(conn);
     work.exec(
@@ -79,6 +69,15 @@ name);
 )"_zv
     );
     work.commit();
+}
+
+UnitOfWorkFactoryImpl::UnitOfWorkFactoryImpl(size_t thread_num, const std::string& db_url)
+    : conn_pool_{thread_num, [db_url] {return std::make_shared<pqxx::connection>(db_url);}} {
+    PrepareDatabase(db_url);
     }
 
+std::unique_ptr<app::UnitOfWork> UnitOfWorkFactoryImpl::CreateUnitOfWork() {
+    return std::make_unique<UnitOfWorkImpl>(conn_pool_.GetConnection());
+}
+
 } //namespace postgres
\ No newline at end of file
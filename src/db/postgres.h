@@ -42,16 +42,4 @@ private:
     conn_pool::ConnectionPool conn_pool_;
 };
 
-class Database {
-public:
-    explicit Database(size_t thread_num, const std::string& db_url);
-
-    UnitOfWorkFactoryImpl& GetUnitOfWorkFactory() {
-        return unit_factory_;
-    }
-
-private:
-    UnitOfWorkFactoryImpl unit_factory_;
-};
-
 } // namespace postgres
\ No newline at end of file
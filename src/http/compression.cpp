@@ -0,0 +1,152 @@
+#include "compression.h"
+
+#include "header_parsing.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace http_handler {
+
+namespace {
+
+// Насколько точно coding описывает кодирование: 2 - по имени, 1 - "*", 0 - не описывает
+int MatchLevel(std::string_view coding, ContentEncoding encoding) {
+    if (coding == "*"sv) {
+        return 1;
+    }
+    if (encoding == ContentEncoding::GZIP) {
+        return boost::iequals(coding, ContentEncodingName::GZIP) || boost::iequals(coding, "x-gzip"sv) ? 2 : 0;
+    }
+    return boost::iequals(coding, ContentEncodingName::DEFLATE) ? 2 : 0;
+}
+
+std::string ReadFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file "s + path.string());
+    }
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+}  // namespace
+
+std::string_view ToString(ContentEncoding encoding) {
+    switch (encoding) {
+    case ContentEncoding::GZIP:
+        return ContentEncodingName::GZIP;
+    case ContentEncoding::DEFLATE:
+        return ContentEncodingName::DEFLATE;
+    default:
+        return ContentEncodingName::IDENTITY;
+    }
+}
+
+ContentEncoding ChooseContentEncoding(std::string_view accept_encoding) {
+    // Качество кодирования задаёт элемент, указавший его по имени: gzip;q=0 исключает gzip, даже если указан *
+    struct Match {
+        int level = 0;
+        double quality = 0.;
+    };
+    constexpr std::array encodings{ContentEncoding::GZIP, ContentEncoding::DEFLATE};
+    std::array<Match, encodings.size()> matches;
+    while (!accept_encoding.empty()) {
+        size_t end = accept_encoding.find(',');
+        std::string_view item = accept_encoding.substr(0, end);
+        size_t params_start = item.find(';');
+        const auto coding = Trim(item.substr(0, params_start));
+        for (size_t i = 0; i < encodings.size(); ++i) {
+            const int level = MatchLevel(coding, encodings[i]);
+            if (level > matches[i].level) {
+                const double quality = params_start == std::string_view::npos
+                    ? 1.
+                    : ParseQuality(item.substr(params_start + 1));
+                matches[i] = {level, quality};
+            }
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        accept_encoding.remove_prefix(end + 1);
+    }
+
+    // При равных весах побеждает gzip: он идёт первым
+    ContentEncoding best = ContentEncoding::IDENTITY;
+    double best_quality = 0.;
+    for (size_t i = 0; i < encodings.size(); ++i) {
+        if (matches[i].quality > best_quality) {
+            best = encodings[i];
+            best_quality = matches[i].quality;
+        }
+    }
+    return best;
+}
+
+std::string Compress(std::string_view data, ContentEncoding encoding, int level) {
+    namespace io = boost::iostreams;
+    std::string compressed;
+    compressed.reserve(data.size() / 4);
+    {
+        io::filtering_ostream stream;
+        if (encoding == ContentEncoding::GZIP) {
+            stream.push(io::gzip_compressor(io::gzip_params(level)));
+        } else {
+            // В HTTP "deflate" означает поток в формате zlib (RFC 1950)
+            stream.push(io::zlib_compressor(io::zlib_params(level)));
+        }
+        stream.push(io::back_inserter(compressed));
+        stream.write(data.data(), data.size());
+    }
+    return compressed;
+}
+
+bool IsPrecompressedContentType(std::string_view content_type) {
+    return (content_type.starts_with("image/"sv) && content_type != "image/svg+xml"sv)
+        || content_type.starts_with("audio/"sv)
+        || content_type.starts_with("video/"sv);
+}
+
+// ResponseCompressor
+ContentEncoding ResponseCompressor::Choose(std::string_view accept_encoding, size_t body_size) const {
+    if (config_.level <= 0 || body_size < config_.min_size || accept_encoding.empty()) {
+        return ContentEncoding::IDENTITY;
+    }
+    return ChooseContentEncoding(accept_encoding);
+}
+
+void ResponseCompressor::CompressResponse(http::response<http::string_body>& response, ContentEncoding encoding) const {
+    if (encoding == ContentEncoding::IDENTITY || response.count(http::field::content_encoding)) {
+        return;
+    }
+    response.body() = Compress(response.body(), encoding, config_.level);
+    response.set(http::field::content_encoding, ToString(encoding));
+    AddVary(response, http::to_string(http::field::accept_encoding));
+    response.content_length(response.body().size());
+}
+
+std::shared_ptr<const std::string> ResponseCompressor::GetCompressedFile(const fs::path& path, ContentEncoding encoding) const {
+    const auto write_time = fs::last_write_time(path);
+    const auto size = fs::file_size(path);
+    FileKey key{path.string(), encoding};
+    {
+        std::lock_guard lock{files_mutex_};
+        if (auto it = files_.find(key); it != files_.end() && it->second.write_time == write_time && it->second.size == size) {
+            return it->second.body;
+        }
+    }
+    // Сжатие выполняется без блокировки: одновременные запросы одного файла
+    // могут сжать его несколько раз, но не задерживают запросы других файлов
+    auto body = std::make_shared<const std::string>(Compress(ReadFile(path), encoding, config_.level));
+    std::lock_guard lock{files_mutex_};
+    files_.insert_or_assign(std::move(key), CachedFile{write_time, size, body});
+    return body;
+}
+
+}  // namespace http_handler
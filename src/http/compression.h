@@ -0,0 +1,136 @@
+#pragma once
+
+#include <boost/beast/http.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http_handler {
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace fs = std::filesystem;
+using namespace std::literals;
+
+// Кодирование тела ответа, выбираемое по заголовку Accept-Encoding
+enum class ContentEncoding {
+    IDENTITY,
+    GZIP,
+    DEFLATE,
+};
+
+struct ContentEncodingName {
+    ContentEncodingName() = delete;
+    static constexpr std::string_view GZIP      = "gzip"sv;
+    static constexpr std::string_view DEFLATE   = "deflate"sv;
+    static constexpr std::string_view IDENTITY  = "identity"sv;
+};
+
+struct CompressionConfig {
+    // Уровень сжатия zlib от 1 до 9, 0 отключает сжатие
+    int level = 6;
+    // Ответы меньшего размера отправляются без сжатия
+    size_t min_size = 1024;
+};
+
+std::string_view ToString(ContentEncoding encoding);
+
+// Выбирает кодирование с учётом q-параметров: вес кодирования задаёт элемент, указавший его по имени,
+// а не *. При равных весах gzip предпочтительнее deflate
+ContentEncoding ChooseContentEncoding(std::string_view accept_encoding);
+
+std::string Compress(std::string_view data, ContentEncoding encoding, int level);
+
+// Тип содержимого, которое уже сжато и не выигрывает от повторного сжатия
+bool IsPrecompressedContentType(std::string_view content_type);
+
+class ResponseCompressor {
+public:
+    explicit ResponseCompressor(CompressionConfig config = {})
+        : config_{config} {
+    }
+
+    const CompressionConfig& GetConfig() const noexcept {
+        return config_;
+    }
+
+    // Кодирование, которым нужно сжать тело размера body_size, или IDENTITY
+    ContentEncoding Choose(std::string_view accept_encoding, size_t body_size) const;
+
+    // Сжимает тело ответа и выставляет Content-Encoding и Vary
+    void CompressResponse(http::response<http::string_body>& response, ContentEncoding encoding) const;
+
+    // Сжатое содержимое статического файла. Файл сжимается один раз,
+    // повторно - только если изменились время модификации или размер.
+    std::shared_ptr<const std::string> GetCompressedFile(const fs::path& path, ContentEncoding encoding) const;
+
+private:
+    struct CachedFile {
+        fs::file_time_type write_time;
+        uintmax_t size;
+        std::shared_ptr<const std::string> body;
+    };
+    using FileKey = std::pair<std::string, ContentEncoding>;
+    struct FileKeyHasher {
+        size_t operator()(const FileKey& key) const {
+            return std::hash<std::string>{}(key.first) * 3 + static_cast<size_t>(key.second);
+        }
+    };
+
+    CompressionConfig config_;
+    mutable std::mutex files_mutex_;
+    mutable std::unordered_map<FileKey, CachedFile, FileKeyHasher> files_;
+};
+
+// Тело ответа, разделяющее неизменяемый буфер с кэшем: содержимое не копируется в каждый ответ
+struct SharedStringBody {
+    using value_type = std::shared_ptr<const std::string>;
+
+    static std::uint64_t size(const value_type& body) {
+        return body ? body->size() : 0;
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = boost::asio::const_buffer;
+
+        template <bool isRequest, typename Fields>
+        writer(const http::header<isRequest, Fields>&, const value_type& body)
+            : body_{body} {
+        }
+
+        void init(beast::error_code& ec) {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            if (!body_ || body_->empty()) {
+                return boost::none;
+            }
+            return {{const_buffers_type{body_->data(), body_->size()}, false}};
+        }
+
+    private:
+        const value_type& body_;
+    };
+};
+
+// Добавляет значение к заголовку Vary, сохраняя уже указанные
+template <typename Body, typename Fields>
+void AddVary(http::response<Body, Fields>& response, std::string_view value) {
+    auto vary = response[http::field::vary];
+    if (vary.empty()) {
+        response.set(http::field::vary, value);
+    } else {
+        response.set(http::field::vary, std::string{vary}.append(", "sv).append(value));
+    }
+}
+
+}  // namespace http_handler
@@ -0,0 +1,37 @@
+#include "header_parsing.h"
+
+#include <charconv>
+
+namespace http_handler {
+
+using namespace std::literals;
+
+std::string_view Trim(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+double ParseQuality(std::string_view params) {
+    while (!params.empty()) {
+        size_t end = params.find(';');
+        std::string_view param = Trim(params.substr(0, end));
+        if (param.starts_with("q="sv)) {
+            double q = 0.;
+            param.remove_prefix(2);
+            auto [ptr, ec] = std::from_chars(param.data(), param.data() + param.size(), q);
+            return ec == std::errc{} ? q : 0.;
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        params.remove_prefix(end + 1);
+    }
+    return 1.;
+}
+
+}  // namespace http_handler
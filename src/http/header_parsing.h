@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string_view>
+
+namespace http_handler {
+
+// Разбор списков в заголовках Accept и Accept-Encoding: "элемент;параметр=значение, ..."
+
+// Отбрасывает пробелы и табуляции по краям
+std::string_view Trim(std::string_view str);
+
+// Вес q из параметров элемента списка ("level=1; q=0.5"): 1, если q не указан, 0, если значение некорректно
+double ParseQuality(std::string_view params);
+
+}  // namespace http_handler
@@ -2,6 +2,7 @@
 
 #include <boost/asio/dispatch.hpp>
 #include <iostream>
+#include <vector>
 
 namespace http_server {
 
@@ -10,18 +11,82 @@ void ReportError(beast::error_code ec, std::string_view where) {
 
 }
 
+// Connections
+void Connections::Add(const std::shared_ptr<SessionBase>& session) {
+    std::lock_guard lock{mutex_};
+    sessions_.emplace(session.get(), session);
+}
+
+void Connections::Remove(SessionBase* session) noexcept {
+    std::lock_guard lock{mutex_};
+    sessions_.erase(session);
+}
+
+void Connections::Drain() {
+    draining_.store(true, std::memory_order_release);
+    std::vector<std::shared_ptr<SessionBase>> sessions;
+    {
+        std::lock_guard lock{mutex_};
+        for (const auto& [ptr, session] : sessions_) {
+            if (auto locked = session.lock()) {
+                sessions.push_back(std::move(locked));
+            }
+        }
+    }
+    // Сессии, созданные после установки флага, закрываются сами перед чтением запроса
+    for (auto& session : sessions) {
+        session->Drain();
+    }
+}
+
+// SessionBase
 void SessionBase::Run() {
+    if (connections_) {
+        connections_->Add(GetSharedThis());
+    }
     net::dispatch(
         stream_.get_executor(),
         beast::bind_front_handler(&SessionBase::Read, GetSharedThis())
     );
 }
 
-SessionBase::SessionBase(tcp::socket&& socket)
-    : stream_(std::move(socket)) {}
+SessionBase::SessionBase(tcp::socket&& socket, StreamHandler stream_handler, std::shared_ptr<Connections> connections)
+    : stream_handler_(std::move(stream_handler))
+    , connections_(std::move(connections))
+    , stream_(std::move(socket)) {}
+
+SessionBase::~SessionBase() {
+    if (connections_) {
+        if (handling_) {
+            connections_->OnRequestFinished();
+        }
+        connections_->Remove(this);
+    }
+}
+
+void SessionBase::Drain() {
+    // Пока сессия не проверена в своём strand, она считается обрабатывающей запрос
+    connections_->OnRequestStarted();
+    net::dispatch(stream_.get_executor(), [self = GetSharedThis()] {
+        if (self->reading_ && !self->handling_) {
+            sys::error_code ec;
+            if (self->buffer_.size() != 0 || self->stream_.socket().available(ec) != 0) {
+                // Запрос уже приходит: он будет обработан, а соединение закроется после ответа
+                self->handling_ = true;
+                return;
+            }
+            self->stream_.cancel();
+        }
+        self->connections_->OnRequestFinished();
+    });
+}
 
 void SessionBase::Read() {
+    if (IsDraining()) {
+        return Close();
+    }
     request_ = {};
+    reading_ = true;
     stream_.expires_after(30s);
     http::async_read(stream_, buffer_, request_,
         beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis())
@@ -29,25 +94,51 @@ void SessionBase::Read() {
 }
 
 void SessionBase::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+    reading_ = false;
+    if (ec) {
+        FinishRequest();
+    }
     if (ec == http::error::end_of_stream) {
         return Close();
     }
+    if (ec == net::error::operation_aborted && IsDraining()) {
+        return Close();
+    }
     if (ec) {
         return ReportError(ec, server_logging::LogMsg::READ);
     }
+    if (stream_handler_ && stream_handler_(stream_, request_)) {
+        return FinishRequest();
+    }
+    StartRequest();
     HandleRequest(std::move(request_));
 }
 
 void SessionBase::OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+    FinishRequest();
     if (ec) {
         return ReportError(ec, server_logging::LogMsg::WRITE);
     }
-    if (close) {
+    if (close || IsDraining()) {
         return Close();
     }
     Read();
 }
 
+void SessionBase::StartRequest() {
+    if (connections_ && !handling_) {
+        handling_ = true;
+        connections_->OnRequestStarted();
+    }
+}
+
+void SessionBase::FinishRequest() {
+    if (handling_) {
+        handling_ = false;
+        connections_->OnRequestFinished();
+    }
+}
+
 void SessionBase::Close() {
     stream_.socket().shutdown(tcp::socket::shutdown_send);
 }
@@ -7,7 +7,14 @@
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 
+#include <atomic>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 namespace http_server {
 
@@ -22,6 +29,54 @@ using tcp = net::ip::tcp;
 
 void ReportError(beast::error_code ec, std::string_view what);
 
+// Обработчик, которому можно передать соединение целиком (WebSocket, поток событий).
+// Вызывается для каждого запроса до обработчика запросов. Если возвращает true,
+// он забрал поток и запрос во владение, и HTTP-сессия завершается.
+using StreamHandler = std::function<bool(beast::tcp_stream& stream, http::request<http::string_body>& request)>;
+
+class SessionBase;
+
+// Открытые HTTP-сессии. При передаче работы новому процессу сессии перестают читать запросы:
+// ожидающие запроса закрываются сразу, обрабатывающие запрос - после ответа с Connection: close.
+// Соединения, переданные обработчику потока (WebSocket, поток событий), не учитываются.
+class Connections {
+public:
+    void Add(const std::shared_ptr<SessionBase>& session);
+
+    void Remove(SessionBase* session) noexcept;
+
+    // Можно вызывать из любого потока
+    void Drain();
+
+    // Снова принимать запросы, если передача работы не состоялась
+    void Resume() noexcept {
+        draining_.store(false, std::memory_order_release);
+    }
+
+    bool IsDraining() const noexcept {
+        return draining_.load(std::memory_order_acquire);
+    }
+
+    // Число сессий, которые прочитали запрос и ещё не отправили ответ
+    size_t GetActiveCount() const noexcept {
+        return active_.load(std::memory_order_acquire);
+    }
+
+    void OnRequestStarted() noexcept {
+        active_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    void OnRequestFinished() noexcept {
+        active_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<SessionBase*, std::weak_ptr<SessionBase>> sessions_;
+    std::atomic<bool> draining_{false};
+    std::atomic<size_t> active_{0};
+};
+
 class SessionBase {
 public:
     SessionBase(const SessionBase&) = delete;
@@ -29,12 +84,15 @@ public:
 
     void Run();
 
+    // Закрывает соединение, если оно ожидает запроса. Можно вызывать из любого потока.
+    void Drain();
+
 protected:
     using HttpRequest = http::request<http::string_body>;
 
-    explicit SessionBase(tcp::socket&& socket);
+    SessionBase(tcp::socket&& socket, StreamHandler stream_handler, std::shared_ptr<Connections> connections);
 
-    virtual ~SessionBase() = default;
+    virtual ~SessionBase();
 
     template <typename Body, typename Fields>
     void Write(http::response<Body, Fields>&& response);
@@ -48,18 +106,36 @@ private:
 
     void Close();
 
+    // Учитывают запрос в числе обрабатываемых
+    void StartRequest();
+
+    void FinishRequest();
+
     virtual void HandleRequest(HttpRequest&& request) = 0;
     virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
 
 private:
+    bool IsDraining() const noexcept {
+        return connections_ && connections_->IsDraining();
+    }
+
     beast::flat_buffer buffer_;
     HttpRequest request_;
+    StreamHandler stream_handler_;
+    std::shared_ptr<Connections> connections_;
+    // Сессия ожидает запроса
+    bool reading_ = false;
+    // Запрос прочитан, ответ ещё не отправлен
+    bool handling_ = false;
 protected:
     beast::tcp_stream stream_;
 };
 
 template <typename Body, typename Fields>
 void http_server::SessionBase::Write(http::response<Body, Fields>&& response) {
+    if (IsDraining()) {
+        response.keep_alive(false);
+    }
     auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
     auto self = GetSharedThis();
     http::async_write(stream_, *safe_response,
@@ -76,8 +152,9 @@ class Session :
 
 public:
     template <typename Handler>
-    Session(tcp::socket&& socket, Handler&& request_handler)
-        : SessionBase(std::move(socket))
+    Session(tcp::socket&& socket, Handler&& request_handler, StreamHandler stream_handler = {},
+            std::shared_ptr<Connections> connections = {})
+        : SessionBase(std::move(socket), std::move(stream_handler), std::move(connections))
         , request_handler_(std::forward<Handler>(request_handler)) {
     }
 
@@ -98,14 +175,43 @@ private:
     RequestHandler request_handler_;
 };
 
+// Слушающий сокет, который можно передать новому процессу сервера
+class ListenerBase {
+public:
+    ListenerBase(const ListenerBase&) = delete;
+    ListenerBase& operator=(const ListenerBase&) = delete;
+
+    virtual ~ListenerBase() = default;
+
+    // Перестаёт принимать соединения, не закрывая сокет: новые соединения ждут в очереди сокета.
+    // Будущий результат готов, когда начатый приём соединения отменён.
+    virtual std::future<void> Pause() = 0;
+
+    virtual void Resume() = 0;
+
+    virtual tcp::acceptor::native_handle_type GetNativeHandle() = 0;
+
+protected:
+    ListenerBase() = default;
+};
+
 template <typename RequestHandler>
-class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
+class Listener : public ListenerBase, public std::enable_shared_from_this<Listener<RequestHandler>> {
 public:
+    // listen_socket - уже слушающий сокет, полученный от старого процесса. Если не задан, сокет открывается на endpoint.
     template <typename Handler>
-    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler)
+    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler,
+             StreamHandler stream_handler = {}, std::shared_ptr<Connections> connections = {},
+             std::optional<tcp::acceptor::native_handle_type> listen_socket = std::nullopt)
         : ioc_(ioc)
         , acceptor_(net::make_strand(ioc))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , stream_handler_(std::move(stream_handler))
+        , connections_(std::move(connections)) {
+        if (listen_socket) {
+            acceptor_.assign(endpoint.protocol(), *listen_socket);
+            return;
+        }
         acceptor_.open(endpoint.protocol());
         acceptor_.set_option(net::socket_base::reuse_address(true));
         acceptor_.bind(endpoint);
@@ -115,8 +221,32 @@ public:
         DoAccept();
     }
 
+    std::future<void> Pause() override {
+        auto paused = std::make_shared<std::promise<void>>();
+        auto result = paused->get_future();
+        net::dispatch(acceptor_.get_executor(), [self = this->shared_from_this(), paused] {
+            self->paused_ = true;
+            self->acceptor_.cancel();
+            paused->set_value();
+        });
+        return result;
+    }
+
+    void Resume() override {
+        net::dispatch(acceptor_.get_executor(), [self = this->shared_from_this()] {
+            if (std::exchange(self->paused_, false) && !self->accepting_) {
+                self->DoAccept();
+            }
+        });
+    }
+
+    tcp::acceptor::native_handle_type GetNativeHandle() override {
+        return acceptor_.native_handle();
+    }
+
 private:
     void DoAccept() {
+        accepting_ = true;
         acceptor_.async_accept(
             net::make_strand(ioc_),
             beast::bind_front_handler(&Listener::OnAccept, this->shared_from_this()));
@@ -124,28 +254,50 @@ private:
 
     void OnAccept(sys::error_code ec, tcp::socket socket) {
         using namespace std::literals;
+        accepting_ = false;
+        if (ec == net::error::operation_aborted) {
+            // Приём отменён паузой. Если работа возобновилась раньше, чем пришла отмена, приём начинается снова.
+            if (!paused_ && acceptor_.is_open()) {
+                DoAccept();
+            }
+            return;
+        }
         if (ec) {
             return ReportError(ec, server_logging::LogMsg::ACCEPT);
         }
+        // Соединение, принятое до отмены, обслуживается: если сессии уже закрываются, оно закроется сразу
         AsyncRunSession(std::move(socket));
-        DoAccept();
+        if (!paused_) {
+            DoAccept();
+        }
     }
 
     void AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_, stream_handler_,
+                                                  connections_)->Run();
     }
 
 private:
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     RequestHandler request_handler_;
+    StreamHandler stream_handler_;
+    std::shared_ptr<Connections> connections_;
+    // Используются в strand слушающего сокета
+    bool paused_ = false;
+    bool accepting_ = false;
 };
 
 template <typename RequestHandler>
-void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+std::shared_ptr<ListenerBase> ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler,
+               StreamHandler stream_handler = {}, std::shared_ptr<Connections> connections = {},
+               std::optional<tcp::acceptor::native_handle_type> listen_socket = std::nullopt) {
     using MyListener = Listener<std::decay_t<RequestHandler>>;
 
-    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+    auto listener = std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler),
+                                                 std::move(stream_handler), std::move(connections), listen_socket);
+    listener->Run();
+    return listener;
 }
 
 }  // namespace http_server
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "priority_strand.h"
+
+#include <string>
+
+namespace http_handler {
+
+using namespace std::literals;
+
+namespace {
+
+// Границы корзин времени ожидания, секунды
+const std::vector<double> QUEUE_WAIT_BOUNDS{0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.};
+
+}  // namespace
+
+PriorityStrand::Metrics::Metrics(metrics::Registry& registry)
+    : queue_wait{
+        &registry.AddHistogram("game_session_queue_wait_tick_seconds"sv,
+            "Time session ticks wait in the session queue"sv, QUEUE_WAIT_BOUNDS),
+        &registry.AddHistogram("game_session_queue_wait_mutation_seconds"sv,
+            "Time player joins and actions wait in the session queue"sv, QUEUE_WAIT_BOUNDS),
+        &registry.AddHistogram("game_session_queue_wait_read_seconds"sv,
+            "Time state reads wait in the session queue"sv, QUEUE_WAIT_BOUNDS)} {
+}
+
+PriorityStrand::PriorityStrand(Strand strand, const Metrics* metrics)
+    : strand_{std::move(strand)}
+    , metrics_{metrics} {
+}
+
+void PriorityStrand::Post(TaskPriority priority, Task task) {
+    {
+        std::lock_guard lock{mutex_};
+        queues_[static_cast<size_t>(priority)].push_back(Entry{std::move(task), Clock::now()});
+    }
+    net::post(strand_, [this] {
+        RunNext();
+    });
+}
+
+size_t PriorityStrand::ChooseQueue(Clock::time_point now) const {
+    size_t chosen = CLASS_COUNT;
+    for (size_t i = 0; i < CLASS_COUNT; ++i) {
+        if (queues_[i].empty()) {
+            continue;
+        }
+        if (chosen == CLASS_COUNT) {
+            chosen = i;
+        } else if (now - queues_[i].front().enqueued > STARVATION_LIMIT
+                   && queues_[i].front().enqueued < queues_[chosen].front().enqueued) {
+            // Задача низшего класса ждёт слишком долго и поставлена раньше выбранной
+            chosen = i;
+        }
+    }
+    return chosen;
+}
+
+void PriorityStrand::RunNext() {
+    Entry entry;
+    size_t index;
+    const auto now = Clock::now();
+    {
+        std::lock_guard lock{mutex_};
+        index = ChooseQueue(now);
+        // Исполнителей в strand столько же, сколько задач в очередях
+        if (index == CLASS_COUNT) {
+            return;
+        }
+        entry = std::move(queues_[index].front());
+        queues_[index].pop_front();
+    }
+    if (metrics_) {
+        metrics_->queue_wait[index]->Observe(std::chrono::duration<double>(now - entry.enqueued).count());
+    }
+    entry.task();
+}
+
+}  // namespace http_handler
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../metrics/metrics.h"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace http_handler {
+
+namespace net = boost::asio;
+
+// Класс задачи в strand сессии: задачи класса с меньшим значением выполняются раньше
+enum class TaskPriority {
+    TICK,     // тик сессии
+    MUTATION, // вход и действия игроков, публикация снимка
+    READ,     // чтение изменений состояния и области интереса
+};
+
+// Очередь задач с приоритетами поверх strand. Post кладёт задачу в очередь её класса и ставит в strand
+// одного исполнителя; исполнитель берёт задачу высшего класса, поэтому тик и действия игроков
+// обгоняют накопившиеся чтения. Чтобы низшие классы не голодали, задача, прождавшая дольше
+// STARVATION_LIMIT, выполняется раньше задач высших классов.
+class PriorityStrand {
+public:
+    using Strand = net::strand<net::io_context::executor_type>;
+    using Task = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t CLASS_COUNT = 3;
+    static constexpr std::chrono::milliseconds STARVATION_LIMIT{100};
+
+    // Гистограммы времени ожидания в очереди по классам задач, общие для всех strand
+    struct Metrics {
+        explicit Metrics(metrics::Registry& registry);
+
+        std::array<metrics::Histogram*, CLASS_COUNT> queue_wait;
+    };
+
+    explicit PriorityStrand(Strand strand, const Metrics* metrics = nullptr);
+
+    PriorityStrand(const PriorityStrand&) = delete;
+    PriorityStrand& operator=(const PriorityStrand&) = delete;
+
+    // Можно вызывать из любого потока. Объект должен существовать, пока в очереди есть задачи.
+    void Post(TaskPriority priority, Task task);
+
+private:
+    struct Entry {
+        Task task;
+        Clock::time_point enqueued;
+    };
+
+    void RunNext();
+
+    // Индекс очереди, из которой берётся следующая задача. Вызывается под mutex_.
+    size_t ChooseQueue(Clock::time_point now) const;
+
+    Strand strand_;
+    const Metrics* metrics_;
+    std::mutex mutex_;
+    std::array<std::deque<Entry>, CLASS_COUNT> queues_;
+};
+
+}  // namespace http_handler
@@ -4,6 +4,9 @@
 
 #include <boost/json/parse.hpp>
 
+#include <array>
+#include <charconv>
+#include <cmath>
 #include <string>
 #include <tuple>
 
@@ -81,6 +84,26 @@ StringResponse MakeStringResponse(http::status status, std::string_view body, co
     return response;
 }
 
+StringResponse MakeJsonResponse(std::string body, const RequestData& req_data) {
+    StringResponse response(http::status::ok, req_data.http_version);
+    response.set(http::field::content_type, ContentType::APPLICATION_JSON);
+    response.set(http::field::cache_control, Constants::NO_CACHE);
+    response.body() = std::move(body);
+    response.prepare_payload();
+    response.keep_alive(req_data.keep_alive);
+    return response;
+}
+
+void SendAndClose(beast::tcp_stream&& stream, StringResponse&& response) {
+    response.keep_alive(false);
+    auto safe_stream = std::make_shared<beast::tcp_stream>(std::move(stream));
+    auto safe_response = std::make_shared<StringResponse>(std::move(response));
+    http::async_write(*safe_stream, *safe_response, [safe_stream, safe_response](beast::error_code, size_t) {
+        beast::error_code ec;
+        safe_stream->socket().shutdown(net::ip::tcp::socket::shutdown_send, ec);
+    });
+}
+
 std::optional<std::string> DecodeURI(std::string_view encoded) {
     static const std::string prefix = "0x"s;
     std::string decoded;
@@ -114,94 +137,255 @@ std::optional<std::string> DecodeURI(std::string_view encoded) {
     return decoded;
 }
 
+std::pair<std::string_view, std::string_view> SplitQuery(std::string_view api_token) {
+    size_t pos = api_token.find('?');
+    if (pos == std::string_view::npos) {
+        return {api_token, {}};
+    }
+    return {api_token.substr(0, pos), api_token.substr(pos + 1)};
+}
+
+bool MatchesETag(std::string_view if_none_match, std::string_view etag) {
+    while (!if_none_match.empty()) {
+        size_t end = if_none_match.find(',');
+        std::string_view candidate = if_none_match.substr(0, end);
+        while (!candidate.empty() && candidate.front() == ' ') {
+            candidate.remove_prefix(1);
+        }
+        while (!candidate.empty() && candidate.back() == ' ') {
+            candidate.remove_suffix(1);
+        }
+        if (candidate.starts_with("W/"sv)) {
+            candidate.remove_prefix(2);
+        }
+        if (candidate == etag || candidate == "*"sv) {
+            return true;
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        if_none_match.remove_prefix(end + 1);
+    }
+    return false;
+}
+
+std::optional<std::string_view> FindQueryParameter(std::string_view query, std::string_view name) {
+    while (!query.empty()) {
+        size_t end = query.find('&');
+        std::string_view parameter = query.substr(0, end);
+        size_t eq = parameter.find('=');
+        if (parameter.substr(0, eq) == name) {
+            return eq == std::string_view::npos ? std::string_view{} : parameter.substr(eq + 1);
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        query.remove_prefix(end + 1);
+    }
+    return std::nullopt;
+}
+
 // ApiHandler
-ApiHandler::ApiHandler(app::Application& app, const extra_data::ExtraData& extra_data)
+ApiHandler::ApiHandler(app::Application& app, const extra_data::ExtraData& extra_data,
+                       metrics::Registry* metrics)
     : app_{app}
-    , extra_data_{extra_data} {}
+    , extra_data_{extra_data}
+    , metrics_{metrics} {
+    if (metrics) {
+        shed_state_polls_ = &metrics->AddCounter("game_shed_state_polls_total"sv,
+            "Number of state delta and area of interest requests rejected under load"sv);
+    }
+    for (const auto& [map_id, loot_types] : extra_data_.map_id_to_loot_types) {
+        loot_types_json_.emplace(map_id, json::serialize(loot_types));
+    }
+}
+
+ApiHandler::RequestScope ApiHandler::GetRequestScope(const RequestData& req_data) {
+    // Некорректные запросы не обращаются к сессиям, на них отвечают ошибкой
+    if (!req_data.decoded_uri.has_value()) {
+        return RequestScope::CONCURRENT;
+    }
+    auto tokens = SplitIntoTokens(SplitQuery(*req_data.decoded_uri).first, '/');
+    if (tokens.size() < 3 || tokens.front() != ApiTokens::API) {
+        return RequestScope::CONCURRENT;
+    }
+    tokens.pop();
+    if (tokens.front() != ApiTokens::V1) {
+        return RequestScope::CONCURRENT;
+    }
+    tokens.pop();
+    const auto root = tokens.front(); tokens.pop();
+    // /api/v1/maps[/<id>] и /api/v1/game/records
+    if (root != ApiTokens::GAME || tokens.empty()) {
+        return RequestScope::CONCURRENT;
+    }
+    if (tokens.size() == 1 && tokens.front() == ApiTokens::RECORDS) {
+        return RequestScope::CONCURRENT;
+    }
+    // Список игроков и полное состояние читаются из снимка сессии. Изменения с тика
+    // и область интереса строятся по самой сессии.
+    if (tokens.size() == 1 && tokens.front() == ApiTokens::PLAYERS) {
+        return RequestScope::CONCURRENT;
+    }
+    if (tokens.size() == 1 && tokens.front() == ApiTokens::STATE) {
+        const auto query = SplitQuery(*req_data.decoded_uri).second;
+        if (!FindQueryParameter(query, Constants::SINCE) && !FindQueryParameter(query, Constants::RADIUS)) {
+            return RequestScope::CONCURRENT;
+        }
+    }
+    // /api/v1/game/tick меняет все сессии сразу
+    if (tokens.size() == 1 && tokens.front() == ApiTokens::TICK) {
+        return RequestScope::GAME;
+    }
+    return RequestScope::SESSION;
+}
 
-StringResponse ApiHandler::HandleSingleMapRequest(std::string_view version) const {
-    std::string_view map_id = req_tokens_.front(); req_tokens_.pop();
-    if (!req_tokens_.empty()) {
-        return ResponseApiError(ErrorCode::BadRequest);
+TaskPriority ApiHandler::GetRequestPriority(const RequestData& req_data) {
+    static const std::string state_path = "/"s.append(ApiTokens::API).append("/"sv).append(ApiTokens::V1)
+        .append("/"sv).append(ApiTokens::GAME).append("/"sv).append(ApiTokens::STATE);
+    if (req_data.decoded_uri && SplitQuery(*req_data.decoded_uri).first == state_path) {
+        return TaskPriority::READ;
+    }
+    return TaskPriority::MUTATION;
+}
+
+std::optional<StringResponse> ApiHandler::ShedRequest(const RequestData& req_data) const {
+    static const std::string state_path = "/"s.append(ApiTokens::API).append("/"sv).append(ApiTokens::V1)
+        .append("/"sv).append(ApiTokens::GAME).append("/"sv).append(ApiTokens::STATE);
+    if (!app_.IsLoadShedding() || !req_data.decoded_uri) {
+        return std::nullopt;
+    }
+    const auto [path, query] = SplitQuery(*req_data.decoded_uri);
+    if (path != state_path
+        || (!FindQueryParameter(query, Constants::SINCE) && !FindQueryParameter(query, Constants::RADIUS))) {
+        return std::nullopt;
+    }
+    if (shed_state_polls_) {
+        shed_state_polls_->Add();
+    }
+    auto response = ErrorBuilder::MakeErrorResponse(ErrorCode::ServerOverloaded, req_data);
+    response.set(http::field::retry_after, "1"sv);
+    return response;
+}
+
+std::optional<model::Map::Id> ApiHandler::FindRequestMap(const RequestData& req_data) const {
+    if (!req_data.decoded_uri.has_value()) {
+        return std::nullopt;
+    }
+    // Игрок входит в игру по идентификатору карты из тела запроса
+    auto tokens = SplitIntoTokens(SplitQuery(*req_data.decoded_uri).first, '/');
+    if (tokens.size() == 4) {
+        tokens.pop(); tokens.pop(); tokens.pop();
+        if (tokens.front() == ApiTokens::JOIN) {
+            if (!req_data.body.has_value()) {
+                return std::nullopt;
+            }
+            std::error_code ec;
+            json::value content = json::parse(*req_data.body, ec);
+            if (ec || !content.is_object()) {
+                return std::nullopt;
+            }
+            const auto* map_id = content.as_object().if_contains(Constants::MAP_ID);
+            if (!map_id || !map_id->is_string()) {
+                return std::nullopt;
+            }
+            return model::Map::Id{std::string{map_id->as_string()}};
+        }
+    }
+    // Остальные запросы к игре выполняются в сессии игрока
+    if (req_data.auth_token.has_value()) {
+        return app_.FindPlayerMap(*req_data.auth_token);
+    }
+    return std::nullopt;
+}
+
+StringResponse ApiHandler::HandleSingleMapRequest(const RequestData& req_data, Tokens& tokens, std::string_view version) const {
+    std::string_view map_id = tokens.front(); tokens.pop();
+    if (!tokens.empty()) {
+        return ResponseApiError(req_data, ErrorCode::BadRequest);
     }
     model::Map::Id id{std::string{map_id}};
     const model::Map* map = app_.FindMap(id);
     if (!map) {
-        return ResponseApiError(ErrorCode::MapNotFound);
+        return ResponseApiError(req_data, ErrorCode::MapNotFound);
     }
-    if (req_data_.method == http::verb::head) {
-        return MakeStringResponse(http::status::ok, {}, req_data_, ContentType::APPLICATION_JSON);
+    if (req_data.method == http::verb::head) {
+        return MakeStringResponse(http::status::ok, {}, req_data, ContentType::APPLICATION_JSON);
     }
-    auto body = json::serialize(MapAsJsonObject(*map));
-    return MakeStringResponse(http::status::ok, body, req_data_, ContentType::APPLICATION_JSON);
+    std::string body;
+    json_writer::JsonWriter writer{body};
+    WriteMap(writer, *map);
+    return MakeJsonResponse(std::move(body), req_data);
 }
 
-StringResponse ApiHandler::HandleAllMapsRequest(std::string_view version) const {
-    if (req_data_.method == http::verb::head) {
-        return MakeStringResponse(http::status::ok, {}, req_data_, ContentType::APPLICATION_JSON);
+StringResponse ApiHandler::HandleAllMapsRequest(const RequestData& req_data, std::string_view version) const {
+    if (req_data.method == http::verb::head) {
+        return MakeStringResponse(http::status::ok, {}, req_data, ContentType::APPLICATION_JSON);
     }
     const bool short_info = true;
-    json::array json_maps;
+    std::string body;
+    json_writer::JsonWriter writer{body};
+    writer.StartArray();
     for (const auto& map : app_.GetMaps()) {
-        json_maps.push_back(std::move(MapAsJsonObject(map, short_info)));
+        WriteMap(writer, map, short_info);
     }
-    auto body = json::serialize(json_maps);
-    return MakeStringResponse(http::status::ok, body, req_data_, ContentType::APPLICATION_JSON);
+    writer.EndArray();
+    return MakeJsonResponse(std::move(body), req_data);
 }
 
-StringResponse ApiHandler::HandleMapsRequest(std::string_view version) const {
+StringResponse ApiHandler::HandleMapsRequest(const RequestData& req_data, Tokens& tokens, std::string_view version) const {
     if (version != ApiTokens::V1){
-        return ErrorBuilder::MakeErrorResponse(ErrorCode::BadRequest, req_data_);
+        return ErrorBuilder::MakeErrorResponse(ErrorCode::BadRequest, req_data);
     }
-    auto action = [this, version]() {
-        return req_tokens_.empty()
-            ? HandleAllMapsRequest(version)
-            : HandleSingleMapRequest(version);
+    auto action = [this, &req_data, &tokens, version]() {
+        return tokens.empty()
+            ? HandleAllMapsRequest(req_data, version)
+            : HandleSingleMapRequest(req_data, tokens, version);
     };
-    return ExecuteAllowedMethods(std::move(action), http::verb::get, http::verb::head);
+    return ExecuteAllowedMethods(req_data, std::move(action), http::verb::get, http::verb::head);
 }
 
-StringResponse ApiHandler::HandleGameRequest(std::string_view version) const {
+StringResponse ApiHandler::HandleGameRequest(const RequestData& req_data, Tokens& tokens, std::string_view version) const {
     if (version != ApiTokens::V1){
-        return ResponseApiError(ErrorCode::BadRequest);
+        return ResponseApiError(req_data, ErrorCode::BadRequest);
     }
-    if (req_tokens_.empty()) {
-        return ResponseApiError(ErrorCode::BadRequest);
+    if (tokens.empty()) {
+        return ResponseApiError(req_data, ErrorCode::BadRequest);
     }
-    auto api_token = req_tokens_.front(); req_tokens_.pop();
-    if (api_token == ApiTokens::JOIN && req_tokens_.empty()) {
-        return HandlePlayerJoin(version);
+    auto api_token = tokens.front(); tokens.pop();
+    if (api_token == ApiTokens::JOIN && tokens.empty()) {
+        return HandlePlayerJoin(req_data, version);
     }
-    if (api_token == ApiTokens::PLAYERS && req_tokens_.empty()) {
-        return HandlePlayersRequest(version);
+    if (api_token == ApiTokens::PLAYERS && tokens.empty()) {
+        return HandlePlayersRequest(req_data, version);
     }
-    if (api_token == ApiTokens::STATE && req_tokens_.empty()) {
-        return HandleGameStateRequest(version);
+    if (SplitQuery(api_token).first == ApiTokens::STATE && tokens.empty()) {
+        return HandleGameStateRequest(req_data, api_token, version);
     }
     if (api_token == ApiTokens::PLAYER) {
-        api_token = req_tokens_.front(); req_tokens_.pop();
-        if (api_token == ApiTokens::ACTION && req_tokens_.empty()) {
-            return HandlePlayerActionRequest(version);
+        api_token = tokens.front(); tokens.pop();
+        if (api_token == ApiTokens::ACTION && tokens.empty()) {
+            return HandlePlayerActionRequest(req_data, version);
         }
     }
-    if (api_token == ApiTokens::TICK && req_tokens_.empty()) {
-        return HandleTickRequest(version);
+    if (api_token == ApiTokens::TICK && tokens.empty()) {
+        return HandleTickRequest(req_data, version);
     }
     if (api_token.starts_with(ApiTokens::RECORDS)) {
-        return HandleRecordsRequest(api_token, version);
+        return HandleRecordsRequest(req_data, api_token, version);
     }
-    return ResponseApiError(ErrorCode::BadRequest);
+    return ResponseApiError(req_data, ErrorCode::BadRequest);
 }
 
-StringResponse ApiHandler::HandlePlayerJoin(std::string_view version) const {
-    auto action = [this]() {
-        if (req_data_.content_type != ContentType::APPLICATION_JSON) {
-            return ResponseApiError(ErrorCode::BadRequest);
+StringResponse ApiHandler::HandlePlayerJoin(const RequestData& req_data, std::string_view version) const {
+    auto action = [this, &req_data]() {
+        if (req_data.content_type != ContentType::APPLICATION_JSON) {
+            return ResponseApiError(req_data, ErrorCode::BadRequest);
         }
         std::error_code ec;
-        json::value content = json::parse(req_data_.body.value(), ec);
+        json::value content = json::parse(req_data.body.value(), ec);
         if (ec) {
-            return ResponseApiError(ErrorCode::JoinGameParse);
+            return ResponseApiError(req_data, ErrorCode::JoinGameParse);
         }
         if (!content.is_object() ||
             !content.as_object().contains(Constants::USER_NAME) ||
@@ -209,112 +393,324 @@ StringResponse ApiHandler::HandlePlayerJoin(std::string_view version) const {
             !content.as_object().at(Constants::USER_NAME).is_string() ||
             !content.as_object().at(Constants::MAP_ID).is_string() ||
             content.as_object().at(Constants::USER_NAME).as_string().empty()) {
-            return ResponseApiError(ErrorCode::JoinGameParse);
+            return ResponseApiError(req_data, ErrorCode::JoinGameParse);
         }
         std::string dog_name = content.as_object().at(Constants::USER_NAME).as_string().c_str();
         std::string map_id = content.as_object().at(Constants::MAP_ID).as_string().c_str();
         auto result = app_.JoinPlayer(model::Map::Id{map_id}, dog_name);
         if (!result.has_value()) {
-            return ResponseApiError(ErrorCode::MapNotFound);
+            return ResponseApiError(req_data, ErrorCode::MapNotFound);
         }
         json::object player;
         player.emplace(Constants::AUTH_TOKEN, *result->first);
         player.emplace(Constants::PLAYER_ID, *result->second);
         auto body = json::serialize(player);
-        return MakeStringResponse(http::status::ok, body, req_data_, ContentType::APPLICATION_JSON);
+        return MakeStringResponse(http::status::ok, body, req_data, ContentType::APPLICATION_JSON);
     };
-    return ExecuteAllowedMethods(std::move(action), http::verb::post);
+    return ExecuteAllowedMethods(req_data, std::move(action), http::verb::post);
 }
 
-StringResponse ApiHandler::HandlePlayersRequest(std::string_view version) const {
-    auto action = [this]() {
-        return ExecuteAuthorized([this](const app::Token& token) {
-            auto players = app_.GetPlayers(token);
-            if (!players.has_value()) {
-                return ResponseApiError(ErrorCode::PlayerTokenNotFound);
+StringResponse ApiHandler::HandlePlayersRequest(const RequestData& req_data, std::string_view version) const {
+    auto action = [this, &req_data]() {
+        return ExecuteAuthorized(req_data, [this, &req_data](const app::Token& token) {
+            auto snapshot = app_.GetSnapshot(token);
+            if (!snapshot) {
+                return ResponseApiError(req_data, ErrorCode::PlayerTokenNotFound);
             }
-            if (req_data_.method == http::verb::head) {
-                return MakeStringResponse(http::status::ok, {}, req_data_, ContentType::APPLICATION_JSON);
+            const auto encoding = ChooseEncoding(req_data.accept);
+            if (req_data.method == http::verb::head) {
+                return MakeEncodedResponse(req_data, {}, encoding);
             }
-            json::object json_players;
-            for (const auto [id, name] : players.value()) {
-                json::object player;
-                player.emplace(Constants::NAME, name);
-                json_players.emplace(std::to_string(*id), player);
+            if (encoding != ResponseEncoding::JSON) {
+                return MakeEncodedResponse(req_data, EncodePlayers(snapshot->players), encoding);
             }
-            auto body = json::serialize(json_players);
-            return MakeStringResponse(http::status::ok, body, req_data_, ContentType::APPLICATION_JSON);
+            std::string body;
+            json_writer::JsonWriter writer{body};
+            writer.StartObject();
+            for (const auto& [id, name] : snapshot->players) {
+                writer.Key(*id).StartObject().Key(Constants::NAME).Value(name).EndObject();
+            }
+            writer.EndObject();
+            return MakeEncodedResponse(req_data, body, encoding);
         });
     };
-    return ExecuteAllowedMethods(std::move(action), http::verb::get, http::verb::head);
+    return ExecuteAllowedMethods(req_data, std::move(action), http::verb::get, http::verb::head);
+}
+
+template <typename T>
+static std::optional<T> ParseNumber(std::string_view str) {
+    T value{};
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc{} || ptr != str.data() + str.size()) {
+        return std::nullopt;
+    }
+    return value;
 }
 
-StringResponse ApiHandler::HandleGameStateRequest(std::string_view version) const {
-    auto action = [this]() {
-        return ExecuteAuthorized([this](const app::Token& token) {
-            auto state = app_.GetGameState(app::Token{token});
-            if (!state.has_value()) {
-                return ResponseApiError(ErrorCode::PlayerTokenNotFound);
+// Ответы с изменениями (since) и с областью интереса (radius) содержат не всё состояние,
+// поэтому их ETag отличается от ETag полного состояния той же версии
+static std::string MakeStateVariant(std::string_view query) {
+    if (const auto since_param = FindQueryParameter(query, Constants::SINCE)) {
+        const auto since = ParseNumber<size_t>(*since_param);
+        return since ? "s"s.append(std::to_string(*since)) : "x"s;
+    }
+    if (const auto radius_param = FindQueryParameter(query, Constants::RADIUS)) {
+        const auto radius = ParseNumber<double>(*radius_param);
+        if (!radius || !std::isfinite(*radius)) {
+            return "x"s;
+        }
+        std::array<char, 32> buffer;
+        const auto [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), *radius);
+        return "r"s.append(buffer.data(), ptr);
+    }
+    return {};
+}
+
+StringResponse ApiHandler::HandleGameStateRequest(const RequestData& req_data, std::string_view api_token,
+                                                  std::string_view version) const {
+    auto action = [this, &req_data, api_token]() {
+        return ExecuteAuthorized(req_data, [this, &req_data, api_token](const app::Token& token) {
+            const auto query = SplitQuery(api_token).second;
+            const auto since_param = FindQueryParameter(query, Constants::SINCE);
+            const auto since = since_param ? ParseNumber<size_t>(*since_param) : std::nullopt;
+            const auto radius_param = FindQueryParameter(query, Constants::RADIUS);
+            const auto radius = radius_param ? ParseNumber<double>(*radius_param) : std::nullopt;
+            const auto wait_param = FindQueryParameter(query, Constants::WAIT);
+            // nan и inf отклоняются
+            const bool valid_radius = radius && std::isfinite(*radius) && *radius >= 0.;
+            if ((since_param && !since) || (radius_param && !valid_radius)
+                || (wait_param && !ParseNumber<size_t>(*wait_param))) {
+                return ResponseApiError(req_data, ErrorCode::BadRequest);
             }
-            if (req_data_.method == http::verb::head) {
-                return MakeStringResponse(http::status::ok, {}, req_data_, ContentType::APPLICATION_JSON);
+            // ETag и полное состояние берутся из одного снимка, чтобы они соответствовали друг другу
+            auto snapshot = app_.GetSnapshot(token);
+            if (!snapshot) {
+                return ResponseApiError(req_data, ErrorCode::PlayerTokenNotFound);
             }
-            static const std::unordered_map<model::Dog::Direction, std::string_view> direction_map{
-                {model::Dog::Direction::NORTH, "U"sv},
-                {model::Dog::Direction::SOUTH, "D"sv},
-                {model::Dog::Direction::WEST,  "L"sv},
-                {model::Dog::Direction::EAST,  "R"sv}
-            };
-
-            json::object json_players_state;
-            for (const auto& player : state->players) {
-                json::object json_player;
-                json_player.emplace(Constants::POSITION, json::array{player.pos.x, player.pos.y});
-                json_player.emplace(Constants::SPEED, json::array{player.speed.x, player.speed.y});
-                json_player.emplace(Constants::DIRECTION, direction_map.at(player.dir));
-                json::array json_bag;
-                for (auto loot_item : player.bag) {
-                    json::object json_loot_item;
-                    json_loot_item.emplace(Constants::ID, loot_item.id);
-                    json_loot_item.emplace(Constants::TYPE, loot_item.type);
-                    json_bag.emplace_back(std::move(json_loot_item));
-                }
-                json_player.emplace(Constants::BAG, std::move(json_bag));
-                json_player.emplace(Constants::SCORE, player.score);
-                json_players_state.emplace(std::to_string(*player.id), std::move(json_player));
+            const app::UseCaseGetStateVersion::StateVersion state_version{
+                snapshot->session_id, snapshot->version, snapshot->tick_seq};
+            const auto etag = MakeStateETag(state_version, ChooseEncoding(req_data.accept), MakeStateVariant(query));
+            if (MatchesETag(req_data.if_none_match, etag)) {
+                return MakeNotModifiedResponse(req_data, etag);
             }
+            auto response = since ? HandleGameStateDeltaRequest(req_data, token, *since)
+                : radius ? HandleAreaOfInterestRequest(req_data, token, *radius)
+                : HandleFullGameStateRequest(req_data, *snapshot);
+            response.set(http::field::etag, etag);
+            return response;
+        });
+    };
+    return ExecuteAllowedMethods(req_data, std::move(action), http::verb::get, http::verb::head);
+}
 
-            json::object json_loot_objects_state;
-            for (const auto& loot_object : state->loot_objects) {
-                json::object json_loot_object;
-                json_loot_object.emplace(Constants::TYPE, loot_object.type);
-                json_loot_object.emplace(Constants::POSITION, json::array{loot_object.pos.x, loot_object.pos.y});
-                json_loot_objects_state.emplace(std::to_string(*loot_object.id), json_loot_object);
-            }
+StringResponse ApiHandler::HandleFullGameStateRequest(const RequestData& req_data,
+                                                      const app::SessionSnapshot& snapshot) const {
+    const auto encoding = ChooseEncoding(req_data.accept);
+    if (req_data.method == http::verb::head) {
+        return MakeEncodedResponse(req_data, {}, encoding);
+    }
+    auto body = state_cache_.Find(snapshot.map_id, snapshot.version, encoding);
+    if (!body) {
+        body = state_cache_.Store(snapshot.map_id, snapshot.version, encoding,
+            encoding == ResponseEncoding::JSON ? SerializeGameState(snapshot.state)
+                                               : EncodeGameState(snapshot.state, encoding));
+    }
+    return MakeEncodedResponse(req_data, *body, encoding);
+}
 
-            json::object json_game_state;
-            json_game_state.emplace(Constants::PLAYERS, std::move(json_players_state));
-            json_game_state.emplace(Constants::LOST_OBJECTS, std::move(json_loot_objects_state));
-            return MakeStringResponse(http::status::ok, json::serialize(json_game_state), req_data_, ContentType::APPLICATION_JSON);
-        });
+std::optional<std::chrono::milliseconds> ApiHandler::GetLongPollWait(const RequestData& req_data) const {
+    static const std::string state_path = "/"s.append(ApiTokens::API).append("/"sv).append(ApiTokens::V1)
+        .append("/"sv).append(ApiTokens::GAME).append("/"sv).append(ApiTokens::STATE);
+    if (req_data.method != http::verb::get || !req_data.decoded_uri || !req_data.auth_token) {
+        return std::nullopt;
+    }
+    const auto [path, query] = SplitQuery(*req_data.decoded_uri);
+    if (path != state_path) {
+        return std::nullopt;
+    }
+    const auto wait_param = FindQueryParameter(query, Constants::WAIT);
+    const auto wait = wait_param ? ParseNumber<size_t>(*wait_param) : std::nullopt;
+    if (!wait || *wait == 0) {
+        return std::nullopt;
+    }
+    const auto state_version = app_.GetStateVersion(*req_data.auth_token);
+    if (!state_version) {
+        return std::nullopt;
+    }
+    // Клиент без If-None-Match ждёт следующего тика, клиент с устаревшим ETag получает ответ сразу
+    if (!req_data.if_none_match.empty()
+        && !MatchesETag(req_data.if_none_match,
+                        MakeStateETag(*state_version, ChooseEncoding(req_data.accept), MakeStateVariant(query)))) {
+        return std::nullopt;
+    }
+    return std::min(std::chrono::milliseconds{*wait}, MAX_LONG_POLL_WAIT);
+}
+
+std::string ApiHandler::MakeStateETag(const app::UseCaseGetStateVersion::StateVersion& state_version,
+                                      ResponseEncoding encoding, std::string_view variant) {
+    std::string etag;
+    etag.reserve(48);
+    etag.push_back('"');
+    etag.append(std::to_string(*state_version.session_id)).push_back('-');
+    etag.append(std::to_string(state_version.tick_seq)).push_back('-');
+    etag.append(std::to_string(state_version.version));
+    if (!variant.empty()) {
+        etag.push_back('-');
+        etag.append(variant);
+    }
+    if (encoding == ResponseEncoding::BINARY) {
+        etag.push_back('b');
+    } else if (encoding == ResponseEncoding::BINARY_FIXED) {
+        etag.push_back('f');
+    }
+    etag.push_back('"');
+    return etag;
+}
+
+StringResponse ApiHandler::MakeNotModifiedResponse(const RequestData& req_data, std::string_view etag) {
+    StringResponse response(http::status::not_modified, req_data.http_version);
+    response.set(http::field::etag, etag);
+    response.set(http::field::cache_control, Constants::NO_CACHE);
+    response.set(http::field::vary, http::to_string(http::field::accept));
+    response.keep_alive(req_data.keep_alive);
+    return response;
+}
+
+StringResponse ApiHandler::HandleGameStateDeltaRequest(const RequestData& req_data, const app::Token& token,
+                                                       size_t since) const {
+    auto delta = app_.GetGameStateDelta(token, since);
+    if (!delta.has_value()) {
+        return ResponseApiError(req_data, ErrorCode::PlayerTokenNotFound);
+    }
+    const auto encoding = ChooseEncoding(req_data.accept);
+    if (req_data.method == http::verb::head) {
+        return MakeEncodedResponse(req_data, {}, encoding);
+    }
+    if (encoding != ResponseEncoding::JSON) {
+        return MakeEncodedResponse(req_data, EncodeGameStateDelta(*delta, encoding), encoding);
+    }
+    return MakeEncodedResponse(req_data, SerializeGameStateDelta(*delta), encoding);
+}
+
+StringResponse ApiHandler::HandleAreaOfInterestRequest(const RequestData& req_data, const app::Token& token,
+                                                       double radius) const {
+    auto state = app_.GetGameState(token, radius);
+    if (!state.has_value()) {
+        return ResponseApiError(req_data, ErrorCode::PlayerTokenNotFound);
+    }
+    const auto encoding = ChooseEncoding(req_data.accept);
+    if (req_data.method == http::verb::head) {
+        return MakeEncodedResponse(req_data, {}, encoding);
+    }
+    if (encoding != ResponseEncoding::JSON) {
+        return MakeEncodedResponse(req_data, EncodeGameState(*state, encoding), encoding);
+    }
+    return MakeEncodedResponse(req_data, SerializeGameState(*state), encoding);
+}
+
+StringResponse ApiHandler::MakeEncodedResponse(const RequestData& req_data, std::string_view body,
+                                               ResponseEncoding encoding) {
+    std::string_view content_type = ContentType::APPLICATION_JSON;
+    if (encoding == ResponseEncoding::BINARY) {
+        content_type = BinaryContentType::FLOAT;
+    } else if (encoding == ResponseEncoding::BINARY_FIXED) {
+        content_type = BinaryContentType::FIXED;
+    }
+    auto response = MakeStringResponse(http::status::ok, body, req_data, content_type);
+    response.set(http::field::vary, http::to_string(http::field::accept));
+    return response;
+}
+
+static void WritePlayersState(json_writer::JsonWriter& writer, const std::vector<app::UseCaseGetGameState::PlayerState>& players) {
+    static const std::unordered_map<model::Dog::Direction, std::string_view> direction_map{
+        {model::Dog::Direction::NORTH, "U"sv},
+        {model::Dog::Direction::SOUTH, "D"sv},
+        {model::Dog::Direction::WEST,  "L"sv},
+        {model::Dog::Direction::EAST,  "R"sv}
     };
-    return ExecuteAllowedMethods(std::move(action), http::verb::get, http::verb::head);
+
+    writer.StartObject();
+    for (const auto& player : players) {
+        writer.Key(*player.id).StartObject();
+        writer.Key(Constants::POSITION).Pair(player.pos.x, player.pos.y);
+        writer.Key(Constants::SPEED).Pair(player.speed.x, player.speed.y);
+        writer.Key(Constants::DIRECTION).Value(direction_map.at(player.dir));
+        writer.Key(Constants::BAG).StartArray();
+        for (auto loot_item : player.bag) {
+            writer.StartObject()
+                .Key(Constants::ID).Value(loot_item.id)
+                .Key(Constants::TYPE).Value(loot_item.type)
+                .EndObject();
+        }
+        writer.EndArray();
+        writer.Key(Constants::SCORE).Value(player.score);
+        writer.EndObject();
+    }
+    writer.EndObject();
+}
+
+static void WriteLootObjectsState(json_writer::JsonWriter& writer, const std::vector<app::UseCaseGetGameState::LootObjectState>& loot_objects) {
+    writer.StartObject();
+    for (const auto& loot_object : loot_objects) {
+        writer.Key(*loot_object.id).StartObject()
+            .Key(Constants::TYPE).Value(loot_object.type)
+            .Key(Constants::POSITION).Pair(loot_object.pos.x, loot_object.pos.y)
+            .EndObject();
+    }
+    writer.EndObject();
+}
+
+std::string ApiHandler::SerializeGameState(const app::UseCaseGetGameState::GameState& state) {
+    std::string body;
+    body.reserve(64 + state.players.size() * 128 + state.loot_objects.size() * 64);
+    json_writer::JsonWriter writer{body};
+    writer.StartObject();
+    writer.Key(Constants::PLAYERS);
+    WritePlayersState(writer, state.players);
+    writer.Key(Constants::LOST_OBJECTS);
+    WriteLootObjectsState(writer, state.loot_objects);
+    writer.EndObject();
+    return body;
+}
+
+std::string ApiHandler::SerializeGameStateDelta(const app::UseCaseGetGameStateDelta::GameStateDelta& delta) {
+    std::string body;
+    json_writer::JsonWriter writer{body};
+    writer.StartObject();
+    writer.Key(Constants::SEQ).Value(delta.seq);
+    writer.Key(Constants::FULL).Value(delta.full);
+    writer.Key(Constants::PLAYERS);
+    WritePlayersState(writer, delta.players);
+    writer.Key(Constants::LOST_OBJECTS);
+    WriteLootObjectsState(writer, delta.loot_objects);
+    writer.Key(Constants::REMOVED_PLAYERS).StartArray();
+    for (const auto& id : delta.retired_players) {
+        writer.Value(*id);
+    }
+    writer.EndArray();
+    writer.Key(Constants::REMOVED_OBJECTS).StartArray();
+    for (const auto& id : delta.removed_loot_objects) {
+        writer.Value(*id);
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return body;
 }
 
-StringResponse ApiHandler::HandlePlayerActionRequest(std::string_view version) const {
-    const auto action = [this](const app::Token& token){
-        if (req_data_.content_type != ContentType::APPLICATION_JSON) {
-            return ResponseApiError(ErrorCode::BadRequest);
+StringResponse ApiHandler::HandlePlayerActionRequest(const RequestData& req_data, std::string_view version) const {
+    const auto action = [this, &req_data](const app::Token& token){
+        if (req_data.content_type != ContentType::APPLICATION_JSON) {
+            return ResponseApiError(req_data, ErrorCode::BadRequest);
         }
         std::error_code ec;
-        json::value content = json::parse(req_data_.body.value(), ec);
+        json::value content = json::parse(req_data.body.value(), ec);
         if (ec) {
-            return ResponseApiError(ErrorCode::ActionParse);
+            return ResponseApiError(req_data, ErrorCode::ActionParse);
         }
         if (!content.is_object() ||
             !content.as_object().contains(Constants::MOVE) ||
             !content.as_object().at(Constants::MOVE).is_string()) {
-            return ResponseApiError(ErrorCode::ActionParse);
+            return ResponseApiError(req_data, ErrorCode::ActionParse);
         }
         static const std::unordered_map<std::string_view, model::Dog::Direction> direction_map{
             {"U"sv, model::Dog::Direction::NORTH},
@@ -325,56 +721,66 @@ StringResponse ApiHandler::HandlePlayerActionRequest(std::string_view version) c
         std::string dir = content.as_object().at(Constants::MOVE).as_string().c_str();
         if (dir.empty()) {
             if (!app_.StopPlayer(token)) {
-                return ResponseApiError(ErrorCode::PlayerTokenNotFound);
+                return ResponseApiError(req_data, ErrorCode::PlayerTokenNotFound);
             }
         } else {
             if (!direction_map.contains(dir)) {
-                return ResponseApiError(ErrorCode::JoinGameParse);
+                return ResponseApiError(req_data, ErrorCode::JoinGameParse);
             }
             if (!app_.MovePlayer(token, direction_map.at(dir))) {
-                return ResponseApiError(ErrorCode::PlayerTokenNotFound);
+                return ResponseApiError(req_data, ErrorCode::PlayerTokenNotFound);
             }
         }
-        return MakeStringResponse(http::status::ok, {}, req_data_, ContentType::APPLICATION_JSON);
+        return MakeStringResponse(http::status::ok, {}, req_data, ContentType::APPLICATION_JSON);
     };
 
-    return ExecuteAllowedMethods([this, &action](){
-        return ExecuteAuthorized([&action](const app::Token& token) {
+    return ExecuteAllowedMethods(req_data, [&req_data, &action](){
+        return ExecuteAuthorized(req_data, [&action](const app::Token& token) {
             return action(token);
         });
     }, http::verb::post);
 }
 
-StringResponse ApiHandler::HandleTickRequest(std::string_view version) const {
-    const auto action = [this](){
-        if (req_data_.content_type != ContentType::APPLICATION_JSON) {
-            return ResponseApiError(ErrorCode::BadRequest);
+StringResponse ApiHandler::HandleTickRequest(const RequestData& req_data, std::string_view version) const {
+    const auto action = [this, &req_data](){
+        if (req_data.content_type != ContentType::APPLICATION_JSON) {
+            return ResponseApiError(req_data, ErrorCode::BadRequest);
         }
         std::error_code ec;
-        json::value content = json::parse(req_data_.body.value(), ec);
+        json::value content = json::parse(req_data.body.value(), ec);
         if (ec) {
-            return ResponseApiError(ErrorCode::TickParse);
+            return ResponseApiError(req_data, ErrorCode::TickParse);
         }
         if (!content.is_object() ||
             !content.as_object().contains(Constants::TIME_DELTA) ||
             !content.as_object().at(Constants::TIME_DELTA).is_int64()) {
-            return ResponseApiError(ErrorCode::TickParse);
+            return ResponseApiError(req_data, ErrorCode::TickParse);
         }
         size_t time_delta = content.as_object().at(Constants::TIME_DELTA).as_int64();
         if (time_delta < 0) {
-            return ResponseApiError(ErrorCode::TickParse);
+            return ResponseApiError(req_data, ErrorCode::TickParse);
         }
         auto tick = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::duration<size_t, std::milli>(time_delta));
         if (app_.TimeTick(tick)) {
-            return MakeStringResponse(http::status::ok, {}, req_data_, ContentType::APPLICATION_JSON);
+            return MakeStringResponse(http::status::ok, {}, req_data, ContentType::APPLICATION_JSON);
         }
-        return ResponseApiError(ErrorCode::TickFail);
+        return ResponseApiError(req_data, ErrorCode::TickFail);
     };
-    return ExecuteAllowedMethods([this, &action](){
+    return ExecuteAllowedMethods(req_data, [&action](){
         return action();
     }, http::verb::post);
 }
 
+StringResponse ApiHandler::HandleMetricsRequest(const RequestData& req_data) const {
+    if (!metrics_) {
+        return ResponseApiError(req_data, ErrorCode::BadRequest);
+    }
+    auto action = [this, &req_data]() {
+        return MakeStringResponse(http::status::ok, metrics_->Render(), req_data, ContentType::PROMETHEUS_TEXT);
+    };
+    return ExecuteAllowedMethods(req_data, std::move(action), http::verb::get, http::verb::head);
+}
+
 int ExtractParameterValue(std::string_view api_token, std::string_view parameter) {
     size_t start = api_token.find(parameter);
     if (start == std::string::npos) {
@@ -398,105 +804,108 @@ static std::tuple<int, int> ParseRecordEndpoint(std::string_view api_token) {
     };
 }
 
-StringResponse ApiHandler::HandleRecordsRequest(std::string_view api_token, std::string_view version) const {
-    const auto action = [this, api_token](){
+StringResponse ApiHandler::HandleRecordsRequest(const RequestData& req_data, std::string_view api_token,
+                                                std::string_view version) const {
+    const auto action = [this, &req_data, api_token](){
         int start, max_items;
         try {
             std::tie(start, max_items) = ParseRecordEndpoint(api_token);
         } catch (...) {
-            return ResponseApiError(ErrorCode::BadRequest);
+            return ResponseApiError(req_data, ErrorCode::BadRequest);
         }
         if (max_items > 100) {
-            return ResponseApiError(ErrorCode::BadRequest);
+            return ResponseApiError(req_data, ErrorCode::BadRequest);
         }
         if (max_items == 0) {
             max_items = 100;
         }
         auto players = app_.Records(start, max_items);
-        json::array json_players;
+        std::string body;
+        json_writer::JsonWriter writer{body};
+        writer.StartArray();
         for (const auto& player : players) {
-            json::object json_player;
-            json_player.emplace(Constants::NAME, player.GetName());
-            json_player.emplace(Constants::SCORE, player.GetScore());
-            json_player.emplace(Constants::PLAY_TIME, player.PlayTime()*1./1000);
-            json_players.push_back(std::move(json_player));
+            writer.StartObject()
+                .Key(Constants::NAME).Value(player.GetName())
+                .Key(Constants::SCORE).Value(player.GetScore())
+                .Key(Constants::PLAY_TIME).Value(player.PlayTime()*1./1000)
+                .EndObject();
         }
-        return MakeStringResponse(http::status::ok, json::serialize(json_players), req_data_, ContentType::APPLICATION_JSON);
+        writer.EndArray();
+        return MakeJsonResponse(std::move(body), req_data);
     };
 
-    return ExecuteAllowedMethods([this, &action](){
+    return ExecuteAllowedMethods(req_data, [&action](){
         return action();
     }, http::verb::get, http::verb::head);
 }
 
-static void JsonifyMainMapInfo(const model::Map& map, json::object& json_map) {
-    json_map.emplace(json_loader::MapFields::id, *map.GetId());
-    json_map.emplace(json_loader::MapFields::name, map.GetName());
+static void WriteMainMapInfo(json_writer::JsonWriter& writer, const model::Map& map) {
+    writer.Key(json_loader::MapFields::id).Value(*map.GetId());
+    writer.Key(json_loader::MapFields::name).Value(map.GetName());
 }
 
-static void JsonifyRoads(const model::Map& map, json::object& json_map) {
-    json::array json_roads;
+static void WriteRoads(json_writer::JsonWriter& writer, const model::Map& map) {
+    writer.Key(json_loader::MapFields::roads).StartArray();
     for (const auto& road : map.GetRoads()) {
-        json::object json_road;
         geom::PointInt start = road.GetStart();
-        json_road.emplace(json_loader::RoadFields::x0, start.x);
-        json_road.emplace(json_loader::RoadFields::y0, start.y);
         geom::PointInt end = road.GetEnd();
+        writer.StartObject();
+        writer.Key(json_loader::RoadFields::x0).Value(start.x);
+        writer.Key(json_loader::RoadFields::y0).Value(start.y);
         if (road.IsHorizontal()) {
-            json_road.emplace(json_loader::RoadFields::x1, end.x);
+            writer.Key(json_loader::RoadFields::x1).Value(end.x);
         } else {
-            json_road.emplace(json_loader::RoadFields::y1, end.y);
+            writer.Key(json_loader::RoadFields::y1).Value(end.y);
         }
-        json_roads.push_back(std::move(json_road));
+        writer.EndObject();
     }
-    json_map.emplace(json_loader::MapFields::roads, json_roads);
+    writer.EndArray();
 }
 
-static void JsonifyBuildings(const model::Map& map, json::object& json_map) {
-    json::array json_offices;
-    for (const auto& office : map.GetOffices()) {
-        json::object json_office;
-        json_office.emplace(json_loader::OfficeFields::id, *office.GetId());
-        geom::PointInt position = office.GetPosition();
-        json_office.emplace(json_loader::OfficeFields::x, position.x);
-        json_office.emplace(json_loader::OfficeFields::y, position.y);
-        model::Offset offset = office.GetOffset();
-        json_office.emplace(json_loader::OfficeFields::offsetX, offset.dx);
-        json_office.emplace(json_loader::OfficeFields::offsetY, offset.dy);
-        json_offices.push_back(std::move(json_office));
+static void WriteBuildings(json_writer::JsonWriter& writer, const model::Map& map) {
+    writer.Key(json_loader::MapFields::buildings).StartArray();
+    for (const auto& building : map.GetBuildings()) {
+        model::Rectangle rect = building.GetBounds();
+        writer.StartObject()
+            .Key(json_loader::BuildingFields::x).Value(rect.position.x)
+            .Key(json_loader::BuildingFields::y).Value(rect.position.y)
+            .Key(json_loader::BuildingFields::w).Value(rect.size.width)
+            .Key(json_loader::BuildingFields::h).Value(rect.size.height)
+            .EndObject();
     }
-    json_map.emplace(json_loader::MapFields::offices, json_offices);
+    writer.EndArray();
 }
 
-static void JsonifyOffices(const model::Map& map, json::object& json_map) {
-    json::array json_buildings;
-    for (const auto& building : map.GetBuildings()) {
-        json::object json_building;
-        model::Rectangle rect = building.GetBounds();
-        json_building.emplace(json_loader::BuildingFields::x, rect.position.x);
-        json_building.emplace(json_loader::BuildingFields::y, rect.position.y);
-        json_building.emplace(json_loader::BuildingFields::w, rect.size.width);
-        json_building.emplace(json_loader::BuildingFields::h, rect.size.height);
-        json_buildings.push_back(std::move(json_building));
+static void WriteOffices(json_writer::JsonWriter& writer, const model::Map& map) {
+    writer.Key(json_loader::MapFields::offices).StartArray();
+    for (const auto& office : map.GetOffices()) {
+        geom::PointInt position = office.GetPosition();
+        model::Offset offset = office.GetOffset();
+        writer.StartObject()
+            .Key(json_loader::OfficeFields::id).Value(*office.GetId())
+            .Key(json_loader::OfficeFields::x).Value(position.x)
+            .Key(json_loader::OfficeFields::y).Value(position.y)
+            .Key(json_loader::OfficeFields::offsetX).Value(offset.dx)
+            .Key(json_loader::OfficeFields::offsetY).Value(offset.dy)
+            .EndObject();
     }
-    json_map.emplace(json_loader::MapFields::buildings, json_buildings);
+    writer.EndArray();
 }
 
-json::object ApiHandler::MapAsJsonObject(const model::Map& map, bool short_info /* = false */) const {
-    json::object json_map;
-    JsonifyMainMapInfo(map, json_map);
-    if (short_info) {
-        return json_map;
+void ApiHandler::WriteMap(json_writer::JsonWriter& writer, const model::Map& map, bool short_info /* = false */) const {
+    writer.StartObject();
+    WriteMainMapInfo(writer, map);
+    if (!short_info) {
+        writer.Key(json_loader::Fields::lootTypes).Raw(loot_types_json_.at(map.GetId()));
+        WriteRoads(writer, map);
+        WriteBuildings(writer, map);
+        WriteOffices(writer, map);
     }
-    json_map.emplace(json_loader::Fields::lootTypes, extra_data_.map_id_to_loot_types.at(map.GetId()));
-    JsonifyRoads(map, json_map);
-    JsonifyOffices(map, json_map);
-    JsonifyBuildings(map, json_map);
-    return json_map;
+    writer.EndObject();
 }
 
-StringResponse ApiHandler::ResponseApiError(ErrorCode ec) const {
-    return ErrorBuilder::MakeErrorResponse(ec, req_data_);
+StringResponse ApiHandler::ResponseApiError(const RequestData& req_data, ErrorCode ec) {
+    return ErrorBuilder::MakeErrorResponse(ec, req_data);
 }
 
 }  // namespace http_handler
@@ -3,12 +3,22 @@
 #include "../app/app.h"
 #include "../json/extra_data.h"
 #include "../json/json_loader.h"
+#include "../json/json_writer.h"
+#include "../metrics/metrics.h"
 #include "../tools/logger.h"
 
+#include "compression.h"
 #include "http_server.h"
+#include "priority_strand.h"
+#include "response_encoding.h"
+#include "session_strands.h"
+#include "state_cache.h"
+#include "tick_waiters.h"
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/json.hpp>
 
@@ -43,6 +53,7 @@ namespace sys = boost::system;
 using StringRequest = http::request<http::string_body>;
 using StringResponse = http::response<http::string_body>;
 using FileResponse = http::response<http::file_body>;
+using SharedResponse = http::response<SharedStringBody>;
 using namespace std::literals;
 
 struct RequestData;
@@ -50,8 +61,23 @@ struct RequestData;
 StringResponse MakeStringResponse(http::status status, std::string_view body, const RequestData& req_data,
                                   std::string_view content_type);
 
+// Ответ 200 с телом JSON, которое перемещается в ответ без копирования
+StringResponse MakeJsonResponse(std::string body, const RequestData& req_data);
+
+// Отправляет ответ в забранное у HTTP-сессии соединение и закрывает его
+void SendAndClose(beast::tcp_stream&& stream, StringResponse&& response);
+
 std::optional<std::string> DecodeURI(std::string_view encoded);
 
+// Отделяет от токена URI строку параметров запроса
+std::pair<std::string_view, std::string_view> SplitQuery(std::string_view api_token);
+
+// Совпадает ли ETag с одним из значений заголовка If-None-Match
+bool MatchesETag(std::string_view if_none_match, std::string_view etag);
+
+// Значение параметра name из строки параметров запроса
+std::optional<std::string_view> FindQueryParameter(std::string_view query, std::string_view name);
+
 
 enum class ErrorCode {
     Ok,
@@ -65,6 +91,8 @@ enum class ErrorCode {
     MapNotFound,
     PlayerTokenNotFound,
     ServerError,
+    ServerOverloaded,
+    SpectatorsLimit,
     TickParse,
     TickFail,
 };
@@ -82,6 +110,7 @@ struct ApiTokens {
     static constexpr std::string_view ACTION    = "action"sv;
     static constexpr std::string_view TICK      = "tick"sv;
     static constexpr std::string_view RECORDS   = "records"sv;
+    static constexpr std::string_view METRICS   = "metrics"sv;
     static const fs::path api_root;
 };
 
@@ -110,6 +139,13 @@ struct Constants {
     static constexpr std::string_view MAX_ITEMS     = "maxItems"sv;
     static constexpr std::string_view START         = "start"sv;
     static constexpr std::string_view PLAY_TIME     = "playTime"sv;
+    static constexpr std::string_view SINCE         = "since"sv;
+    static constexpr std::string_view RADIUS        = "radius"sv;
+    static constexpr std::string_view SEQ           = "seq"sv;
+    static constexpr std::string_view FULL          = "full"sv;
+    static constexpr std::string_view REMOVED_PLAYERS = "removedPlayers"sv;
+    static constexpr std::string_view REMOVED_OBJECTS = "removedObjects"sv;
+    static constexpr std::string_view WAIT          = "wait"sv;
 };
 
 struct Methods {
@@ -127,6 +163,7 @@ struct ContentType {
     static constexpr std::string_view TEXT_PLAIN        = "text/plain"sv;
     static constexpr std::string_view TEXT_JS           = "text/javascript"sv;
     static constexpr std::string_view APPLICATION_JSON  = "application/json"sv;
+    static constexpr std::string_view PROMETHEUS_TEXT   = "text/plain; version=0.0.4"sv;
     static constexpr std::string_view APPLICATION_XML   = "text/xml"sv;
     static constexpr std::string_view IMAGE_PNG         = "image/png"sv;
     static constexpr std::string_view IMAGE_JPG         = "image/jpeg"sv;
@@ -173,6 +210,9 @@ struct RequestData {
         if (req.count(http::field::authorization)) {
             auth_token = ParseAuthToken(req);
         }
+        accept = req[http::field::accept];
+        accept_encoding = req[http::field::accept_encoding];
+        if_none_match = req[http::field::if_none_match];
     }
 
     unsigned http_version{};
@@ -183,6 +223,9 @@ struct RequestData {
     std::optional<std::string_view> body;
     std::optional<std::string_view> content_type;
     std::optional<app::Token> auth_token;
+    std::string_view accept;
+    std::string_view accept_encoding;
+    std::string_view if_none_match;
 
 private:
     template <typename Body, typename Allocator>
@@ -253,6 +296,10 @@ private:
             return {http::status::unauthorized, SerializeError(Codes::UnknownToken, Messages::PlayerToken), ContentType::APPLICATION_JSON};
         case ErrorCode::TickFail:
             return {http::status::bad_request, SerializeError(Codes::BadRequest, Messages::InvalidEndpoint), ContentType::APPLICATION_JSON};
+        case ErrorCode::SpectatorsLimit:
+            return {http::status::service_unavailable, SerializeError(Codes::ServiceUnavailable, Messages::SpectatorsLimit), ContentType::APPLICATION_JSON};
+        case ErrorCode::ServerOverloaded:
+            return {http::status::service_unavailable, SerializeError(Codes::ServiceUnavailable, Messages::ServerOverloaded), ContentType::APPLICATION_JSON};
         default:
             return {};
         }
@@ -267,6 +314,7 @@ private:
         static constexpr std::string_view InvalidArgument = "invalidArgument"sv;
         static constexpr std::string_view InvalidToken = "invalidToken"sv;
         static constexpr std::string_view UnknownToken = "unknownToken"sv;
+        static constexpr std::string_view ServiceUnavailable = "serviceUnavailable"sv;
     };
 
     struct Messages {
@@ -283,6 +331,8 @@ private:
         static constexpr std::string_view AuthHeader        = "Authorization header is missing"sv;
         static constexpr std::string_view PlayerToken       = "Player token has not been found"sv;
         static constexpr std::string_view InvalidEndpoint   = "Invalid endpoint"sv;
+        static constexpr std::string_view SpectatorsLimit   = "Too many spectators, try again later"sv;
+        static constexpr std::string_view ServerOverloaded  = "Server is overloaded, request full state or try again later"sv;
     };
 
 };
@@ -290,64 +340,125 @@ private:
 class ApiHandler {
 
 public:
-    explicit ApiHandler(app::Application& app, const extra_data::ExtraData& extra_data);
+    // metrics - реестр метрик для /api/v1/metrics, без него запрос метрик отклоняется
+    explicit ApiHandler(app::Application& app, const extra_data::ExtraData& extra_data,
+                        metrics::Registry* metrics = nullptr);
 
     template <typename Body, typename Allocator>
-    StringResponse HandleRequest(const http::request<Body, http::basic_fields<Allocator>>& req);
+    StringResponse HandleRequest(const http::request<Body, http::basic_fields<Allocator>>& req) const;
+
+    // Где выполняется запрос
+    enum class RequestScope {
+        CONCURRENT, // читает карты, рекорды или снимки сессий: в любом потоке
+        SESSION,    // обращается к одной игровой сессии: в её strand
+        GAME,       // затрагивает все сессии (/tick): в strand координатора
+    };
+
+    static RequestScope GetRequestScope(const RequestData& req_data);
+
+    // Класс запроса, выполняемого в strand сессии: чтение состояния уступает входу и действиям игроков
+    static TaskPriority GetRequestPriority(const RequestData& req_data);
+
+    // Карта, к сессии которой относится запрос: из тела запроса на вход в игру или по токену игрока.
+    // Может вызываться в любом потоке.
+    std::optional<model::Map::Id> FindRequestMap(const RequestData& req_data) const;
+
+    // Под нагрузкой запросы изменений состояния и области интереса (since, radius) получают ответ 503
+    // без обращения к сессии; полное состояние по снимку остаётся доступным. nullopt, если запрос нужно выполнить.
+    // Может вызываться в любом потоке.
+    std::optional<StringResponse> ShedRequest(const RequestData& req_data) const;
+
+    // Наибольшее время ожидания следующего тика в запросе состояния с параметром wait
+    static constexpr std::chrono::milliseconds MAX_LONG_POLL_WAIT{30000};
+
+    // Время, на которое запрос состояния нужно отложить до следующего тика, или nullopt,
+    // если на него нужно ответить сразу. Может вызываться в любом потоке.
+    std::optional<std::chrono::milliseconds> GetLongPollWait(const RequestData& req_data) const;
+
+    static std::string SerializeGameState(const app::UseCaseGetGameState::GameState& state);
+
+    static std::string SerializeGameStateDelta(const app::UseCaseGetGameStateDelta::GameStateDelta& delta);
 
 private:
-    StringResponse HandleMapsRequest(std::string_view version) const;
+    using Tokens = std::queue<std::string_view>;
+
+    // Обработчики не хранят состояния запроса: разобранный запрос и ещё не разобранные
+    // части пути передаются им параметрами, поэтому запросы можно обрабатывать параллельно
+    StringResponse HandleMapsRequest(const RequestData& req_data, Tokens& tokens, std::string_view version) const;
+
+    StringResponse HandleAllMapsRequest(const RequestData& req_data, std::string_view version) const;
 
-    StringResponse HandleAllMapsRequest(std::string_view version) const;
+    StringResponse HandleSingleMapRequest(const RequestData& req_data, Tokens& tokens, std::string_view version) const;
 
-    StringResponse HandleSingleMapRequest(std::string_view version) const;
+    StringResponse HandleGameRequest(const RequestData& req_data, Tokens& tokens, std::string_view version) const;
 
-    StringResponse HandleGameRequest(std::string_view version) const;
+    StringResponse HandlePlayerJoin(const RequestData& req_data, std::string_view version) const;
 
-    StringResponse HandlePlayerJoin(std::string_view version) const;
+    StringResponse HandlePlayersRequest(const RequestData& req_data, std::string_view version) const;
 
-    StringResponse HandlePlayersRequest(std::string_view version) const;
+    StringResponse HandleGameStateRequest(const RequestData& req_data, std::string_view api_token,
+                                          std::string_view version) const;
 
-    StringResponse HandleGameStateRequest(std::string_view version) const;
+    // Полное состояние строится по снимку сессии и не требует strand
+    StringResponse HandleFullGameStateRequest(const RequestData& req_data, const app::SessionSnapshot& snapshot) const;
 
-    StringResponse HandlePlayerActionRequest(std::string_view version) const;
+    StringResponse HandleGameStateDeltaRequest(const RequestData& req_data, const app::Token& token,
+                                               size_t since) const;
 
-    StringResponse HandleTickRequest(std::string_view version) const;
+    StringResponse HandleAreaOfInterestRequest(const RequestData& req_data, const app::Token& token,
+                                               double radius) const;
 
-    StringResponse HandleRecordsRequest(std::string_view api_token, std::string_view version) const;
+    StringResponse HandlePlayerActionRequest(const RequestData& req_data, std::string_view version) const;
 
-    json::object MapAsJsonObject(const model::Map& map, bool short_info = false) const;
+    StringResponse HandleTickRequest(const RequestData& req_data, std::string_view version) const;
 
-    StringResponse ResponseApiError(ErrorCode ec) const;
+    StringResponse HandleMetricsRequest(const RequestData& req_data) const;
+
+    StringResponse HandleRecordsRequest(const RequestData& req_data, std::string_view api_token,
+                                        std::string_view version) const;
+
+    void WriteMap(json_writer::JsonWriter& writer, const model::Map& map, bool short_info = false) const;
+
+    // ETag состояния: сессия, номер тика, версия состояния сессии и вид ответа (since, radius)
+    static std::string MakeStateETag(const app::UseCaseGetStateVersion::StateVersion& state_version,
+                                     ResponseEncoding encoding, std::string_view variant);
+
+    static StringResponse MakeNotModifiedResponse(const RequestData& req_data, std::string_view etag);
+
+    // Ответ с телом в формате, выбранном по заголовку Accept
+    static StringResponse MakeEncodedResponse(const RequestData& req_data, std::string_view body,
+                                              ResponseEncoding encoding);
+
+    static StringResponse ResponseApiError(const RequestData& req_data, ErrorCode ec);
 
     template <typename Arg, typename... Args>
-    bool IsMethodOneOfAllowed(const Arg& arg, const Args&... args) const {
-        if (req_data_.method == arg)
+    static bool IsMethodOneOfAllowed(http::verb method, const Arg& arg, const Args&... args) {
+        if (method == arg)
             return true;
         if constexpr (sizeof...(args) != 0) {
-            return IsMethodOneOfAllowed(args...);
+            return IsMethodOneOfAllowed(method, args...);
         }
         return false;
     }
 
     template <typename Fn, typename... Args>
-    StringResponse ExecuteAllowedMethods(Fn&& action, const Args&... allowed_methods) const {
-        if (!IsMethodOneOfAllowed(allowed_methods...)) {
-            return MakeInvalidMethodResponse(allowed_methods...);
+    static StringResponse ExecuteAllowedMethods(const RequestData& req_data, Fn&& action, const Args&... allowed_methods) {
+        if (!IsMethodOneOfAllowed(req_data.method, allowed_methods...)) {
+            return MakeInvalidMethodResponse(req_data, allowed_methods...);
         }
         return action();
     }
 
     template <typename Fn>
-    StringResponse ExecuteAuthorized(Fn&& action) const {
-        if (!req_data_.auth_token.has_value()) {
-            return ResponseApiError(ErrorCode::InvalidAuthHeader);
+    static StringResponse ExecuteAuthorized(const RequestData& req_data, Fn&& action) {
+        if (!req_data.auth_token.has_value()) {
+            return ResponseApiError(req_data, ErrorCode::InvalidAuthHeader);
         }
-        return action(req_data_.auth_token.value());
+        return action(req_data.auth_token.value());
     }
 
     template <typename Arg, typename... Args>
-    void PrintMethods(std::ostream& out, const Arg& arg, const Args&... args) const {
+    static void PrintMethods(std::ostream& out, const Arg& arg, const Args&... args) {
         out << Methods::method_to_str.at(arg);
         if constexpr (sizeof...(args) != 0) {
             out << ", "sv;
@@ -356,60 +467,68 @@ private:
     }
 
     template <typename... Args>
-    StringResponse MakeInvalidMethodResponse(const Args&... args) const {
+    static StringResponse MakeInvalidMethodResponse(const RequestData& req_data, const Args&... args) {
         std::ostringstream methods;
         PrintMethods(methods, args...);
-        auto response = ErrorBuilder::MakeErrorResponse(ErrorCode::InvalidMethod, req_data_, methods.str());
+        auto response = ErrorBuilder::MakeErrorResponse(ErrorCode::InvalidMethod, req_data, methods.str());
         response.set(http::field::allow, methods.str());
         return response;
     }
 
 private:
-    RequestData req_data_;
     app::Application& app_;
     const extra_data::ExtraData& extra_data_;
-    mutable std::queue<std::string_view> req_tokens_;
+    const metrics::Registry* metrics_;
+    metrics::Counter* shed_state_polls_ = nullptr;
+    // Типы трофеев карт, сериализованные один раз при создании обработчика
+    std::unordered_map<model::Map::Id, std::string, util::TaggedHasher<model::Map::Id>> loot_types_json_;
+    // Потокобезопасен: запросы состояния разных сессий выполняются параллельно
+    mutable StateCache state_cache_;
 };
 
 template <typename Body, typename Allocator>
-StringResponse ApiHandler::HandleRequest(const http::request<Body, http::basic_fields<Allocator>>& req) {
-    req_data_.Construct(req);
-    if (!req_data_.decoded_uri.has_value()) {
-        return ResponseApiError(ErrorCode::InvalidURI);
+StringResponse ApiHandler::HandleRequest(const http::request<Body, http::basic_fields<Allocator>>& req) const {
+    const RequestData req_data(req);
+    if (!req_data.decoded_uri.has_value()) {
+        return ResponseApiError(req_data, ErrorCode::InvalidURI);
     }
-    req_tokens_ = SplitIntoTokens(*req_data_.decoded_uri, '/');
-    if (req_tokens_.empty() || req_tokens_.front() != ApiTokens::API) {
+    Tokens tokens = SplitIntoTokens(*req_data.decoded_uri, '/');
+    if (tokens.empty() || tokens.front() != ApiTokens::API) {
         throw std::runtime_error("Not API request");
     }
-    req_tokens_.pop();
-    if (req_tokens_.empty()) {
-        return ResponseApiError(ErrorCode::BadRequest);
+    tokens.pop();
+    if (tokens.empty()) {
+        return ResponseApiError(req_data, ErrorCode::BadRequest);
     }
-    auto version = req_tokens_.front(); req_tokens_.pop();
+    auto version = tokens.front(); tokens.pop();
     if (version != ApiTokens::V1) {
-        return ResponseApiError(ErrorCode::BadRequest);
+        return ResponseApiError(req_data, ErrorCode::BadRequest);
     }
-    if (req_tokens_.empty()) {
-        return ResponseApiError(ErrorCode::BadRequest);
+    if (tokens.empty()) {
+        return ResponseApiError(req_data, ErrorCode::BadRequest);
     }
-    auto token = req_tokens_.front(); req_tokens_.pop();
+    auto token = tokens.front(); tokens.pop();
     if (token == ApiTokens::MAPS) {
-        return HandleMapsRequest(version);
+        return HandleMapsRequest(req_data, tokens, version);
     }
     if (token == ApiTokens::GAME) {
-        return HandleGameRequest(version);
+        return HandleGameRequest(req_data, tokens, version);
     }
-    return ResponseApiError(ErrorCode::BadRequest);
+    if (token == ApiTokens::METRICS && tokens.empty()) {
+        return HandleMetricsRequest(req_data);
+    }
+    return ResponseApiError(req_data, ErrorCode::BadRequest);
 }
 
 class RequestHandler : public std::enable_shared_from_this<RequestHandler>{
-    using Strand = net::strand<net::io_context::executor_type>;
-
 public:
-    explicit RequestHandler(ApiHandler& api_handler, fs::path&& root, Strand api_strand)
+    explicit RequestHandler(ApiHandler& api_handler, fs::path&& root, std::shared_ptr<SessionStrands> strands,
+                            std::shared_ptr<TickWaiters> tick_waiters, CompressionConfig compression = {})
         : api_handler_{api_handler}
         , root_(std::move(root))
-        , api_strand_{api_strand} {
+        , strands_{std::move(strands)}
+        , tick_waiters_{std::move(tick_waiters)}
+        , compressor_{compression} {
         std::error_code ec;
         if (!fs::exists(root_, ec) || ec) {
             std::ostringstream message;
@@ -436,15 +555,8 @@ private:
     template <typename Body, typename Allocator, typename Send>
     void HandleRequest(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send) {
         if (IsApiRequest(req)) {
-            auto handle = [self = shared_from_this(), send, req = std::forward<decltype(req)>(req)]() {
-                try {
-                    send(self->api_handler_.HandleRequest(std::forward<decltype(req)>(req)));
-                } catch (...) {
-                    RequestData data(req);
-                    send(ErrorBuilder::MakeErrorResponse(ErrorCode::ServerError, data));
-                }
-            };
-            return net::dispatch(api_strand_, handle);
+            const bool may_wait = true;
+            return DispatchApiRequest(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send), may_wait);
         }
         return std::visit(
             [&send](auto&& result) {
@@ -454,8 +566,100 @@ private:
         );
     }
 
+    // Выбирает, где выполнить запрос к API: сразу в текущем потоке, в strand сессии или в strand координатора
+    template <typename Request, typename Send>
+    void DispatchApiRequest(Request&& req, Send&& send, bool may_wait) {
+        const RequestData data(req);
+        const SessionStrands::Session* session = nullptr;
+        switch (ApiHandler::GetRequestScope(data)) {
+        case ApiHandler::RequestScope::CONCURRENT:
+            break;
+        case ApiHandler::RequestScope::GAME:
+            return net::dispatch(strands_->GetCoordinator(),
+                [self = shared_from_this(), send, req = std::forward<Request>(req)]() {
+                    self->HandleApiRequest(req, send, false);
+                });
+        case ApiHandler::RequestScope::SESSION:
+            if (auto response = api_handler_.ShedRequest(data)) {
+                return send(std::move(*response));
+            }
+            if (auto map_id = api_handler_.FindRequestMap(data)) {
+                session = strands_->FindByMap(*map_id);
+            }
+            break;
+        }
+        // Запросы, не найденные ни в одной сессии, не обращаются к сессиям:
+        // на них отвечают ошибкой сразу
+        if (!session) {
+            return HandleApiRequest(req, send, false);
+        }
+        const auto priority = ApiHandler::GetRequestPriority(data);
+        strands_->Post(*session, priority, [self = shared_from_this(), send, req = std::forward<Request>(req), may_wait]() {
+            self->HandleApiRequest(req, send, may_wait);
+        });
+    }
+
+    template <typename Request, typename Send>
+    void HandleApiRequest(const Request& req, const Send& send, bool may_wait) {
+        try {
+            if (may_wait) {
+                if (auto wait = api_handler_.GetLongPollWait(RequestData(req))) {
+                    return WaitForTick(req, send, *wait);
+                }
+            }
+            SendApiResponse(api_handler_.HandleRequest(req), req[http::field::accept_encoding], send);
+        } catch (...) {
+            RequestData data(req);
+            send(ErrorBuilder::MakeErrorResponse(ErrorCode::ServerError, data));
+        }
+    }
+
+    // Откладывает ответ до окончания следующего тика или истечения времени ожидания.
+    // Отложенный запрос не занимает strand: он хранится как обработчик в tick_waiters_
+    // и после пробуждения заново направляется в strand своей сессии.
+    template <typename Request, typename Send>
+    void WaitForTick(const Request& req, const Send& send, std::chrono::milliseconds wait) {
+        const bool may_wait = false;
+        auto timer = std::make_shared<net::steady_timer>(strands_->GetCoordinator().get_inner_executor(), wait);
+        const auto id = tick_waiters_->Add([self = shared_from_this(), req, send, timer]() {
+            timer->cancel();
+            // Обработчики тика выполняются под исключительной блокировкой или в потоке симуляции,
+            // поэтому запрос продолжается в потоке ввода-вывода
+            net::post(self->strands_->GetCoordinator().get_inner_executor(), [self, req, send]() {
+                self->DispatchApiRequest(Request{req}, Send{send}, may_wait);
+            });
+        });
+        timer->async_wait([self = shared_from_this(), req, send, timer, id](sys::error_code) {
+            if (self->tick_waiters_->Remove(id)) {
+                self->DispatchApiRequest(Request{req}, Send{send}, may_wait);
+            }
+        });
+    }
+
+    template <typename Send>
+    void SendApiResponse(StringResponse&& response, std::string_view accept_encoding, const Send& send) {
+        const auto encoding = compressor_.Choose(accept_encoding, response.body().size());
+        if (encoding == ContentEncoding::IDENTITY && !strands_->IsSimulationThread()) {
+            return send(std::move(response));
+        }
+        // Сжатие и отправка выполняются вне strand сессии и потока симуляции,
+        // чтобы не задерживать остальные запросы к игре и тики
+        net::post(strands_->GetCoordinator().get_inner_executor(),
+            [self = shared_from_this(), response = std::move(response), encoding, send]() mutable {
+                try {
+                    if (encoding != ContentEncoding::IDENTITY) {
+                        self->compressor_.CompressResponse(response, encoding);
+                    }
+                } catch (...) {
+                    // При ошибке сжатия тело ответа не изменяется и отправляется как есть
+                }
+                send(std::move(response));
+            }
+        );
+    }
+
     template <typename Body, typename Allocator>
-    std::variant<StringResponse, FileResponse> HandleFileRequest(http::request<Body, http::basic_fields<Allocator>>&& req) const {
+    std::variant<StringResponse, FileResponse, SharedResponse> HandleFileRequest(http::request<Body, http::basic_fields<Allocator>>&& req) const {
         RequestData data(req);
         if (!data.decoded_uri.has_value()) {
             return ErrorBuilder::MakeErrorResponse(ErrorCode::InvalidURI, data);
@@ -476,6 +680,9 @@ private:
         std::string_view content = ContentType::FromFileExt(
             boost::algorithm::to_lower_copy(uri.extension().string())
         );
+        if (auto compressed = GetCompressedFile(uri, content, data)) {
+            return std::move(*compressed);
+        }
         FileResponse response;
         response.version(data.http_version);
         response.result(http::status::ok);
@@ -492,6 +699,30 @@ private:
         return response;
     }
 
+    // Сжатый файл отправляется из кэша без копирования
+    std::optional<SharedResponse> GetCompressedFile(const fs::path& path, std::string_view content_type,
+                                                    const RequestData& data) const {
+        if (IsPrecompressedContentType(content_type)) {
+            return std::nullopt;
+        }
+        std::error_code ec;
+        const auto file_size = fs::file_size(path, ec);
+        if (ec) {
+            return std::nullopt;
+        }
+        const auto encoding = compressor_.Choose(data.accept_encoding, file_size);
+        if (encoding == ContentEncoding::IDENTITY) {
+            return std::nullopt;
+        }
+        SharedResponse response(http::status::ok, data.http_version);
+        response.set(http::field::content_type, content_type);
+        response.set(http::field::content_encoding, ToString(encoding));
+        response.set(http::field::vary, http::to_string(http::field::accept_encoding));
+        response.body() = compressor_.GetCompressedFile(path, encoding);
+        response.prepare_payload();
+        return response;
+    }
+
 private:
     template <typename Body, typename Allocator>
     bool IsApiRequest(const http::request<Body, http::basic_fields<Allocator>>& req) const {
@@ -504,8 +735,10 @@ private:
     }
 
     fs::path root_;
-    Strand api_strand_;
+    std::shared_ptr<SessionStrands> strands_;
     ApiHandler& api_handler_;
+    std::shared_ptr<TickWaiters> tick_waiters_;
+    ResponseCompressor compressor_;
 };
 
 }  // namespace http_handler
@@ -0,0 +1,243 @@
+#include "response_encoding.h"
+
+#include "header_parsing.h"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace http_handler {
+
+namespace {
+
+std::string_view MediaTypeOf(ResponseEncoding encoding) {
+    switch (encoding) {
+    case ResponseEncoding::BINARY:
+        return BinaryContentType::FLOAT;
+    case ResponseEncoding::BINARY_FIXED:
+        return BinaryContentType::FIXED;
+    case ResponseEncoding::JSON:
+        break;
+    }
+    return "application/json"sv;
+}
+
+// Насколько точно диапазон media_range из Accept описывает тип формата: 0 - не описывает
+int MatchLevel(std::string_view media_range, ResponseEncoding encoding) {
+    if (media_range == MediaTypeOf(encoding)) {
+        return 3;
+    }
+    if (media_range == "application/*"sv) {
+        return 2;
+    }
+    if (media_range == "*/*"sv) {
+        return 1;
+    }
+    return 0;
+}
+
+class BinaryWriter {
+public:
+    BinaryWriter(std::string& out, ResponseEncoding encoding)
+        : out_{out}
+        , fixed_point_{encoding == ResponseEncoding::BINARY_FIXED} {
+    }
+
+    void U8(uint8_t value) {
+        out_.push_back(static_cast<char>(value));
+    }
+
+    void U16(uint16_t value) {
+        WriteLittleEndian(value);
+    }
+
+    void U32(uint32_t value) {
+        WriteLittleEndian(value);
+    }
+
+    void U64(uint64_t value) {
+        WriteLittleEndian(value);
+    }
+
+    void F64(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        WriteLittleEndian(bits);
+    }
+
+    void Bytes(std::string_view bytes) {
+        out_.append(bytes);
+    }
+
+    void Coord(double value) {
+        if (fixed_point_) {
+            U32(static_cast<uint32_t>(static_cast<int32_t>(std::llround(value * FIXED_POINT_SCALE))));
+        } else {
+            F64(value);
+        }
+    }
+
+    void Point(const geom::PointDouble& point) {
+        Coord(point.x);
+        Coord(point.y);
+    }
+
+    uint8_t Flags() const noexcept {
+        return fixed_point_ ? 1 : 0;
+    }
+
+private:
+    template <typename T>
+    void WriteLittleEndian(T value) {
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            out_.push_back(static_cast<char>(value & 0xFF));
+            value >>= 8;
+        }
+    }
+
+    std::string& out_;
+    bool fixed_point_;
+};
+
+uint8_t DirectionCode(model::Dog::Direction dir) {
+    switch (dir) {
+    case model::Dog::Direction::NORTH:
+        return 0;
+    case model::Dog::Direction::SOUTH:
+        return 1;
+    case model::Dog::Direction::WEST:
+        return 2;
+    case model::Dog::Direction::EAST:
+        return 3;
+    }
+    return 0;
+}
+
+void WritePlayers(BinaryWriter& writer, const std::vector<app::UseCaseGetGameState::PlayerState>& players) {
+    writer.U32(static_cast<uint32_t>(players.size()));
+    for (const auto& player : players) {
+        writer.U64(*player.id);
+        writer.Point(player.pos);
+        writer.Point(player.speed);
+        writer.U8(DirectionCode(player.dir));
+        writer.U64(player.score);
+        writer.U16(static_cast<uint16_t>(player.bag.size()));
+        for (const auto& loot_item : player.bag) {
+            writer.U64(loot_item.id);
+            writer.U32(static_cast<uint32_t>(loot_item.type));
+        }
+    }
+}
+
+void WriteLootObjects(BinaryWriter& writer, const std::vector<app::UseCaseGetGameState::LootObjectState>& loot_objects) {
+    writer.U32(static_cast<uint32_t>(loot_objects.size()));
+    for (const auto& loot_object : loot_objects) {
+        writer.U64(*loot_object.id);
+        writer.U32(static_cast<uint32_t>(loot_object.type));
+        writer.Point(loot_object.pos);
+    }
+}
+
+constexpr size_t PLAYER_SIZE_ESTIMATE = 64;
+constexpr size_t LOOT_OBJECT_SIZE_ESTIMATE = 28;
+
+}  // namespace
+
+ResponseEncoding ChooseEncoding(std::string_view accept) {
+    // Качество формата задаёт наиболее точно описывающий его диапазон: application/json;q=0 исключает JSON,
+    // даже если указан */*
+    struct Match {
+        int level = 0;
+        double quality = 0.;
+        size_t position = 0;
+    };
+    std::array<Match, RESPONSE_ENCODINGS_COUNT> matches;
+    for (size_t position = 0; !accept.empty(); ++position) {
+        size_t end = accept.find(',');
+        std::string_view media_range = accept.substr(0, end);
+        size_t params_start = media_range.find(';');
+        const auto media_type = Trim(media_range.substr(0, params_start));
+        for (size_t i = 0; i < RESPONSE_ENCODINGS_COUNT; ++i) {
+            const int level = MatchLevel(media_type, static_cast<ResponseEncoding>(i));
+            if (level > matches[i].level) {
+                const double quality = params_start == std::string_view::npos
+                    ? 1.
+                    : ParseQuality(media_range.substr(params_start + 1));
+                matches[i] = {level, quality, position};
+            }
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        accept.remove_prefix(end + 1);
+    }
+
+    // Из форматов с наибольшим качеством выбирается указанный явно и раньше других, иначе JSON.
+    // Если приемлемых форматов нет, ответ всё равно отправляется в JSON.
+    ResponseEncoding best = ResponseEncoding::JSON;
+    const Match* best_match = nullptr;
+    for (size_t i = 0; i < RESPONSE_ENCODINGS_COUNT; ++i) {
+        const auto& match = matches[i];
+        if (match.level == 0 || match.quality <= 0.) {
+            continue;
+        }
+        const bool exact = match.level == 3;
+        if (!best_match || match.quality > best_match->quality
+            || (match.quality == best_match->quality && exact
+                && (best_match->level != 3 || match.position < best_match->position))) {
+            best = static_cast<ResponseEncoding>(i);
+            best_match = &match;
+        }
+    }
+    return best;
+}
+
+std::string EncodeGameState(const app::UseCaseGetGameState::GameState& state, ResponseEncoding encoding) {
+    std::string body;
+    body.reserve(16 + state.players.size() * PLAYER_SIZE_ESTIMATE + state.loot_objects.size() * LOOT_OBJECT_SIZE_ESTIMATE);
+    BinaryWriter writer{body, encoding};
+    writer.Bytes("DGS\1"sv);
+    writer.U8(writer.Flags());
+    WritePlayers(writer, state.players);
+    WriteLootObjects(writer, state.loot_objects);
+    return body;
+}
+
+std::string EncodeGameStateDelta(const app::UseCaseGetGameStateDelta::GameStateDelta& delta, ResponseEncoding encoding) {
+    std::string body;
+    body.reserve(32 + delta.players.size() * PLAYER_SIZE_ESTIMATE + delta.loot_objects.size() * LOOT_OBJECT_SIZE_ESTIMATE
+        + (delta.retired_players.size() + delta.removed_loot_objects.size()) * sizeof(uint64_t));
+    BinaryWriter writer{body, encoding};
+    writer.Bytes("DGD\1"sv);
+    writer.U8(writer.Flags());
+    writer.U64(delta.seq);
+    writer.U8(delta.full ? 1 : 0);
+    WritePlayers(writer, delta.players);
+    WriteLootObjects(writer, delta.loot_objects);
+    writer.U32(static_cast<uint32_t>(delta.retired_players.size()));
+    for (const auto& id : delta.retired_players) {
+        writer.U64(*id);
+    }
+    writer.U32(static_cast<uint32_t>(delta.removed_loot_objects.size()));
+    for (const auto& id : delta.removed_loot_objects) {
+        writer.U64(*id);
+    }
+    return body;
+}
+
+std::string EncodePlayers(const std::vector<std::pair<model::Dog::Id, std::string>>& players) {
+    std::string body;
+    BinaryWriter writer{body, ResponseEncoding::BINARY};
+    writer.Bytes("DGP\1"sv);
+    writer.U32(static_cast<uint32_t>(players.size()));
+    for (const auto& [id, name] : players) {
+        const auto name_size = std::min<size_t>(name.size(), UINT16_MAX);
+        writer.U64(*id);
+        writer.U16(static_cast<uint16_t>(name_size));
+        writer.Bytes(std::string_view{name}.substr(0, name_size));
+    }
+    return body;
+}
+
+}  // namespace http_handler
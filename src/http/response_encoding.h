@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../app/app.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace http_handler {
+
+using namespace std::literals;
+
+/*
+ *  Формат тела ответов о состоянии игры, выбираемый по заголовку Accept.
+ *  JSON используется по умолчанию.
+ *
+ *  Двоичный формат: little-endian, без выравнивания.
+ *  Координаты и скорости записываются как f64 (BINARY)
+ *  или как i32 в тысячных долях клетки (BINARY_FIXED).
+ *
+ *  GameState:  u8[4] "DGS\1", u8 flags, Players, LootObjects
+ *  Delta:      u8[4] "DGD\1", u8 flags, u64 seq, u8 full, Players, LootObjects,
+ *              u32 n, u64 retired_id[n], u32 m, u64 removed_loot_id[m]
+ *  Players:    u32 n, { u64 id, Point pos, Point speed, u8 dir, u64 score,
+ *                       u16 bag_size, { u64 id, u32 type }[bag_size] }[n]
+ *  LootObjects: u32 n, { u64 id, u32 type, Point pos }[n]
+ *  PlayersList: u8[4] "DGP\1", u32 n, { u64 id, u16 name_size, u8 name[name_size] }[n]
+ *
+ *  flags: бит 0 - координаты в фиксированной точке.
+ *  dir: 0 - U, 1 - D, 2 - L, 3 - R.
+ */
+enum class ResponseEncoding {
+    JSON,
+    BINARY,
+    BINARY_FIXED,
+};
+
+inline constexpr size_t RESPONSE_ENCODINGS_COUNT = 3;
+
+struct BinaryContentType {
+    BinaryContentType() = delete;
+    static constexpr std::string_view FLOAT  = "application/vnd.dog-game+binary"sv;
+    static constexpr std::string_view FIXED  = "application/vnd.dog-game.fixed+binary"sv;
+};
+
+// Масштаб координат в формате с фиксированной точкой
+inline constexpr double FIXED_POINT_SCALE = 1000.;
+
+// Выбирает формат по значению заголовка Accept с учётом q-параметров и масок типов (application/*, */*)
+ResponseEncoding ChooseEncoding(std::string_view accept);
+
+std::string EncodeGameState(const app::UseCaseGetGameState::GameState& state, ResponseEncoding encoding);
+
+std::string EncodeGameStateDelta(const app::UseCaseGetGameStateDelta::GameStateDelta& delta, ResponseEncoding encoding);
+
+std::string EncodePlayers(const std::vector<std::pair<model::Dog::Id, std::string>>& players);
+
+}  // namespace http_handler
@@ -0,0 +1,100 @@
+#include "session_strands.h"
+
+#include <atomic>
+#include <utility>
+
+namespace http_handler {
+
+SessionStrands::SessionStrands(net::io_context& ioc, app::Application& app, Strand coordinator,
+                               std::shared_ptr<app::Simulation> simulation, metrics::Registry* registry)
+    : app_{app}
+    , coordinator_{std::move(coordinator)}
+    , simulation_{std::move(simulation)} {
+    if (registry) {
+        metrics_.emplace(*registry);
+    }
+    const PriorityStrand::Metrics* metrics = metrics_ ? &*metrics_ : nullptr;
+    for (const auto& map : app_.GetMaps()) {
+        sessions_.try_emplace(map.GetId(), map.GetId(), net::make_strand(ioc), metrics);
+    }
+}
+
+const SessionStrands::Session* SessionStrands::FindByMap(const model::Map::Id& map_id) const {
+    if (auto it = sessions_.find(map_id); it != sessions_.end()) {
+        return &it->second;
+    }
+    return nullptr;
+}
+
+const SessionStrands::Session* SessionStrands::FindByToken(const app::Token& token) const {
+    if (auto map_id = app_.FindPlayerMap(token)) {
+        return FindByMap(*map_id);
+    }
+    return nullptr;
+}
+
+void SessionStrands::Tick(std::chrono::milliseconds delta) {
+    delayed_delta_ += delta;
+    if (tick_running_) {
+        return;
+    }
+    tick_running_ = true;
+    tick_start_ = std::chrono::steady_clock::now();
+    const auto tick = std::exchange(delayed_delta_, std::chrono::milliseconds{0});
+    app::TickSchedule::DueSessions due;
+    if (schedule_) {
+        due = schedule_->Advance(tick);
+    } else {
+        due.reserve(sessions_.size());
+        for (const auto& [map_id, session] : sessions_) {
+            due.push_back(app::TickSchedule::DueSession{map_id, tick});
+        }
+    }
+    if (due.empty()) {
+        return CompleteTick(tick);
+    }
+    auto remaining = std::make_shared<std::atomic<size_t>>(due.size());
+    for (const auto& [map_id, session_delta] : due) {
+        const Session* session = FindByMap(map_id);
+        // Снимок сессии публикуется в конце её тика
+        Post(*session, TaskPriority::TICK, [self = shared_from_this(), session, session_delta, tick, remaining] {
+            try {
+                self->app_.TickSession(session->map_id, session_delta);
+            } catch (...) {
+                // Ошибка в одной сессии не должна останавливать тики остальных
+            }
+            if (remaining->fetch_sub(1) == 1) {
+                net::post(self->coordinator_, [self, tick] {
+                    self->CompleteTick(tick);
+                });
+            }
+        });
+    }
+}
+
+void SessionStrands::SchedulePublish(const Session& session) const {
+    session.tasks.Post(TaskPriority::MUTATION, [self = shared_from_this(), &session] {
+        auto lock = self->app_.LockSession();
+        session.publish_scheduled = false;
+        try {
+            self->app_.PublishSnapshot(session.map_id);
+        } catch (...) {
+            // Читатели получат предыдущий снимок до следующей публикации
+        }
+    });
+}
+
+void SessionStrands::CompleteTick(std::chrono::milliseconds delta) {
+    try {
+        app_.CompleteTick(delta);
+    } catch (...) {
+    }
+    tick_running_ = false;
+    if (governor_) {
+        const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - tick_start_);
+        set_period_(governor_->OnTick(duration, GetQueueDepth()));
+    }
+}
+
+}  // namespace http_handler
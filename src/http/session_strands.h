@@ -0,0 +1,136 @@
+#pragma once
+
+#include "../app/app.h"
+#include "../app/simulation.h"
+#include "../app/tick_governor.h"
+#include "../app/tick_schedule.h"
+#include "../metrics/metrics.h"
+
+#include "priority_strand.h"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+namespace http_handler {
+
+namespace net = boost::asio;
+
+// Strand для каждой игровой сессии. Запросы к разным картам и их тики выполняются
+// параллельно, а операции над всеми сессиями (обработчики тика, запрос /tick) -
+// в strand координатора под исключительной блокировкой приложения.
+// Задачи strand сессии выполняются по классам (PriorityStrand): тик, затем действия игроков, затем чтения.
+// Если задана симуляция в отдельном потоке, операции над сессиями передаются ей, а strand не используются.
+class SessionStrands : public std::enable_shared_from_this<SessionStrands> {
+public:
+    using Strand = net::strand<net::io_context::executor_type>;
+
+    struct Session {
+        Session(model::Map::Id map_id, Strand strand, const PriorityStrand::Metrics* metrics)
+            : map_id{std::move(map_id)}
+            , tasks{std::move(strand), metrics} {
+        }
+
+        model::Map::Id map_id;
+        mutable PriorityStrand tasks;
+        // Публикация снимка уже запланирована в strand сессии
+        mutable std::atomic<bool> publish_scheduled{false};
+    };
+
+    // registry - реестр для гистограмм времени ожидания задач в очередях сессий
+    SessionStrands(net::io_context& ioc, app::Application& app, Strand coordinator,
+                   std::shared_ptr<app::Simulation> simulation = nullptr, metrics::Registry* registry = nullptr);
+
+    const Strand& GetCoordinator() const noexcept {
+        return coordinator_;
+    }
+
+    // Ответы, подготовленные в потоке симуляции, отправляются из потоков ввода-вывода
+    bool IsSimulationThread() const noexcept {
+        return simulation_ && simulation_->IsRunningInThisThread();
+    }
+
+    // Список карт не меняется после загрузки, поэтому таблица strand не изменяется
+    // и методы поиска можно вызывать из любого потока
+
+    // nullptr, если карта не найдена
+    const Session* FindByMap(const model::Map::Id& map_id) const;
+
+    // nullptr, если игрок с таким токеном не найден
+    const Session* FindByToken(const app::Token& token) const;
+
+    // Выполняет fn в strand сессии под разделяемой блокировкой приложения в очереди класса priority.
+    // Если fn изменила сессию, публикует её снимок следующей задачей strand,
+    // так что серия действий игроков приводит к одной публикации.
+    // При симуляции в отдельном потоке fn выполняется в начале следующего тика, снимок публикует тик.
+    template <typename Fn>
+    void Post(const Session& session, TaskPriority priority, Fn&& fn) const {
+        if (simulation_) {
+            return simulation_->Push([fn = std::forward<Fn>(fn)]() mutable {
+                fn();
+            });
+        }
+        queue_depth_.fetch_add(1, std::memory_order_relaxed);
+        session.tasks.Post(priority, [self = shared_from_this(), &session, fn = std::forward<Fn>(fn)]() mutable {
+            self->queue_depth_.fetch_sub(1, std::memory_order_relaxed);
+            auto lock = self->app_.LockSession();
+            fn();
+            if (self->app_.IsSnapshotStale(session.map_id) && !session.publish_scheduled.exchange(true)) {
+                self->SchedulePublish(session);
+            }
+        });
+    }
+
+    // Задаёт расписание тиков сессий с собственным периодом. Без расписания каждый тик обновляет все сессии.
+    // Вызывается до запуска таймера.
+    void SetTickSchedule(app::TickSchedule schedule) {
+        schedule_ = std::move(schedule);
+    }
+
+    // Число задач, ожидающих выполнения в strand сессий. Можно вызывать из любого потока.
+    size_t GetQueueDepth() const noexcept {
+        return queue_depth_.load(std::memory_order_relaxed);
+    }
+
+    // Включает адаптивный период тиков: после каждого тика governor получает его длительность
+    // и глубину очередей, а новый период передаётся в set_period в strand координатора.
+    // Вызывается до запуска таймера.
+    void SetTickGovernor(std::shared_ptr<app::TickGovernor> governor,
+                         std::function<void(std::chrono::milliseconds)> set_period) {
+        governor_ = std::move(governor);
+        set_period_ = std::move(set_period);
+    }
+
+    // Запускает тик: каждая сессия, срок которой наступил, обновляется в своём strand, после чего
+    // в strand координатора вызываются обработчики тика. Если предыдущий тик ещё не завершился во всех сессиях,
+    // время накапливается до следующего вызова. Вызывается в strand координатора.
+    void Tick(std::chrono::milliseconds delta);
+
+private:
+    void SchedulePublish(const Session& session) const;
+
+    void CompleteTick(std::chrono::milliseconds delta);
+
+    app::Application& app_;
+    Strand coordinator_;
+    std::shared_ptr<app::Simulation> simulation_;
+    std::optional<PriorityStrand::Metrics> metrics_;
+    std::unordered_map<model::Map::Id, Session, util::TaggedHasher<model::Map::Id>> sessions_;
+    mutable std::atomic<size_t> queue_depth_{0};
+    // Поля ниже используются только в strand координатора
+    std::optional<app::TickSchedule> schedule_;
+    std::shared_ptr<app::TickGovernor> governor_;
+    std::function<void(std::chrono::milliseconds)> set_period_;
+    std::chrono::steady_clock::time_point tick_start_;
+    bool tick_running_ = false;
+    std::chrono::milliseconds delayed_delta_{0};
+};
+
+}  // namespace http_handler
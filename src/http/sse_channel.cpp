@@ -0,0 +1,274 @@
+#include "sse_channel.h"
+
+#include "request_handler.h"
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <sstream>
+
+namespace http_handler {
+
+namespace {
+
+struct SseConstants {
+    SseConstants() = delete;
+    static constexpr std::string_view LAST_EVENT_ID = "Last-Event-ID"sv;
+    static constexpr std::string_view EVENT_STREAM  = "text/event-stream"sv;
+    // Задержка переподключения EventSource в миллисекундах
+    static constexpr std::string_view RETRY         = "retry: 3000\n\n"sv;
+};
+
+std::optional<size_t> ParseEventId(std::string_view str) {
+    size_t value = 0;
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (str.empty() || ec != std::errc{} || ptr != str.data() + str.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+bool IsEmptyDelta(const app::UseCaseGetGameStateDelta::GameStateDelta& delta) {
+    return !delta.full && delta.players.empty() && delta.loot_objects.empty()
+        && delta.retired_players.empty() && delta.removed_loot_objects.empty();
+}
+
+}  // namespace
+
+// SseConnection
+SseConnection::SseConnection(beast::tcp_stream&& stream, std::shared_ptr<SseHub> hub)
+    : stream_{std::move(stream)}
+    , hub_{std::move(hub)} {
+}
+
+SseConnection::~SseConnection() {
+    hub_->OnDisconnect();
+}
+
+void SseConnection::Run(unsigned http_version) {
+    // Ответ не имеет длины и продолжается до закрытия соединения
+    http::response<http::empty_body> response{http::status::ok, http_version};
+    response.set(http::field::content_type, SseConstants::EVENT_STREAM);
+    response.set(http::field::cache_control, Constants::NO_CACHE);
+    response.keep_alive(false);
+    std::ostringstream header;
+    header << response.base() << SseConstants::RETRY;
+    stream_.expires_never();
+    Enqueue(std::make_shared<const std::string>(header.str()), false);
+}
+
+void SseConnection::Push(Buffer event) {
+    net::post(stream_.get_executor(), [self = shared_from_this(), event = std::move(event)]() mutable {
+        self->Enqueue(std::move(event), true);
+    });
+}
+
+void SseConnection::Close() {
+    net::post(stream_.get_executor(), [self = shared_from_this()] {
+        self->closed_ = true;
+        // Буфер отправляемого события нужен до завершения записи, которую отменяет закрытие сокета
+        const size_t in_flight = self->writing_ ? 1 : 0;
+        self->queue_.erase(self->queue_.begin() + in_flight, self->queue_.end());
+        beast::error_code ec;
+        self->stream_.socket().shutdown(net::ip::tcp::socket::shutdown_both, ec);
+        self->stream_.close();
+    });
+}
+
+void SseConnection::Enqueue(Buffer event, bool droppable) {
+    if (closed_) {
+        return;
+    }
+    if (droppable) {
+        const size_t in_flight = writing_ ? 1 : 0;
+        const size_t queued = std::count_if(queue_.begin() + in_flight, queue_.end(),
+            [](const auto& queued_event) { return queued_event.second; });
+        if (queued >= MAX_QUEUED_EVENTS) {
+            // Зритель не успевает принимать события: вместо накопленных изменений
+            // после следующего тика он получит полное состояние
+            queue_.erase(std::remove_if(queue_.begin() + in_flight, queue_.end(),
+                [](const auto& queued_event) { return queued_event.second; }), queue_.end());
+            needs_full_state_ = true;
+            return;
+        }
+    }
+    queue_.emplace_back(std::move(event), droppable);
+    if (!writing_) {
+        Write();
+    }
+}
+
+void SseConnection::Write() {
+    writing_ = true;
+    stream_.expires_after(WRITE_TIMEOUT);
+    net::async_write(stream_, net::buffer(*queue_.front().first),
+        beast::bind_front_handler(&SseConnection::OnWrite, shared_from_this()));
+}
+
+void SseConnection::OnWrite(beast::error_code ec, [[maybe_unused]] size_t bytes_written) {
+    writing_ = false;
+    if (ec) {
+        // Зритель отключился. Соединение будет удалено из рассылки на следующем тике.
+        closed_ = true;
+        queue_.clear();
+        return;
+    }
+    stream_.expires_never();
+    queue_.pop_front();
+    if (!queue_.empty()) {
+        Write();
+    }
+}
+
+// SseHub
+SseHub::SseHub(app::Application& app, std::shared_ptr<SessionStrands> strands, size_t max_subscribers,
+               std::chrono::milliseconds heartbeat_period)
+    : app_{app}
+    , strands_{std::move(strands)}
+    , max_subscribers_{max_subscribers}
+    , heartbeat_period_{heartbeat_period} {
+}
+
+bool SseHub::TryAccept(beast::tcp_stream& stream, http::request<http::string_body>& request) {
+    const auto [path, query] = SplitQuery(request.target());
+    if (path != PATH) {
+        return false;
+    }
+    const RequestData req_data(request);
+    if (req_data.method != http::verb::get) {
+        auto response = ErrorBuilder::MakeErrorResponse(ErrorCode::InvalidMethod, req_data, Methods::GET);
+        response.set(http::field::allow, Methods::GET);
+        SendAndClose(std::move(stream), std::move(response));
+        return true;
+    }
+    const auto map_param = FindQueryParameter(query, Constants::MAP_ID);
+    const auto map_id = map_param ? DecodeURI(*map_param) : std::nullopt;
+    if (!map_id.has_value()) {
+        SendAndClose(std::move(stream), ErrorBuilder::MakeErrorResponse(ErrorCode::BadRequest, req_data));
+        return true;
+    }
+    const auto* strand = strands_->FindByMap(model::Map::Id{*map_id});
+    if (!strand) {
+        SendAndClose(std::move(stream), ErrorBuilder::MakeErrorResponse(ErrorCode::MapNotFound, req_data));
+        return true;
+    }
+    if (subscribers_count_.fetch_add(1) >= max_subscribers_) {
+        --subscribers_count_;
+        auto response = ErrorBuilder::MakeErrorResponse(ErrorCode::SpectatorsLimit, req_data);
+        const auto retry_after = std::chrono::ceil<std::chrono::seconds>(heartbeat_period_);
+        response.set(http::field::retry_after, std::to_string(retry_after.count()));
+        SendAndClose(std::move(stream), std::move(response));
+        return true;
+    }
+    const auto last_event_id = ParseEventId(request[SseConstants::LAST_EVENT_ID]);
+    auto connection = std::make_shared<SseConnection>(std::move(stream), shared_from_this());
+    connection->Run(req_data.http_version);
+    strands_->Post(*strand, TaskPriority::READ, [self = shared_from_this(), connection = std::move(connection),
+                                                 map_id = model::Map::Id{*map_id}, last_event_id]() mutable {
+        self->Subscribe(std::move(connection), std::move(map_id), last_event_id);
+    });
+    return true;
+}
+
+void SseHub::Subscribe(std::shared_ptr<SseConnection> connection, model::Map::Id map_id,
+                       std::optional<size_t> last_event_id) {
+    size_t last_seq = 0;
+    {
+        std::lock_guard lock{mutex_};
+        if (draining_) {
+            return connection->Close();
+        }
+        auto [it, inserted] = maps_.try_emplace(map_id);
+        auto& subscribers = it->second;
+        if (inserted) {
+            const auto state_version = app_.GetStateVersion(map_id);
+            subscribers.last_seq = state_version ? state_version->tick_seq : 0;
+            subscribers.last_event = Clock::now();
+        }
+        subscribers.connections.push_back(connection);
+        last_seq = subscribers.last_seq;
+    }
+    // Переподключившийся зритель догоняет изменениями с последнего полученного события,
+    // если история сессии их ещё хранит. Иначе придёт полное состояние.
+    if (last_event_id.has_value() && *last_event_id <= last_seq) {
+        auto delta = app_.GetGameStateDelta(map_id, *last_event_id);
+        connection->TakeFullStateRequest();
+        connection->Push(MakeEvent(*delta));
+    } else if (connection->TakeFullStateRequest()) {
+        connection->Push(MakeFullStateEvent(map_id, last_seq));
+    }
+}
+
+void SseHub::Drain() {
+    draining_ = true;
+    std::lock_guard lock{mutex_};
+    for (const auto& [map_id, subscribers] : maps_) {
+        for (const auto& connection : subscribers.connections) {
+            connection->Close();
+        }
+    }
+    maps_.clear();
+}
+
+SseConnection::Buffer SseHub::MakeFullStateEvent(const model::Map::Id& map_id, size_t seq) const {
+    auto state = app_.GetGameState(map_id);
+    app::UseCaseGetGameStateDelta::GameStateDelta delta;
+    delta.seq = seq;
+    delta.full = true;
+    delta.players = std::move(state->players);
+    delta.loot_objects = std::move(state->loot_objects);
+    return MakeEvent(delta);
+}
+
+SseConnection::Buffer SseHub::MakeEvent(const app::UseCaseGetGameStateDelta::GameStateDelta& delta) {
+    // Сериализованное состояние не содержит переводов строк и помещается в одно поле data
+    const std::string data = ApiHandler::SerializeGameStateDelta(delta);
+    std::string event;
+    event.reserve(data.size() + 32);
+    event.append("id: "sv).append(std::to_string(delta.seq)).append("\ndata: "sv).append(data).append("\n\n"sv);
+    return std::make_shared<const std::string>(std::move(event));
+}
+
+void SseHub::OnTick() {
+    std::lock_guard lock{mutex_};
+    const auto now = Clock::now();
+    for (auto map_it = maps_.begin(); map_it != maps_.end();) {
+        auto& subscribers = map_it->second;
+        std::erase_if(subscribers.connections, [](const std::shared_ptr<SseConnection>& connection) {
+            return connection->IsClosed();
+        });
+        if (subscribers.connections.empty()) {
+            map_it = maps_.erase(map_it);
+            continue;
+        }
+        const auto& map_id = map_it->first;
+        auto delta = app_.GetGameStateDelta(map_id, subscribers.last_seq);
+        // Пока сессия на карте не создана, каждый тик возвращает одно и то же пустое полное состояние,
+        // которое зрители уже получили при подключении
+        if (delta->full && delta->seq == subscribers.last_seq) {
+            delta->full = false;
+        }
+        subscribers.last_seq = delta->seq;
+        SseConnection::Buffer delta_event;
+        if (!IsEmptyDelta(*delta) || now - subscribers.last_event >= heartbeat_period_) {
+            delta_event = MakeEvent(*delta);
+            subscribers.last_event = now;
+        }
+        // Полное состояние строится только если оно кому-то нужно
+        SseConnection::Buffer full_event = delta->full ? delta_event : nullptr;
+        for (const auto& connection : subscribers.connections) {
+            if (connection->TakeFullStateRequest()) {
+                if (!full_event) {
+                    full_event = MakeFullStateEvent(map_id, delta->seq);
+                }
+                connection->Push(full_event);
+            } else if (delta_event) {
+                connection->Push(delta_event);
+            }
+        }
+        ++map_it;
+    }
+}
+
+}  // namespace http_handler
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "../app/app.h"
+
+#include "session_strands.h"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace http_handler {
+
+namespace beast = boost::beast;
+namespace net = boost::asio;
+namespace http = beast::http;
+using namespace std::literals;
+
+class SseHub;
+
+/*
+ *  Поток событий для зрителей (Server-Sent Events): GET /api/v1/game/spectate?mapId=<id>
+ *
+ *  Токен игрока не нужен. Первым событием приходит полное состояние сессии на карте,
+ *  далее после каждого тика - изменения в формате ответа /api/v1/game/state?since=... .
+ *  Идентификатор события - номер тика, поэтому EventSource при переподключении
+ *  передаёт его в Last-Event-ID и получает изменения с этого тика.
+ */
+class SseConnection : public std::enable_shared_from_this<SseConnection> {
+public:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    // Наибольшее число событий в очереди на отправку. Если зритель не успевает
+    // их принимать, очередь сбрасывается, а после следующего тика отправляется полное состояние.
+    static constexpr size_t MAX_QUEUED_EVENTS = 8;
+    // Соединение закрывается, если событие не удаётся отправить за это время
+    static constexpr std::chrono::seconds WRITE_TIMEOUT{30};
+
+    SseConnection(beast::tcp_stream&& stream, std::shared_ptr<SseHub> hub);
+
+    ~SseConnection();
+
+    // Отправляет заголовок ответа. Вызывается в потоке соединения.
+    void Run(unsigned http_version);
+
+    // Методы ниже можно вызывать из любого потока
+
+    void Push(Buffer event);
+
+    // Закрывает соединение, не отправляя события из очереди
+    void Close();
+
+    // Сбрасывает и возвращает признак того, что зрителю нужно полное состояние
+    bool TakeFullStateRequest() noexcept {
+        return needs_full_state_.exchange(false);
+    }
+
+    bool IsClosed() const noexcept {
+        return closed_;
+    }
+
+private:
+    void Enqueue(Buffer event, bool droppable);
+
+    void Write();
+
+    void OnWrite(beast::error_code ec, size_t bytes_written);
+
+    beast::tcp_stream stream_;
+    std::shared_ptr<SseHub> hub_;
+    std::deque<std::pair<Buffer, bool>> queue_;
+    bool writing_ = false;
+    std::atomic<bool> closed_{false};
+    std::atomic<bool> needs_full_state_{true};
+};
+
+// Рассылка состояния сессий зрителям. Один буфер события на карту за тик
+// разделяется всеми зрителями этой карты. Подписка выполняется в strand сессии, рассылка - в обработчике тика.
+class SseHub : public std::enable_shared_from_this<SseHub> {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::string_view PATH = "/api/v1/game/spectate"sv;
+    // Если изменений нет, пустое событие отправляется не чаще, чем раз в этот период,
+    // чтобы обнаруживать отключившихся зрителей. Период по умолчанию.
+    static constexpr std::chrono::seconds HEARTBEAT_PERIOD{15};
+
+    SseHub(app::Application& app, std::shared_ptr<SessionStrands> strands, size_t max_subscribers,
+           std::chrono::milliseconds heartbeat_period = HEARTBEAT_PERIOD);
+
+    // Забирает соединение, если запрос адресован потоку событий. Вызывается в потоке соединения.
+    bool TryAccept(beast::tcp_stream& stream, http::request<http::string_body>& request);
+
+    // Строит по одному событию на карту и рассылает его зрителям
+    void OnTick();
+
+    // При передаче работы новому процессу: закрывает потоки событий, и EventSource
+    // переподключается к новому процессу с Last-Event-ID
+    void Drain();
+
+    // Снова принимать зрителей, если передача работы не состоялась
+    void Resume() noexcept {
+        draining_ = false;
+    }
+
+    size_t GetSubscribersCount() const noexcept {
+        return subscribers_count_;
+    }
+
+private:
+    friend SseConnection;
+
+    struct MapSubscribers {
+        size_t last_seq = 0;
+        Clock::time_point last_event;
+        std::vector<std::shared_ptr<SseConnection>> connections;
+    };
+    using Maps = std::unordered_map<model::Map::Id, MapSubscribers, util::TaggedHasher<model::Map::Id>>;
+
+    void Subscribe(std::shared_ptr<SseConnection> connection, model::Map::Id map_id,
+                   std::optional<size_t> last_event_id);
+
+    SseConnection::Buffer MakeFullStateEvent(const model::Map::Id& map_id, size_t seq) const;
+
+    static SseConnection::Buffer MakeEvent(const app::UseCaseGetGameStateDelta::GameStateDelta& delta);
+
+    void OnDisconnect() noexcept {
+        --subscribers_count_;
+    }
+
+    app::Application& app_;
+    std::shared_ptr<SessionStrands> strands_;
+    const size_t max_subscribers_;
+    const std::chrono::milliseconds heartbeat_period_;
+    std::atomic<size_t> subscribers_count_{0};
+    std::atomic<bool> draining_{false};
+    // Зрители разных карт подписываются параллельно
+    std::mutex mutex_;
+    Maps maps_;
+};
+
+class SseHubNotifier : public app::ApplicationListener {
+public:
+    explicit SseHubNotifier(std::shared_ptr<SseHub> hub)
+        : hub_{std::move(hub)} {
+    }
+
+    void OnTick(std::chrono::milliseconds) override {
+        hub_->OnTick();
+    }
+
+private:
+    std::shared_ptr<SseHub> hub_;
+};
+
+}  // namespace http_handler
@@ -0,0 +1,26 @@
+#include "state_cache.h"
+
+namespace http_handler {
+
+StateCache::Buffer StateCache::Find(const model::Map::Id& map_id, size_t version, ResponseEncoding encoding) const {
+    std::lock_guard lock{mutex_};
+    if (auto it = entries_.find(map_id); it != entries_.end() && it->second.version == version) {
+        return it->second.bodies[static_cast<size_t>(encoding)];
+    }
+    return nullptr;
+}
+
+StateCache::Buffer StateCache::Store(const model::Map::Id& map_id, size_t version, ResponseEncoding encoding, std::string body) {
+    auto buffer = std::make_shared<const std::string>(std::move(body));
+    std::lock_guard lock{mutex_};
+    auto [it, inserted] = entries_.try_emplace(map_id, Entry{version, {}});
+    if (it->second.version < version) {
+        it->second = Entry{version, {}};
+    }
+    if (it->second.version == version) {
+        it->second.bodies[static_cast<size_t>(encoding)] = buffer;
+    }
+    return buffer;
+}
+
+}  // namespace http_handler
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../model/model.h"
+
+#include "response_encoding.h"
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace http_handler {
+
+// Кэш сериализованного состояния игровых сессий.
+// Все игроки одной сессии получают одинаковое тело ответа, поэтому оно строится
+// один раз для каждой версии состояния сессии и формата ответа и разделяется между запросами.
+// На карте не больше одной сессии, а номер сессии после восстановления может повторяться,
+// поэтому записи различаются картой.
+class StateCache {
+public:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    // Возвращает тело ответа, если оно было построено для указанной версии сессии на карте
+    Buffer Find(const model::Map::Id& map_id, size_t version, ResponseEncoding encoding) const;
+
+    // Сохраняет тело ответа для указанной версии сессии на карте, вытесняя устаревшее
+    Buffer Store(const model::Map::Id& map_id, size_t version, ResponseEncoding encoding, std::string body);
+
+private:
+    struct Entry {
+        size_t version;
+        std::array<Buffer, RESPONSE_ENCODINGS_COUNT> bodies;
+    };
+    using MapIdToEntry = std::unordered_map<model::Map::Id, Entry, util::TaggedHasher<model::Map::Id>>;
+
+    mutable std::mutex mutex_;
+    MapIdToEntry entries_;
+};
+
+}  // namespace http_handler
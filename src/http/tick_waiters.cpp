@@ -0,0 +1,36 @@
+#include "tick_waiters.h"
+
+#include <utility>
+
+namespace http_handler {
+
+TickWaiters::Id TickWaiters::Add(Callback callback) {
+    std::lock_guard lock{mutex_};
+    const Id id = next_id_++;
+    callbacks_.emplace(id, std::move(callback));
+    return id;
+}
+
+bool TickWaiters::Remove(Id id) {
+    std::lock_guard lock{mutex_};
+    return callbacks_.erase(id) != 0;
+}
+
+void TickWaiters::Notify() {
+    std::unordered_map<Id, Callback> callbacks;
+    {
+        std::lock_guard lock{mutex_};
+        callbacks.swap(callbacks_);
+    }
+    // Обработчики вызываются без блокировки: они могут снова встать в ожидание
+    for (auto& [id, callback] : callbacks) {
+        callback();
+    }
+}
+
+size_t TickWaiters::Size() const {
+    std::lock_guard lock{mutex_};
+    return callbacks_.size();
+}
+
+}  // namespace http_handler
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../app/app.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace http_handler {
+
+// Запросы, ожидающие завершения следующего тика (long poll).
+// Ожидающий запрос хранит только обработчик продолжения и не занимает strand.
+class TickWaiters {
+public:
+    using Id = size_t;
+    using Callback = std::function<void()>;
+
+    // Регистрирует обработчик, который будет вызван после следующего тика
+    Id Add(Callback callback);
+
+    // Снимает ожидание. Возвращает false, если обработчик уже был вызван
+    bool Remove(Id id);
+
+    // Вызывает и снимает все зарегистрированные обработчики
+    void Notify();
+
+    size_t Size() const;
+
+private:
+    mutable std::mutex mutex_;
+    Id next_id_ = 0;
+    std::unordered_map<Id, Callback> callbacks_;
+};
+
+// Пробуждает ожидающие запросы по окончании тика приложения
+class TickWaitersNotifier : public app::ApplicationListener {
+public:
+    explicit TickWaitersNotifier(std::shared_ptr<TickWaiters> waiters)
+        : waiters_{std::move(waiters)} {
+    }
+
+    void OnTick(std::chrono::milliseconds) override {
+        waiters_->Notify();
+    }
+
+private:
+    std::shared_ptr<TickWaiters> waiters_;
+};
+
+}  // namespace http_handler
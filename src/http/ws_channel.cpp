@@ -0,0 +1,353 @@
+#include "ws_channel.h"
+
+#include "request_handler.h"
+
+#include <boost/asio/post.hpp>
+#include <boost/json/parse.hpp>
+
+#include <algorithm>
+#include <cctype>
+
+namespace http_handler {
+
+namespace {
+
+struct WsErrors {
+    WsErrors() = delete;
+    static constexpr std::string_view INVALID_ARGUMENT  = "invalidArgument"sv;
+    static constexpr std::string_view INVALID_TOKEN     = "invalidToken"sv;
+    static constexpr std::string_view UNKNOWN_TOKEN     = "unknownToken"sv;
+    static constexpr std::string_view ACTION_PARSE      = "Failed to parse action"sv;
+    static constexpr std::string_view AUTH_REQUIRED     = "Authorization token is required"sv;
+    static constexpr std::string_view PLAYER_TOKEN      = "Player token has not been found"sv;
+};
+
+bool IsValidToken(std::string_view token) {
+    return token.size() == 32 && std::all_of(token.begin(), token.end(), [](unsigned char ch) {
+        return std::isxdigit(ch);
+    });
+}
+
+std::optional<std::optional<model::Dog::Direction>> ParseMove(std::string_view move) {
+    if (move.empty()) {
+        return std::optional<model::Dog::Direction>{};
+    }
+    if (move == "U"sv) {
+        return model::Dog::Direction::NORTH;
+    }
+    if (move == "D"sv) {
+        return model::Dog::Direction::SOUTH;
+    }
+    if (move == "L"sv) {
+        return model::Dog::Direction::WEST;
+    }
+    if (move == "R"sv) {
+        return model::Dog::Direction::EAST;
+    }
+    return std::nullopt;
+}
+
+}  // namespace
+
+// WsConnection
+WsConnection::WsConnection(beast::tcp_stream&& stream, std::shared_ptr<WsHub> hub)
+    : ws_{std::move(stream)}
+    , hub_{std::move(hub)} {
+}
+
+void WsConnection::Run(http::request<http::string_body>&& upgrade_request) {
+    upgrade_request_ = std::move(upgrade_request);
+    // Таймаут HTTP-сессии больше не действует, за соединением следит websocket::stream
+    beast::get_lowest_layer(ws_).expires_never();
+    ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+    ws_.async_accept(upgrade_request_, beast::bind_front_handler(&WsConnection::OnAccept, shared_from_this()));
+}
+
+void WsConnection::Push(Buffer frame) {
+    net::post(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+        self->Enqueue(Frame{std::move(frame), true, false});
+    });
+}
+
+void WsConnection::SendError(std::string_view code, std::string_view message, bool close /* = false */) {
+    std::string body;
+    json_writer::JsonWriter writer{body};
+    writer.StartObject().Key("code"sv).Value(code).Key("message"sv).Value(message).EndObject();
+    net::post(ws_.get_executor(), [self = shared_from_this(), body = std::move(body), close]() mutable {
+        self->Enqueue(Frame{std::make_shared<const std::string>(std::move(body)), false, close});
+    });
+}
+
+void WsConnection::Drain() {
+    net::post(ws_.get_executor(), [self = shared_from_this()] {
+        if (self->closing_) {
+            return;
+        }
+        self->close_code_ = websocket::close_code::going_away;
+        // Отправляемый кадр дописывается, остальные не нужны: после переподключения придёт полное состояние
+        const size_t in_flight = self->writing_ ? 1 : 0;
+        self->queue_.erase(self->queue_.begin() + in_flight, self->queue_.end());
+        if (self->writing_) {
+            self->queue_.front().close = true;
+        } else {
+            self->Close();
+        }
+    });
+}
+
+void WsConnection::OnAccept(beast::error_code ec) {
+    if (ec) {
+        return server_logging::LogError(ec, server_logging::LogMsg::ACCEPT);
+    }
+    RequestData data(upgrade_request_);
+    upgrade_request_ = {};
+    if (data.auth_token.has_value()) {
+        token_ = std::move(data.auth_token);
+        auth_requested_ = true;
+        hub_->Authenticate(shared_from_this(), *token_);
+    }
+    Read();
+}
+
+void WsConnection::Read() {
+    ws_.async_read(buffer_, beast::bind_front_handler(&WsConnection::OnRead, shared_from_this()));
+}
+
+void WsConnection::OnRead(beast::error_code ec, [[maybe_unused]] size_t bytes_read) {
+    if (ec == websocket::error::closed) {
+        return;
+    }
+    if (ec) {
+        return server_logging::LogError(ec, server_logging::LogMsg::READ);
+    }
+    const auto data = buffer_.cdata();
+    HandleMessage(std::string_view(static_cast<const char*>(data.data()), data.size()));
+    buffer_.consume(buffer_.size());
+    Read();
+}
+
+void WsConnection::HandleMessage(std::string_view message) {
+    std::error_code ec;
+    auto content = boost::json::parse(message, ec);
+    if (ec || !content.is_object()) {
+        return SendError(WsErrors::INVALID_ARGUMENT, WsErrors::ACTION_PARSE);
+    }
+    const auto& object = content.as_object();
+    if (!auth_requested_) {
+        const auto* token = object.if_contains(Constants::AUTH_TOKEN);
+        if (!token || !token->is_string() || !IsValidToken(token->as_string())) {
+            return SendError(WsErrors::INVALID_TOKEN, WsErrors::AUTH_REQUIRED, true);
+        }
+        token_.emplace(std::string{token->as_string()});
+        auth_requested_ = true;
+        return hub_->Authenticate(shared_from_this(), *token_);
+    }
+    const auto* move = object.if_contains(Constants::MOVE);
+    if (!move || !move->is_string()) {
+        return SendError(WsErrors::INVALID_ARGUMENT, WsErrors::ACTION_PARSE);
+    }
+    auto dir = ParseMove(move->as_string());
+    if (!dir.has_value()) {
+        return SendError(WsErrors::INVALID_ARGUMENT, WsErrors::ACTION_PARSE);
+    }
+    hub_->Act(shared_from_this(), *dir);
+}
+
+void WsConnection::Enqueue(Frame frame) {
+    if (closing_) {
+        return;
+    }
+    if (frame.droppable) {
+        const size_t in_flight = writing_ ? 1 : 0;
+        const size_t queued = std::count_if(queue_.begin() + in_flight, queue_.end(),
+            [](const Frame& queued_frame) { return queued_frame.droppable; });
+        if (queued >= MAX_QUEUED_FRAMES) {
+            // Клиент не успевает принимать кадры: изменения из очереди теряют смысл
+            // по отдельности, поэтому они отбрасываются, а после тика придёт полное состояние
+            queue_.erase(std::remove_if(queue_.begin() + in_flight, queue_.end(),
+                [](const Frame& queued_frame) { return queued_frame.droppable; }), queue_.end());
+            needs_full_state_ = true;
+            return;
+        }
+    }
+    queue_.push_back(std::move(frame));
+    if (!writing_) {
+        Write();
+    }
+}
+
+void WsConnection::Write() {
+    writing_ = true;
+    ws_.text(true);
+    ws_.async_write(net::buffer(*queue_.front().data),
+        beast::bind_front_handler(&WsConnection::OnWrite, shared_from_this()));
+}
+
+void WsConnection::OnWrite(beast::error_code ec, [[maybe_unused]] size_t bytes_written) {
+    writing_ = false;
+    if (ec) {
+        closing_ = true;
+        queue_.clear();
+        return server_logging::LogError(ec, server_logging::LogMsg::WRITE);
+    }
+    const bool close = queue_.front().close;
+    queue_.pop_front();
+    if (close) {
+        return Close();
+    }
+    if (!queue_.empty()) {
+        Write();
+    }
+}
+
+void WsConnection::Close() {
+    closing_ = true;
+    queue_.clear();
+    ws_.async_close(close_code_, [self = shared_from_this()](beast::error_code) {});
+}
+
+// WsHub
+WsHub::WsHub(app::Application& app, std::shared_ptr<SessionStrands> strands)
+    : app_{app}
+    , strands_{std::move(strands)} {
+}
+
+void WsHub::Accept(beast::tcp_stream&& stream, http::request<http::string_body>&& upgrade_request) {
+    if (SplitQuery(upgrade_request.target()).first != PATH) {
+        return SendAndClose(std::move(stream),
+            ErrorBuilder::MakeErrorResponse(ErrorCode::BadRequest, RequestData(upgrade_request)));
+    }
+    std::make_shared<WsConnection>(std::move(stream), shared_from_this())->Run(std::move(upgrade_request));
+}
+
+void WsHub::Authenticate(std::shared_ptr<WsConnection> connection, app::Token token) {
+    const auto* strand = strands_->FindByToken(token);
+    if (!strand) {
+        return connection->SendError(WsErrors::UNKNOWN_TOKEN, WsErrors::PLAYER_TOKEN, true);
+    }
+    strands_->Post(*strand, TaskPriority::READ, [self = shared_from_this(), connection = std::move(connection), token = std::move(token)]() {
+        if (!self->app_.GetStateVersion(token)) {
+            return connection->SendError(WsErrors::UNKNOWN_TOKEN, WsErrors::PLAYER_TOKEN, true);
+        }
+        self->Subscribe(connection);
+    });
+}
+
+void WsHub::Act(std::shared_ptr<WsConnection> connection, std::optional<model::Dog::Direction> dir) {
+    const auto* strand = strands_->FindByToken(connection->GetToken());
+    if (!strand) {
+        return connection->SendError(WsErrors::UNKNOWN_TOKEN, WsErrors::PLAYER_TOKEN, true);
+    }
+    // Счётчик увеличивается до проверки признака, поэтому передача работы либо дождётся действия,
+    // либо действие будет отклонено
+    ++pending_actions_;
+    if (draining_) {
+        --pending_actions_;
+        return connection->Drain();
+    }
+    strands_->Post(*strand, TaskPriority::MUTATION, [self = shared_from_this(), connection = std::move(connection), dir]() {
+        const auto& token = connection->GetToken();
+        const bool done = dir.has_value() ? self->app_.MovePlayer(token, *dir) : self->app_.StopPlayer(token);
+        --self->pending_actions_;
+        if (!done) {
+            connection->SendError(WsErrors::UNKNOWN_TOKEN, WsErrors::PLAYER_TOKEN, true);
+        }
+    });
+}
+
+void WsHub::Drain() {
+    draining_ = true;
+    std::lock_guard lock{mutex_};
+    for (const auto& [map_id, subscribers] : sessions_) {
+        for (const auto& weak_connection : subscribers.connections) {
+            if (auto connection = weak_connection.lock()) {
+                connection->Drain();
+            }
+        }
+    }
+    sessions_.clear();
+}
+
+void WsHub::Subscribe(const std::shared_ptr<WsConnection>& connection) {
+    const auto map_id = app_.FindPlayerMap(connection->GetToken());
+    const auto state_version = app_.GetStateVersion(*map_id);
+    size_t last_seq = 0;
+    {
+        std::lock_guard lock{mutex_};
+        if (draining_) {
+            return connection->Drain();
+        }
+        auto [it, inserted] = sessions_.try_emplace(*map_id);
+        if (inserted) {
+            it->second.last_seq = state_version->tick_seq;
+        }
+        it->second.connections.push_back(connection);
+        last_seq = it->second.last_seq;
+    }
+    // Полное состояние на момент последней рассылки, чтобы следующий кадр изменений продолжил его.
+    // Рассылка выполняется под исключительной блокировкой и не может начаться, пока идёт подписка.
+    if (connection->TakeFullStateRequest()) {
+        connection->Push(MakeFullStateFrame(connection->GetToken(), last_seq));
+    }
+}
+
+WsConnection::Buffer WsHub::MakeFullStateFrame(const app::Token& token, size_t seq) const {
+    auto state = app_.GetGameState(token);
+    app::UseCaseGetGameStateDelta::GameStateDelta delta;
+    delta.seq = seq;
+    delta.full = true;
+    delta.players = std::move(state->players);
+    delta.loot_objects = std::move(state->loot_objects);
+    return std::make_shared<const std::string>(ApiHandler::SerializeGameStateDelta(delta));
+}
+
+void WsHub::OnTick() {
+    std::lock_guard lock{mutex_};
+    for (auto session_it = sessions_.begin(); session_it != sessions_.end();) {
+        auto& subscribers = session_it->second;
+        std::vector<std::shared_ptr<WsConnection>> connections;
+        connections.reserve(subscribers.connections.size());
+        std::erase_if(subscribers.connections, [&](const std::weak_ptr<WsConnection>& weak_connection) {
+            auto connection = weak_connection.lock();
+            if (!connection) {
+                return true;
+            }
+            // Собака ушла на покой: токен больше не действует
+            if (!app_.GetStateVersion(connection->GetToken())) {
+                connection->SendError(WsErrors::UNKNOWN_TOKEN, WsErrors::PLAYER_TOKEN, true);
+                return true;
+            }
+            connections.push_back(std::move(connection));
+            return false;
+        });
+        if (connections.empty()) {
+            session_it = sessions_.erase(session_it);
+            continue;
+        }
+        const auto& token = connections.front()->GetToken();
+        auto delta = app_.GetGameStateDelta(token, subscribers.last_seq);
+        // Сессия с собственным периодом тиков могла не обновляться в этот тик
+        if (!delta->full && delta->seq == subscribers.last_seq) {
+            ++session_it;
+            continue;
+        }
+        subscribers.last_seq = delta->seq;
+        // Один буфер изменений на сессию разделяется всеми подписчиками,
+        // полное состояние строится только если оно кому-то нужно
+        auto delta_frame = std::make_shared<const std::string>(ApiHandler::SerializeGameStateDelta(*delta));
+        WsConnection::Buffer full_frame = delta->full ? delta_frame : nullptr;
+        for (const auto& connection : connections) {
+            if (connection->TakeFullStateRequest()) {
+                if (!full_frame) {
+                    full_frame = MakeFullStateFrame(token, delta->seq);
+                }
+                connection->Push(full_frame);
+            } else {
+                connection->Push(delta_frame);
+            }
+        }
+        ++session_it;
+    }
+}
+
+}  // namespace http_handler
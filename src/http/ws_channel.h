@@ -0,0 +1,182 @@
+#pragma once
+
+#include "../app/app.h"
+
+#include "session_strands.h"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace http_handler {
+
+namespace beast = boost::beast;
+namespace net = boost::asio;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+using namespace std::literals;
+
+class WsHub;
+
+/*
+ *  Канал WebSocket игрока: /api/v1/game/ws
+ *
+ *  Токен передаётся один раз: в заголовке Authorization запроса на upgrade
+ *  или первым кадром {"authToken": "..."}. Далее клиент отправляет действия
+ *  кадрами {"move": "L"}, а сервер после каждого тика присылает изменения
+ *  состояния сессии в формате ответа /api/v1/game/state?since=... .
+ *  Первым после подключения и после пропуска кадров присылается полное состояние (full = true).
+ */
+class WsConnection : public std::enable_shared_from_this<WsConnection> {
+public:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    // Наибольшее число кадров состояния в очереди на отправку. Если клиент не успевает
+    // их принимать, очередь сбрасывается, а после следующего тика отправляется полное состояние.
+    static constexpr size_t MAX_QUEUED_FRAMES = 8;
+
+    WsConnection(beast::tcp_stream&& stream, std::shared_ptr<WsHub> hub);
+
+    void Run(http::request<http::string_body>&& upgrade_request);
+
+    // Методы ниже можно вызывать из любого потока
+
+    // Кадр состояния, который можно отбросить при переполнении очереди
+    void Push(Buffer frame);
+
+    void SendError(std::string_view code, std::string_view message, bool close = false);
+
+    // Закрывает соединение с кодом going_away, не отправляя кадры из очереди
+    void Drain();
+
+    // Сбрасывает и возвращает признак того, что клиенту нужно полное состояние
+    bool TakeFullStateRequest() noexcept {
+        return needs_full_state_.exchange(false);
+    }
+
+    // Токен устанавливается до подписки на сессию и дальше не меняется
+    const app::Token& GetToken() const noexcept {
+        return *token_;
+    }
+
+private:
+    struct Frame {
+        Buffer data;
+        bool droppable;
+        bool close;
+    };
+
+    void OnAccept(beast::error_code ec);
+
+    void Read();
+
+    void OnRead(beast::error_code ec, size_t bytes_read);
+
+    void HandleMessage(std::string_view message);
+
+    void Enqueue(Frame frame);
+
+    void Write();
+
+    void OnWrite(beast::error_code ec, size_t bytes_written);
+
+    void Close();
+
+    websocket::stream<beast::tcp_stream> ws_;
+    std::shared_ptr<WsHub> hub_;
+    http::request<http::string_body> upgrade_request_;
+    beast::flat_buffer buffer_;
+    std::optional<app::Token> token_;
+    bool auth_requested_ = false;
+    std::deque<Frame> queue_;
+    bool writing_ = false;
+    bool closing_ = false;
+    websocket::close_code close_code_ = websocket::close_code::policy_error;
+    std::atomic<bool> needs_full_state_{true};
+};
+
+// Рассылка состояния игровых сессий подключённым по WebSocket игрокам.
+// Действия игроков выполняются в strand их сессий, рассылка - в обработчике тика.
+class WsHub : public std::enable_shared_from_this<WsHub> {
+public:
+    static constexpr std::string_view PATH = "/api/v1/game/ws"sv;
+
+    WsHub(app::Application& app, std::shared_ptr<SessionStrands> strands);
+
+    // Принимает соединение после запроса на upgrade. Вызывается в потоке соединения.
+    void Accept(beast::tcp_stream&& stream, http::request<http::string_body>&& upgrade_request);
+
+    void Authenticate(std::shared_ptr<WsConnection> connection, app::Token token);
+
+    // nullopt - остановить собаку
+    void Act(std::shared_ptr<WsConnection> connection, std::optional<model::Dog::Direction> dir);
+
+    // Строит по одному кадру на сессию и рассылает его подписчикам
+    void OnTick();
+
+    // При передаче работы новому процессу: закрывает соединения и перестаёт принимать действия.
+    // Клиенты переподключаются к новому процессу.
+    void Drain();
+
+    // Снова принимать соединения и действия, если передача работы не состоялась
+    void Resume() noexcept {
+        draining_ = false;
+    }
+
+    bool IsDraining() const noexcept {
+        return draining_;
+    }
+
+    // Число действий, переданных в strand сессий и ещё не выполненных
+    size_t GetPendingActions() const noexcept {
+        return pending_actions_;
+    }
+
+private:
+    struct SessionSubscribers {
+        size_t last_seq = 0;
+        std::vector<std::weak_ptr<WsConnection>> connections;
+    };
+    // Сессии различаются картой: номер сессии восстанавливается из файла состояния и может повторяться
+    using Sessions = std::unordered_map<model::Map::Id, SessionSubscribers, util::TaggedHasher<model::Map::Id>>;
+
+    // Выполняется в strand сессии игрока
+    void Subscribe(const std::shared_ptr<WsConnection>& connection);
+
+    WsConnection::Buffer MakeFullStateFrame(const app::Token& token, size_t seq) const;
+
+    app::Application& app_;
+    std::shared_ptr<SessionStrands> strands_;
+    std::atomic<bool> draining_{false};
+    std::atomic<size_t> pending_actions_{0};
+    // Подписываются игроки разных сессий параллельно
+    std::mutex mutex_;
+    Sessions sessions_;
+};
+
+class WsHubNotifier : public app::ApplicationListener {
+public:
+    explicit WsHubNotifier(std::shared_ptr<WsHub> hub)
+        : hub_{std::move(hub)} {
+    }
+
+    void OnTick(std::chrono::milliseconds) override {
+        hub_->OnTick();
+    }
+
+private:
+    std::shared_ptr<WsHub> hub_;
+};
+
+}  // namespace http_handler
@@ -55,6 +55,22 @@ static void AddBuilding(const json::value& json_building, model::Map& map) {
                                                        .size = size } });
 }
 
+// Период тиков карты задаётся в секундах (tickPeriod) или числом базовых периодов (tickDivisor)
+static void SetTickRate(const json::value& json_map, model::Map& map) {
+    const bool has_period = json_map.as_object().contains(MapFields::tickPeriod);
+    const bool has_divisor = json_map.as_object().contains(MapFields::tickDivisor);
+    if (has_period && has_divisor) {
+        throw std::invalid_argument("Map ["s + *map.GetId() + "]. Both tickPeriod and tickDivisor are set"s);
+    }
+    if (has_period) {
+        const auto period = std::chrono::duration<double>(json_map.at(MapFields::tickPeriod).to_number<double>());
+        map.SetTickPeriod(std::chrono::duration_cast<std::chrono::milliseconds>(period));
+    }
+    if (has_divisor) {
+        map.SetTickDivisor(json_map.at(MapFields::tickDivisor).to_number<size_t>());
+    }
+}
+
 static void AddOffice(const json::value& json_office, model::Map& map) {
     std::string id = GetObjectFieldAsString(json_office, OfficeFields::id);
     geom::PointInt position{.x = GetObjectFieldAsDimension(json_office, OfficeFields::x),
@@ -109,6 +125,7 @@ std::pair<model::Game, extra_data::ExtraData> LoadGame(const json::value& input_
             : default_bag_capacity;
         model::Map map(std::move(id), std::move(name));
         map.SetDogSpeed(dog_speed).SetDogBagCapacity(bag_capacity);
+        SetTickRate(json_map, map);
         auto loot_types = json_map.at(Fields::lootTypes).as_array();
         for (const auto& loot_item : loot_types) {
             map.AddLootTypeWorth(loot_item.at(LootTypesFields::value).as_int64());
@@ -31,6 +31,8 @@ struct MapFields {
     static constexpr std::string_view offices     = "offices"sv;
     static constexpr std::string_view dogSpeed    = "dogSpeed"sv;
     static constexpr std::string_view bagCapacity = "bagCapacity"sv;
+    static constexpr std::string_view tickPeriod  = "tickPeriod"sv;
+    static constexpr std::string_view tickDivisor = "tickDivisor"sv;
 };
 
 struct RoadFields {
@@ -0,0 +1,72 @@
+#include "json_writer.h"
+
+#include <cmath>
+
+namespace json_writer {
+
+using namespace std::literals;
+
+JsonWriter& JsonWriter::Value(double value) {
+    // Так же, как boost::json::serialize без allow_infinity_and_nan
+    if (std::isnan(value)) {
+        return Null();
+    }
+    if (std::isinf(value)) {
+        return Raw(value > 0 ? "1e99999"sv : "-1e99999"sv);
+    }
+    // Кратчайшее представление вида "d.dddde+XX" приводится к формату ryu,
+    // который использует boost::json: "d.ddddEXX" без '+' и ведущих нулей в порядке
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::scientific);
+    std::string_view repr(buf, end - buf);
+    const size_t exp_pos = repr.find('e');
+    std::string_view mantissa = repr.substr(0, exp_pos);
+    std::string_view exponent = repr.substr(exp_pos + 1);
+    const bool negative_exp = exponent.front() == '-';
+    exponent.remove_prefix(1);
+    while (exponent.size() > 1 && exponent.front() == '0') {
+        exponent.remove_prefix(1);
+    }
+
+    BeforeValue();
+    out_.append(mantissa);
+    out_.push_back('E');
+    if (negative_exp) {
+        out_.push_back('-');
+    }
+    out_.append(exponent);
+    need_comma_ = true;
+    return *this;
+}
+
+void JsonWriter::WriteString(std::string_view str) {
+    static constexpr char hex_digits[] = "0123456789abcdef";
+    out_.push_back('"');
+    size_t run_start = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+        const auto ch = static_cast<unsigned char>(str[i]);
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+        out_.append(str.substr(run_start, i - run_start));
+        run_start = i + 1;
+        out_.push_back('\\');
+        switch (ch) {
+        case '"':  out_.push_back('"');  break;
+        case '\\': out_.push_back('\\'); break;
+        case '\b': out_.push_back('b');  break;
+        case '\f': out_.push_back('f');  break;
+        case '\n': out_.push_back('n');  break;
+        case '\r': out_.push_back('r');  break;
+        case '\t': out_.push_back('t');  break;
+        default:
+            out_.append("u00"sv);
+            out_.push_back(hex_digits[ch >> 4]);
+            out_.push_back(hex_digits[ch & 0xF]);
+        }
+    }
+    out_.append(str.substr(run_start));
+    out_.push_back('"');
+}
+
+}  // namespace json_writer
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <charconv>
+#include <concepts>
+#include <string>
+#include <string_view>
+
+namespace json_writer {
+
+/*
+ * Потоковая запись JSON напрямую в строку без построения дерева boost::json.
+ * Результат побайтно совпадает с boost::json::serialize для тех же значений:
+ * порядок ключей определяется порядком вызовов, строки экранируются так же,
+ * числа с плавающей точкой записываются в кратчайшей научной форме ("1.5E0").
+ *
+ *  std::string body;
+ *  JsonWriter writer{body};
+ *  writer.StartObject().Key("id"sv).Value(42).EndObject();  // {"id":42}
+ */
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) noexcept
+        : out_{out} {
+    }
+
+    JsonWriter& StartObject() {
+        BeforeValue();
+        out_.push_back('{');
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& EndObject() {
+        out_.push_back('}');
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& StartArray() {
+        BeforeValue();
+        out_.push_back('[');
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& EndArray() {
+        out_.push_back(']');
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& Key(std::string_view key) {
+        BeforeValue();
+        WriteString(key);
+        out_.push_back(':');
+        need_comma_ = false;
+        return *this;
+    }
+
+    // Ключ из целого числа, например идентификатор собаки
+    template <std::integral T>
+    JsonWriter& Key(T key) {
+        char buf[24];
+        auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), key);
+        return Key(std::string_view(buf, ptr - buf));
+    }
+
+    JsonWriter& Value(std::string_view value) {
+        BeforeValue();
+        WriteString(value);
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& Value(const char* value) {
+        return Value(std::string_view{value});
+    }
+
+    JsonWriter& Value(bool value) {
+        return Raw(value ? "true" : "false");
+    }
+
+    template <std::integral T>
+    JsonWriter& Value(T value) {
+        char buf[24];
+        auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+        return Raw(std::string_view(buf, ptr - buf));
+    }
+
+    JsonWriter& Value(double value);
+
+    JsonWriter& Null() {
+        return Raw("null");
+    }
+
+    // Уже сериализованное значение
+    JsonWriter& Raw(std::string_view json) {
+        BeforeValue();
+        out_.append(json);
+        need_comma_ = true;
+        return *this;
+    }
+
+    // Массив из двух чисел, например координаты точки
+    JsonWriter& Pair(double x, double y) {
+        return StartArray().Value(x).Value(y).EndArray();
+    }
+
+private:
+    void BeforeValue() {
+        if (need_comma_) {
+            out_.push_back(',');
+        }
+    }
+
+    void WriteString(std::string_view str);
+
+    std::string& out_;
+    bool need_comma_ = false;
+};
+
+}  // namespace json_writer
@@ -1,10 +1,18 @@
 #include "sdk.h"
 //
+#include "./db/in_memory.h"
+#include "./db/postgres.h"
 #include "./json/extra_data.h"
 #include "./json/json_loader.h"
+#include "./app/simulation.h"
+#include "./app/tick_governor.h"
 #include "./http/request_handler.h"
+#include "./http/session_strands.h"
+#include "./http/sse_channel.h"
+#include "./http/ws_channel.h"
 #include "./model/model_serialization.h"
 #include "./tools/cmd_parser.h"
+#include "./tools/handoff.h"
 #include "./tools/logger.h"
 #include "./tools/ticker.h"
 
@@ -73,20 +81,62 @@ std::string GetDbURLFromEnv() {
     return {};
 }
 
+std::unique_ptr<app::UnitOfWorkFactory> MakeUnitOfWorkFactory(const cmd_parser::Args& args, const app::AppConfig& conf) {
+    if (args.storage == cmd_parser::StorageType::MEMORY) {
+        std::optional<std::filesystem::path> records_file;
+        if (args.has_records_file_path) {
+            records_file = args.records_file_path;
+        }
+        return std::make_unique<in_memory::UnitOfWorkFactoryImpl>(std::move(records_file));
+    }
+    return std::make_unique<postgres::UnitOfWorkFactoryImpl>(conf.num_threads, conf.db_url);
+}
+
 void StartServer(const cmd_parser::Args& args) {
     // 1. Загружаем карту из файла и строим модель игры
     auto input_json = json_loader::LoadJsonData(args.config_path);
     auto [game, extra_data] = json_loader::LoadGame(input_json);
     game.SetRandomSpawn(args.randomize_spawn_points);
     app::AppConfig conf {
-        .db_url = GetDbURLFromEnv(),
+        .db_url = args.storage == cmd_parser::StorageType::POSTGRES ? GetDbURLFromEnv() : std::string{},
         .num_threads = std::thread::hardware_concurrency()
     };
-    app::Application app(game, conf);
+    app::Application app(game, MakeUnitOfWorkFactory(args, conf));
+
+    // Метрики сервера, доступные по /api/v1/metrics
+    metrics::Registry metrics_registry;
 
-    // 1.1 загружаем сохраненное состояние игры
-    serialization::AppSerializator app_serializator(app, game, args.state_file_path, args.has_state_file_path);
-    app_serializator.Restore();
+    // 1.1 загружаем сохраненное состояние игры и воспроизводим журнал действий после него
+    std::unique_ptr<app::ActionLog> action_log;
+    if (args.action_log) {
+        action_log = std::make_unique<app::ActionLog>(args.state_file_path, &metrics_registry);
+    }
+    auto state_format = serialization::SnapshotFormat::TEXT;
+    if (args.state_format == cmd_parser::StateFormat::BINARY) {
+        state_format = serialization::SnapshotFormat::BINARY;
+    } else if (args.state_format == cmd_parser::StateFormat::MAPPED) {
+        state_format = serialization::SnapshotFormat::MAPPED;
+    }
+    serialization::AppSerializator app_serializator(app, game, args.state_file_path, args.has_state_file_path,
+                                                    state_format, &metrics_registry);
+    app_serializator.SetIncremental(args.incremental_state);
+    app_serializator.SetCompressionLevel(args.state_compression_level);
+    // При перезапуске без простоя состояние и слушающий сокет передаёт работающий процесс
+    std::optional<handoff::Takeover> takeover;
+    if (args.has_handoff_socket_path) {
+        takeover = handoff::TakeOver(args.handoff_socket_path, app_serializator);
+    }
+    if (!takeover) {
+        app_serializator.Restore();
+    }
+    if (action_log) {
+        action_log->Recover(app, app_serializator.GetLogSegment());
+        action_log->Start();
+        app.SetActionLog(action_log.get());
+        app_serializator.SetActionLog(action_log.get());
+    }
+    // Снимки восстановленных сессий для чтения состояния без обращения к strand
+    app.PublishSnapshots();
 
     // 1.2 Добавляем обработчик автосохранения
     if (args.has_save_state_period) {
@@ -103,19 +153,51 @@ void StartServer(const cmd_parser::Args& args) {
 
     // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры
     // Обработчик API
-    http_handler::ApiHandler api_handler(app, extra_data);
-    // strand для выполнения запросов к API
+    http_handler::ApiHandler api_handler(app, extra_data, &metrics_registry);
+    // strand координатора для операций над всеми сессиями и по strand на каждую сессию
     auto api_strand = net::make_strand(ioc);
+    // Симуляция в отдельном потоке вместо тиков по таймеру в strand
+    std::shared_ptr<app::Simulation> simulation;
+    if (args.simulation_thread) {
+        app.TimeTickerUsed();
+        simulation = std::make_shared<app::Simulation>(app, std::chrono::milliseconds{args.tick_period},
+            args.has_simulation_cpu ? std::optional<unsigned>{args.simulation_cpu} : std::nullopt, &metrics_registry);
+    }
+    auto strands = std::make_shared<http_handler::SessionStrands>(ioc, app, api_strand, simulation, &metrics_registry);
     //запуск таймера
-    if (args.has_tick_period) {
+    if (simulation) {
+        simulation->Start();
+    } else if (args.has_tick_period) {
         app.TimeTickerUsed();
+        // Один таймер с базовым периодом, сессии карт с собственным периодом тикают реже
+        strands->SetTickSchedule(app::TickSchedule{app.GetMaps(), std::chrono::milliseconds{args.tick_period}});
         auto ticker = std::make_shared<Ticker>(api_strand, std::chrono::milliseconds{args.tick_period},
-            [&app](std::chrono::milliseconds delta) { app.Tick(delta); }
+            [strands](std::chrono::milliseconds delta) { strands->Tick(delta); }, &metrics_registry
         );
+        // Под нагрузкой период тиков удлиняется до --max-tick-period
+        if (args.has_max_tick_period) {
+            auto governor = std::make_shared<app::TickGovernor>(app, app::TickGovernor::Config{
+                .min_period = std::chrono::milliseconds{args.tick_period},
+                .max_period = std::chrono::milliseconds{args.max_tick_period}
+            }, &metrics_registry);
+            strands->SetTickGovernor(std::move(governor), [weak_ticker = std::weak_ptr{ticker}](auto period) {
+                if (auto ticker = weak_ticker.lock()) {
+                    ticker->SetPeriod(period);
+                }
+            });
+        }
         ticker->Start();
     }
     // Создаём обработчик запросов в куче, управляемый shared_ptr
-    auto handler = std::make_shared<http_handler::RequestHandler>(api_handler, args.root_path, api_strand);
+    http_handler::CompressionConfig compression{
+        .level = args.compression_level,
+        .min_size = args.compression_min_size
+    };
+    // Запросы состояния, ожидающие следующего тика
+    auto tick_waiters = std::make_shared<http_handler::TickWaiters>();
+    app.AddListener(std::make_unique<http_handler::TickWaitersNotifier>(tick_waiters));
+    auto handler = std::make_shared<http_handler::RequestHandler>(api_handler, args.root_path, strands,
+                                                                  tick_waiters, compression);
     // Оборачиваем его в логирующий декоратор
     server_logging::LoggingRequestHandler logging_handler(
         [handler](auto&& req, auto&& send) {
@@ -129,7 +211,38 @@ void StartServer(const cmd_parser::Args& args) {
     // 5. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
     const auto address = net::ip::make_address("0.0.0.0");
     constexpr net::ip::port_type port = 8080;
-    http_server::ServeHttp(ioc, {address, port}, logging_handler);
+    // Канал WebSocket для действий игроков и рассылки состояния после тиков
+    auto ws_hub = std::make_shared<http_handler::WsHub>(app, strands);
+    app.AddListener(std::make_unique<http_handler::WsHubNotifier>(ws_hub));
+    // Поток событий для зрителей
+    auto sse_hub = std::make_shared<http_handler::SseHub>(app, strands, args.max_spectators);
+    app.AddListener(std::make_unique<http_handler::SseHubNotifier>(sse_hub));
+    // HTTP-сессии, которые закрываются при передаче работы новому процессу
+    auto connections = std::make_shared<http_server::Connections>();
+    auto listener = http_server::ServeHttp(ioc, {address, port}, logging_handler,
+        [ws_hub, sse_hub](auto& stream, auto& req) {
+            if (boost::beast::websocket::is_upgrade(req)) {
+                ws_hub->Accept(std::move(stream), std::move(req));
+                return true;
+            }
+            return sse_hub->TryAccept(stream, req);
+        },
+        connections,
+        takeover ? std::optional<int>{takeover->listen_socket} : std::nullopt
+    );
+    // Старый процесс завершается, получив подтверждение, а новый сам ждёт следующего
+    std::unique_ptr<handoff::HandoffServer> handoff_server;
+    if (takeover) {
+        takeover->channel.Acknowledge();
+        takeover.reset();
+    }
+    if (args.has_handoff_socket_path) {
+        handoff_server = std::make_unique<handoff::HandoffServer>(
+            handoff::HandoffServer::Config{.socket_path = args.handoff_socket_path},
+            app, app_serializator, action_log.get(), listener, connections, ws_hub, sse_hub, [&ioc] {
+                ioc.stop();
+            });
+    }
 
     // 6. Логгируем старт
     server_logging::LogStart(port, address);
@@ -139,7 +252,12 @@ void StartServer(const cmd_parser::Args& args) {
         ioc.run();
     });
 
-    // 8. Сохраняем состояние сервера при получении сигналов SIGINT, SIGTERM
+    // 8. Сохраняем состояние сервера при получении сигналов SIGINT, SIGTERM.
+    // Если работа передана новому процессу, состояние сохраняет он.
+    if (simulation) {
+        simulation->Stop();
+    }
+    handoff_server.reset();
     app_serializator.Serialize();
 }
 
@@ -0,0 +1,107 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace metrics {
+
+using namespace std::literals;
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_{std::move(bounds)}
+    , buckets_{std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1)} {
+    if (!std::is_sorted(bounds_.begin(), bounds_.end())) {
+        throw std::invalid_argument("Histogram bounds must be sorted");
+    }
+}
+
+void Histogram::Observe(double value) noexcept {
+    const auto bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::GetCumulativeCount(size_t index) const noexcept {
+    uint64_t result = 0;
+    for (size_t i = 0; i <= index && i <= bounds_.size(); ++i) {
+        result += buckets_[i].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+template <typename Metric, typename... Args>
+Metric& Registry::Add(std::string_view name, std::string_view help, Args&&... args) {
+    std::lock_guard lock{mutex_};
+    for (auto& entry : entries_) {
+        if (entry.name != name) {
+            continue;
+        }
+        if (auto* metric = std::get_if<std::unique_ptr<Metric>>(&entry.metric)) {
+            return **metric;
+        }
+        throw std::invalid_argument("Metric "s.append(name).append(" already registered with another type"sv));
+    }
+    auto metric = std::make_unique<Metric>(std::forward<Args>(args)...);
+    auto& result = *metric;
+    entries_.push_back(Entry{std::string{name}, std::string{help}, std::move(metric)});
+    return result;
+}
+
+Counter& Registry::AddCounter(std::string_view name, std::string_view help) {
+    return Add<Counter>(name, help);
+}
+
+Gauge& Registry::AddGauge(std::string_view name, std::string_view help) {
+    return Add<Gauge>(name, help);
+}
+
+Histogram& Registry::AddHistogram(std::string_view name, std::string_view help, std::vector<double> bounds) {
+    return Add<Histogram>(name, help, std::move(bounds));
+}
+
+std::string Registry::Render() const {
+    std::ostringstream out;
+    std::lock_guard lock{mutex_};
+    for (const auto& entry : entries_) {
+        out << "# HELP "sv << entry.name << ' ' << entry.help << '\n';
+        if (const auto* counter = std::get_if<std::unique_ptr<Counter>>(&entry.metric)) {
+            out << "# TYPE "sv << entry.name << " counter\n"sv;
+            out << entry.name << ' ' << (*counter)->Get() << '\n';
+        } else if (const auto* gauge = std::get_if<std::unique_ptr<Gauge>>(&entry.metric)) {
+            out << "# TYPE "sv << entry.name << " gauge\n"sv;
+            out << entry.name << ' ' << (*gauge)->Get() << '\n';
+        } else if (const auto* histogram = std::get_if<std::unique_ptr<Histogram>>(&entry.metric)) {
+            const auto& bounds = (*histogram)->GetBounds();
+            out << "# TYPE "sv << entry.name << " histogram\n"sv;
+            for (size_t i = 0; i < bounds.size(); ++i) {
+                out << entry.name << "_bucket{le=\""sv << bounds[i] << "\"} "sv
+                    << (*histogram)->GetCumulativeCount(i) << '\n';
+            }
+            out << entry.name << "_bucket{le=\"+Inf\"} "sv << (*histogram)->GetCumulativeCount(bounds.size()) << '\n';
+            out << entry.name << "_sum "sv << (*histogram)->GetSum() << '\n';
+            out << entry.name << "_count "sv << (*histogram)->GetCount() << '\n';
+        }
+    }
+    return out.str();
+}
+
+TickMetrics::TickMetrics(Registry& registry)
+    : ticks{registry.AddCounter("game_ticks_total"sv, "Number of game ticks"sv)}
+    , missed_deadlines{registry.AddCounter("game_tick_missed_deadlines_total"sv,
+        "Number of tick deadlines missed because the previous tick overran"sv)}
+    , lateness_seconds{registry.AddGauge("game_tick_lateness_seconds"sv,
+        "Delay between the deadline and the start of the last tick"sv)}
+    , duration_seconds{registry.AddGauge("game_tick_duration_seconds"sv, "Duration of the last tick"sv)} {
+}
+
+void TickMetrics::OnTick(std::chrono::steady_clock::duration lateness,
+                         std::chrono::steady_clock::duration duration) noexcept {
+    using Seconds = std::chrono::duration<double>;
+    ticks.Add();
+    lateness_seconds.Set(std::chrono::duration_cast<Seconds>(lateness).count());
+    duration_seconds.Set(std::chrono::duration_cast<Seconds>(duration).count());
+}
+
+}  // namespace metrics
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace metrics {
+
+// Монотонно растущий счётчик. Изменяется из любого потока.
+class Counter {
+public:
+    void Add(uint64_t value = 1) noexcept {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t Get() const noexcept {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Текущее значение величины. Изменяется из любого потока.
+class Gauge {
+public:
+    void Set(double value) noexcept {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    double Get() const noexcept {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<double> value_{0.};
+};
+
+// Распределение значений по корзинам с верхними границами bounds (по возрастанию).
+// Изменяется из любого потока.
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void Observe(double value) noexcept;
+
+    const std::vector<double>& GetBounds() const noexcept {
+        return bounds_;
+    }
+
+    // Число значений не больше bounds[index]; для index == bounds.size() - число всех значений
+    uint64_t GetCumulativeCount(size_t index) const noexcept;
+
+    uint64_t GetCount() const noexcept {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    double GetSum() const noexcept {
+        return sum_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<double> sum_{0.};
+};
+
+// Реестр метрик сервера. Метрики регистрируются при создании компонентов,
+// а GET /api/v1/metrics отдаёт их значения в текстовом формате Prometheus.
+class Registry {
+public:
+    // Возвращает уже зарегистрированную метрику с тем же именем или создаёт новую.
+    // Ссылка действительна, пока существует реестр.
+    Counter& AddCounter(std::string_view name, std::string_view help);
+
+    Gauge& AddGauge(std::string_view name, std::string_view help);
+
+    // Границы корзин учитываются только при создании гистограммы
+    Histogram& AddHistogram(std::string_view name, std::string_view help, std::vector<double> bounds);
+
+    std::string Render() const;
+
+private:
+    struct Entry {
+        std::string name;
+        std::string help;
+        std::variant<std::unique_ptr<Counter>, std::unique_ptr<Gauge>, std::unique_ptr<Histogram>> metric;
+    };
+
+    template <typename Metric, typename... Args>
+    Metric& Add(std::string_view name, std::string_view help, Args&&... args);
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_;
+};
+
+// Метрики цикла тиков: сколько тиков выполнено, сколько сроков тиков пропущено
+// из-за долгих обработчиков, насколько тик начался позже срока и сколько длился
+struct TickMetrics {
+    explicit TickMetrics(Registry& registry);
+
+    void OnTick(std::chrono::steady_clock::duration lateness, std::chrono::steady_clock::duration duration) noexcept;
+
+    Counter& ticks;
+    Counter& missed_deadlines;
+    Gauge& lateness_seconds;
+    Gauge& duration_seconds;
+};
+
+}  // namespace metrics
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "geom.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace serialization {
+
+// Запись и чтение двоичных данных: целые числа в формате LEB128, вещественные - как 8 байт IEEE 754
+// в порядке little-endian. Записи начинаются с версии своей схемы и длины, поэтому читатель
+// пропускает незнакомый хвост записи более новой версии.
+
+class BinaryWriter {
+public:
+    explicit BinaryWriter(std::string& out)
+        : out_{out} {
+    }
+
+    void Uint(uint64_t value) {
+        while (value >= 0x80) {
+            out_.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out_.push_back(static_cast<char>(value));
+    }
+
+    void Double(double value) {
+        const auto bits = std::bit_cast<uint64_t>(value);
+        for (int i = 0; i < 8; ++i) {
+            out_.push_back(static_cast<char>(bits >> (8 * i)));
+        }
+    }
+
+    void Point(const geom::PointDouble& point) {
+        Double(point.x);
+        Double(point.y);
+    }
+
+    void String(std::string_view value) {
+        Uint(value.size());
+        out_.append(value);
+    }
+
+    // Записывает версию и длину записи, содержимое которой формирует write
+    template <typename Fn>
+    void Record(uint64_t version, Fn&& write) {
+        record_.clear();
+        BinaryWriter record{record_};
+        write(record);
+        Uint(version);
+        Uint(record_.size());
+        out_.append(record_);
+    }
+
+private:
+    std::string& out_;
+    // Буфер вложенной записи. Записи сессий содержат записи собак, поэтому у каждого уровня свой буфер.
+    std::string record_;
+};
+
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data)
+        : data_{data} {
+    }
+
+    uint64_t Uint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const auto byte = static_cast<uint8_t>(Take(1).front());
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Corrupted data: invalid integer");
+    }
+
+    double Double() {
+        const auto bytes = Take(8);
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; ++i) {
+            bits |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+        }
+        return std::bit_cast<double>(bits);
+    }
+
+    geom::PointDouble Point() {
+        geom::PointDouble point;
+        point.x = Double();
+        point.y = Double();
+        return point;
+    }
+
+    std::string String() {
+        return std::string{Take(Uint())};
+    }
+
+    // Читает запись: read получает версию записи и читатель её содержимого.
+    // Незнакомый хвост записи более новой версии пропускается.
+    template <typename Fn>
+    void Record(uint64_t known_version, Fn&& read) {
+        const auto version = Uint();
+        BinaryReader record{Take(Uint())};
+        read(std::min(version, known_version), record);
+    }
+
+    // Следующие size байт как есть
+    std::string_view Bytes(uint64_t size) {
+        return Take(size);
+    }
+
+    bool Empty() const noexcept {
+        return data_.empty();
+    }
+
+    // Резерв под count записей. Каждая запись занимает хотя бы байт, поэтому повреждённый счётчик
+    // не приводит к огромному выделению памяти.
+    template <typename Container>
+    void Reserve(Container& container, uint64_t count) const {
+        container.reserve(std::min<uint64_t>(count, data_.size()));
+    }
+
+private:
+    std::string_view Take(uint64_t size) {
+        if (size > data_.size()) {
+            throw std::runtime_error("Corrupted data: unexpected end of data");
+        }
+        const auto result = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return result;
+    }
+
+    std::string_view data_;
+};
+
+// Проверяет, что данные начинаются с signature, не сдвигая позицию чтения
+inline bool DetectSignature(std::istream& in, std::string_view signature) {
+    const auto position = in.tellg();
+    std::string read(signature.size(), '\0');
+    in.read(read.data(), read.size());
+    const bool detected = in.gcount() == static_cast<std::streamsize>(signature.size()) && read == signature;
+    in.clear();
+    in.seekg(position);
+    return detected;
+}
+
+}  // namespace serialization
@@ -0,0 +1,175 @@
+#include "binary_snapshot.h"
+
+#include "binary_io.h"
+
+#include <optional>
+
+namespace serialization {
+
+using namespace std::literals;
+
+namespace {
+
+void WriteLoot(BinaryWriter& out, const model::LootObject& loot) {
+    out.Uint(*loot.GetId());
+    out.Uint(loot.GetType());
+    out.Uint(loot.GetWorth());
+}
+
+model::LootObject ReadLoot(BinaryReader& in) {
+    const model::LootObject::Id id{in.Uint()};
+    const size_t type = in.Uint();
+    const size_t worth = in.Uint();
+    return {id, type, worth};
+}
+
+void WriteDog(BinaryWriter& out, const model::Dog& dog) {
+    out.Record(BinarySnapshot::DOG_VERSION, [&dog](BinaryWriter& record) {
+        record.Uint(*dog.GetId());
+        record.String(dog.GetName());
+        record.Uint(static_cast<uint64_t>(dog.GetDirection()));
+        record.Point(dog.GetCoorginates());
+        record.Point(dog.GetSpeed());
+        record.Point(dog.GetPrevCoorginates());
+        record.Uint(dog.GetScore());
+        record.Uint(dog.GetBagpack().size());
+        for (const auto& loot : dog.GetBagpack()) {
+            record.Record(BinarySnapshot::LOOT_VERSION, [&loot](BinaryWriter& loot_record) {
+                WriteLoot(loot_record, loot);
+            });
+        }
+    });
+}
+
+model::Dog ReadDog(BinaryReader& in) {
+    std::optional<model::Dog> result;
+    in.Record(BinarySnapshot::DOG_VERSION, [&result](uint64_t, BinaryReader& record) {
+        const model::Dog::Id id{record.Uint()};
+        auto name = record.String();
+        const auto direction_value = record.Uint();
+        if (direction_value > static_cast<uint64_t>(model::Dog::Direction::EAST)) {
+            throw std::runtime_error("Corrupted snapshot: invalid dog direction");
+        }
+        const auto direction = static_cast<model::Dog::Direction>(direction_value);
+        const auto coords = record.Point();
+        const auto speed = record.Point();
+        const auto prev_coords = record.Point();
+        // Как и при чтении текстового архива: собака создаётся в предыдущей точке и перемещается в текущую
+        auto& dog = result.emplace(id, std::move(name), prev_coords, direction, speed);
+        dog.SetCoorginates(coords);
+        dog.AddScore(record.Uint());
+        for (auto count = record.Uint(); count > 0; --count) {
+            record.Record(BinarySnapshot::LOOT_VERSION, [&dog](uint64_t, BinaryReader& loot_record) {
+                dog.AddLootObjectToBagpack(ReadLoot(loot_record));
+            });
+        }
+    });
+    return std::move(*result);
+}
+
+void WriteSession(BinaryWriter& out, const model::GameSession::StateContent& session) {
+    out.Record(BinarySnapshot::SESSION_VERSION, [&session](BinaryWriter& record) {
+        record.String(*session.map_id);
+        record.Uint(*session.session_id);
+        record.Uint(session.dogs_join);
+        record.Uint(session.objects_spawned);
+        record.Uint(session.dogs.size());
+        for (const auto& dog : session.dogs) {
+            WriteDog(record, dog);
+        }
+        record.Uint(session.loot_objects.size());
+        for (const auto& [loot, coords] : session.loot_objects) {
+            record.Record(BinarySnapshot::LOOT_VERSION, [&loot, &coords](BinaryWriter& loot_record) {
+                WriteLoot(loot_record, loot);
+                loot_record.Point(coords);
+            });
+        }
+    });
+}
+
+model::GameSession::StateContent ReadSession(BinaryReader& in) {
+    model::GameSession::StateContent session;
+    in.Record(BinarySnapshot::SESSION_VERSION, [&session](uint64_t, BinaryReader& record) {
+        session.map_id = model::Map::Id{record.String()};
+        session.session_id = model::GameSession::Id{record.Uint()};
+        session.dogs_join = record.Uint();
+        session.objects_spawned = record.Uint();
+        for (auto count = record.Uint(); count > 0; --count) {
+            session.dogs.push_back(ReadDog(record));
+        }
+        const auto loot_count = record.Uint();
+        record.Reserve(session.loot_objects, loot_count);
+        for (auto count = loot_count; count > 0; --count) {
+            record.Record(BinarySnapshot::LOOT_VERSION, [&session](uint64_t, BinaryReader& loot_record) {
+                auto loot = ReadLoot(loot_record);
+                session.loot_objects.emplace_back(std::move(loot), loot_record.Point());
+            });
+        }
+    });
+    return session;
+}
+
+}  // namespace
+
+std::string BinarySnapshot::Write(const ApplicationState& state, uint64_t log_segment) {
+    const auto& [players, sessions] = state;
+    std::string data{SIGNATURE};
+    BinaryWriter out{data};
+    out.Uint(FORMAT_VERSION);
+    out.Uint(players.size());
+    for (const auto& player : players) {
+        out.Record(PLAYER_VERSION, [&player](BinaryWriter& record) {
+            record.String(*player.token);
+            record.String(*player.map_id);
+            record.Uint(*player.session_id);
+            record.Uint(*player.dog_id);
+        });
+    }
+    out.Uint(sessions.size());
+    for (const auto& session : sessions) {
+        WriteSession(out, session);
+    }
+    if (log_segment != 0) {
+        out.Uint(log_segment);
+    }
+    return data;
+}
+
+ApplicationState BinarySnapshot::Read(std::string_view data, uint64_t* log_segment) {
+    if (!data.starts_with(SIGNATURE)) {
+        throw std::runtime_error("Not a binary snapshot");
+    }
+    BinaryReader in{data.substr(SIGNATURE.size())};
+    if (const auto version = in.Uint(); version > FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot format version "s + std::to_string(version));
+    }
+    ApplicationState state;
+    auto& [players, sessions] = state;
+    const auto players_count = in.Uint();
+    in.Reserve(players, players_count);
+    for (auto count = players_count; count > 0; --count) {
+        in.Record(PLAYER_VERSION, [&players](uint64_t, BinaryReader& record) {
+            auto& player = players.emplace_back();
+            player.token = app::Token{record.String()};
+            player.map_id = model::Map::Id{record.String()};
+            player.session_id = model::GameSession::Id{record.Uint()};
+            player.dog_id = model::Dog::Id{record.Uint()};
+        });
+    }
+    const auto sessions_count = in.Uint();
+    in.Reserve(sessions, sessions_count);
+    for (auto count = sessions_count; count > 0; --count) {
+        sessions.push_back(ReadSession(in));
+    }
+    const uint64_t segment = in.Empty() ? 0 : in.Uint();
+    if (log_segment) {
+        *log_segment = segment;
+    }
+    return state;
+}
+
+bool BinarySnapshot::Detect(std::istream& in) {
+    return DetectSignature(in, SIGNATURE);
+}
+
+}  // namespace serialization
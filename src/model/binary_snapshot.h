@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../app/app.h"
+#include "model.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace serialization {
+
+// Формат файла состояния игры
+enum class SnapshotFormat {
+    TEXT,   // текстовый архив boost::serialization
+    BINARY, // двоичный снимок BinarySnapshot
+    MAPPED, // снимок MappedSnapshot, который читается из отображённого в память файла
+};
+
+using ApplicationState = std::pair<app::PlayersState, model::Game::GameState>;
+
+// Двоичный снимок состояния: сигнатура, версия формата, затем записи игроков и сессий.
+// Целые числа записываются в формате LEB128, вещественные - как 8 байт IEEE 754 в порядке little-endian.
+// Каждая запись начинается с версии своей схемы и длины. Новые поля добавляются только в конец записи
+// с увеличением её версии: старый код пропускает незнакомый хвост, новый код читает старые записи
+// без новых полей.
+class BinarySnapshot {
+public:
+    BinarySnapshot() = delete;
+
+    static constexpr std::string_view SIGNATURE = "DGSNAPB\n";
+    static constexpr uint64_t FORMAT_VERSION = 1;
+
+    // Версии схем записей
+    static constexpr uint64_t PLAYER_VERSION = 1;
+    static constexpr uint64_t SESSION_VERSION = 1;
+    static constexpr uint64_t DOG_VERSION = 1;
+    static constexpr uint64_t LOOT_VERSION = 1;
+
+    // log_segment - номер первого сегмента журнала действий, не вошедшего в снимок.
+    // Записывается в конце снимка, только если не равен нулю: прежние версии его не читают.
+    static std::string Write(const ApplicationState& state, uint64_t log_segment = 0);
+
+    // Бросает std::runtime_error, если данные повреждены или записаны более новым форматом
+    static ApplicationState Read(std::string_view data, uint64_t* log_segment = nullptr);
+
+    // Проверяет сигнатуру, не сдвигая позицию чтения
+    static bool Detect(std::istream& in);
+};
+
+}  // namespace serialization
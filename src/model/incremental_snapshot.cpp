@@ -0,0 +1,54 @@
+#include "incremental_snapshot.h"
+
+#include "binary_io.h"
+
+namespace serialization {
+
+using namespace std::literals;
+
+std::string IncrementalSnapshot::Write(const Manifest& manifest) {
+    std::string data{SIGNATURE};
+    BinaryWriter out{data};
+    out.Uint(FORMAT_VERSION);
+    out.Uint(manifest.log_segment);
+    out.Uint(manifest.segments.size());
+    for (const auto& segment : manifest.segments) {
+        out.Record(SEGMENT_VERSION, [&segment](BinaryWriter& record) {
+            record.String(*segment.map_id);
+            record.String(segment.file_name);
+        });
+    }
+    return data;
+}
+
+IncrementalSnapshot::Manifest IncrementalSnapshot::Read(std::string_view data) {
+    if (!data.starts_with(SIGNATURE)) {
+        throw std::runtime_error("Not an incremental snapshot");
+    }
+    BinaryReader in{data.substr(SIGNATURE.size())};
+    if (const auto version = in.Uint(); version > FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot format version "s + std::to_string(version));
+    }
+    Manifest manifest;
+    manifest.log_segment = in.Uint();
+    const auto count = in.Uint();
+    in.Reserve(manifest.segments, count);
+    for (auto i = count; i > 0; --i) {
+        in.Record(SEGMENT_VERSION, [&manifest](uint64_t, BinaryReader& record) {
+            auto& segment = manifest.segments.emplace_back();
+            segment.map_id = model::Map::Id{record.String()};
+            segment.file_name = record.String();
+            // Файл сессии лежит в каталоге файла состояния
+            if (segment.file_name.empty() || segment.file_name.find('/') != std::string::npos) {
+                throw std::runtime_error("Corrupted snapshot: invalid session file name");
+            }
+        });
+    }
+    return manifest;
+}
+
+bool IncrementalSnapshot::Detect(std::istream& in) {
+    return DetectSignature(in, SIGNATURE);
+}
+
+}  // namespace serialization
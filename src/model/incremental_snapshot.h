@@ -0,0 +1,50 @@
+#pragma once
+
+#include "model.h"
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace serialization {
+
+// Файл состояния при инкрементальном сохранении - оглавление файлов сессий.
+// Каждая сессия вместе с её игроками хранится в отдельном файле рядом с файлом состояния
+// в любом формате снимка. При сохранении записываются только файлы изменившихся сессий,
+// а затем оглавление атомарно заменяется. Файлы сессий не перезаписываются: изменившаяся сессия
+// записывается в новый файл, а файлы, на которые не ссылается оглавление, удаляются после его замены.
+// Поэтому после сбоя оглавление всегда ссылается на целиком записанные файлы.
+//
+// Оглавление записывается так же, как BinarySnapshot: сигнатура, версия формата и записи сессий.
+class IncrementalSnapshot {
+public:
+    IncrementalSnapshot() = delete;
+
+    static constexpr std::string_view SIGNATURE = "DGSNAPI\n";
+    static constexpr uint64_t FORMAT_VERSION = 1;
+    static constexpr uint64_t SEGMENT_VERSION = 1;
+
+    struct Segment {
+        model::Map::Id map_id{""};
+        // Имя файла сессии в каталоге файла состояния
+        std::string file_name;
+    };
+
+    struct Manifest {
+        std::vector<Segment> segments;
+        // Номер первого сегмента журнала действий, не вошедшего в состояние
+        uint64_t log_segment = 0;
+    };
+
+    static std::string Write(const Manifest& manifest);
+
+    // Бросает std::runtime_error, если данные повреждены или записаны более новым форматом
+    static Manifest Read(std::string_view data);
+
+    // Проверяет сигнатуру, не сдвигая позицию чтения
+    static bool Detect(std::istream& in);
+};
+
+}  // namespace serialization
@@ -0,0 +1,448 @@
+#include "mapped_snapshot.h"
+
+#include "../util/parallel_for.h"
+#include "binary_io.h"
+
+#include <boost/endian/conversion.hpp>
+
+#include <bit>
+#include <cstring>
+#include <unordered_map>
+
+namespace serialization {
+
+using namespace std::literals;
+
+namespace {
+
+constexpr uint64_t WORD = sizeof(uint64_t);
+
+// Номера слов заголовка файла
+namespace header {
+enum : size_t {
+    VERSION, WORDS, LOG_SEGMENT,
+    STRINGS_OFFSET, STRINGS_SIZE,
+    PLAYERS_OFFSET, PLAYERS_ROWS, PLAYERS_ROW_WORDS,
+    SESSIONS_COUNT, INDEX_OFFSET,
+    COUNT
+};
+}  // namespace header
+
+// Строка оглавления: смещение секции сессии от начала файла и её размер в байтах
+namespace index_entry {
+enum : size_t { OFFSET, SIZE, COUNT };
+}  // namespace index_entry
+
+// Номера слов заголовка секции сессии. Смещения таблиц отсчитываются от начала секции.
+namespace session_header {
+enum : size_t {
+    WORDS,
+    MAP_ID_OFFSET, MAP_ID_SIZE,
+    SESSION_ID, DOGS_JOIN, OBJECTS_SPAWNED,
+    DOGS_OFFSET, DOGS_ROWS, DOGS_ROW_WORDS,
+    LOOT_OFFSET, LOOT_ROWS, LOOT_ROW_WORDS,
+    BAG_OFFSET, BAG_ROWS, BAG_ROW_WORDS,
+    // Добавлено для передачи работы: в более ранних файлах заголовок заканчивается перед этим словом
+    TICK_SEQ,
+    COUNT
+};
+}  // namespace session_header
+
+// Поля строк таблиц
+namespace player_field {
+enum : size_t { TOKEN_OFFSET, TOKEN_SIZE, MAP_ID_OFFSET, MAP_ID_SIZE, SESSION_ID, DOG_ID, COUNT };
+}  // namespace player_field
+
+namespace dog_field {
+enum : size_t {
+    ID, NAME_OFFSET, NAME_SIZE, DIRECTION,
+    X, Y, SPEED_X, SPEED_Y, PREV_X, PREV_Y,
+    SCORE, BAG_FIRST, BAG_COUNT,
+    COUNT
+};
+}  // namespace dog_field
+
+namespace loot_field {
+enum : size_t { ID, TYPE, WORTH, X, Y, COUNT };
+}  // namespace loot_field
+
+namespace bag_field {
+enum : size_t { ID, TYPE, WORTH, COUNT };
+}  // namespace bag_field
+
+uint64_t LoadWord(const char* data) {
+    uint64_t value;
+    std::memcpy(&value, data, WORD);
+    return boost::endian::little_to_native(value);
+}
+
+// Слова, начинающиеся со смещения offset, с проверкой границ
+class Words {
+public:
+    Words(std::string_view data, uint64_t offset, uint64_t count) {
+        if (offset > data.size() || count > (data.size() - offset) / WORD) {
+            throw std::runtime_error("Corrupted snapshot: section out of bounds");
+        }
+        data_ = data.data() + offset;
+    }
+
+    uint64_t Uint(size_t index) const {
+        return LoadWord(data_ + index * WORD);
+    }
+
+    double Double(size_t index) const {
+        return std::bit_cast<double>(Uint(index));
+    }
+
+    geom::PointDouble Point(size_t index) const {
+        return {Double(index), Double(index + 1)};
+    }
+
+private:
+    const char* data_ = nullptr;
+};
+
+// Плоская таблица из rows строк по row_words слов. Поля после known_words записаны более новой версией и пропускаются.
+class Table {
+public:
+    Table(std::string_view data, uint64_t offset, uint64_t rows, uint64_t row_words, size_t known_words)
+        : rows_{rows}
+        , row_words_{row_words} {
+        if (row_words < known_words) {
+            throw std::runtime_error("Corrupted snapshot: table row is too short");
+        }
+        if (offset > data.size() || rows > (data.size() - offset) / WORD / row_words) {
+            throw std::runtime_error("Corrupted snapshot: table out of bounds");
+        }
+        data_ = data.data() + offset;
+    }
+
+    size_t GetRows() const noexcept {
+        return rows_;
+    }
+
+    Words Row(size_t row) const {
+        return Words{{data_ + row * row_words_ * WORD, row_words_ * WORD}, 0, row_words_};
+    }
+
+private:
+    const char* data_ = nullptr;
+    uint64_t rows_;
+    uint64_t row_words_;
+};
+
+// Заголовок из не менее чем known_words слов, первое из которых (номер words_index) - число слов заголовка
+Words ReadHeader(std::string_view data, uint64_t offset, size_t words_index, size_t known_words) {
+    const auto words = Words{data, offset, words_index + 1}.Uint(words_index);
+    if (words < known_words) {
+        throw std::runtime_error("Corrupted snapshot: header is too short");
+    }
+    return Words{data, offset, words};
+}
+
+// Смещение строки в блоке строк и её длина
+struct StringRef {
+    uint64_t offset;
+    uint64_t size;
+};
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::string& out)
+        : out_{out} {
+    }
+
+    size_t GetSize() const noexcept {
+        return out_.size();
+    }
+
+    void Uint(uint64_t value) {
+        value = boost::endian::native_to_little(value);
+        out_.append(reinterpret_cast<const char*>(&value), WORD);
+    }
+
+    void Double(double value) {
+        Uint(std::bit_cast<uint64_t>(value));
+    }
+
+    void Point(const geom::PointDouble& point) {
+        Double(point.x);
+        Double(point.y);
+    }
+
+    void String(StringRef ref) {
+        Uint(ref.offset);
+        Uint(ref.size);
+    }
+
+    // Резервирует count слов и возвращает их позицию. Слова заполняются позже через Set.
+    size_t Reserve(size_t count) {
+        const auto position = out_.size();
+        out_.append(count * WORD, '\0');
+        return position;
+    }
+
+    void Set(size_t position, size_t index, uint64_t value) {
+        value = boost::endian::native_to_little(value);
+        std::memcpy(out_.data() + position + index * WORD, &value, WORD);
+    }
+
+    StringRef AddString(std::string_view value) {
+        const StringRef ref{strings_.size(), value.size()};
+        strings_.append(value);
+        return ref;
+    }
+
+    // Повторяющиеся строки (идентификаторы карт) хранятся один раз
+    StringRef AddSharedString(const std::string& value) {
+        auto [it, inserted] = shared_strings_.emplace(value, strings_.size());
+        if (inserted) {
+            strings_.append(value);
+        }
+        return {it->second, value.size()};
+    }
+
+    // Дописывает блок строк и возвращает его смещение
+    size_t FlushStrings() {
+        const auto position = out_.size();
+        out_.append(strings_);
+        return position;
+    }
+
+    size_t GetStringsSize() const noexcept {
+        return strings_.size();
+    }
+
+private:
+    std::string& out_;
+    std::string strings_;
+    std::unordered_map<std::string, uint64_t> shared_strings_;
+};
+
+void WriteSession(SnapshotWriter& out, const model::GameSession::StateContent& session) {
+    using namespace session_header;
+
+    const auto start = out.Reserve(COUNT);
+    const auto map_id = out.AddSharedString(*session.map_id);
+    out.Set(start, WORDS, COUNT);
+    out.Set(start, MAP_ID_OFFSET, map_id.offset);
+    out.Set(start, MAP_ID_SIZE, map_id.size);
+    out.Set(start, SESSION_ID, *session.session_id);
+    out.Set(start, DOGS_JOIN, session.dogs_join);
+    out.Set(start, OBJECTS_SPAWNED, session.objects_spawned);
+    out.Set(start, TICK_SEQ, session.tick_seq);
+
+    out.Set(start, DOGS_OFFSET, out.GetSize() - start);
+    out.Set(start, DOGS_ROWS, session.dogs.size());
+    out.Set(start, DOGS_ROW_WORDS, dog_field::COUNT);
+    uint64_t bag_rows = 0;
+    for (const auto& dog : session.dogs) {
+        out.Uint(*dog.GetId());
+        out.String(out.AddString(dog.GetName()));
+        out.Uint(static_cast<uint64_t>(dog.GetDirection()));
+        out.Point(dog.GetCoorginates());
+        out.Point(dog.GetSpeed());
+        out.Point(dog.GetPrevCoorginates());
+        out.Uint(dog.GetScore());
+        out.Uint(bag_rows);
+        out.Uint(dog.GetBagpack().size());
+        bag_rows += dog.GetBagpack().size();
+    }
+
+    out.Set(start, LOOT_OFFSET, out.GetSize() - start);
+    out.Set(start, LOOT_ROWS, session.loot_objects.size());
+    out.Set(start, LOOT_ROW_WORDS, loot_field::COUNT);
+    for (const auto& [loot, coords] : session.loot_objects) {
+        out.Uint(*loot.GetId());
+        out.Uint(loot.GetType());
+        out.Uint(loot.GetWorth());
+        out.Point(coords);
+    }
+
+    out.Set(start, BAG_OFFSET, out.GetSize() - start);
+    out.Set(start, BAG_ROWS, bag_rows);
+    out.Set(start, BAG_ROW_WORDS, bag_field::COUNT);
+    for (const auto& dog : session.dogs) {
+        for (const auto& loot : dog.GetBagpack()) {
+            out.Uint(*loot.GetId());
+            out.Uint(loot.GetType());
+            out.Uint(loot.GetWorth());
+        }
+    }
+}
+
+}  // namespace
+
+std::string MappedSnapshot::Write(const ApplicationState& state, uint64_t log_segment) {
+    const auto& [players, sessions] = state;
+    std::string data{SIGNATURE};
+    SnapshotWriter out{data};
+
+    const auto file_header = out.Reserve(header::COUNT);
+    out.Set(file_header, header::VERSION, FORMAT_VERSION);
+    out.Set(file_header, header::WORDS, header::COUNT);
+    out.Set(file_header, header::LOG_SEGMENT, log_segment);
+    out.Set(file_header, header::SESSIONS_COUNT, sessions.size());
+    out.Set(file_header, header::INDEX_OFFSET, out.GetSize());
+    const auto index = out.Reserve(sessions.size() * index_entry::COUNT);
+
+    out.Set(file_header, header::PLAYERS_OFFSET, out.GetSize());
+    out.Set(file_header, header::PLAYERS_ROWS, players.size());
+    out.Set(file_header, header::PLAYERS_ROW_WORDS, player_field::COUNT);
+    for (const auto& player : players) {
+        out.String(out.AddString(*player.token));
+        out.String(out.AddSharedString(*player.map_id));
+        out.Uint(*player.session_id);
+        out.Uint(*player.dog_id);
+    }
+
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        const auto start = out.GetSize();
+        WriteSession(out, sessions[i]);
+        out.Set(index, i * index_entry::COUNT + index_entry::OFFSET, start);
+        out.Set(index, i * index_entry::COUNT + index_entry::SIZE, out.GetSize() - start);
+    }
+
+    out.Set(file_header, header::STRINGS_SIZE, out.GetStringsSize());
+    out.Set(file_header, header::STRINGS_OFFSET, out.FlushStrings());
+    return data;
+}
+
+MappedSnapshot::MappedSnapshot(std::string_view data)
+    : data_{data} {
+    if (!data.starts_with(SIGNATURE)) {
+        throw std::runtime_error("Not a mapped snapshot");
+    }
+    if (const auto version = Words{data, SIGNATURE.size(), 1}.Uint(header::VERSION); version > FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot format version "s + std::to_string(version));
+    }
+    const auto file_header = ReadHeader(data, SIGNATURE.size(), header::WORDS, header::COUNT);
+    log_segment_ = file_header.Uint(header::LOG_SEGMENT);
+    const auto strings_offset = file_header.Uint(header::STRINGS_OFFSET);
+    const auto strings_size = file_header.Uint(header::STRINGS_SIZE);
+    if (strings_offset > data.size() || strings_size > data.size() - strings_offset) {
+        throw std::runtime_error("Corrupted snapshot: strings out of bounds");
+    }
+    strings_ = data.substr(strings_offset, strings_size);
+    players_offset_ = file_header.Uint(header::PLAYERS_OFFSET);
+    players_rows_ = file_header.Uint(header::PLAYERS_ROWS);
+    players_row_words_ = file_header.Uint(header::PLAYERS_ROW_WORDS);
+    sessions_count_ = file_header.Uint(header::SESSIONS_COUNT);
+    index_offset_ = file_header.Uint(header::INDEX_OFFSET);
+    // Проверяет границы оглавления и таблицы игроков
+    if (sessions_count_ > data.size() / (index_entry::COUNT * WORD)) {
+        throw std::runtime_error("Corrupted snapshot: index out of bounds");
+    }
+    Words{data, index_offset_, sessions_count_ * index_entry::COUNT};
+    Table{data, players_offset_, players_rows_, players_row_words_, player_field::COUNT};
+}
+
+namespace {
+
+std::string GetString(std::string_view strings, uint64_t offset, uint64_t size) {
+    if (offset > strings.size() || size > strings.size() - offset) {
+        throw std::runtime_error("Corrupted snapshot: string out of bounds");
+    }
+    return std::string{strings.substr(offset, size)};
+}
+
+}  // namespace
+
+app::PlayersState MappedSnapshot::ReadPlayers() const {
+    const Table table{data_, players_offset_, players_rows_, players_row_words_, player_field::COUNT};
+    app::PlayersState players;
+    players.reserve(table.GetRows());
+    for (size_t i = 0; i < table.GetRows(); ++i) {
+        using namespace player_field;
+        const auto row = table.Row(i);
+        auto& player = players.emplace_back();
+        player.token = app::Token{GetString(strings_, row.Uint(TOKEN_OFFSET), row.Uint(TOKEN_SIZE))};
+        player.map_id = model::Map::Id{GetString(strings_, row.Uint(MAP_ID_OFFSET), row.Uint(MAP_ID_SIZE))};
+        player.session_id = model::GameSession::Id{row.Uint(SESSION_ID)};
+        player.dog_id = model::Dog::Id{row.Uint(DOG_ID)};
+    }
+    return players;
+}
+
+model::GameSession::StateContent MappedSnapshot::ReadSession(size_t index) const {
+    const Words entry{data_, index_offset_ + index * index_entry::COUNT * WORD, index_entry::COUNT};
+    const auto offset = entry.Uint(index_entry::OFFSET);
+    const auto size = entry.Uint(index_entry::SIZE);
+    if (offset > data_.size() || size > data_.size() - offset) {
+        throw std::runtime_error("Corrupted snapshot: section out of bounds");
+    }
+    const auto section = data_.substr(offset, size);
+
+    using namespace session_header;
+    const auto header = ReadHeader(section, 0, WORDS, TICK_SEQ);
+    model::GameSession::StateContent session;
+    session.map_id = model::Map::Id{GetString(strings_, header.Uint(MAP_ID_OFFSET), header.Uint(MAP_ID_SIZE))};
+    session.session_id = model::GameSession::Id{header.Uint(SESSION_ID)};
+    session.dogs_join = header.Uint(DOGS_JOIN);
+    session.objects_spawned = header.Uint(OBJECTS_SPAWNED);
+    session.tick_seq = header.Uint(WORDS) > TICK_SEQ ? header.Uint(TICK_SEQ) : 0;
+
+    const Table dogs{section, header.Uint(DOGS_OFFSET), header.Uint(DOGS_ROWS), header.Uint(DOGS_ROW_WORDS),
+                     dog_field::COUNT};
+    const Table loot{section, header.Uint(LOOT_OFFSET), header.Uint(LOOT_ROWS), header.Uint(LOOT_ROW_WORDS),
+                     loot_field::COUNT};
+    const Table bags{section, header.Uint(BAG_OFFSET), header.Uint(BAG_ROWS), header.Uint(BAG_ROW_WORDS),
+                     bag_field::COUNT};
+
+    session.dogs.reserve(dogs.GetRows());
+    for (size_t i = 0; i < dogs.GetRows(); ++i) {
+        using namespace dog_field;
+        const auto row = dogs.Row(i);
+        const auto direction = row.Uint(DIRECTION);
+        if (direction > static_cast<uint64_t>(model::Dog::Direction::EAST)) {
+            throw std::runtime_error("Corrupted snapshot: invalid dog direction");
+        }
+        // Как и при чтении текстового архива: собака создаётся в предыдущей точке и перемещается в текущую
+        auto& dog = session.dogs.emplace_back(model::Dog::Id{row.Uint(ID)},
+                                              GetString(strings_, row.Uint(NAME_OFFSET), row.Uint(NAME_SIZE)),
+                                              row.Point(PREV_X), static_cast<model::Dog::Direction>(direction),
+                                              row.Point(SPEED_X));
+        dog.SetCoorginates(row.Point(X));
+        dog.AddScore(row.Uint(SCORE));
+        const auto bag_first = row.Uint(BAG_FIRST);
+        const auto bag_count = row.Uint(BAG_COUNT);
+        if (bag_first > bags.GetRows() || bag_count > bags.GetRows() - bag_first) {
+            throw std::runtime_error("Corrupted snapshot: bag out of bounds");
+        }
+        for (auto j = bag_first; j < bag_first + bag_count; ++j) {
+            const auto item = bags.Row(j);
+            dog.AddLootObjectToBagpack({model::LootObject::Id{item.Uint(bag_field::ID)},
+                                        item.Uint(bag_field::TYPE), item.Uint(bag_field::WORTH)});
+        }
+    }
+
+    session.loot_objects.reserve(loot.GetRows());
+    for (size_t i = 0; i < loot.GetRows(); ++i) {
+        using namespace loot_field;
+        const auto row = loot.Row(i);
+        session.loot_objects.emplace_back(
+            model::LootObject{model::LootObject::Id{row.Uint(ID)}, row.Uint(TYPE), row.Uint(WORTH)}, row.Point(X));
+    }
+    return session;
+}
+
+ApplicationState MappedSnapshot::Read(std::string_view data, uint64_t* log_segment) {
+    const MappedSnapshot snapshot{data};
+    ApplicationState state;
+    auto& [players, sessions] = state;
+    sessions.resize(snapshot.GetSessionCount());
+    util::ParallelFor(sessions.size(), [&snapshot, &sessions](size_t index) {
+        sessions[index] = snapshot.ReadSession(index);
+    });
+    players = snapshot.ReadPlayers();
+    if (log_segment) {
+        *log_segment = snapshot.GetLogSegment();
+    }
+    return state;
+}
+
+bool MappedSnapshot::Detect(std::istream& in) {
+    return DetectSignature(in, SIGNATURE);
+}
+
+}  // namespace serialization
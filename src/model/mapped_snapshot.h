@@ -0,0 +1,66 @@
+#pragma once
+
+#include "binary_snapshot.h"
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+
+namespace serialization {
+
+// Снимок состояния, который читается на месте из отображённого в память файла.
+// Все значения - 8-байтовые слова little-endian (вещественные - IEEE 754), выровненные по 8 байт:
+//
+//   сигнатура | заголовок | оглавление сессий | таблица игроков | секции сессий | строки
+//
+// Оглавление хранит смещение и размер секции каждой сессии, поэтому секции читаются независимо
+// и параллельно. Секция - заголовок сессии и плоские таблицы собак, трофеев на карте и трофеев в рюкзаках
+// (собака ссылается на диапазон строк таблицы рюкзаков). Строки хранятся одним блоком в конце файла,
+// записи ссылаются на них смещением и длиной.
+//
+// Заголовки начинаются с числа своих слов, а для каждой таблицы записано число слов в строке:
+// новые поля добавляются только в конец, и старый код пропускает их без смены версии формата.
+class MappedSnapshot {
+public:
+    static constexpr std::string_view SIGNATURE = "DGSNAPM\n";
+    static constexpr uint64_t FORMAT_VERSION = 1;
+
+    // log_segment - номер первого сегмента журнала действий, не вошедшего в снимок
+    static std::string Write(const ApplicationState& state, uint64_t log_segment = 0);
+
+    // Проверяет заголовок и оглавление, не читая секций. data должны существовать, пока существует объект.
+    // Бросает std::runtime_error, если данные повреждены или записаны более новым форматом.
+    explicit MappedSnapshot(std::string_view data);
+
+    uint64_t GetLogSegment() const noexcept {
+        return log_segment_;
+    }
+
+    size_t GetSessionCount() const noexcept {
+        return sessions_count_;
+    }
+
+    app::PlayersState ReadPlayers() const;
+
+    // Секции не зависят друг от друга, поэтому метод можно вызывать из нескольких потоков одновременно
+    model::GameSession::StateContent ReadSession(size_t index) const;
+
+    // Читает снимок целиком, секции сессий - параллельно
+    static ApplicationState Read(std::string_view data, uint64_t* log_segment = nullptr);
+
+    // Проверяет сигнатуру, не сдвигая позицию чтения
+    static bool Detect(std::istream& in);
+
+private:
+    std::string_view data_;
+    std::string_view strings_;
+    uint64_t log_segment_ = 0;
+    uint64_t players_offset_ = 0;
+    uint64_t players_rows_ = 0;
+    uint64_t players_row_words_ = 0;
+    uint64_t sessions_count_ = 0;
+    uint64_t index_offset_ = 0;
+};
+
+}  // namespace serialization
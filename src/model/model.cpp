@@ -1,4 +1,5 @@
 #include "model.h"
+#include <algorithm>
 #include <stdexcept>
 
 namespace model {
@@ -66,6 +67,32 @@ size_t Map::GetDogBagCapacity() const noexcept {
     return bag_capacity_;
 }
 
+Map& Map::SetTickPeriod(std::chrono::milliseconds value) {
+    if (value <= std::chrono::milliseconds::zero()) {
+        throw std::invalid_argument("Tick period must be positive");
+    }
+    tick_period_ = value;
+    return *this;
+}
+
+Map& Map::SetTickDivisor(size_t value) {
+    if (value == 0) {
+        throw std::invalid_argument("Tick divisor must be positive");
+    }
+    tick_period_.reset();
+    tick_divisor_ = value;
+    return *this;
+}
+
+size_t Map::GetTickDivisor(std::chrono::milliseconds base_period) const noexcept {
+    if (!tick_period_ || base_period <= std::chrono::milliseconds::zero()) {
+        return tick_divisor_;
+    }
+    // Ближайшее кратное базового периода
+    const auto divisor = (*tick_period_ + base_period / 2) / base_period;
+    return std::max<size_t>(1, static_cast<size_t>(divisor));
+}
+
 // LootObject::
 LootObject::LootObject(Id id, size_t type, size_t worth) noexcept
     : id_{id}
@@ -192,6 +219,25 @@ size_t Dog::GetTimeInGame() const noexcept {
     return time_in_game_;
 }
 
+// ChangeSet::
+void ChangeSet::Merge(const ChangeSet& other) {
+    changed_dogs.insert(other.changed_dogs.begin(), other.changed_dogs.end());
+    retired_dogs.insert(other.retired_dogs.begin(), other.retired_dogs.end());
+    spawned_loot.insert(other.spawned_loot.begin(), other.spawned_loot.end());
+    removed_loot.insert(other.removed_loot.begin(), other.removed_loot.end());
+    // Идентификаторы не переиспользуются, поэтому удаление перекрывает изменение
+    for (const auto& id : retired_dogs) {
+        changed_dogs.erase(id);
+    }
+    for (const auto& id : removed_loot) {
+        spawned_loot.erase(id);
+    }
+}
+
+bool ChangeSet::Empty() const noexcept {
+    return changed_dogs.empty() && retired_dogs.empty() && spawned_loot.empty() && removed_loot.empty();
+}
+
 // GameSession::
 GameSession::GameSession(const Map* map, size_t index, bool random_spawn,
     const loot_gen::LootGeneratorParams& loot_gen_params,
@@ -226,8 +272,12 @@ const GameSession::Id& GameSession::GetId() const noexcept {
 }
 
 Dog* GameSession::NewDog(std::string name) {
+    return NewDog(std::move(name), GetDogSpawnPoint());
+}
+
+Dog* GameSession::NewDog(std::string name, geom::PointDouble spawn_point) {
     size_t index = GetNewDogIndex();
-    return AddDog({Dog::Id{index}, std::move(name), GetDogSpawnPoint()});
+    return AddDog({Dog::Id{index}, std::move(name), spawn_point});
 }
 
 void GameSession::AddLootObject(LootObject obj, geom::PointDouble coords) {
@@ -236,6 +286,8 @@ void GameSession::AddLootObject(LootObject obj, geom::PointDouble coords) {
     }
     loot_obj_id_to_coords_.emplace(obj.GetId(), coords);
     loot_obj_id_to_obj_.emplace(obj.GetId(), obj);
+    pending_changes_.spawned_loot.insert(obj.GetId());
+    MarkChanged();
 }
 
 Dog* GameSession::AddDog(Dog dog) {
@@ -244,6 +296,8 @@ Dog* GameSession::AddDog(Dog dog) {
     if (!inserted) {
         throw std::runtime_error("Dog already exists");
     }
+    pending_changes_.changed_dogs.insert(dog_it->GetId());
+    MarkChanged();
     return &(*dog_it);
 }
 
@@ -268,10 +322,11 @@ GameSession::StateContent GameSession::GetSessionStateContent() const {
     return StateContent{
         .map_id = map_->GetId(),
         .session_id = id_,
-        .dogs = dogs_,
+        .dogs = {dogs_.begin(), dogs_.end()},
         .loot_objects = std::move(loot_objects),
         .dogs_join = dogs_join_,
-        .objects_spawned = objects_spawned_
+        .objects_spawned = objects_spawned_,
+        .tick_seq = tick_seq_
     };
 }
 
@@ -280,7 +335,8 @@ size_t GameSession::GetNewDogIndex() {
 }
 
 geom::PointDouble GameSession::GetRandomPointOnRandomRoad() const {
-    static std::random_device rd;
+    // Сессии обновляются параллельно, поэтому у каждого потока свой источник
+    thread_local std::random_device rd;
     std::uniform_int_distribution<size_t> road_d(0, road_count_ - 1);
     size_t road_index = road_d(rd);
     if(!(road_index >= 0 && road_index < road_count_)) {
@@ -305,7 +361,7 @@ geom::PointDouble GameSession::GetDogSpawnPoint() const {
 
 void GameSession::SpawnLootObject() {
     size_t index = objects_spawned_++;
-    static std::random_device rd;
+    thread_local std::random_device rd;
     size_t type = std::uniform_int_distribution<size_t>{0, map_->GetLootTypeCount() - 1}(rd);
     auto [it, inserted] = loot_obj_id_to_obj_.emplace(
         LootObject::Id{index},
@@ -314,37 +370,107 @@ void GameSession::SpawnLootObject() {
     if (!inserted) {
         throw std::runtime_error("Loot object already exists");
     }
-    loot_obj_id_to_coords_[it->first] = GetRandomPointOnRandomRoad();
+    const auto coords = GetRandomPointOnRandomRoad();
+    loot_obj_id_to_coords_[it->first] = coords;
+    pending_changes_.spawned_loot.insert(it->first);
+    last_spawned_loot_.push_back({it->first, type, coords});
+    MarkContentChanged();
+}
+
+void GameSession::AddSpawnedLoot(const SpawnedLoot& loot) {
+    if (loot.type >= map_->GetLootTypeCount()) {
+        throw std::runtime_error("Unknown loot type");
+    }
+    AddLootObject(LootObject(loot.id, loot.type, map_->GetLootWorth(loot.type)), loot.coords);
+    objects_spawned_ = std::max(objects_spawned_, *loot.id + 1);
+    last_spawned_loot_.push_back(loot);
 }
 
-void GameSession::SpawnLoot(std::chrono::milliseconds tick) {
-    int objects_count = loot_generator_.Generate(
+void GameSession::SetLoadShedding(std::shared_ptr<LoadShedding> load_shedding) {
+    load_shedding_ = std::move(load_shedding);
+}
+
+void GameSession::SpawnLoot(std::chrono::milliseconds tick, const SpawnedLoots* spawned_loot) {
+    last_spawned_loot_.clear();
+    unsigned objects_count = loot_generator_.Generate(
         tick,
         loot_obj_id_to_obj_.size(),
         dogs_.size()
     );
+    // Генератор вызывается и при воспроизведении, чтобы его состояние совпало с исходным
+    if (spawned_loot) {
+        for (const auto& loot : *spawned_loot) {
+            AddSpawnedLoot(loot);
+        }
+        return;
+    }
+    // Под нагрузкой трофеи появляются не пачкой, а по одному за тик: недостача покроется следующими тиками
+    if (load_shedding_) {
+        const unsigned limit = load_shedding_->max_loot_per_tick.load(std::memory_order_relaxed);
+        if (limit != 0 && objects_count > limit) {
+            load_shedding_->shed_loot.fetch_add(objects_count - limit, std::memory_order_relaxed);
+            objects_count = limit;
+        }
+    }
     while (objects_count--) {
         SpawnLootObject();
     }
 }
 
 void GameSession::OnTick(std::chrono::milliseconds tick) {
-    for (Dog& dog : dogs_) {
-        Move(dog, tick);
-        if (dog.IsStoped() && dog.GetHoldingPeriod() >= dog_retirement_time_) {
-            dogs_to_retire_.push_back(dog.GetId());
+    Tick(tick, nullptr);
+}
+
+void GameSession::OnTick(std::chrono::milliseconds tick, const SpawnedLoots& spawned_loot) {
+    Tick(tick, &spawned_loot);
+}
+
+const GameSession::SpawnedLoots& GameSession::GetLastSpawnedLoot() const noexcept {
+    return last_spawned_loot_;
+}
+
+void GameSession::Tick(std::chrono::milliseconds tick, const SpawnedLoots* spawned_loot) {
+    auto remaining = tick;
+    do {
+        const auto step = std::min(remaining, MAX_TICK_STEP);
+        remaining -= step;
+        for (Dog& dog : dogs_) {
+            if (!dog.IsStoped()) {
+                pending_changes_.changed_dogs.insert(dog.GetId());
+                MarkContentChanged();
+            }
+            Move(dog, step);
+            if (dog.IsStoped() && dog.GetHoldingPeriod() >= dog_retirement_time_) {
+                dogs_to_retire_.push_back(dog.GetId());
+            }
         }
+        RetireDogs();
+        HandleCollisions();
+    } while (remaining.count() > 0);
+    SpawnLoot(tick, spawned_loot);
+    CommitTickChanges();
+    // Версия сохраняемого состояния увеличивается в местах изменений: время стоящих собак идёт и без них
+    ++state_version_;
+}
+
+void GameSession::CommitTickChanges() {
+    changes_history_.emplace_back(++tick_seq_, std::move(pending_changes_));
+    pending_changes_ = {};
+    if (changes_history_.size() > CHANGES_HISTORY_SIZE) {
+        changes_history_.pop_front();
     }
-    RetireDogs();
-    HandleCollisions();
-    SpawnLoot(tick);
 }
 
 void GameSession::RetireDogs() {
     for (Dog::Id dog_id : dogs_to_retire_) {
-        do_on_retire_(dog_id, map_->GetId());
+        if (do_on_retire_) {
+            do_on_retire_(dog_id, map_->GetId());
+        }
         auto nh = dog_id_to_dog_.extract(dog_id);
         dogs_.erase(nh.mapped());
+        pending_changes_.changed_dogs.erase(dog_id);
+        pending_changes_.retired_dogs.insert(dog_id);
+        MarkContentChanged();
     }
     dogs_to_retire_.clear();
 }
@@ -353,6 +479,88 @@ bool GameSession::IsRandomSpawn() const noexcept {
     return random_spawn_;
 }
 
+size_t GameSession::GetStateVersion() const noexcept {
+    return state_version_;
+}
+
+size_t GameSession::GetContentVersion() const noexcept {
+    return content_version_;
+}
+
+void GameSession::MarkChanged() noexcept {
+    ++state_version_;
+    ++content_version_;
+}
+
+void GameSession::MarkContentChanged() noexcept {
+    ++content_version_;
+}
+
+void GameSession::MarkDogChanged(Dog::Id id) {
+    pending_changes_.changed_dogs.insert(id);
+    MarkChanged();
+}
+
+size_t GameSession::GetTickSeq() const noexcept {
+    return tick_seq_;
+}
+
+void GameSession::RestoreTickSeq(size_t tick_seq) noexcept {
+    tick_seq_ = tick_seq;
+}
+
+std::optional<ChangeSet> GameSession::GetChangesSince(size_t since) const {
+    if (since > tick_seq_) {
+        return std::nullopt;
+    }
+    ChangeSet changes;
+    if (since < tick_seq_) {
+        if (changes_history_.empty() || changes_history_.front().first > since + 1) {
+            return std::nullopt;
+        }
+        for (const auto& [seq, tick_changes] : changes_history_) {
+            if (seq > since) {
+                changes.Merge(tick_changes);
+            }
+        }
+    }
+    changes.Merge(pending_changes_);
+    return changes;
+}
+
+std::vector<Dog::Id> GameSession::FindDogsInRadius(geom::PointDouble center, double radius) const {
+    UpdateSpatialIndex();
+    std::vector<Dog::Id> result;
+    dogs_index_.ForEachInRadius(center, radius, [&result](Dog::Id id, geom::PointDouble) {
+        result.push_back(id);
+    });
+    return result;
+}
+
+std::vector<LootObject::Id> GameSession::FindLootObjectsInRadius(geom::PointDouble center, double radius) const {
+    UpdateSpatialIndex();
+    std::vector<LootObject::Id> result;
+    loot_index_.ForEachInRadius(center, radius, [&result](LootObject::Id id, geom::PointDouble) {
+        result.push_back(id);
+    });
+    return result;
+}
+
+void GameSession::UpdateSpatialIndex() const {
+    if (indexed_version_ == state_version_) {
+        return;
+    }
+    dogs_index_.Clear();
+    for (const Dog& dog : dogs_) {
+        dogs_index_.Add(dog.GetId(), dog.GetCoorginates());
+    }
+    loot_index_.Clear();
+    for (const auto& [id, coords] : loot_obj_id_to_coords_) {
+        loot_index_.Add(id, coords);
+    }
+    indexed_version_ = state_version_;
+}
+
 void GameSession::HandleCollisions() {
     using namespace collision_detector;
 
@@ -401,10 +609,17 @@ void GameSession::HandleLootColletc(Dog* dog, LootObject::Id id) {
     }
     if (auto loot_obj = ExtractLootObject(id)) {
         dog->AddLootObjectToBagpack(std::move(*loot_obj));
+        pending_changes_.changed_dogs.insert(dog->GetId());
+        pending_changes_.removed_loot.insert(id);
+        MarkContentChanged();
     }
 }
 
 void GameSession::HandleLootDrop(Dog* dog) {
+    if (dog->LootCountInBagpack() != 0) {
+        pending_changes_.changed_dogs.insert(dog->GetId());
+        MarkContentChanged();
+    }
     dog->DropBagpackContent();
 }
 
@@ -504,6 +719,13 @@ const Map* Game::FindMap(const Map::Id& id) const noexcept {
 }
 
 GameSession* Game::GetGameSessionByMapId(const Map::Id& id) {
+    {
+        std::shared_lock lock{*sessions_mutex_};
+        if (auto session = map_id_to_session_.find(id); session != map_id_to_session_.end()) {
+            return &session->second;
+        }
+    }
+    std::unique_lock lock{*sessions_mutex_};
     if (auto session = map_id_to_session_.find(id); session != map_id_to_session_.end()) {
         return &session->second;
     }
@@ -516,13 +738,23 @@ GameSession* Game::GetGameSessionByMapId(const Map::Id& id) {
             dog_retirement_time_,
             do_on_retire_
         );
+        session.SetLoadShedding(load_shedding_);
         return &(map_id_to_session_.emplace(id, std::move(session)).first->second);
     }
     return nullptr;
 }
 
+const GameSession* Game::FindGameSession(const Map::Id& id) const {
+    std::shared_lock lock{*sessions_mutex_};
+    if (auto session = map_id_to_session_.find(id); session != map_id_to_session_.end()) {
+        return &session->second;
+    }
+    return nullptr;
+}
+
 GameSession* Game::AddGameSession(const Map::Id& id, size_t index,
     size_t dog_start_id /* = 0 */, size_t loot_object_start_id /* = 0 */) {
+    std::unique_lock lock{*sessions_mutex_};
     if (auto map = map_id_to_index_.find(id); map != map_id_to_index_.end()) {
         GameSession session(
             &maps_[map->second],
@@ -533,6 +765,9 @@ GameSession* Game::AddGameSession(const Map::Id& id, size_t index,
             dog_start_id,
             loot_object_start_id
         );
+        session.SetLoadShedding(load_shedding_);
+        // Сессии, созданные после восстановления, не должны повторять восстановленный номер
+        last_session_index_ = std::max(last_session_index_, index + 1);
         return &(map_id_to_session_.emplace(id, std::move(session)).first->second);
     } else {
         throw std::runtime_error("Map not found");
@@ -541,15 +776,34 @@ GameSession* Game::AddGameSession(const Map::Id& id, size_t index,
 }
 
 void Game::OnTick(std::chrono::milliseconds tick) {
+    std::shared_lock lock{*sessions_mutex_};
     for (auto& [map, session] : map_id_to_session_) {
         session.OnTick(tick);
     }
 }
 
+void Game::OnTick(const Map::Id& id, std::chrono::milliseconds tick) {
+    GameSession* session = nullptr;
+    {
+        std::shared_lock lock{*sessions_mutex_};
+        if (auto it = map_id_to_session_.find(id); it != map_id_to_session_.end()) {
+            session = &it->second;
+        }
+    }
+    // Узлы unordered_map не перемещаются при вставке, поэтому указатель остаётся действительным
+    if (session) {
+        session->OnTick(tick);
+    }
+}
+
 void Game::SetRandomSpawn(bool value) {
     random_spawn_ = value;
 }
 
+LoadShedding& Game::GetLoadShedding() noexcept {
+    return *load_shedding_;
+}
+
 void Game::SetLootGeneratorParams(double period, double probability) {
     loot_generator_params_.period = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::duration<double>(period));
     loot_generator_params_.probability = probability;
@@ -560,6 +814,7 @@ void Game::SetDogRetirementTime(size_t dog_retirement_time) {
 }
 
 Game::GameState Game::GetGameState() const {
+    std::shared_lock lock{*sessions_mutex_};
     GameState state;
     state.reserve(map_id_to_session_.size());
     for (const auto& [id, session] : map_id_to_session_) {
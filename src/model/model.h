@@ -5,15 +5,22 @@
 
 #include "geom.h"
 #include "loot_generator.h"
+#include "spatial_index.h"
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <deque>
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <ranges>
+#include <set>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -201,6 +208,14 @@ public:
 
     size_t GetLootWorth(size_t loot_type) const noexcept;
 
+    // Собственный период тиков карты. Округляется до целого числа базовых периодов.
+    Map& SetTickPeriod(std::chrono::milliseconds value);
+
+    // Сессия карты обновляется каждые value базовых тиков
+    Map& SetTickDivisor(size_t value);
+
+    // Через сколько базовых тиков обновляется сессия карты, не меньше 1
+    size_t GetTickDivisor(std::chrono::milliseconds base_period) const noexcept;
 
 private:
     using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
@@ -214,6 +229,8 @@ private:
     double dog_speed_;
     size_t bag_capacity_;
     std::vector<size_t> loot_types_worth_;
+    std::optional<std::chrono::milliseconds> tick_period_;
+    size_t tick_divisor_ = 1;
 };
 
 // LootObject
@@ -316,19 +333,64 @@ private:
 };
 
 
+// Изменения игровой сессии за один или несколько тиков
+struct ChangeSet {
+    std::set<Dog::Id> changed_dogs;
+    std::set<Dog::Id> retired_dogs;
+    std::set<LootObject::Id> spawned_loot;
+    std::set<LootObject::Id> removed_loot;
+
+    void Merge(const ChangeSet& other);
+
+    bool Empty() const noexcept;
+};
+
+// Ограничение необязательной работы сессий под нагрузкой. Общее для всех сессий игры,
+// изменяется из любого потока.
+struct LoadShedding {
+    // Наибольшее число трофеев, появляющихся в сессии за тик; 0 - без ограничения
+    std::atomic<unsigned> max_loot_per_tick{0};
+    // Сколько трофеев не появилось из-за ограничения
+    std::atomic<uint64_t> shed_loot{0};
+};
+
 class GameSession {
 public:
     using Id = util::Tagged<size_t, GameSession>;
 
+    // Количество последних тиков, изменения за которые хранятся в сессии
+    static constexpr size_t CHANGES_HISTORY_SIZE = 64;
+
+    // Размер ячейки пространственного индекса собак и трофеев
+    static constexpr double SPATIAL_INDEX_CELL_SIZE = 10.;
+
+    // Наибольший шаг моделирования. Более длинный тик (например, после задержки таймера)
+    // моделируется несколькими шагами, чтобы остановки, сбор трофеев и уход на покой
+    // происходили в тот же момент, что и при обычных тиках.
+    static constexpr std::chrono::milliseconds MAX_TICK_STEP{100};
+
     struct StateContent {
         Map::Id map_id{""};
         GameSession::Id session_id{0u};
-        std::list<Dog> dogs;
+        // Вектор вместо списка: снимок состояния для сохранения копируется одним выделением памяти.
+        // Текстовый архив списка и вектора совпадает, поэтому сохранённые ранее файлы читаются.
+        std::vector<Dog> dogs;
         using LootObjects = std::vector<std::pair<LootObject, geom::PointDouble>>;
         LootObjects loot_objects;
         size_t dogs_join;
         size_t objects_spawned;
+        // Номер последнего тика. Сохраняется только в формате mapped (при передаче работы),
+        // чтобы клиенты продолжили получать изменения в прежней нумерации.
+        size_t tick_seq = 0;
+    };
+
+    // Трофей, появившийся в тике. Журнал действий записывает их, чтобы воспроизвести тик без случайных чисел.
+    struct SpawnedLoot {
+        LootObject::Id id{0u};
+        size_t type = 0;
+        geom::PointDouble coords;
     };
+    using SpawnedLoots = std::vector<SpawnedLoot>;
 
     GameSession(const Map* map, size_t index, bool random_spawn,
         const loot_gen::LootGeneratorParams& loot_gen_params,
@@ -344,8 +406,13 @@ public:
 
     Dog* NewDog(std::string name);
 
+    // Новая собака в заданной точке (при воспроизведении журнала действий)
+    Dog* NewDog(std::string name, geom::PointDouble spawn_point);
+
     void AddLootObject(LootObject obj, geom::PointDouble coords);
 
+    void SetLoadShedding(std::shared_ptr<LoadShedding> load_shedding);
+
     Dog* AddDog(Dog dog);
 
     const Map& GetMap() const;
@@ -359,8 +426,40 @@ public:
 
     void OnTick(std::chrono::milliseconds tick);
 
+    // Тик, в котором вместо случайных трофеев появляются заданные (при воспроизведении журнала действий)
+    void OnTick(std::chrono::milliseconds tick, const SpawnedLoots& spawned_loot);
+
+    // Трофеи, появившиеся в последнем тике
+    const SpawnedLoots& GetLastSpawnedLoot() const noexcept;
+
     bool IsRandomSpawn() const noexcept;
 
+    // Версия состояния сессии увеличивается при каждом её изменении
+    size_t GetStateVersion() const noexcept;
+
+    // Версия сохраняемого состояния: собак, трофеев и счётчиков сессии. В отличие от GetStateVersion
+    // не меняется в тике, в котором ничего не сдвинулось, поэтому простаивающая сессия не сохраняется повторно.
+    size_t GetContentVersion() const noexcept;
+
+    // Отмечает изменение собаки вне тика (например, по команде игрока)
+    void MarkDogChanged(Dog::Id id);
+
+    // Номер последнего выполненного тика
+    size_t GetTickSeq() const noexcept;
+
+    // Продолжает нумерацию тиков восстановленной сессии. История изменений при этом пуста,
+    // и клиенты с более ранним номером получат полное состояние.
+    void RestoreTickSeq(size_t tick_seq) noexcept;
+
+    // Изменения после тика since, включая ещё не завершённый тик.
+    // Возвращает std::nullopt, если история изменений не покрывает since.
+    std::optional<ChangeSet> GetChangesSince(size_t since) const;
+
+    // Собаки и трофеи на расстоянии не больше radius от center
+    std::vector<Dog::Id> FindDogsInRadius(geom::PointDouble center, double radius) const;
+
+    std::vector<LootObject::Id> FindLootObjectsInRadius(geom::PointDouble center, double radius) const;
+
     void DoOnRetire(std::function<void(Dog::Id dog, const Map::Id&)> do_on_retire) {
         do_on_retire_ = std::move(do_on_retire);
     }
@@ -376,10 +475,14 @@ private:
 
     void Move(Dog& dog, std::chrono::milliseconds delta_t) const;
 
-    void SpawnLoot(std::chrono::milliseconds tick);
+    void Tick(std::chrono::milliseconds tick, const SpawnedLoots* spawned_loot);
+
+    void SpawnLoot(std::chrono::milliseconds tick, const SpawnedLoots* spawned_loot);
 
     void SpawnLootObject();
 
+    void AddSpawnedLoot(const SpawnedLoot& loot);
+
     void HandleCollisions();
 
     void HandleLootColletc(Dog* dog, LootObject::Id);
@@ -390,6 +493,15 @@ private:
 
     void RetireDogs();
 
+    void MarkChanged() noexcept;
+
+    // Изменение сохраняемого состояния в тике. Версия состояния увеличивается в конце тика.
+    void MarkContentChanged() noexcept;
+
+    void CommitTickChanges();
+
+    void UpdateSpatialIndex() const;
+
     const Map* map_;
     Id id_;
     bool random_spawn_;
@@ -399,6 +511,18 @@ private:
     std::function<void(Dog::Id dog, const Map::Id&)> do_on_retire_;
     size_t dogs_join_;
     size_t objects_spawned_;
+    std::shared_ptr<LoadShedding> load_shedding_;
+    size_t state_version_ = 0;
+    size_t content_version_ = 0;
+    size_t tick_seq_ = 0;
+    ChangeSet pending_changes_;
+    std::deque<std::pair<size_t, ChangeSet>> changes_history_;
+    SpawnedLoots last_spawned_loot_;
+
+    // Индекс перестраивается при первом запросе после изменения состояния сессии
+    mutable SpatialIndex<Dog::Id> dogs_index_{SPATIAL_INDEX_CELL_SIZE};
+    mutable SpatialIndex<LootObject::Id> loot_index_{SPATIAL_INDEX_CELL_SIZE};
+    mutable std::optional<size_t> indexed_version_;
 
     std::vector<Dog::Id> dogs_to_retire_;
 
@@ -426,19 +550,30 @@ public:
 
     const Map* FindMap(const Map::Id& id) const noexcept;
 
+    // Методы доступа к сессиям можно вызывать из разных потоков. Сама сессия
+    // не синхронизирована: операции над ней выполняются в её strand.
     GameSession* GetGameSessionByMapId(const Map::Id& id);
 
+    // В отличие от GetGameSessionByMapId не создаёт сессию
+    const GameSession* FindGameSession(const Map::Id& id) const;
+
     GameSession* AddGameSession(const Map::Id& id, size_t index,
         size_t dog_start_id = 0, size_t loot_object_start_id = 0);
 
     void OnTick(std::chrono::milliseconds tick);
 
+    // Тик одной сессии, если она создана
+    void OnTick(const Map::Id& id, std::chrono::milliseconds tick);
+
     void SetRandomSpawn(bool value);
 
     void SetLootGeneratorParams(double period, double probability);
 
     void SetDogRetirementTime(size_t dog_retirement_time);
 
+    // Ограничения под нагрузкой, действующие во всех сессиях игры
+    LoadShedding& GetLoadShedding() noexcept;
+
     using GameState = std::vector<GameSession::StateContent>;
     GameState GetGameState() const;
 
@@ -451,11 +586,14 @@ private:
     std::vector<Map> maps_;
     MapIdToIndex map_id_to_index_;
     MapIndexToSession map_id_to_session_;
+    // Защищает map_id_to_session_ и last_session_index_. Хранится в unique_ptr, чтобы Game оставалась перемещаемой.
+    std::unique_ptr<std::shared_mutex> sessions_mutex_ = std::make_unique<std::shared_mutex>();
     size_t last_session_index_ = 0;
     bool random_spawn_ = false;
     loot_gen::LootGeneratorParams loot_generator_params_;
     size_t dog_retirement_time_;
     std::function<void(Dog::Id dog, const Map::Id&)> do_on_retire_;
+    std::shared_ptr<LoadShedding> load_shedding_ = std::make_shared<LoadShedding>();
 
 };
 
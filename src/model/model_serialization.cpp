@@ -1,5 +1,22 @@
 #include "model_serialization.h"
+
+#include "../util/durable_file.h"
+#include "../util/mapped_file.h"
+#include "../util/parallel_for.h"
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <algorithm>
+#include <charconv>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+#include <streambuf>
+#include <unordered_set>
 
 namespace model {
 
@@ -36,6 +53,99 @@ void serialize(text_iarchive& ar, Dog& dog, [[maybe_unused]] const unsigned vers
 
 namespace serialization {
 
+using namespace std::literals;
+
+namespace {
+
+// Буфер потока над данными в памяти, чтобы читать текстовый архив без копирования
+class ViewBuffer : public std::streambuf {
+public:
+    explicit ViewBuffer(std::string_view data) {
+        char* begin = const_cast<char*>(data.data());
+        setg(begin, begin, begin + data.size());
+    }
+};
+
+// Начало потока gzip (RFC 1952). Несжатые форматы начинаются с сигнатуры или с текстового заголовка архива.
+constexpr std::string_view GZIP_MAGIC = "\x1f\x8b"sv;
+
+// compression_level - уровень сжатия gzip, 0 - без сжатия
+std::string EncodeState(const ApplicationState& state, uint64_t log_segment, SnapshotFormat format,
+                        int compression_level) {
+    namespace io = boost::iostreams;
+    if (format != SnapshotFormat::TEXT && compression_level == 0) {
+        return format == SnapshotFormat::BINARY ? BinarySnapshot::Write(state, log_segment)
+                                                : MappedSnapshot::Write(state, log_segment);
+    }
+    std::string result;
+    {
+        io::filtering_ostream out;
+        if (compression_level > 0) {
+            out.push(io::gzip_compressor(io::gzip_params(compression_level)));
+        }
+        out.push(io::back_inserter(result));
+        if (format == SnapshotFormat::TEXT) {
+            // Текстовый архив пишется прямо в поток сжатия, без несжатой копии в памяти
+            boost::archive::text_oarchive oa{out};
+            oa << state;
+            // Прежние версии не читают номер сегмента после состояния
+            if (log_segment != 0) {
+                oa << log_segment;
+            }
+        } else {
+            const auto data = format == SnapshotFormat::BINARY ? BinarySnapshot::Write(state, log_segment)
+                                                               : MappedSnapshot::Write(state, log_segment);
+            out.write(data.data(), data.size());
+        }
+    }
+    return result;
+}
+
+// Распаковывает данные в buffer, если они сжаты, и возвращает несжатые данные
+std::string_view Uncompress(std::string_view data, std::string& buffer) {
+    namespace io = boost::iostreams;
+    if (!data.starts_with(GZIP_MAGIC)) {
+        return data;
+    }
+    buffer.clear();
+    try {
+        io::filtering_istreambuf in;
+        in.push(io::gzip_decompressor());
+        in.push(io::array_source(data.data(), data.size()));
+        io::copy(in, io::back_inserter(buffer));
+    } catch (const std::ios_base::failure& ex) {
+        throw std::runtime_error("Corrupted snapshot: "s + ex.what());
+    }
+    return buffer;
+}
+
+// Сжатые данные распаковываются, затем формат определяется по сигнатуре.
+// Текстовые архивы прежних версий читаются как раньше.
+ApplicationState DecodeState(std::string_view data, uint64_t& log_segment) {
+    std::string uncompressed;
+    data = Uncompress(data, uncompressed);
+    if (data.starts_with(MappedSnapshot::SIGNATURE)) {
+        return MappedSnapshot::Read(data, &log_segment);
+    }
+    if (data.starts_with(BinarySnapshot::SIGNATURE)) {
+        return BinarySnapshot::Read(data, &log_segment);
+    }
+    ViewBuffer buffer{data};
+    std::istream in{&buffer};
+    boost::archive::text_iarchive ia{in};
+    ApplicationState state;
+    ia >> state;
+    try {
+        ia >> log_segment;
+    } catch (const boost::archive::archive_exception&) {
+        // Файл записан без журнала действий
+        log_segment = 0;
+    }
+    return state;
+}
+
+}  // namespace
+
 // LootObjRepr
 LootObjRepr::LootObjRepr(const model::LootObject& obj)
     : id_{obj.GetId()}
@@ -68,25 +178,291 @@ DogRepr::DogRepr(const model::Dog& dog)
     return dog;
 }
 
+SaveMetrics::SaveMetrics(metrics::Registry& registry)
+    : saves{registry.AddCounter("game_state_saves_total"sv, "Number of game state saves"sv)}
+    , skipped{registry.AddCounter("game_state_saves_skipped_total"sv,
+        "Number of autosaves postponed because the previous save was still running"sv)}
+    , errors{registry.AddCounter("game_state_save_errors_total"sv, "Number of failed background saves"sv)}
+    , capture_seconds{registry.AddGauge("game_state_capture_seconds"sv,
+        "Time the tick spent copying the state for the last save"sv)}
+    , write_seconds{registry.AddGauge("game_state_write_seconds"sv,
+        "Time spent encoding and writing the last saved state"sv)}
+    , sessions_written{registry.AddCounter("game_state_sessions_written_total"sv,
+        "Number of session files written by incremental saves"sv)}
+    , sessions_reused{registry.AddCounter("game_state_sessions_reused_total"sv,
+        "Number of unchanged session files kept by incremental saves"sv)} {
+}
+
 // ApplicationSerializator
-AppSerializator::AppSerializator(app::Application& app, model::Game& game, const std::string path, bool save_require)
+AppSerializator::AppSerializator(app::Application& app, model::Game& game, const std::string path, bool save_require,
+                                 SnapshotFormat format, metrics::Registry* registry)
     : app_{app}
     , game_{game}
     , target_file_path_{path}
-    , has_file_{save_require} {
+    , has_file_{save_require}
+    , format_{format} {
     buf_file_path_ = target_file_path_;
     buf_file_path_.replace_filename(target_file_path_.stem().string().append("_buf"));
+    if (registry) {
+        metrics_.emplace(*registry);
+    }
+    if (has_file_) {
+        saver_ = std::jthread([this](std::stop_token stop) {
+            RunSaver(std::move(stop));
+        });
+    }
 }
 
-void AppSerializator::Serialize() const {
+AppSerializator::~AppSerializator() {
+    if (saver_.joinable()) {
+        saver_.request_stop();
+        saver_.join();
+    }
+}
+
+void AppSerializator::Serialize() {
     if (!has_file_) {
         return;
     }
-    std::ofstream ss(buf_file_path_);
-    boost::archive::text_oarchive oa{ss};
-    ApplicationState state(app_.GetPlayersState(), game_.GetGameState());
-    oa << state;
+    Capture capture;
+    {
+        std::lock_guard lock{mutex_};
+        if (handed_off_) {
+            return;
+        }
+        pending_.reset();
+        capture = CaptureState();
+    }
+    Save(capture);
+}
+
+bool AppSerializator::SerializeInBackground() {
+    if (!has_file_) {
+        return true;
+    }
+    std::unique_lock lock{mutex_};
+    if (handed_off_) {
+        return true;
+    }
+    if (saving_ || pending_) {
+        if (metrics_) {
+            metrics_->skipped.Add();
+        }
+        return false;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    pending_ = CaptureState();
+    if (metrics_) {
+        metrics_->capture_seconds.Set(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    lock.unlock();
+    cv_.notify_one();
+    return true;
+}
+
+void AppSerializator::SetActionLog(app::ActionLog* action_log) {
+    action_log_ = action_log;
+}
+
+uint64_t AppSerializator::GetLogSegment() const noexcept {
+    return log_segment_;
+}
+
+void AppSerializator::SetIncremental(bool incremental) {
+    incremental_ = incremental;
+    if (!incremental_ || !has_file_) {
+        return;
+    }
+    // Имя файла сессии: <префикс><номер сохранения>_<номер сессии>
+    const auto prefix = GetSessionFilePrefix();
+    for (const auto& path : ListSessionFiles()) {
+        const auto name = path.filename().string();
+        uint64_t generation = 0;
+        std::from_chars(name.data() + prefix.size(), name.data() + name.size(), generation);
+        generation_ = std::max(generation_, generation);
+    }
+}
+
+std::string AppSerializator::HandOff() {
+    std::unique_lock lock{mutex_};
+    // Начатая запись файла должна закончиться до того, как его начнёт записывать новый процесс
+    cv_.wait(lock, [this] {
+        return !saving_;
+    });
+    pending_.reset();
+    handed_off_ = true;
+    // Новый процесс воспроизводит журнал действий с сегмента, начатого здесь
+    const uint64_t log_segment = action_log_ ? action_log_->Rotate() : 0;
+    return MappedSnapshot::Write({app_.GetPlayersState(), game_.GetGameState()}, log_segment);
+}
+
+void AppSerializator::CancelHandOff() {
+    {
+        std::lock_guard lock{mutex_};
+        handed_off_ = false;
+    }
+    SerializeInBackground();
+}
+
+void AppSerializator::SetCompressionLevel(int level) {
+    if (level < 0 || level > 9) {
+        throw std::invalid_argument("State compression level must be in range 0-9"s);
+    }
+    compression_level_ = level;
+}
+
+void AppSerializator::Wait() {
+    std::unique_lock lock{mutex_};
+    cv_.wait(lock, [this] {
+        return !saving_ && !pending_;
+    });
+}
+
+AppSerializator::Capture AppSerializator::CaptureState() {
+    // Действия после снятия копии попадают в новый сегмент журнала
+    const uint64_t log_segment = action_log_ ? action_log_->Rotate() : 0;
+    if (!incremental_) {
+        return {{app_.GetPlayersState(), game_.GetGameState()}, ++generation_, log_segment};
+    }
+    Capture capture{{}, ++generation_, log_segment};
+    // Копируются только сессии, изменившиеся после записи их файлов
+    for (const auto& map : game_.GetMaps()) {
+        const model::GameSession* session = game_.FindGameSession(map.GetId());
+        if (!session) {
+            continue;
+        }
+        auto& item = capture.sessions.emplace_back();
+        item.map_id = map.GetId();
+        item.content_version = session->GetContentVersion();
+        if (auto it = session_files_.find(item.map_id);
+            it != session_files_.end() && it->second.content_version == item.content_version) {
+            item.file_name = it->second.file_name;
+            continue;
+        }
+        model::Game::GameState session_state;
+        session_state.push_back(session->GetSessionStateContent());
+        item.state.emplace(app_.GetPlayersState(*session), std::move(session_state));
+    }
+    return capture;
+}
+
+void AppSerializator::RunSaver(std::stop_token stop) {
+    std::unique_lock lock{mutex_};
+    while (cv_.wait(lock, stop, [this] { return pending_.has_value(); })) {
+        auto capture = std::move(*pending_);
+        pending_.reset();
+        saving_ = true;
+        lock.unlock();
+        try {
+            Save(capture);
+        } catch (...) {
+            // Следующее автосохранение повторит попытку
+            if (metrics_) {
+                metrics_->errors.Add();
+            }
+        }
+        // Копия освобождается вне блокировки, чтобы не задерживать тик
+        capture = {};
+        lock.lock();
+        saving_ = false;
+        cv_.notify_all();
+    }
+}
+
+void AppSerializator::Save(const Capture& capture) {
+    std::lock_guard lock{file_mutex_};
+    if (capture.generation < written_generation_) {
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::string data;
+    SessionFiles session_files;
+    if (incremental_) {
+        data = IncrementalSnapshot::Write(WriteSessionFiles(capture, session_files));
+        // Файлы сессий должны оказаться в каталоге раньше ссылающегося на них оглавления
+        util::SyncDirectory(target_file_path_);
+    } else {
+        data = EncodeState(capture.state, capture.log_segment, format_, compression_level_);
+    }
+    util::WriteFileDurably(buf_file_path_, data);
     std::filesystem::rename(buf_file_path_, target_file_path_);
+    util::SyncDirectory(target_file_path_);
+    written_generation_ = capture.generation;
+    {
+        std::lock_guard lock{mutex_};
+        session_files_ = std::move(session_files);
+    }
+    RemoveUnusedSessionFiles(session_files_);
+    // Действия до снятия копии вошли в файл состояния
+    if (action_log_ && capture.log_segment != 0) {
+        action_log_->Truncate(capture.log_segment);
+    }
+    if (metrics_) {
+        metrics_->saves.Add();
+        metrics_->write_seconds.Set(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+IncrementalSnapshot::Manifest AppSerializator::WriteSessionFiles(const Capture& capture,
+                                                                 SessionFiles& session_files) const {
+    IncrementalSnapshot::Manifest manifest;
+    manifest.log_segment = capture.log_segment;
+    manifest.segments.resize(capture.sessions.size());
+    // Имена новых файлов уникальны для каждого сохранения, поэтому записанные ранее файлы не перезаписываются
+    const auto prefix = GetSessionFilePrefix() + std::to_string(capture.generation) + '_';
+    util::ParallelFor(capture.sessions.size(), [&](size_t index) {
+        const auto& session = capture.sessions[index];
+        auto& segment = manifest.segments[index];
+        segment.map_id = session.map_id;
+        if (session.state) {
+            segment.file_name = prefix + std::to_string(index);
+            util::WriteFileDurably(GetSessionFilePath(segment.file_name), EncodeState(*session.state, 0, format_, compression_level_));
+        } else {
+            segment.file_name = session.file_name;
+        }
+    });
+    for (size_t i = 0; i < capture.sessions.size(); ++i) {
+        const auto& session = capture.sessions[i];
+        session_files.emplace(session.map_id, SessionFile{session.content_version, manifest.segments[i].file_name});
+        if (metrics_) {
+            (session.state ? metrics_->sessions_written : metrics_->sessions_reused).Add();
+        }
+    }
+    return manifest;
+}
+
+std::filesystem::path AppSerializator::GetSessionFilePath(std::string_view file_name) const {
+    return target_file_path_.parent_path() / file_name;
+}
+
+std::string AppSerializator::GetSessionFilePrefix() const {
+    return target_file_path_.stem().string() + "_session_"s;
+}
+
+std::vector<std::filesystem::path> AppSerializator::ListSessionFiles() const {
+    const auto prefix = GetSessionFilePrefix();
+    const auto dir = target_file_path_.has_parent_path() ? target_file_path_.parent_path() : std::filesystem::path{"."};
+    std::vector<std::filesystem::path> result;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.path().filename().string().starts_with(prefix)) {
+            result.push_back(entry.path());
+        }
+    }
+    return result;
+}
+
+void AppSerializator::RemoveUnusedSessionFiles(const SessionFiles& session_files) const {
+    std::unordered_set<std::string> used;
+    for (const auto& [map_id, file] : session_files) {
+        used.insert(file.file_name);
+    }
+    std::error_code ec;
+    for (const auto& path : ListSessionFiles()) {
+        if (!used.contains(path.filename().string())) {
+            std::filesystem::remove(path, ec);
+        }
+    }
 }
 
 void AppSerializator::Restore() {
@@ -96,30 +472,94 @@ void AppSerializator::Restore() {
     if (std::error_code ec; !std::filesystem::exists(target_file_path_, ec)) {
         return;
     }
-    std::ifstream ss(target_file_path_);
-    boost::archive::text_iarchive ia{ss};
-    ApplicationState state;
-    ia >> state;
-    auto& [players_state, game_state] = state;
-    for (auto& session_state : game_state) {
-        model::GameSession* session = game_.AddGameSession(
-            session_state.map_id,
-            *session_state.session_id,
-            session_state.dogs_join,
-            session_state.objects_spawned
-        );
-        for (model::Dog& dog : session_state.dogs) {
-            session->AddDog(std::move(dog));
+    const util::MappedFile file{target_file_path_};
+    RestoreFrom(file.GetData());
+}
+
+void AppSerializator::RestoreFrom(std::string_view data) {
+    // Сжатый снимок любого формата распаковывается в память целиком
+    std::string uncompressed;
+    data = Uncompress(data, uncompressed);
+    if (data.starts_with(IncrementalSnapshot::SIGNATURE)) {
+        RestoreIncremental(data);
+    } else if (data.starts_with(MappedSnapshot::SIGNATURE)) {
+        log_segment_ = ApplyMapped(data);
+    } else {
+        auto state = DecodeState(data, log_segment_);
+        Apply(state);
+    }
+}
+
+uint64_t AppSerializator::ApplyMapped(std::string_view data) {
+    // Секции сессий читаются прямо из отображённого файла и сразу переносятся в модель,
+    // поэтому копия всего состояния в памяти не создаётся
+    const MappedSnapshot snapshot{data};
+    util::ParallelFor(snapshot.GetSessionCount(), [this, &snapshot](size_t index) {
+        auto session_state = snapshot.ReadSession(index);
+        ApplySession(session_state);
+    });
+    auto players_state = snapshot.ReadPlayers();
+    ApplyPlayers(players_state);
+    return snapshot.GetLogSegment();
+}
+
+void AppSerializator::RestoreIncremental(std::string_view data) {
+    const auto manifest = IncrementalSnapshot::Read(data);
+    std::mutex players_mutex;
+    app::PlayersState players_state;
+    util::ParallelFor(manifest.segments.size(), [&](size_t index) {
+        const auto& segment = manifest.segments[index];
+        const util::MappedFile file{GetSessionFilePath(segment.file_name)};
+        uint64_t log_segment = 0;
+        auto [players, sessions] = DecodeState(file.GetData(), log_segment);
+        if (sessions.size() != 1 || sessions.front().map_id != segment.map_id) {
+            throw std::runtime_error("Corrupted snapshot: session file "s + segment.file_name
+                                     + " does not match map "s + *segment.map_id);
         }
-        for (auto& [obj, coords] : session_state.loot_objects) {
-            session->AddLootObject(obj, coords);
+        ApplySession(sessions.front());
+        std::lock_guard lock{players_mutex};
+        players_state.insert(players_state.end(), std::make_move_iterator(players.begin()),
+                             std::make_move_iterator(players.end()));
+    });
+    ApplyPlayers(players_state);
+    // Файлы сессий, не изменившихся после запуска, не записываются повторно
+    for (const auto& segment : manifest.segments) {
+        if (const auto* session = game_.FindGameSession(segment.map_id)) {
+            session_files_[segment.map_id] = {session->GetContentVersion(), segment.file_name};
         }
     }
+    log_segment_ = manifest.log_segment;
+}
+
+void AppSerializator::Apply(ApplicationState& state) {
+    auto& [players_state, game_state] = state;
+    util::ParallelFor(game_state.size(), [this, &game_state](size_t index) {
+        ApplySession(game_state[index]);
+    });
+    ApplyPlayers(players_state);
+}
+
+void AppSerializator::ApplySession(model::GameSession::StateContent& session_state) {
+    // Game::AddGameSession защищён блокировкой, а собаки и трофеи добавляются в свою сессию
+    model::GameSession* session = game_.AddGameSession(
+        session_state.map_id,
+        *session_state.session_id,
+        session_state.dogs_join,
+        session_state.objects_spawned
+    );
+    for (model::Dog& dog : session_state.dogs) {
+        session->AddDog(std::move(dog));
+    }
+    for (auto& [obj, coords] : session_state.loot_objects) {
+        session->AddLootObject(obj, coords);
+    }
+    session->RestoreTickSeq(session_state.tick_seq);
+}
+
+void AppSerializator::ApplyPlayers(app::PlayersState& players_state) {
     for (auto& player_state : players_state) {
         app_.AddPlayer(std::move(player_state.token), player_state.map_id, player_state.session_id, player_state.dog_id);
     }
 }
 
-
-
 } // namespace serialization
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "../app/app.h"
+#include "../metrics/metrics.h"
+#include "binary_snapshot.h"
+#include "incremental_snapshot.h"
+#include "mapped_snapshot.h"
 #include "model.h"
 
 #include <boost/archive/text_iarchive.hpp>
@@ -9,8 +13,17 @@
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/unordered_map.hpp>
 
+#include <condition_variable>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace {
 
@@ -125,22 +138,168 @@ private:
 };
 
 
+// Метрики сохранения состояния
+struct SaveMetrics {
+    explicit SaveMetrics(metrics::Registry& registry);
+
+    metrics::Counter& saves;
+    metrics::Counter& skipped;
+    metrics::Counter& errors;
+    // Время копирования состояния, на которое останавливается тик
+    metrics::Gauge& capture_seconds;
+    // Время кодирования и записи файла в фоновом потоке
+    metrics::Gauge& write_seconds;
+    // При инкрементальном сохранении: записанные заново и оставшиеся прежними файлы сессий
+    metrics::Counter& sessions_written;
+    metrics::Counter& sessions_reused;
+};
+
 // ApplicationSerializator
+// Состояние записывается во временный файл, который сбрасывается на диск и атомарно переименовывается,
+// поэтому файл состояния никогда не бывает записан наполовину.
+// Автосохранение выполняется в фоновом потоке: в тике снимается только копия состояния.
 class AppSerializator {
 public:
-    AppSerializator(app::Application& app, model::Game& game, const std::string path, bool save_require);
+    // format - формат сохранения. Восстанавливается файл любого формата: он определяется по сигнатуре.
+    AppSerializator(app::Application& app, model::Game& game, const std::string path, bool save_require,
+                    SnapshotFormat format = SnapshotFormat::TEXT, metrics::Registry* registry = nullptr);
+
+    AppSerializator(const AppSerializator&) = delete;
+    AppSerializator& operator=(const AppSerializator&) = delete;
+
+    // Незаписанная копия состояния отбрасывается, начатая запись завершается
+    ~AppSerializator();
 
-    void Serialize() const;
+    // Сохраняет состояние в вызывающем потоке (при остановке сервера).
+    // Копия, ожидающая фоновой записи, отбрасывается: записывается более новое состояние.
+    void Serialize();
+
+    // Копирует состояние и передаёт копию фоновому потоку. Вызывается, когда модель не изменяется
+    // (в обработчике тика). Если предыдущее сохранение ещё не закончено, ничего не копирует и возвращает false:
+    // сохранение не встаёт в очередь, а повторяется при следующем вызове.
+    bool SerializeInBackground();
+
+    // Дожидается окончания фонового сохранения
+    void Wait();
 
     void Restore();
 
+    // Восстанавливает состояние из данных файла состояния любого формата (снимок, полученный от старого процесса)
+    void RestoreFrom(std::string_view data);
+
+    // Передача работы новому процессу: дожидается фонового сохранения, снимает копию состояния в формате mapped
+    // и отключает сохранение, чтобы старый процесс не перезаписал файл нового. Вызывается, когда модель не изменяется.
+    std::string HandOff();
+
+    // Возобновляет сохранение, если новый процесс не запустился, и сразу сохраняет состояние в фоне.
+    // Вызывается, когда модель не изменяется.
+    void CancelHandOff();
+
+    // При снятии копии состояния начинается новый сегмент журнала, его номер сохраняется в файле состояния,
+    // а после записи файла предыдущие сегменты удаляются. Вызывается до запуска сервера.
+    void SetActionLog(app::ActionLog* action_log);
+
+    // Номер первого сегмента журнала действий, не вошедшего в восстановленный файл состояния
+    uint64_t GetLogSegment() const noexcept;
+
+    // Сохранять только изменившиеся сессии: каждая сессия записывается в свой файл,
+    // а файл состояния становится их оглавлением (см. IncrementalSnapshot). Вызывается до первого сохранения.
+    // Номера новых файлов сессий продолжают номера файлов, оставшихся от прежнего процесса,
+    // поэтому файл, на который ссылается записанное оглавление, не перезаписывается.
+    void SetIncremental(bool incremental);
+
+    // Уровень сжатия файлов состояния и сессий потоком gzip (1-9), 0 - без сжатия. Оглавление не сжимается.
+    // Сжатый файл распознаётся при восстановлении автоматически. Вызывается до первого сохранения.
+    void SetCompressionLevel(int level);
+
 private:
-    using ApplicationState = std::pair<app::PlayersState, model::Game::GameState>;
+    // Файл сессии и версия её сохраняемого состояния на момент записи
+    struct SessionFile {
+        size_t content_version = 0;
+        std::string file_name;
+    };
+    using SessionFiles = std::unordered_map<model::Map::Id, SessionFile, util::TaggedHasher<model::Map::Id>>;
+
+    // Сессия при инкрементальном сохранении: копия состояния изменившейся сессии с её игроками
+    // или имя уже записанного файла неизменившейся
+    struct SessionCapture {
+        model::Map::Id map_id{""};
+        size_t content_version = 0;
+        std::optional<ApplicationState> state;
+        std::string file_name;
+    };
+
+    // Копия состояния, её номер и номер сегмента журнала, начатого при снятии копии.
+    // При инкрементальном сохранении вместо state заполняется sessions.
+    struct Capture {
+        ApplicationState state;
+        uint64_t generation = 0;
+        uint64_t log_segment = 0;
+        std::vector<SessionCapture> sessions;
+    };
+
+    // Вызывается под mutex_
+    Capture CaptureState();
+
+    // Записывает состояние, если более новое ещё не записано
+    void Save(const Capture& capture);
+
+    // Записывает файлы изменившихся сессий и возвращает оглавление. Вызывается под file_mutex_.
+    IncrementalSnapshot::Manifest WriteSessionFiles(const Capture& capture, SessionFiles& session_files) const;
+
+    void RestoreIncremental(std::string_view data);
+
+    // Переносит в модель снимок MappedSnapshot, сессии - параллельно. Возвращает номер сегмента журнала.
+    uint64_t ApplyMapped(std::string_view data);
+
+    // Удаляет файлы сессий, на которые не ссылается записанное оглавление
+    void RemoveUnusedSessionFiles(const SessionFiles& session_files) const;
+
+    // Файлы сессий в каталоге файла состояния
+    std::vector<std::filesystem::path> ListSessionFiles() const;
+
+    std::string GetSessionFilePrefix() const;
+
+    std::filesystem::path GetSessionFilePath(std::string_view file_name) const;
+
+    void RunSaver(std::stop_token stop);
+
+    // Сессии восстанавливаются параллельно, игроки - после них
+    void Apply(ApplicationState& state);
+
+    // Можно вызывать из нескольких потоков для разных сессий
+    void ApplySession(model::GameSession::StateContent& session_state);
+
+    void ApplyPlayers(app::PlayersState& players_state);
+
     app::Application& app_;
     model::Game& game_;
     std::filesystem::path target_file_path_;
     std::filesystem::path buf_file_path_;
     bool has_file_;
+    SnapshotFormat format_;
+    std::optional<SaveMetrics> metrics_;
+    app::ActionLog* action_log_ = nullptr;
+    uint64_t log_segment_ = 0;
+    bool incremental_ = false;
+    int compression_level_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    // Копия состояния, ожидающая записи
+    std::optional<Capture> pending_;
+    bool saving_ = false;
+    // Работа передана новому процессу, состояние не сохраняется
+    bool handed_off_ = false;
+    uint64_t generation_ = 0;
+    // Файлы сессий последнего записанного оглавления. Изменяются только в Save.
+    SessionFiles session_files_;
+
+    // Запись файла из фонового потока и из Serialize не пересекается
+    std::mutex file_mutex_;
+    uint64_t written_generation_ = 0;
+
+    std::jthread saver_;
 };
 
 class SerializingListener : public app::ApplicationListener {
@@ -151,9 +310,9 @@ public:
 
     void OnTick(std::chrono::milliseconds tick) override {
         counter += tick;
-        if (counter >= save_period_) {
-            counter = counter - save_period_;
-            serializator_.Serialize();
+        // Пока предыдущее сохранение не закончено, срок переносится на следующий тик
+        if (counter >= save_period_ && serializator_.SerializeInBackground()) {
+            counter %= save_period_;
         }
     }
 
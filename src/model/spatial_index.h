@@ -0,0 +1,120 @@
+#pragma once
+
+#include "geom.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace model {
+
+/*
+ * Равномерная сетка для поиска объектов рядом с заданной точкой.
+ * Объекты раскладываются по квадратным ячейкам со стороной cell_size,
+ * поиск в радиусе просматривает только ячейки, пересекающие описанный квадрат
+ * и лежащие в границах занятых ячеек. Если таких ячеек больше, чем занятых (большой радиус
+ * или редко занятая сетка), перебираются занятые ячейки, поэтому поиск не дороже одного прохода по ним.
+ */
+template <typename Id>
+class SpatialIndex {
+public:
+    explicit SpatialIndex(double cell_size)
+        : cell_size_{cell_size} {
+    }
+
+    void Clear() {
+        cells_.clear();
+    }
+
+    void Add(Id id, geom::PointDouble pos) {
+        const Cell cell = CellOf(pos);
+        if (cells_.empty()) {
+            min_ = max_ = cell;
+        } else {
+            min_ = {std::min(min_.x, cell.x), std::min(min_.y, cell.y)};
+            max_ = {std::max(max_.x, cell.x), std::max(max_.y, cell.y)};
+        }
+        cells_[cell].emplace_back(std::move(id), pos);
+    }
+
+    // Вызывает fn(id, pos) для каждого объекта на расстоянии не больше radius от center
+    template <typename Fn>
+    void ForEachInRadius(geom::PointDouble center, double radius, Fn&& fn) const {
+        if (cells_.empty() || !(radius >= 0.)) {
+            return;
+        }
+        const long long from_x = ClampCell(center.x - radius, min_.x, max_.x);
+        const long long to_x = ClampCell(center.x + radius, min_.x, max_.x);
+        const long long from_y = ClampCell(center.y - radius, min_.y, max_.y);
+        const long long to_y = ClampCell(center.y + radius, min_.y, max_.y);
+        const double sq_radius = radius * radius;
+        const auto visit = [&](const auto& objects) {
+            for (const auto& [id, pos] : objects) {
+                const double dx = pos.x - center.x;
+                const double dy = pos.y - center.y;
+                if (dx * dx + dy * dy <= sq_radius) {
+                    fn(id, pos);
+                }
+            }
+        };
+        // Число ячеек квадрата считается в double: для далёких границ оно не помещается в long long
+        const double box_cells = (static_cast<double>(to_x) - from_x + 1.) * (static_cast<double>(to_y) - from_y + 1.);
+        if (box_cells > static_cast<double>(cells_.size())) {
+            for (const auto& [cell, objects] : cells_) {
+                if (cell.x >= from_x && cell.x <= to_x && cell.y >= from_y && cell.y <= to_y) {
+                    visit(objects);
+                }
+            }
+            return;
+        }
+        for (long long x = from_x; x <= to_x; ++x) {
+            for (long long y = from_y; y <= to_y; ++y) {
+                if (auto it = cells_.find(Cell{x, y}); it != cells_.end()) {
+                    visit(it->second);
+                }
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        long long x, y;
+        bool operator==(const Cell&) const = default;
+    };
+
+    struct CellHasher {
+        size_t operator()(const Cell& cell) const {
+            return std::hash<long long>{}(cell.x) * 37 ^ std::hash<long long>{}(cell.y);
+        }
+    };
+
+    Cell CellOf(geom::PointDouble pos) const {
+        return Cell{
+            static_cast<long long>(std::floor(pos.x / cell_size_)),
+            static_cast<long long>(std::floor(pos.y / cell_size_))
+        };
+    }
+
+    // Номер ячейки координаты coord, ограниченный отрезком [min, max]. Ограничение выполняется до
+    // преобразования к целому, поэтому координата за пределами long long не приводит к переполнению.
+    long long ClampCell(double coord, long long min, long long max) const {
+        const double cell = std::floor(coord / cell_size_);
+        if (!(cell > static_cast<double>(min))) {
+            return min;
+        }
+        if (cell >= static_cast<double>(max)) {
+            return max;
+        }
+        return static_cast<long long>(cell);
+    }
+
+    double cell_size_;
+    std::unordered_map<Cell, std::vector<std::pair<Id, geom::PointDouble>>, CellHasher> cells_;
+    // Границы занятых ячеек, действительны, если cells_ не пуст
+    Cell min_{0, 0};
+    Cell max_{0, 0};
+};
+
+}  // namespace model
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <iostream>
 #include <optional>
+#include <string_view>
 #include <vector>
 
 namespace cmd_parser {
@@ -19,9 +20,48 @@ struct Args {
 
     std::string state_file_path;
     bool has_state_file_path;
+    std::string state_format;
+    int state_compression_level;
 
     size_t save_state_period;
     bool has_save_state_period;
+
+    bool action_log;
+
+    bool incremental_state;
+
+    std::string storage;
+
+    std::string records_file_path;
+    bool has_records_file_path;
+
+    int compression_level;
+    size_t compression_min_size;
+
+    size_t max_spectators;
+
+    bool simulation_thread;
+    unsigned simulation_cpu;
+    bool has_simulation_cpu;
+
+    size_t max_tick_period;
+    bool has_max_tick_period;
+
+    std::string handoff_socket_path;
+    bool has_handoff_socket_path;
+};
+
+struct StateFormat {
+    StateFormat() = delete;
+    static constexpr std::string_view TEXT   = "text"sv;
+    static constexpr std::string_view BINARY = "binary"sv;
+    static constexpr std::string_view MAPPED = "mapped"sv;
+};
+
+struct StorageType {
+    StorageType() = delete;
+    static constexpr std::string_view POSTGRES = "postgres"sv;
+    static constexpr std::string_view MEMORY   = "memory"sv;
 };
 
 [[nodiscard]] inline std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
@@ -36,7 +76,30 @@ struct Args {
         ("tick-period,t", po::value<size_t>(&args.tick_period)->value_name("milliseconds"s), "set tick period")
         ("randomize-spawn-points,r", "spawn dogs at random positions")
         ("state-file,s", po::value(&args.state_file_path)->value_name("file"s), "set game state file path")
-        ("save-state-period,p", po::value<size_t>(&args.save_state_period)->value_name("milliseconds"s), "set game state save period");
+        ("state-format", po::value(&args.state_format)->value_name("text|binary|mapped"s)->default_value(std::string{StateFormat::TEXT}),
+            "set game state file format, any format is restored")
+        ("state-compression-level", po::value<int>(&args.state_compression_level)->value_name("0-9"s)->default_value(0),
+            "set gzip compression level of game state files, 0 disables compression")
+        ("save-state-period,p", po::value<size_t>(&args.save_state_period)->value_name("milliseconds"s), "set game state save period")
+        ("incremental-state", "save only changed sessions into separate files next to the state file")
+        ("action-log", "log player actions and ticks next to the state file to recover after a crash, requires state file")
+        ("storage", po::value(&args.storage)->value_name("postgres|memory"s)->default_value(std::string{StorageType::POSTGRES}),
+            "set retired players storage")
+        ("records-file", po::value(&args.records_file_path)->value_name("file"s), "set append-only file for memory storage")
+        ("compression-level", po::value<int>(&args.compression_level)->value_name("0-9"s)->default_value(6),
+            "set gzip/deflate response compression level, 0 disables compression")
+        ("compression-min-size", po::value<size_t>(&args.compression_min_size)->value_name("bytes"s)->default_value(1024),
+            "set minimal response size to compress")
+        ("max-spectators", po::value<size_t>(&args.max_spectators)->value_name("count"s)->default_value(1000),
+            "set maximal number of spectator event streams")
+        ("simulation-thread", "run game simulation on a dedicated thread, requires tick period")
+        ("simulation-cpu", po::value<unsigned>(&args.simulation_cpu)->value_name("cpu"s),
+            "pin simulation thread to cpu")
+        ("max-tick-period", po::value<size_t>(&args.max_tick_period)->value_name("milliseconds"s),
+            "lengthen tick period up to this value under load, requires tick period")
+        ("handoff-socket", po::value(&args.handoff_socket_path)->value_name("file"s),
+            "take over the listening socket and game state from a running server with the same option, "
+            "then wait for the next server on this unix socket, requires no simulation thread");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -55,6 +118,44 @@ struct Args {
     args.has_tick_period = vm.contains("tick-period"s);
     args.has_state_file_path = vm.contains("state-file");
     args.has_save_state_period = vm.contains("save-state-period");
+    args.action_log = vm.contains("action-log"s);
+    args.incremental_state = vm.contains("incremental-state"s);
+    if (args.action_log && !args.has_state_file_path) {
+        throw std::runtime_error("Action log requires state file"s);
+    }
+    if (args.state_format != StateFormat::TEXT && args.state_format != StateFormat::BINARY
+        && args.state_format != StateFormat::MAPPED) {
+        throw std::runtime_error("Unknown state format "s + args.state_format);
+    }
+    if (args.state_compression_level < 0 || args.state_compression_level > 9) {
+        throw std::runtime_error("State compression level must be in range 0-9"s);
+    }
+    if (args.storage != StorageType::POSTGRES && args.storage != StorageType::MEMORY) {
+        throw std::runtime_error("Unknown storage type "s + args.storage);
+    }
+    args.has_records_file_path = vm.contains("records-file");
+    if (args.compression_level < 0 || args.compression_level > 9) {
+        throw std::runtime_error("Compression level must be in range 0-9"s);
+    }
+    args.simulation_thread = vm.contains("simulation-thread"s);
+    args.has_simulation_cpu = vm.contains("simulation-cpu"s);
+    if (args.simulation_thread && !args.has_tick_period) {
+        throw std::runtime_error("Simulation thread requires tick period"s);
+    }
+    args.has_handoff_socket_path = vm.contains("handoff-socket"s);
+    if (args.has_handoff_socket_path && args.simulation_thread) {
+        // Поток моделирования изменяет модель без блокировки сессий, и копия состояния не была бы согласованной
+        throw std::runtime_error("Handoff socket requires no simulation thread"s);
+    }
+    args.has_max_tick_period = vm.contains("max-tick-period"s);
+    if (args.has_max_tick_period) {
+        if (!args.has_tick_period || args.simulation_thread) {
+            throw std::runtime_error("Adaptive tick period requires tick period and no simulation thread"s);
+        }
+        if (args.max_tick_period < args.tick_period) {
+            throw std::runtime_error("Max tick period must not be less than tick period"s);
+        }
+    }
     return args;
 }
 
@@ -0,0 +1,152 @@
+#include "handoff.h"
+
+#include "logger.h"
+
+#include <future>
+#include <string>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace handoff {
+
+using namespace std::literals;
+
+namespace {
+
+// Как часто поток передачи проверяет, не пора ли остановиться
+constexpr auto POLL_PERIOD = 200ms;
+
+}  // namespace
+
+HandoffServer::HandoffServer(Config config, app::Application& app, serialization::AppSerializator& serializator,
+                             app::ActionLog* action_log, std::shared_ptr<http_server::ListenerBase> listener,
+                             std::shared_ptr<http_server::Connections> connections,
+                             std::shared_ptr<http_handler::WsHub> ws_hub, std::shared_ptr<http_handler::SseHub> sse_hub,
+                             std::function<void()> on_complete)
+    : config_{std::move(config)}
+    , app_{app}
+    , serializator_{serializator}
+    , action_log_{action_log}
+    , listener_{std::move(listener)}
+    , connections_{std::move(connections)}
+    , ws_hub_{std::move(ws_hub)}
+    , sse_hub_{std::move(sse_hub)}
+    , on_complete_{std::move(on_complete)}
+    , handoff_listener_{config_.socket_path}
+    , thread_{[this](std::stop_token stop) {
+        Run(std::move(stop));
+    }} {
+}
+
+HandoffServer::~HandoffServer() {
+    thread_.request_stop();
+    thread_.join();
+}
+
+void HandoffServer::Run(std::stop_token stop) {
+    while (!stop.stop_requested()) {
+        std::optional<util::HandoffChannel> channel;
+        try {
+            channel = handoff_listener_.Accept(POLL_PERIOD);
+        } catch (const std::exception& ex) {
+            server_logging::LogHandoff(ex.what());
+            continue;
+        }
+        if (!channel) {
+            continue;
+        }
+        server_logging::LogHandoff("new process connected"sv);
+        if (HandOff(*channel, stop)) {
+            server_logging::LogHandoff("completed"sv);
+            on_complete_();
+            return;
+        }
+        server_logging::LogHandoff("cancelled"sv);
+        Cancel();
+    }
+}
+
+bool HandoffServer::HandOff(util::HandoffChannel& channel, const std::stop_token& stop) {
+    try {
+        auto paused = listener_->Pause();
+        while (paused.wait_for(POLL_PERIOD) != std::future_status::ready) {
+            if (stop.stop_requested()) {
+                return false;
+            }
+        }
+        // Запросы и действия игроков, начатые до передачи, должны попасть в копию состояния
+        connections_->Drain();
+        ws_hub_->Drain();
+        sse_hub_->Drain();
+        const auto deadline = std::chrono::steady_clock::now() + config_.drain_timeout;
+        while (connections_->GetActiveCount() != 0 || ws_hub_->GetPendingActions() != 0) {
+            if (stop.stop_requested()) {
+                return false;
+            }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                // Копия без незавершённых действий потеряла бы их
+                server_logging::LogHandoff("drain timeout"sv);
+                return false;
+            }
+            std::this_thread::sleep_for(10ms);
+        }
+
+        std::string snapshot;
+        {
+            auto lock = app_.LockAllSessions();
+            app_.SetTicksSuspended(true);
+            // Новый процесс продолжает журнал с сегмента, начатого при снятии копии
+            app_.SetActionLog(nullptr);
+            snapshot = serializator_.HandOff();
+        }
+        channel.Send(listener_->GetNativeHandle(), snapshot);
+        snapshot = {};
+
+        // Новый процесс восстанавливает состояние и подтверждает, что принимает соединения
+        while (!channel.Poll(POLL_PERIOD)) {
+            if (stop.stop_requested()) {
+                return false;
+            }
+        }
+        return channel.ReadAcknowledge();
+    } catch (const std::exception& ex) {
+        server_logging::LogHandoff(ex.what());
+        return false;
+    }
+}
+
+void HandoffServer::Cancel() {
+    {
+        auto lock = app_.LockAllSessions();
+        app_.SetActionLog(action_log_);
+        serializator_.CancelHandOff();
+        app_.SetTicksSuspended(false);
+    }
+    connections_->Resume();
+    ws_hub_->Resume();
+    sse_hub_->Resume();
+    listener_->Resume();
+}
+
+std::optional<Takeover> TakeOver(const std::filesystem::path& socket_path,
+                                 serialization::AppSerializator& serializator) {
+    auto channel = util::HandoffChannel::Connect(socket_path);
+    if (!channel) {
+        return std::nullopt;
+    }
+    server_logging::LogHandoff("connected to the old process"sv);
+    auto transfer = channel->Receive();
+    try {
+        serializator.RestoreFrom(transfer.snapshot);
+    } catch (...) {
+#ifdef __linux__
+        ::close(transfer.socket);
+#endif
+        throw;
+    }
+    return Takeover{std::move(*channel), transfer.socket};
+}
+
+}  // namespace handoff
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../app/action_log.h"
+#include "../app/app.h"
+#include "../http/http_server.h"
+#include "../http/sse_channel.h"
+#include "../http/ws_channel.h"
+#include "../model/model_serialization.h"
+#include "../util/handoff_channel.h"
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <thread>
+
+namespace handoff {
+
+// Передача работы новому процессу сервера (перезапуск без простоя). Старый процесс слушает Unix-сокет
+// в отдельном потоке. Когда к нему подключается новый процесс, старый:
+//   1. перестаёт принимать соединения - новые ждут в очереди слушающего сокета;
+//   2. закрывает keep-alive соединения, ожидающие запроса, соединения WebSocket и потоки событий
+//      и дожидается ответов на начатые запросы и выполнения полученных действий игроков.
+//      Если они не завершились за drain_timeout, передача отменяется;
+//   3. под исключительной блокировкой приостанавливает тики, отключает журнал действий и сохранение состояния
+//      и снимает копию состояния;
+//   4. передаёт новому процессу слушающий сокет и копию состояния и ждёт подтверждения.
+// После подтверждения вызывается on_complete (остановка сервера). Если новый процесс закрыл соединение
+// без подтверждения, старый возобновляет тики, журнал, сохранение и приём соединений.
+class HandoffServer {
+public:
+    struct Config {
+        std::filesystem::path socket_path;
+        // Сколько ждать ответов на начатые запросы и выполнения действий
+        std::chrono::milliseconds drain_timeout{5000};
+    };
+
+    HandoffServer(Config config, app::Application& app, serialization::AppSerializator& serializator,
+                  app::ActionLog* action_log, std::shared_ptr<http_server::ListenerBase> listener,
+                  std::shared_ptr<http_server::Connections> connections,
+                  std::shared_ptr<http_handler::WsHub> ws_hub, std::shared_ptr<http_handler::SseHub> sse_hub,
+                  std::function<void()> on_complete);
+
+    HandoffServer(const HandoffServer&) = delete;
+    HandoffServer& operator=(const HandoffServer&) = delete;
+
+    // Останавливает поток, незавершённая передача отменяется
+    ~HandoffServer();
+
+private:
+    void Run(std::stop_token stop);
+
+    // Возвращает true, если новый процесс подтвердил запуск
+    bool HandOff(util::HandoffChannel& channel, const std::stop_token& stop);
+
+    void Cancel();
+
+    Config config_;
+    app::Application& app_;
+    serialization::AppSerializator& serializator_;
+    app::ActionLog* action_log_;
+    std::shared_ptr<http_server::ListenerBase> listener_;
+    std::shared_ptr<http_server::Connections> connections_;
+    std::shared_ptr<http_handler::WsHub> ws_hub_;
+    std::shared_ptr<http_handler::SseHub> sse_hub_;
+    std::function<void()> on_complete_;
+    util::HandoffListener handoff_listener_;
+    std::jthread thread_;
+};
+
+// Работа, полученная новым процессом: соединение со старым процессом для подтверждения и слушающий сокет
+struct Takeover {
+    util::HandoffChannel channel;
+    int listen_socket = -1;
+};
+
+// Новый процесс: забирает работу у старого, если тот слушает socket_path, и восстанавливает состояние
+// из полученной копии. Возвращает nullopt, если старого процесса нет. Подтверждение отправляется,
+// когда новый процесс начал принимать соединения.
+std::optional<Takeover> TakeOver(const std::filesystem::path& socket_path,
+                                 serialization::AppSerializator& serializator);
+
+}  // namespace handoff
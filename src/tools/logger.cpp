@@ -64,4 +64,11 @@ void LogError(beast::error_code ec, std::string_view where) {
                             << LogMsg::ERROR;
 }
 
+void LogHandoff(std::string_view text) {
+    boost::json::object data;
+    data.emplace(LogField::TEXT, text);
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, data)
+                            << LogMsg::HANDOFF;
+}
+
 } //namespace server_logging
\ No newline at end of file
@@ -53,6 +53,7 @@ struct LogMsg {
     static constexpr std::string_view WRITE         = "write"sv;
     static constexpr std::string_view ACCEPT        = "accept"sv;
     static constexpr std::string_view ERROR         = "error"sv;
+    static constexpr std::string_view HANDOFF       = "handoff"sv;
 };
 
 BOOST_LOG_ATTRIBUTE_KEYWORD(additional_data, "AdditionalData", json::value)
@@ -70,6 +71,9 @@ void LogStop(const std::exception& e);
 
 void LogError(beast::error_code ec, std::string_view where);
 
+// Этап передачи работы между старым и новым процессом сервера
+void LogHandoff(std::string_view text);
+
 template<class RequestHandler>
 class LoggingRequestHandler {
 public:
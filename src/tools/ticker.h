@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../metrics/metrics.h"
+
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
@@ -7,6 +9,7 @@
 #include <chrono>
 #include <functional>
 #include <memory>
+#include <optional>
 
 namespace {
 
@@ -18,23 +21,34 @@ public:
     using Strand = net::strand<net::io_context::executor_type>;
     using Handler = std::function<void(std::chrono::milliseconds delta)>;
 
-    // Функция handler будет вызываться внутри strand с интервалом period
-    Ticker(Strand strand, std::chrono::milliseconds period, Handler handler)
+    // Функция handler будет вызываться внутри strand с интервалом period.
+    // Сроки тиков отсчитываются от запуска, а не от окончания предыдущего обработчика,
+    // поэтому время работы обработчика не накапливается в отставание.
+    Ticker(Strand strand, std::chrono::milliseconds period, Handler handler, metrics::Registry* registry = nullptr)
         : strand_{strand}
         , period_{period}
         , handler_{std::move(handler)} {
+        if (registry) {
+            metrics_.emplace(*registry);
+        }
     }
 
     void Start() {
         net::dispatch(strand_, [self = shared_from_this()] {
             self->last_tick_ = Clock::now();
+            self->deadline_ = self->last_tick_ + self->period_;
             self->ScheduleTick();
         });
     }
 
+    // Новый период действует со следующего срока. Вызывается в strand.
+    void SetPeriod(std::chrono::milliseconds period) {
+        period_ = period;
+    }
+
 private:
     void ScheduleTick() {
-        timer_.expires_after(period_);
+        timer_.expires_at(deadline_);
         timer_.async_wait([self = shared_from_this()](sys::error_code ec) {
             self->OnTick(ec);
         });
@@ -44,13 +58,28 @@ private:
         using namespace std::chrono;
 
         if (!ec) {
-            auto this_tick = Clock::now();
-            auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
-            last_tick_ = this_tick;
+            const auto this_tick = Clock::now();
+            // Остаток от округления до миллисекунд переходит в следующий тик. Если тик запоздал,
+            // модель разбивает длинный интервал на несколько шагов.
+            const auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
+            last_tick_ += delta;
             try {
                 handler_(delta);
             } catch (...) {
             }
+            const auto now = Clock::now();
+            if (metrics_) {
+                metrics_->OnTick(this_tick - deadline_, now - this_tick);
+            }
+            deadline_ += period_;
+            if (deadline_ <= now) {
+                // Пропущенные сроки не догоняются отдельными тиками: их время войдёт в следующий тик
+                const auto missed = (now - deadline_) / period_ + 1;
+                deadline_ += missed * period_;
+                if (metrics_) {
+                    metrics_->missed_deadlines.Add(missed);
+                }
+            }
             ScheduleTick();
         }
     }
@@ -61,7 +90,9 @@ private:
     std::chrono::milliseconds period_;
     net::steady_timer timer_{strand_};
     Handler handler_;
-    std::chrono::steady_clock::time_point last_tick_;
+    std::optional<metrics::TickMetrics> metrics_;
+    Clock::time_point last_tick_;
+    Clock::time_point deadline_;
 };
 
-} //namespace
\ No newline at end of file
+} //namespace
@@ -0,0 +1,137 @@
+#include "durable_file.h"
+
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace util {
+
+using namespace std::literals;
+
+#ifdef __linux__
+
+namespace {
+
+[[noreturn]] void ThrowSystemError(std::string_view action, const std::filesystem::path& path) {
+    throw std::system_error(errno, std::generic_category(), std::string{action}.append(path.string()));
+}
+
+void WriteAll(int fd, std::string_view data, const std::filesystem::path& path) {
+    while (!data.empty()) {
+        const auto written = ::write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("Failed to write "sv, path);
+        }
+        data.remove_prefix(written);
+    }
+}
+
+}  // namespace
+
+void WriteFileDurably(const std::filesystem::path& path, std::string_view data) {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ThrowSystemError("Failed to open "sv, path);
+    }
+    try {
+        WriteAll(fd, data, path);
+        if (::fsync(fd) != 0) {
+            ThrowSystemError("Failed to sync "sv, path);
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+}
+
+void SyncDirectory(const std::filesystem::path& path) {
+    const auto dir = path.has_parent_path() ? path.parent_path() : std::filesystem::path{"."};
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+AppendFile::AppendFile(const std::filesystem::path& path)
+    : fd_{::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)}
+    , path_{path} {
+    if (fd_ < 0) {
+        ThrowSystemError("Failed to open "sv, path);
+    }
+}
+
+AppendFile::~AppendFile() {
+    ::close(fd_);
+}
+
+void AppendFile::Append(std::string_view data) {
+    WriteAll(fd_, data, path_);
+}
+
+void AppendFile::Sync() {
+    if (::fdatasync(fd_) != 0) {
+        ThrowSystemError("Failed to sync "sv, path_);
+    }
+}
+
+#else
+
+struct AppendFile::Stream {
+    std::ofstream out;
+};
+
+void WriteFileDurably(const std::filesystem::path& path, std::string_view data) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), data.size());
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("Failed to write "s + path.string());
+    }
+}
+
+void SyncDirectory(const std::filesystem::path&) {
+}
+
+AppendFile::AppendFile(const std::filesystem::path& path)
+    : stream_{new Stream{std::ofstream(path, std::ios::binary | std::ios::app)}}
+    , path_{path} {
+    if (!stream_->out) {
+        delete stream_;
+        throw std::runtime_error("Failed to open "s + path.string());
+    }
+}
+
+AppendFile::~AppendFile() {
+    delete stream_;
+}
+
+void AppendFile::Append(std::string_view data) {
+    stream_->out.write(data.data(), data.size());
+    if (!stream_->out) {
+        throw std::runtime_error("Failed to write "s + path_.string());
+    }
+}
+
+void AppendFile::Sync() {
+    stream_->out.flush();
+    if (!stream_->out) {
+        throw std::runtime_error("Failed to write "s + path_.string());
+    }
+}
+
+#endif
+
+}  // namespace util
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace util {
+
+// Записывает файл целиком и дожидается, пока данные окажутся на диске.
+// Бросает std::system_error или std::runtime_error при ошибке.
+void WriteFileDurably(const std::filesystem::path& path, std::string_view data);
+
+// Сбрасывает на диск каталог файла, чтобы создание, переименование и удаление файла пережили сбой питания
+void SyncDirectory(const std::filesystem::path& path);
+
+// Файл, открытый на дозапись. Данные попадают на диск после Sync.
+class AppendFile {
+public:
+    explicit AppendFile(const std::filesystem::path& path);
+
+    AppendFile(const AppendFile&) = delete;
+    AppendFile& operator=(const AppendFile&) = delete;
+
+    ~AppendFile();
+
+    void Append(std::string_view data);
+
+    void Sync();
+
+private:
+#ifdef __linux__
+    int fd_ = -1;
+#else
+    struct Stream;
+    Stream* stream_ = nullptr;
+#endif
+    std::filesystem::path path_;
+};
+
+}  // namespace util
@@ -0,0 +1,304 @@
+#include "handoff_channel.h"
+
+#include <boost/endian/conversion.hpp>
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace util {
+
+using namespace std::literals;
+
+namespace {
+
+// Заголовок: сигнатура, версия формата и размер снимка (слова little-endian)
+constexpr size_t HEADER_SIZE = HandoffChannel::SIGNATURE.size() + 2 * sizeof(uint64_t);
+constexpr char ACKNOWLEDGE = 'A';
+
+}  // namespace
+
+#ifdef __linux__
+
+namespace {
+
+[[noreturn]] void ThrowSystemError(std::string_view action) {
+    throw std::system_error(errno, std::generic_category(), std::string{action});
+}
+
+sockaddr_un MakeAddress(const std::filesystem::path& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const auto& name = path.native();
+    if (name.empty() || name.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Invalid handoff socket path "s + name);
+    }
+    std::memcpy(address.sun_path, name.data(), name.size());
+    return address;
+}
+
+void SendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        // MSG_NOSIGNAL: если другой процесс завершился, send возвращает EPIPE вместо сигнала SIGPIPE
+        const auto sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("Failed to send handoff data"sv);
+        }
+        data.remove_prefix(sent);
+    }
+}
+
+void ReceiveAll(int fd, char* data, size_t size) {
+    while (size != 0) {
+        const auto received = ::recv(fd, data, size, 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("Failed to receive handoff data"sv);
+        }
+        if (received == 0) {
+            throw std::runtime_error("Handoff connection closed by the old process"s);
+        }
+        data += received;
+        size -= received;
+    }
+}
+
+bool PollReadable(int fd, std::chrono::milliseconds timeout) {
+    pollfd item{fd, POLLIN, 0};
+    const int result = ::poll(&item, 1, static_cast<int>(timeout.count()));
+    if (result < 0 && errno != EINTR) {
+        ThrowSystemError("Failed to poll handoff socket"sv);
+    }
+    return result > 0;
+}
+
+}  // namespace
+
+std::optional<HandoffChannel> HandoffChannel::Connect(const std::filesystem::path& path) {
+    const auto address = MakeAddress(path);
+    HandoffChannel channel{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    if (channel.fd_ < 0) {
+        ThrowSystemError("Failed to create handoff socket"sv);
+    }
+    if (::connect(channel.fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        // Файла сокета нет или его оставил завершившийся процесс
+        if (errno == ENOENT || errno == ECONNREFUSED) {
+            return std::nullopt;
+        }
+        ThrowSystemError("Failed to connect to "s + path.string());
+    }
+    return channel;
+}
+
+HandoffChannel::~HandoffChannel() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void HandoffChannel::Send(int socket, std::string_view snapshot) {
+    std::array<char, HEADER_SIZE> header;
+    std::memcpy(header.data(), SIGNATURE.data(), SIGNATURE.size());
+    const uint64_t words[] = {
+        boost::endian::native_to_little(FORMAT_VERSION),
+        boost::endian::native_to_little(static_cast<uint64_t>(snapshot.size()))
+    };
+    std::memcpy(header.data() + SIGNATURE.size(), words, sizeof(words));
+
+    // Дескриптор передаётся вместе с заголовком, поэтому получатель находит его при чтении первого байта
+    iovec part{header.data(), header.size()};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* item = CMSG_FIRSTHDR(&message);
+    item->cmsg_level = SOL_SOCKET;
+    item->cmsg_type = SCM_RIGHTS;
+    item->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(item), &socket, sizeof(int));
+
+    ssize_t sent;
+    while ((sent = ::sendmsg(fd_, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR) {
+    }
+    if (sent < 0) {
+        ThrowSystemError("Failed to send listening socket"sv);
+    }
+    SendAll(fd_, std::string_view{header.data(), header.size()}.substr(sent));
+    SendAll(fd_, snapshot);
+}
+
+HandoffChannel::Transfer HandoffChannel::Receive() {
+    std::array<char, HEADER_SIZE> header;
+    iovec part{header.data(), header.size()};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t received;
+    while ((received = ::recvmsg(fd_, &message, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {
+    }
+    if (received < 0) {
+        ThrowSystemError("Failed to receive listening socket"sv);
+    }
+    if (received == 0) {
+        throw std::runtime_error("Handoff connection closed by the old process"s);
+    }
+    Transfer transfer;
+    for (cmsghdr* item = CMSG_FIRSTHDR(&message); item; item = CMSG_NXTHDR(&message, item)) {
+        if (item->cmsg_level == SOL_SOCKET && item->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&transfer.socket, CMSG_DATA(item), sizeof(int));
+        }
+    }
+    // Дальше дескриптор принадлежит transfer, а transfer - вызывающему, поэтому при ошибке его нужно закрыть
+    try {
+        if (transfer.socket < 0 || (message.msg_flags & MSG_CTRUNC)) {
+            throw std::runtime_error("Handoff message carries no listening socket"s);
+        }
+        ReceiveAll(fd_, header.data() + received, header.size() - received);
+        if (std::string_view{header.data(), SIGNATURE.size()} != SIGNATURE) {
+            throw std::runtime_error("Not a handoff message"s);
+        }
+        uint64_t words[2];
+        std::memcpy(words, header.data() + SIGNATURE.size(), sizeof(words));
+        const auto version = boost::endian::little_to_native(words[0]);
+        if (version > FORMAT_VERSION) {
+            throw std::runtime_error("Unsupported handoff format version "s + std::to_string(version));
+        }
+        transfer.snapshot.resize(boost::endian::little_to_native(words[1]));
+        ReceiveAll(fd_, transfer.snapshot.data(), transfer.snapshot.size());
+    } catch (...) {
+        if (transfer.socket >= 0) {
+            ::close(transfer.socket);
+        }
+        throw;
+    }
+    return transfer;
+}
+
+void HandoffChannel::Acknowledge() {
+    SendAll(fd_, std::string_view{&ACKNOWLEDGE, 1});
+}
+
+bool HandoffChannel::Poll(std::chrono::milliseconds timeout) {
+    return PollReadable(fd_, timeout);
+}
+
+bool HandoffChannel::ReadAcknowledge() {
+    char reply = 0;
+    ssize_t received;
+    while ((received = ::recv(fd_, &reply, 1, 0)) < 0 && errno == EINTR) {
+    }
+    return received == 1 && reply == ACKNOWLEDGE;
+}
+
+HandoffListener::HandoffListener(const std::filesystem::path& path) {
+    const auto address = MakeAddress(path);
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        ThrowSystemError("Failed to create handoff socket"sv);
+    }
+    // Файл сокета прежнего процесса больше не нужен: тот либо завершился, либо уже передал работу
+    ::unlink(path.c_str());
+    if (::bind(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        || ::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0
+        || ::listen(fd_, 1) != 0) {
+        const int error = errno;
+        ::close(fd_);
+        throw std::system_error(error, std::generic_category(), "Failed to listen on "s + path.string());
+    }
+}
+
+HandoffListener::~HandoffListener() {
+    ::close(fd_);
+}
+
+std::optional<HandoffChannel> HandoffListener::Accept(std::chrono::milliseconds timeout) {
+    if (!PollReadable(fd_, timeout)) {
+        return std::nullopt;
+    }
+    const int fd = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED) {
+            return std::nullopt;
+        }
+        ThrowSystemError("Failed to accept handoff connection"sv);
+    }
+    return HandoffChannel{fd};
+}
+
+#else
+
+std::optional<HandoffChannel> HandoffChannel::Connect(const std::filesystem::path&) {
+    throw std::runtime_error("Handoff is supported only on Linux"s);
+}
+
+HandoffChannel::~HandoffChannel() = default;
+
+void HandoffChannel::Send(int, std::string_view) {
+}
+
+HandoffChannel::Transfer HandoffChannel::Receive() {
+    return {};
+}
+
+void HandoffChannel::Acknowledge() {
+}
+
+bool HandoffChannel::Poll(std::chrono::milliseconds) {
+    return false;
+}
+
+bool HandoffChannel::ReadAcknowledge() {
+    return false;
+}
+
+HandoffListener::HandoffListener(const std::filesystem::path&) {
+    throw std::runtime_error("Handoff is supported only on Linux"s);
+}
+
+HandoffListener::~HandoffListener() = default;
+
+std::optional<HandoffChannel> HandoffListener::Accept(std::chrono::milliseconds) {
+    return std::nullopt;
+}
+
+#endif
+
+HandoffChannel::HandoffChannel(int fd) noexcept
+    : fd_{fd} {
+}
+
+HandoffChannel::HandoffChannel(HandoffChannel&& other) noexcept
+    : fd_{std::exchange(other.fd_, -1)} {
+}
+
+HandoffChannel& HandoffChannel::operator=(HandoffChannel&& other) noexcept {
+    if (this != &other) {
+        HandoffChannel old{std::move(*this)};
+        fd_ = std::exchange(other.fd_, -1);
+    }
+    return *this;
+}
+
+}  // namespace util
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+// Соединение Unix-сокета между старым и новым процессом сервера при перезапуске без простоя.
+// Старый процесс одним сообщением передаёт заголовок и дескриптор слушающего сокета (SCM_RIGHTS),
+// затем снимок состояния. Новый процесс отвечает подтверждением, когда начал принимать соединения.
+// Бросает std::system_error или std::runtime_error при ошибке.
+class HandoffChannel {
+public:
+    static constexpr std::string_view SIGNATURE = "DGHNDOF\n";
+    static constexpr uint64_t FORMAT_VERSION = 1;
+
+    // Полученные от старого процесса слушающий сокет (владение переходит получателю) и снимок состояния
+    struct Transfer {
+        int socket = -1;
+        std::string snapshot;
+    };
+
+    // Подключается к старому процессу. Возвращает nullopt, если никто не слушает path (первый запуск).
+    static std::optional<HandoffChannel> Connect(const std::filesystem::path& path);
+
+    explicit HandoffChannel(int fd) noexcept;
+
+    HandoffChannel(HandoffChannel&& other) noexcept;
+    HandoffChannel& operator=(HandoffChannel&& other) noexcept;
+
+    ~HandoffChannel();
+
+    // Старый процесс: передаёт копию дескриптора socket и снимок
+    void Send(int socket, std::string_view snapshot);
+
+    // Новый процесс
+    Transfer Receive();
+
+    // Новый процесс: сообщает, что принимает соединения
+    void Acknowledge();
+
+    // Ждёт, пока из соединения можно читать. Возвращает false по истечении timeout.
+    bool Poll(std::chrono::milliseconds timeout);
+
+    // Старый процесс: true, если получено подтверждение, false, если новый процесс закрыл соединение без него
+    bool ReadAcknowledge();
+
+private:
+    int fd_ = -1;
+};
+
+// Слушающий Unix-сокет старого процесса. Файл сокета создаётся с правами 0600 вместо прежнего
+// и не удаляется при закрытии: к этому времени его может занять уже новый процесс.
+class HandoffListener {
+public:
+    explicit HandoffListener(const std::filesystem::path& path);
+
+    HandoffListener(const HandoffListener&) = delete;
+    HandoffListener& operator=(const HandoffListener&) = delete;
+
+    ~HandoffListener();
+
+    // Ждёт подключения нового процесса не дольше timeout
+    std::optional<HandoffChannel> Accept(std::chrono::milliseconds timeout);
+
+private:
+    int fd_ = -1;
+};
+
+}  // namespace util
@@ -0,0 +1,72 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+namespace util {
+
+using namespace std::literals;
+
+#ifdef __linux__
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open "s + path.string());
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) != 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Failed to stat "s + path.string());
+    }
+    const auto size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return;
+    }
+    void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    const int error = errno;
+    // Отображение остаётся действительным после закрытия файла
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "Failed to map "s + path.string());
+    }
+    // Файл читается целиком: ядро начинает упреждающее чтение сразу
+    ::madvise(address, size, MADV_WILLNEED);
+    data_ = {static_cast<const char*>(address), size};
+}
+
+MappedFile::~MappedFile() {
+    if (!data_.empty()) {
+        ::munmap(const_cast<char*>(data_.data()), data_.size());
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open "s + path.string());
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data_ = buffer_;
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
+
+}  // namespace util
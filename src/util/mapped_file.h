@@ -0,0 +1,33 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+// Файл, отображённый в память только для чтения. Страницы читаются с диска при первом обращении,
+// поэтому файл в несколько гигабайт не копируется в память процесса целиком.
+// Бросает std::system_error или std::runtime_error, если файл не удалось открыть.
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    // Действительно, пока существует объект
+    std::string_view GetData() const noexcept {
+        return data_;
+    }
+
+private:
+    std::string_view data_;
+#ifndef __linux__
+    std::string buffer_;
+#endif
+};
+
+}  // namespace util
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace util {
+
+// Неограниченная очередь без блокировок для нескольких производителей и одного потребителя
+// (интрузивная очередь Д. Вьюкова). Push можно вызывать из любого потока, TryPop - только из потока потребителя.
+// Пока производитель не завершил Push, его элемент и следующие за ним могут быть не видны потребителю:
+// TryPop вернёт nullopt, и элементы будут получены при следующем вызове.
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() = default;
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue() {
+        while (TryPop()) {
+        }
+    }
+
+    void Push(T value) {
+        PushNode(new Node{std::move(value)});
+    }
+
+    std::optional<T> TryPop() {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        // Заглушка не хранит значения, её пропускаем
+        if (tail == &stub_) {
+            if (!next) {
+                return std::nullopt;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return Take(tail);
+        }
+        if (tail != head_.load(std::memory_order_acquire)) {
+            // Производитель уже поместил новый элемент в голову, но ещё не связал его с tail
+            return std::nullopt;
+        }
+        // tail - последний элемент. Чтобы забрать его, за ним ставится заглушка.
+        stub_.next.store(nullptr, std::memory_order_relaxed);
+        PushNode(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return Take(tail);
+        }
+        return std::nullopt;
+    }
+
+private:
+    struct Node {
+        Node() = default;
+
+        explicit Node(T value)
+            : value{std::move(value)} {
+        }
+
+        std::atomic<Node*> next{nullptr};
+        std::optional<T> value;
+    };
+
+    void PushNode(Node* node) noexcept {
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    static std::optional<T> Take(Node* node) {
+        std::optional<T> value{std::move(node->value)};
+        delete node;
+        return value;
+    }
+
+    Node stub_;
+    // Производители добавляют элементы в голову, потребитель забирает из хвоста
+    std::atomic<Node*> head_{&stub_};
+    Node* tail_ = &stub_;
+};
+
+}  // namespace util
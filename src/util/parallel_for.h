@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+// Вызывает fn(index) для каждого index из [0, count) в нескольких потоках, включая вызывающий.
+// Первое исключение из fn пробрасывается после завершения всех потоков, оставшиеся индексы не обрабатываются.
+template <typename Fn>
+void ParallelFor(size_t count, const Fn& fn, size_t thread_count = std::thread::hardware_concurrency()) {
+    thread_count = std::clamp<size_t>(thread_count, 1, std::max<size_t>(count, 1));
+    std::atomic<size_t> next{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    const auto run = [&] {
+        for (size_t index = next++; index < count; index = next++) {
+            try {
+                fn(index);
+            } catch (...) {
+                std::lock_guard lock{error_mutex};
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = count;
+            }
+        }
+    };
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(thread_count - 1);
+        for (size_t i = 1; i < thread_count; ++i) {
+            workers.emplace_back(run);
+        }
+        run();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}  // namespace util
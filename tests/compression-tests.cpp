@@ -0,0 +1,115 @@
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/http/compression.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace std::literals;
+using namespace http_handler;
+
+namespace {
+
+std::string Decompress(const std::string& data, ContentEncoding encoding) {
+    namespace io = boost::iostreams;
+    io::filtering_istream stream;
+    if (encoding == ContentEncoding::GZIP) {
+        stream.push(io::gzip_decompressor());
+    } else {
+        stream.push(io::zlib_decompressor());
+    }
+    std::istringstream input(data);
+    stream.push(input);
+    std::ostringstream output;
+    io::copy(stream, output);
+    return output.str();
+}
+
+std::string MakeText(size_t size) {
+    std::string text;
+    while (text.size() < size) {
+        text += R"({"pos":[1.5E0,2.5E0],"speed":[0E0,0E0],"dir":"U"},)"s;
+    }
+    return text;
+}
+
+}  // namespace
+
+SCENARIO("Content encoding negotiation") {
+    CHECK(ChooseContentEncoding(""sv) == ContentEncoding::IDENTITY);
+    CHECK(ChooseContentEncoding("gzip"sv) == ContentEncoding::GZIP);
+    CHECK(ChooseContentEncoding("deflate, gzip"sv) == ContentEncoding::GZIP);
+    CHECK(ChooseContentEncoding("deflate"sv) == ContentEncoding::DEFLATE);
+    CHECK(ChooseContentEncoding("gzip;q=0.5, deflate"sv) == ContentEncoding::DEFLATE);
+    CHECK(ChooseContentEncoding("gzip;q=0, br"sv) == ContentEncoding::IDENTITY);
+    CHECK(ChooseContentEncoding("br, *"sv) == ContentEncoding::GZIP);
+    CHECK(ChooseContentEncoding("gzip;q=0, *"sv) == ContentEncoding::DEFLATE);
+    CHECK(ChooseContentEncoding("*, gzip;q=0"sv) == ContentEncoding::DEFLATE);
+    CHECK(ChooseContentEncoding("*;q=0.5, deflate"sv) == ContentEncoding::DEFLATE);
+    CHECK(ChooseContentEncoding("gzip;q=0, deflate;q=0, *"sv) == ContentEncoding::IDENTITY);
+    CHECK(ChooseContentEncoding("GZip"sv) == ContentEncoding::GZIP);
+}
+
+SCENARIO("Response compression") {
+    GIVEN("a compressor with threshold") {
+        ResponseCompressor compressor{CompressionConfig{.level = 6, .min_size = 100}};
+
+        THEN("small bodies and clients without Accept-Encoding are not compressed") {
+            CHECK(compressor.Choose("gzip"sv, 99) == ContentEncoding::IDENTITY);
+            CHECK(compressor.Choose(""sv, 1000) == ContentEncoding::IDENTITY);
+            CHECK(compressor.Choose("gzip"sv, 100) == ContentEncoding::GZIP);
+        }
+
+        WHEN("a response is compressed") {
+            const std::string text = MakeText(10000);
+            for (auto encoding : {ContentEncoding::GZIP, ContentEncoding::DEFLATE}) {
+                http::response<http::string_body> response{http::status::ok, 11};
+                response.set(http::field::vary, "Accept"sv);
+                response.body() = text;
+                response.prepare_payload();
+                compressor.CompressResponse(response, encoding);
+
+                INFO("encoding: " << ToString(encoding));
+                CHECK(response[http::field::content_encoding] == ToString(encoding));
+                CHECK(response[http::field::vary] == "Accept, Accept-Encoding"sv);
+                CHECK(response[http::field::content_length] == std::to_string(response.body().size()));
+                CHECK(response.body().size() < text.size());
+                CHECK(Decompress(response.body(), encoding) == text);
+            }
+        }
+
+        WHEN("a static file is compressed") {
+            const auto path = fs::temp_directory_path() / "compression_tests_file.js";
+            const std::string text = MakeText(5000);
+            {
+                std::ofstream file(path, std::ios::binary);
+                file << text;
+            }
+            auto first = compressor.GetCompressedFile(path, ContentEncoding::GZIP);
+            auto second = compressor.GetCompressedFile(path, ContentEncoding::GZIP);
+
+            THEN("it is compressed once and cached") {
+                CHECK(first == second);
+                CHECK(Decompress(*first, ContentEncoding::GZIP) == text);
+            }
+
+            THEN("the response shares the cached body instead of copying it") {
+                http::response<SharedStringBody> response{http::status::ok, 11};
+                response.body() = first;
+                response.prepare_payload();
+                CHECK(response.body().get() == first.get());
+                CHECK(response[http::field::content_length] == std::to_string(first->size()));
+
+                std::ostringstream out;
+                out << response;
+                const auto message = out.str();
+                CHECK(message.substr(message.find("\r\n\r\n"sv) + 4) == *first);
+            }
+            fs::remove(path);
+        }
+    }
+}
@@ -0,0 +1,289 @@
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/db/in_memory.h"
+#include "../src/model/model_serialization.h"
+#include "../src/tools/handoff.h"
+#include "../src/util/handoff_channel.h"
+#include "test-game.h"
+#include "ws-test-client.h"
+
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace std::literals;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+namespace {
+
+std::filesystem::path GetSocketPath() {
+    return std::filesystem::temp_directory_path() / "handoff_test.sock";
+}
+
+// Слушающий сокет вместо Listener: передаче работы нужны только пауза и дескриптор
+class FakeListener : public http_server::ListenerBase {
+public:
+    explicit FakeListener(net::io_context& ioc)
+        : acceptor_{ioc, {net::ip::address_v4::loopback(), 0}} {
+    }
+
+    std::future<void> Pause() override {
+        paused_ = true;
+        std::promise<void> paused;
+        paused.set_value();
+        return paused.get_future();
+    }
+
+    void Resume() override {
+        paused_ = false;
+    }
+
+    tcp::acceptor::native_handle_type GetNativeHandle() override {
+        return acceptor_.native_handle();
+    }
+
+    bool IsPaused() const noexcept {
+        return paused_;
+    }
+
+private:
+    tcp::acceptor acceptor_;
+    std::atomic<bool> paused_{false};
+};
+
+}  // namespace
+
+SCENARIO("Handoff channel") {
+    const auto path = GetSocketPath();
+
+    GIVEN("no running server") {
+        std::filesystem::remove(path);
+        THEN("the new process starts on its own") {
+            CHECK_FALSE(util::HandoffChannel::Connect(path));
+        }
+    }
+
+    GIVEN("an old process listening on the handoff socket") {
+        util::HandoffListener handoff_listener{path};
+        CHECK((std::filesystem::status(path).permissions() & std::filesystem::perms::group_all)
+              == std::filesystem::perms::none);
+
+        net::io_context ioc;
+        tcp::acceptor acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        const std::string snapshot(3'000'000, 'x');
+
+        WHEN("a new process connects") {
+            // Старый процесс: проверки Catch выполняются только в основном потоке
+            auto old_side = std::async(std::launch::async, [&] {
+                auto channel = handoff_listener.Accept(5s);
+                if (!channel) {
+                    return false;
+                }
+                channel->Send(acceptor.native_handle(), snapshot);
+                return channel->Poll(5s) && channel->ReadAcknowledge();
+            });
+            auto channel = util::HandoffChannel::Connect(path);
+            REQUIRE(channel);
+            auto transfer = channel->Receive();
+
+            THEN("it receives the listening socket and the snapshot") {
+                CHECK(transfer.snapshot == snapshot);
+                tcp::acceptor received{ioc, tcp::v4(), transfer.socket};
+                CHECK(received.local_endpoint() == acceptor.local_endpoint());
+
+                // Соединение из очереди сокета принимает новый процесс
+                tcp::socket client{ioc};
+                client.connect(acceptor.local_endpoint());
+                CHECK_NOTHROW(received.accept());
+
+                channel->Acknowledge();
+                CHECK(old_side.get());
+            }
+
+            THEN("the old process notices a new process that exits without acknowledgement") {
+                tcp::acceptor received{ioc, tcp::v4(), transfer.socket};
+                channel.reset();
+                CHECK_FALSE(old_side.get());
+            }
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+SCENARIO("State handoff") {
+    const auto path = std::filesystem::temp_directory_path() / "handoff_state_test.txt";
+    std::filesystem::remove(path);
+
+    GIVEN("an application with players") {
+        auto game = test_game::MakeGame(10, 60000);
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto token = app.JoinPlayer(model::Map::Id{"map1"s}, "Pluto"s)->first;
+        app.JoinPlayer(model::Map::Id{"map1"s}, "Goofy"s);
+        app.Tick(100ms);
+        app.Tick(100ms);
+        serialization::AppSerializator serializator(app, game, path.string(), true);
+
+        WHEN("the state is handed off") {
+            const auto snapshot = serializator.HandOff();
+
+            THEN("the new process restores it") {
+                auto restored_game = test_game::MakeGame();
+                app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+                serialization::AppSerializator loader(restored_app, restored_game, path.string(), true);
+                loader.RestoreFrom(snapshot);
+                const auto* session = restored_game.GetGameSessionByMapId(model::Map::Id{"map1"s});
+                CHECK(session->GetDogs().size() == 2);
+                CHECK(restored_app.FindPlayerMap(token));
+
+                // Клиенты продолжают получать изменения в нумерации тиков старого процесса
+                CHECK(session->GetTickSeq() == 2);
+                CHECK(session->GetChangesSince(2));
+                CHECK_FALSE(session->GetChangesSince(1));
+            }
+
+            THEN("the old process does not overwrite the state file") {
+                serializator.Serialize();
+                CHECK(serializator.SerializeInBackground());
+                serializator.Wait();
+                CHECK_FALSE(std::filesystem::exists(path));
+            }
+
+            AND_WHEN("the handoff is cancelled") {
+                serializator.CancelHandOff();
+                serializator.Wait();
+                THEN("the state is saved again") {
+                    CHECK(std::filesystem::exists(path));
+                }
+            }
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+SCENARIO("Suspended ticks") {
+    GIVEN("a moving dog") {
+        auto game = test_game::MakeGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto [token, dog_id] = *app.JoinPlayer(model::Map::Id{"map1"s}, "Pluto"s);
+        app.MovePlayer(token, model::Dog::Direction::EAST);
+        const auto* dog = game.GetGameSessionByMapId(model::Map::Id{"map1"s})->GetDogById(dog_id);
+        const auto position = dog->GetCoorginates();
+
+        WHEN("ticks are suspended") {
+            app.SetTicksSuspended(true);
+            app.Tick(1s);
+            THEN("the dog stays in place") {
+                CHECK(dog->GetCoorginates().x == position.x);
+            }
+
+            AND_WHEN("ticks are resumed") {
+                app.SetTicksSuspended(false);
+                app.Tick(1s);
+                THEN("the dog moves again") {
+                    CHECK(dog->GetCoorginates().x > position.x);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Handoff server") {
+    const auto socket_path = std::filesystem::temp_directory_path() / "handoff_server_test.sock";
+    const auto old_path = std::filesystem::temp_directory_path() / "handoff_server_old.txt";
+    const auto new_path = std::filesystem::temp_directory_path() / "handoff_server_new.txt";
+
+    GIVEN("a running server with a WebSocket player") {
+        auto game = test_game::MakeGame(10, 60000);
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto [token, dog_id] = *app.JoinPlayer(model::Map::Id{"map1"s}, "Pluto"s);
+        serialization::AppSerializator serializator(app, game, old_path.string(), true);
+        net::io_context ioc;
+        auto strands = std::make_shared<http_handler::SessionStrands>(ioc, app, net::make_strand(ioc));
+        auto ws_hub = std::make_shared<http_handler::WsHub>(app, strands);
+        auto sse_hub = std::make_shared<http_handler::SseHub>(app, strands, 1);
+        auto listener = std::make_shared<FakeListener>(ioc);
+        auto connections = std::make_shared<http_server::Connections>();
+        tcp::acceptor ws_acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        ws_test::WsClient client{ioc, ws_acceptor, *ws_hub, *token};
+        REQUIRE(client.Read());
+        std::atomic<bool> completed = false;
+        const auto start_handoff_server = [&](std::chrono::milliseconds drain_timeout) {
+            return std::make_unique<handoff::HandoffServer>(
+                handoff::HandoffServer::Config{.socket_path = socket_path, .drain_timeout = drain_timeout},
+                app, serializator, nullptr, listener, connections, ws_hub, sse_hub, [&completed] {
+                    completed = true;
+                });
+        };
+
+        WHEN("a request does not finish before the drain timeout") {
+            auto handoff_server = start_handoff_server(100ms);
+            connections->OnRequestStarted();
+            auto channel = util::HandoffChannel::Connect(socket_path);
+            REQUIRE(channel);
+
+            THEN("the handoff is cancelled and the server keeps working") {
+                CHECK_THROWS(channel->Receive());
+                CHECK_FALSE(listener->IsPaused());
+                CHECK_FALSE(connections->IsDraining());
+                CHECK_FALSE(ws_hub->IsDraining());
+                CHECK_FALSE(completed);
+
+                ws_test::WsClient again{ioc, ws_acceptor, *ws_hub, *token};
+                REQUIRE(again.Read());
+                again.Send(R"({"move": "R"})"sv);
+                REQUIRE(ws_test::RunUntil(ioc, [&] {
+                    return app.GetSnapshot(token)->state.players.front().dir == model::Dog::Direction::EAST;
+                }));
+                const auto* dog = game.GetGameSessionByMapId(model::Map::Id{"map1"s})->GetDogById(dog_id);
+                const auto position = dog->GetCoorginates();
+                app.Tick(1s);
+                CHECK(dog->GetCoorginates().x > position.x);
+            }
+            connections->OnRequestFinished();
+        }
+
+        WHEN("a player action waits in the session strand when a new process connects") {
+            auto handoff_server = start_handoff_server(5s);
+            client.Send(R"({"move": "R"})"sv);
+            REQUIRE(ws_test::RunUntil(ioc, [&] { return ws_hub->GetPendingActions() != 0; }));
+
+            auto restored_game = test_game::MakeGame();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            serialization::AppSerializator loader(restored_app, restored_game, new_path.string(), true);
+            // Новый процесс: проверки Catch выполняются только в основном потоке
+            auto new_process = std::async(std::launch::async, [&] {
+                auto takeover = handoff::TakeOver(socket_path, loader);
+                if (!takeover) {
+                    return false;
+                }
+                net::io_context new_ioc;
+                tcp::acceptor received{new_ioc, tcp::v4(), takeover->listen_socket};
+                takeover->channel.Acknowledge();
+                return true;
+            });
+
+            THEN("the snapshot is taken after the action and the player is sent to the new process") {
+                CHECK(new_process.wait_for(500ms) == std::future_status::timeout);
+                CHECK(listener->IsPaused());
+                REQUIRE(ws_test::RunUntil(ioc, [&] {
+                    return new_process.wait_for(0s) == std::future_status::ready;
+                }));
+                REQUIRE(new_process.get());
+                REQUIRE(ws_test::RunUntil(ioc, [&] { return completed.load(); }));
+
+                const auto* dog = restored_game.GetGameSessionByMapId(model::Map::Id{"map1"s})->GetDogById(dog_id);
+                REQUIRE(dog);
+                CHECK(dog->GetDirection() == model::Dog::Direction::EAST);
+                CHECK_FALSE(client.Read());
+                CHECK(client.GetCloseCode() == ws_test::websocket::close_code::going_away);
+            }
+        }
+    }
+    std::filesystem::remove(old_path);
+    std::filesystem::remove(new_path);
+}
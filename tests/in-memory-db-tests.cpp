@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_container_properties.hpp>
+
+#include "../src/db/in_memory.h"
+
+#include <filesystem>
+
+using namespace std::literals;
+using namespace Catch::Matchers;
+
+namespace {
+
+app::RetiredPlayer MakePlayer(std::string name, size_t score, size_t play_time) {
+    return {app::RetiredPlayerId::New(), std::move(name), score, play_time};
+}
+
+void SavePlayers(app::UnitOfWorkFactory& factory, std::vector<app::RetiredPlayer> players) {
+    auto unit = factory.CreateUnitOfWork();
+    for (const auto& player : players) {
+        unit->PlayerRepository().Save(player);
+    }
+    unit->Commit();
+}
+
+std::vector<std::string> Names(const std::vector<app::RetiredPlayer>& players) {
+    std::vector<std::string> names;
+    for (const auto& player : players) {
+        names.push_back(player.GetName());
+    }
+    return names;
+}
+
+}  // namespace
+
+SCENARIO("In-memory retired players storage") {
+    GIVEN("In-memory unit of work factory") {
+        in_memory::UnitOfWorkFactoryImpl factory;
+
+        WHEN("players are saved without commit") {
+            {
+                auto unit = factory.CreateUnitOfWork();
+                unit->PlayerRepository().Save(MakePlayer("Rex"s, 10, 1000));
+            }
+            THEN("they are not visible") {
+                auto unit = factory.CreateUnitOfWork();
+                CHECK_THAT(unit->PlayerRepository().GetSavedRetiredPlayers(0, 100), IsEmpty());
+            }
+        }
+
+        WHEN("players are committed") {
+            SavePlayers(factory, {
+                MakePlayer("Bob"s, 10, 3000),
+                MakePlayer("Ann"s, 30, 5000),
+                MakePlayer("Cid"s, 10, 1000),
+                MakePlayer("Abe"s, 10, 1000),
+            });
+            THEN("they are ordered by score, play time and name") {
+                auto unit = factory.CreateUnitOfWork();
+                auto players = unit->PlayerRepository().GetSavedRetiredPlayers(0, 100);
+                CHECK(Names(players) == std::vector{"Ann"s, "Abe"s, "Cid"s, "Bob"s});
+            }
+            THEN("offset and limit are applied") {
+                auto unit = factory.CreateUnitOfWork();
+                CHECK(Names(unit->PlayerRepository().GetSavedRetiredPlayers(1, 2)) == std::vector{"Abe"s, "Cid"s});
+                CHECK_THAT(unit->PlayerRepository().GetSavedRetiredPlayers(4, 2), IsEmpty());
+            }
+        }
+    }
+
+    GIVEN("In-memory factory with records file") {
+        const auto path = std::filesystem::temp_directory_path() / "in_memory_db_tests_records.txt";
+        std::filesystem::remove(path);
+        {
+            in_memory::UnitOfWorkFactoryImpl factory{path};
+            SavePlayers(factory, {MakePlayer("Old \"Dog\""s, 5, 100), MakePlayer("Pluto"s, 7, 200)});
+        }
+        WHEN("factory is recreated") {
+            in_memory::UnitOfWorkFactoryImpl factory{path};
+            THEN("committed players are restored") {
+                auto unit = factory.CreateUnitOfWork();
+                auto players = unit->PlayerRepository().GetSavedRetiredPlayers(0, 100);
+                REQUIRE_THAT(players, SizeIs(2));
+                CHECK(players[0].GetName() == "Pluto"s);
+                CHECK(players[1].GetName() == "Old \"Dog\""s);
+                CHECK(players[1].GetScore() == 5);
+                CHECK(players[1].PlayTime() == 100);
+            }
+        }
+        std::filesystem::remove(path);
+    }
+}
@@ -0,0 +1,101 @@
+#include <boost/json.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/json/json_writer.h"
+
+#include <limits>
+
+using namespace std::literals;
+using json_writer::JsonWriter;
+
+namespace {
+
+std::string WriteDouble(double value) {
+    std::string out;
+    JsonWriter{out}.Value(value);
+    return out;
+}
+
+std::string WriteString(std::string_view value) {
+    std::string out;
+    JsonWriter{out}.Value(value);
+    return out;
+}
+
+}  // namespace
+
+SCENARIO("JSON writer number formatting") {
+    GIVEN("double values") {
+        THEN("they are written in the boost::json format") {
+            CHECK(WriteDouble(0.) == "0E0"s);
+            CHECK(WriteDouble(-0.) == "-0E0"s);
+            CHECK(WriteDouble(1.) == "1E0"s);
+            CHECK(WriteDouble(1.5) == "1.5E0"s);
+            CHECK(WriteDouble(10.) == "1E1"s);
+            CHECK(WriteDouble(-0.25) == "-2.5E-1"s);
+            CHECK(WriteDouble(123.456) == "1.23456E2"s);
+            CHECK(WriteDouble(0.1) == "1E-1"s);
+            CHECK(WriteDouble(1e100) == "1E100"s);
+            CHECK(WriteDouble(5e-324) == "5E-324"s);
+            CHECK(WriteDouble(std::numeric_limits<double>::infinity()) == "1e99999"s);
+            CHECK(WriteDouble(std::numeric_limits<double>::quiet_NaN()) == "null"s);
+        }
+    }
+    GIVEN("integer values") {
+        THEN("they are written as decimals") {
+            std::string out;
+            JsonWriter writer{out};
+            writer.StartArray().Value(0).Value(-42).Value(std::numeric_limits<uint64_t>::max()).Value(true).EndArray();
+            CHECK(out == "[0,-42,18446744073709551615,true]"s);
+        }
+    }
+}
+
+SCENARIO("JSON writer string escaping") {
+    CHECK(WriteString("plain"sv) == "\"plain\""s);
+    CHECK(WriteString("Old \"Dog\""sv) == "\"Old \\\"Dog\\\"\""s);
+    CHECK(WriteString("a\\b\n\t\r\b\f"sv) == "\"a\\\\b\\n\\t\\r\\b\\f\""s);
+    CHECK(WriteString("\x01\x1f"sv) == "\"\\u0001\\u001f\""s);
+    CHECK(WriteString("Шарик/"sv) == "\"Шарик/\""s);
+}
+
+SCENARIO("JSON writer output matches boost::json::serialize") {
+    GIVEN("a nested document") {
+        boost::json::object player;
+        player.emplace("pos"sv, boost::json::array{10.5, 0.});
+        player.emplace("dir"sv, "U"sv);
+        player.emplace("bag"sv, boost::json::array{boost::json::object{{"id"sv, 3u}, {"type"sv, 1u}}});
+        player.emplace("score"sv, 7u);
+        boost::json::object players;
+        players.emplace("42"sv, std::move(player));
+        boost::json::object document;
+        document.emplace("players"sv, std::move(players));
+        document.emplace("lostObjects"sv, boost::json::object{});
+        document.emplace("full"sv, false);
+        document.emplace("removed"sv, boost::json::array{});
+
+        WHEN("the same document is written with the writer") {
+            std::string out;
+            JsonWriter writer{out};
+            writer.StartObject();
+            writer.Key("players"sv).StartObject();
+            writer.Key(42).StartObject()
+                .Key("pos"sv).Pair(10.5, 0.)
+                .Key("dir"sv).Value("U"sv)
+                .Key("bag"sv).StartArray()
+                    .StartObject().Key("id"sv).Value(3u).Key("type"sv).Value(1u).EndObject()
+                .EndArray()
+                .Key("score"sv).Value(7u)
+                .EndObject();
+            writer.EndObject();
+            writer.Key("lostObjects"sv).StartObject().EndObject();
+            writer.Key("full"sv).Value(false);
+            writer.Key("removed"sv).StartArray().EndArray();
+            writer.EndObject();
+
+            THEN("output is byte-identical") {
+                CHECK(out == boost::json::serialize(document));
+            }
+        }
+    }
+}
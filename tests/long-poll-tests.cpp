@@ -0,0 +1,123 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/db/in_memory.h"
+#include "../src/http/request_handler.h"
+#include "../src/http/tick_waiters.h"
+#include "test-game.h"
+
+#include <string>
+
+using namespace std::literals;
+using namespace http_handler;
+
+namespace {
+
+http::request<http::string_body> MakeStateRequest(std::string_view target, const app::Token& token,
+                                                  std::string_view if_none_match = {}) {
+    http::request<http::string_body> request{http::verb::get, target, 11};
+    request.set(http::field::authorization, "Bearer "s + *token);
+    if (!if_none_match.empty()) {
+        request.set(http::field::if_none_match, if_none_match);
+    }
+    return request;
+}
+
+}  // namespace
+
+SCENARIO("ETag matching") {
+    const auto etag = "\"1-5-17\""sv;
+    CHECK_FALSE(MatchesETag(""sv, etag));
+    CHECK(MatchesETag("\"1-5-17\""sv, etag));
+    CHECK(MatchesETag("W/\"1-5-17\""sv, etag));
+    CHECK(MatchesETag("\"1-4-12\", \"1-5-17\""sv, etag));
+    CHECK(MatchesETag("*"sv, etag));
+    CHECK_FALSE(MatchesETag("\"1-4-12\""sv, etag));
+    CHECK_FALSE(MatchesETag("\"1-5-17b\""sv, etag));
+}
+
+SCENARIO("State ETag") {
+    GIVEN("a player") {
+        auto game = test_game::MakeGame(100);
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto token = app.JoinPlayer(model::Map::Id{"map1"s}, "dog1"s)->first;
+        app.PublishSnapshots();
+        extra_data::ExtraData extra_data;
+        ApiHandler handler(app, extra_data);
+
+        const auto full = handler.HandleRequest(MakeStateRequest("/api/v1/game/state"sv, token));
+        REQUIRE(full.result() == http::status::ok);
+        const std::string full_etag{full[http::field::etag]};
+        REQUIRE_FALSE(full_etag.empty());
+
+        THEN("an unchanged full state is not sent again") {
+            const auto response = handler.HandleRequest(MakeStateRequest("/api/v1/game/state"sv, token, full_etag));
+            CHECK(response.result() == http::status::not_modified);
+        }
+
+        WHEN("the player holds a delta or an area of interest") {
+            const auto delta = handler.HandleRequest(MakeStateRequest("/api/v1/game/state?since=0"sv, token));
+            const auto area = handler.HandleRequest(MakeStateRequest("/api/v1/game/state?radius=2.5"sv, token));
+            REQUIRE(delta.result() == http::status::ok);
+            REQUIRE(area.result() == http::status::ok);
+            const std::string delta_etag{delta[http::field::etag]};
+            const std::string area_etag{area[http::field::etag]};
+
+            THEN("their ETags differ from the full state and from each other") {
+                CHECK(delta_etag != full_etag);
+                CHECK(area_etag != full_etag);
+                CHECK(delta_etag != area_etag);
+            }
+
+            THEN("their ETags do not validate the full state") {
+                for (const auto& etag : {delta_etag, area_etag}) {
+                    const auto response = handler.HandleRequest(MakeStateRequest("/api/v1/game/state"sv, token, etag));
+                    CHECK(response.result() == http::status::ok);
+                    CHECK_FALSE(response.body().empty());
+                }
+            }
+
+            THEN("the same request is still validated by its own ETag") {
+                const auto response = handler.HandleRequest(
+                    MakeStateRequest("/api/v1/game/state?since=0"sv, token, delta_etag));
+                CHECK(response.result() == http::status::not_modified);
+                const auto other_radius = handler.HandleRequest(
+                    MakeStateRequest("/api/v1/game/state?radius=3"sv, token, area_etag));
+                CHECK(other_radius.result() == http::status::ok);
+            }
+        }
+    }
+}
+
+SCENARIO("Tick waiters") {
+    GIVEN("waiters registry") {
+        TickWaiters waiters;
+        int resumed = 0;
+        const auto first = waiters.Add([&resumed] { ++resumed; });
+        const auto second = waiters.Add([&resumed] { ++resumed; });
+        REQUIRE(waiters.Size() == 2);
+
+        WHEN("a waiter times out before the tick") {
+            CHECK(waiters.Remove(first));
+            waiters.Notify();
+            THEN("only the remaining waiter is resumed") {
+                CHECK(resumed == 1);
+                CHECK(waiters.Size() == 0);
+            }
+            THEN("the resumed waiter can not be removed by its timer") {
+                CHECK_FALSE(waiters.Remove(second));
+            }
+        }
+
+        WHEN("a waiter re-registers while being resumed") {
+            TickWaiters::Id again = 0;
+            waiters.Add([&] { again = waiters.Add([&resumed] { ++resumed; }); });
+            waiters.Notify();
+            THEN("it waits for the next tick") {
+                CHECK(resumed == 2);
+                CHECK(waiters.Size() == 1);
+                waiters.Notify();
+                CHECK(resumed == 3);
+            }
+        }
+    }
+}
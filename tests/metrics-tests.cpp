@@ -0,0 +1,66 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/metrics/metrics.h"
+
+#include <stdexcept>
+#include <string>
+
+using namespace std::literals;
+
+SCENARIO("Metrics registry") {
+    GIVEN("a registry with a counter and a gauge") {
+        metrics::Registry registry;
+        auto& counter = registry.AddCounter("requests_total"sv, "Number of requests"sv);
+        auto& gauge = registry.AddGauge("queue_depth"sv, "Queue depth"sv);
+        counter.Add();
+        counter.Add(2);
+        gauge.Set(1.5);
+
+        THEN("values are rendered in Prometheus text format") {
+            const auto text = registry.Render();
+            CHECK(text.find("# HELP requests_total Number of requests\n") != std::string::npos);
+            CHECK(text.find("# TYPE requests_total counter\nrequests_total 3\n") != std::string::npos);
+            CHECK(text.find("# TYPE queue_depth gauge\nqueue_depth 1.5\n") != std::string::npos);
+        }
+
+        THEN("registering the same name returns the same metric") {
+            CHECK(&registry.AddCounter("requests_total"sv, "Number of requests"sv) == &counter);
+            CHECK_THROWS_AS(registry.AddGauge("requests_total"sv, ""sv), std::invalid_argument);
+        }
+    }
+
+    GIVEN("a histogram") {
+        metrics::Registry registry;
+        auto& histogram = registry.AddHistogram("wait_seconds"sv, "Wait time"sv, {0.1, 1.});
+        histogram.Observe(0.05);
+        histogram.Observe(0.1);
+        histogram.Observe(0.5);
+        histogram.Observe(2.);
+
+        THEN("buckets are cumulative and include the upper bound") {
+            CHECK(histogram.GetCumulativeCount(0) == 2);
+            CHECK(histogram.GetCumulativeCount(1) == 3);
+            CHECK(histogram.GetCumulativeCount(2) == 4);
+            CHECK(histogram.GetSum() == 2.65);
+            const auto text = registry.Render();
+            CHECK(text.find("# TYPE wait_seconds histogram\n"s) != std::string::npos);
+            CHECK(text.find("wait_seconds_bucket{le=\"0.1\"} 2\n"s) != std::string::npos);
+            CHECK(text.find("wait_seconds_bucket{le=\"+Inf\"} 4\n"s) != std::string::npos);
+            CHECK(text.find("wait_seconds_count 4\n"s) != std::string::npos);
+        }
+    }
+
+    GIVEN("tick metrics") {
+        metrics::Registry registry;
+        metrics::TickMetrics tick_metrics{registry};
+        tick_metrics.OnTick(2ms, 500us);
+        tick_metrics.missed_deadlines.Add(3);
+
+        THEN("they are shared through the registry") {
+            CHECK(tick_metrics.ticks.Get() == 1);
+            CHECK(tick_metrics.lateness_seconds.Get() == 0.002);
+            CHECK(tick_metrics.duration_seconds.Get() == 0.0005);
+            CHECK(registry.Render().find("game_tick_missed_deadlines_total 3\n") != std::string::npos);
+        }
+    }
+}
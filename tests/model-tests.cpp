@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <cmath>
+#include <limits>
 #include <catch2/catch_test_macros.hpp>
 
 #include "../src/model/geom.h"
 #include "../src/model/model.h"
+#include "../src/model/spatial_index.h"
 
 using namespace std::literals;
 using namespace  model;
@@ -24,4 +27,198 @@ SCENARIO("Loot spawn") {
             }
         }
     }
-}
\ No newline at end of file
+}
+
+SCENARIO("Session changes history") {
+    GIVEN("Game session with 1 map with 1 road") {
+        Map map(Map::Id{"id"s}, "name"s);
+        map.SetDogSpeed(1).SetDogBagCapacity(3);
+        map.AddLootTypeWorth(1);
+        Road road(Road::HORIZONTAL, {0 ,0}, 10);
+        map.AddRoad(road);
+        GameSession session(&map, 0, false, {5s, 0.0}, 60'000, {});
+        auto* dog = session.NewDog("dog"s);
+        const auto dog_id = dog->GetId();
+
+        WHEN("no tick has passed") {
+            THEN("joined dog is reported as pending change") {
+                auto changes = session.GetChangesSince(0);
+                REQUIRE(changes.has_value());
+                CHECK(changes->changed_dogs.contains(dog_id));
+                CHECK(session.GetTickSeq() == 0);
+            }
+        }
+        WHEN("dog moves during a tick") {
+            session.OnTick(100ms);
+            dog->SetDirection(Dog::Direction::EAST);
+            dog->SetSpeed(1);
+            session.MarkDogChanged(dog_id);
+            session.OnTick(100ms);
+            THEN("tick sequence grows and changes are recorded per tick") {
+                CHECK(session.GetTickSeq() == 2);
+                auto changes = session.GetChangesSince(1);
+                REQUIRE(changes.has_value());
+                CHECK(changes->changed_dogs.contains(dog_id));
+                auto no_changes = session.GetChangesSince(2);
+                REQUIRE(no_changes.has_value());
+                CHECK(no_changes->Empty());
+            }
+        }
+        WHEN("client is too far behind") {
+            for (size_t i = 0; i < GameSession::CHANGES_HISTORY_SIZE + 1; ++i) {
+                session.OnTick(1ms);
+            }
+            THEN("changes are not available") {
+                CHECK_FALSE(session.GetChangesSince(0).has_value());
+                CHECK(session.GetChangesSince(1).has_value());
+            }
+        }
+        WHEN("client is ahead of the session") {
+            THEN("changes are not available") {
+                CHECK_FALSE(session.GetChangesSince(5).has_value());
+            }
+        }
+    }
+}
+
+SCENARIO("Long tick is split into steps") {
+    GIVEN("Two sessions on the same map with a moving dog") {
+        Map map(Map::Id{"id"s}, "name"s);
+        map.SetDogSpeed(1).SetDogBagCapacity(3);
+        map.AddLootTypeWorth(1);
+        map.AddRoad(Road(Road::HORIZONTAL, {0, 0}, 10));
+        GameSession one_tick(&map, 0, false, {5s, 0.0}, 60'000, {});
+        GameSession many_ticks(&map, 0, false, {5s, 0.0}, 60'000, {});
+        for (auto* session : {&one_tick, &many_ticks}) {
+            auto* dog = session->NewDog("dog"s);
+            dog->SetDirection(Dog::Direction::EAST);
+            dog->SetSpeed(1);
+        }
+
+        WHEN("one session gets a single long tick and the other gets short ticks") {
+            one_tick.OnTick(1000ms);
+            for (int i = 0; i < 10; ++i) {
+                many_ticks.OnTick(GameSession::MAX_TICK_STEP);
+            }
+            THEN("dogs end up in the same place") {
+                const auto& a = one_tick.GetDogs().front().GetCoorginates();
+                const auto& b = many_ticks.GetDogs().front().GetCoorginates();
+                CHECK(std::abs(a.x - b.x) < 1e-9);
+                CHECK(std::abs(a.y - b.y) < 1e-9);
+                CHECK(std::abs(a.x - 1.0) < 1e-9);
+            }
+        }
+    }
+}
+
+SCENARIO("Area of interest search") {
+    GIVEN("Game session with dogs and loot spread along a long road") {
+        Map map(Map::Id{"id"s}, "name"s);
+        map.SetDogSpeed(1).SetDogBagCapacity(3);
+        map.AddLootTypeWorth(1);
+        map.AddRoad(Road(Road::HORIZONTAL, {0 ,0}, 100));
+        GameSession session(&map, 0, false, {5s, 0.0}, 60'000, {});
+        session.AddDog(Dog{Dog::Id{0}, "near"s, {1., 0.}});
+        session.AddDog(Dog{Dog::Id{1}, "border"s, {25., 0.}});
+        session.AddDog(Dog{Dog::Id{2}, "far"s, {70., 0.}});
+        session.AddLootObject(LootObject{LootObject::Id{0}, 0, 1}, {24.5, 0.});
+        session.AddLootObject(LootObject{LootObject::Id{1}, 0, 1}, {26., 0.});
+
+        WHEN("searching around a point") {
+            auto dogs = session.FindDogsInRadius({5., 0.}, 20.);
+            auto loot = session.FindLootObjectsInRadius({5., 0.}, 20.);
+            THEN("only objects within the radius are found") {
+                std::sort(dogs.begin(), dogs.end());
+                CHECK(dogs == std::vector{Dog::Id{0}, Dog::Id{1}});
+                CHECK(loot == std::vector{LootObject::Id{0}});
+            }
+        }
+        WHEN("a dog moves away") {
+            session.GetDogById(Dog::Id{1})->SetCoorginates({90., 0.});
+            session.MarkDogChanged(Dog::Id{1});
+            THEN("the index follows the session state") {
+                CHECK(session.FindDogsInRadius({5., 0.}, 20.) == std::vector{Dog::Id{0}});
+            }
+        }
+        WHEN("searching with an infinite or a very large radius") {
+            auto all_dogs = session.FindDogsInRadius({5., 0.}, std::numeric_limits<double>::infinity());
+            auto huge_dogs = session.FindDogsInRadius({5., 0.}, 1e12);
+            auto huge_loot = session.FindLootObjectsInRadius({1e300, -1e300}, 1e300);
+            THEN("every object is found and only the occupied cells are scanned") {
+                std::sort(all_dogs.begin(), all_dogs.end());
+                std::sort(huge_dogs.begin(), huge_dogs.end());
+                std::sort(huge_loot.begin(), huge_loot.end());
+                CHECK(all_dogs == std::vector{Dog::Id{0}, Dog::Id{1}, Dog::Id{2}});
+                CHECK(huge_dogs == all_dogs);
+                CHECK(huge_loot == std::vector{LootObject::Id{0}, LootObject::Id{1}});
+            }
+        }
+        WHEN("searching with an invalid radius") {
+            THEN("nothing is found") {
+                CHECK(session.FindDogsInRadius({5., 0.}, std::numeric_limits<double>::quiet_NaN()).empty());
+                CHECK(session.FindDogsInRadius({5., 0.}, -1.).empty());
+            }
+        }
+    }
+}
+
+SCENARIO("Spatial index over sparsely occupied cells") {
+    GIVEN("objects in cells far apart") {
+        SpatialIndex<int> index{1.};
+        index.Add(0, {0., 0.});
+        index.Add(1, {1e6, 1e6});
+        index.Add(2, {1e6, 0.});
+
+        WHEN("the radius covers a box of far more cells than are occupied") {
+            std::vector<int> found;
+            index.ForEachInRadius({0., 0.}, 1e6, [&found](int id, geom::PointDouble) {
+                found.push_back(id);
+            });
+            THEN("the occupied cells are checked instead of the box") {
+                std::sort(found.begin(), found.end());
+                CHECK(found == std::vector{0, 2});
+            }
+        }
+
+        WHEN("the radius covers a few cells") {
+            std::vector<int> found;
+            index.ForEachInRadius({1e6, 1e6}, 1.5, [&found](int id, geom::PointDouble) {
+                found.push_back(id);
+            });
+            THEN("only the objects within the radius are found") {
+                CHECK(found == std::vector{1});
+            }
+        }
+    }
+}
+
+SCENARIO("Session content version") {
+    GIVEN("a session with a stopped dog and no loot generation") {
+        Map map(Map::Id{"id"s}, "name"s);
+        map.SetDogSpeed(1).SetDogBagCapacity(3);
+        map.AddLootTypeWorth(1);
+        map.AddRoad(Road(Road::HORIZONTAL, {0 ,0}, 100));
+        GameSession session(&map, 0, false, {5s, 0.0}, 60'000, {});
+        auto* dog = session.AddDog(Dog{Dog::Id{0}, "dog"s, {1., 0.}});
+        const auto version = session.GetContentVersion();
+
+        WHEN("a tick passes and nothing moves") {
+            session.OnTick(100ms);
+            THEN("only the state version changes") {
+                CHECK(session.GetContentVersion() == version);
+                CHECK(session.GetStateVersion() > version);
+            }
+        }
+        WHEN("the dog moves during a tick") {
+            dog->SetDirection(Dog::Direction::EAST);
+            dog->SetSpeed(1.);
+            session.MarkDogChanged(dog->GetId());
+            const auto commanded = session.GetContentVersion();
+            session.OnTick(100ms);
+            THEN("the content version changes on the command and on the tick") {
+                CHECK(commanded > version);
+                CHECK(session.GetContentVersion() > commanded);
+            }
+        }
+    }
+}
@@ -0,0 +1,212 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/http/response_encoding.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace std::literals;
+using namespace http_handler;
+
+namespace {
+
+// Читает двоичный ответ так, как его читает клиент
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data)
+        : data_{data} {
+    }
+
+    std::string_view Bytes(size_t size) {
+        REQUIRE(data_.size() >= size);
+        const auto result = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return result;
+    }
+
+    uint8_t U8() {
+        return static_cast<uint8_t>(Bytes(1).front());
+    }
+
+    uint16_t U16() {
+        return static_cast<uint16_t>(ReadLittleEndian(2));
+    }
+
+    uint32_t U32() {
+        return static_cast<uint32_t>(ReadLittleEndian(4));
+    }
+
+    int32_t I32() {
+        return static_cast<int32_t>(U32());
+    }
+
+    uint64_t U64() {
+        return ReadLittleEndian(8);
+    }
+
+    double F64() {
+        const uint64_t bits = U64();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    bool AtEnd() const noexcept {
+        return data_.empty();
+    }
+
+private:
+    uint64_t ReadLittleEndian(size_t size) {
+        const auto bytes = Bytes(size);
+        uint64_t value = 0;
+        for (size_t i = size; i-- > 0;) {
+            value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+        }
+        return value;
+    }
+
+    std::string_view data_;
+};
+
+app::UseCaseGetGameState::GameState MakeState() {
+    app::UseCaseGetGameState::GameState state;
+    state.players.push_back({model::Dog::Id{7}, {1.5, 2.25}, {0., -1.}, model::Dog::Direction::WEST, {{3, 1}}, 42});
+    state.loot_objects.push_back({model::LootObject::Id{5}, 2, {-0.5, 4.}});
+    return state;
+}
+
+}  // namespace
+
+SCENARIO("Response encoding negotiation") {
+    using enum ResponseEncoding;
+    const auto binary = std::string{BinaryContentType::FLOAT};
+    const auto fixed = std::string{BinaryContentType::FIXED};
+
+    GIVEN("no or unknown media types") {
+        CHECK(ChooseEncoding(""sv) == JSON);
+        CHECK(ChooseEncoding("text/html"sv) == JSON);
+        CHECK(ChooseEncoding("*/*"sv) == JSON);
+        CHECK(ChooseEncoding("application/*"sv) == JSON);
+    }
+
+    GIVEN("an explicit binary media type") {
+        CHECK(ChooseEncoding(binary) == BINARY);
+        CHECK(ChooseEncoding(fixed) == BINARY_FIXED);
+        CHECK(ChooseEncoding("text/html, "s + binary + " ; level=1; q=0.9"s) == BINARY);
+    }
+
+    GIVEN("q-values") {
+        CHECK(ChooseEncoding("application/json;q=0.5, "s + fixed) == BINARY_FIXED);
+        CHECK(ChooseEncoding(binary + ";q=0.4, application/json;q=0.8"s) == JSON);
+        CHECK(ChooseEncoding("application/*;q=0.5, "s + fixed + ";q=0.4"s) == JSON);
+        CHECK(ChooseEncoding(binary + ";q=abc"s) == JSON);
+    }
+
+    GIVEN("equal q-values") {
+        THEN("an explicit type wins over a wildcard, an earlier one over a later one") {
+            CHECK(ChooseEncoding("*/*, "s + binary) == BINARY);
+            CHECK(ChooseEncoding(fixed + ", "s + binary) == BINARY_FIXED);
+            CHECK(ChooseEncoding(binary + ", "s + fixed) == BINARY);
+        }
+    }
+
+    GIVEN("q=0") {
+        THEN("it excludes the type even if a wildcard allows it") {
+            CHECK(ChooseEncoding(binary + ";q=0, */*"s) == JSON);
+            CHECK(ChooseEncoding("*/*, application/json;q=0"s) == BINARY);
+            CHECK(ChooseEncoding("application/json;q=0, "s + binary + ";q=0.1"s) == BINARY);
+        }
+        THEN("JSON is used if no type is acceptable") {
+            CHECK(ChooseEncoding("application/json;q=0"sv) == JSON);
+            CHECK(ChooseEncoding(binary + ";q=0"s) == JSON);
+        }
+    }
+}
+
+SCENARIO("Binary game state layout") {
+    const auto state = MakeState();
+
+    GIVEN("the floating point encoding") {
+        const auto body = EncodeGameState(state, ResponseEncoding::BINARY);
+        BinaryReader reader{body};
+        CHECK(reader.Bytes(4) == "DGS\1"sv);
+        CHECK(reader.U8() == 0);
+        REQUIRE(reader.U32() == 1);
+        CHECK(reader.U64() == 7);
+        CHECK(reader.F64() == 1.5);
+        CHECK(reader.F64() == 2.25);
+        CHECK(reader.F64() == 0.);
+        CHECK(reader.F64() == -1.);
+        CHECK(reader.U8() == 2);
+        CHECK(reader.U64() == 42);
+        REQUIRE(reader.U16() == 1);
+        CHECK(reader.U64() == 3);
+        CHECK(reader.U32() == 1);
+        REQUIRE(reader.U32() == 1);
+        CHECK(reader.U64() == 5);
+        CHECK(reader.U32() == 2);
+        CHECK(reader.F64() == -0.5);
+        CHECK(reader.F64() == 4.);
+        CHECK(reader.AtEnd());
+    }
+
+    GIVEN("the fixed point encoding") {
+        const auto body = EncodeGameState(state, ResponseEncoding::BINARY_FIXED);
+        BinaryReader reader{body};
+        CHECK(reader.Bytes(4) == "DGS\1"sv);
+        CHECK(reader.U8() == 1);
+        REQUIRE(reader.U32() == 1);
+        CHECK(reader.U64() == 7);
+        CHECK(reader.I32() == 1500);
+        CHECK(reader.I32() == 2250);
+        CHECK(reader.I32() == 0);
+        CHECK(reader.I32() == -1000);
+        CHECK(reader.U8() == 2);
+        CHECK(reader.U64() == 42);
+        REQUIRE(reader.U16() == 1);
+        CHECK(reader.U64() == 3);
+        CHECK(reader.U32() == 1);
+        REQUIRE(reader.U32() == 1);
+        CHECK(reader.U64() == 5);
+        CHECK(reader.U32() == 2);
+        CHECK(reader.I32() == -500);
+        CHECK(reader.I32() == 4000);
+        CHECK(reader.AtEnd());
+    }
+
+    GIVEN("a delta") {
+        app::UseCaseGetGameStateDelta::GameStateDelta delta;
+        delta.seq = 9;
+        delta.full = false;
+        delta.retired_players = {model::Dog::Id{4}};
+        delta.removed_loot_objects = {model::LootObject::Id{1}, model::LootObject::Id{2}};
+        const auto body = EncodeGameStateDelta(delta, ResponseEncoding::BINARY);
+        BinaryReader reader{body};
+        CHECK(reader.Bytes(4) == "DGD\1"sv);
+        CHECK(reader.U8() == 0);
+        CHECK(reader.U64() == 9);
+        CHECK(reader.U8() == 0);
+        CHECK(reader.U32() == 0);
+        CHECK(reader.U32() == 0);
+        REQUIRE(reader.U32() == 1);
+        CHECK(reader.U64() == 4);
+        REQUIRE(reader.U32() == 2);
+        CHECK(reader.U64() == 1);
+        CHECK(reader.U64() == 2);
+        CHECK(reader.AtEnd());
+    }
+}
+
+SCENARIO("Binary players list layout") {
+    const auto body = EncodePlayers({{model::Dog::Id{1}, "Rex"s}, {model::Dog::Id{258}, ""s}});
+    BinaryReader reader{body};
+    CHECK(reader.Bytes(4) == "DGP\1"sv);
+    REQUIRE(reader.U32() == 2);
+    CHECK(reader.U64() == 1);
+    REQUIRE(reader.U16() == 3);
+    CHECK(reader.Bytes(3) == "Rex"sv);
+    CHECK(reader.U64() == 258);
+    CHECK(reader.U16() == 0);
+    CHECK(reader.AtEnd());
+}
@@ -0,0 +1,186 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/db/in_memory.h"
+#include "../src/http/request_handler.h"
+#include "../src/http/session_strands.h"
+#include "test-game.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+using namespace http_handler;
+
+namespace {
+
+class CountingListener : public app::ApplicationListener {
+public:
+    explicit CountingListener(std::atomic<int>& calls)
+        : calls_{calls} {
+    }
+
+    void OnTick(std::chrono::milliseconds) override {
+        ++calls_;
+    }
+
+private:
+    std::atomic<int>& calls_;
+};
+
+RequestData MakeRequestData(std::string uri) {
+    RequestData data;
+    data.decoded_uri = std::move(uri);
+    return data;
+}
+
+}  // namespace
+
+SCENARIO("API request scope") {
+    using Scope = ApiHandler::RequestScope;
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/maps"s)) == Scope::CONCURRENT);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/maps/map1"s)) == Scope::CONCURRENT);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/game/records?maxItems=10"s)) == Scope::CONCURRENT);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/game/tick"s)) == Scope::GAME);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/game/join"s)) == Scope::SESSION);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/game/players"s)) == Scope::CONCURRENT);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/game/state"s)) == Scope::CONCURRENT);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/game/state?wait=1000"s)) == Scope::CONCURRENT);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/game/state?since=3"s)) == Scope::SESSION);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/game/state?radius=5"s)) == Scope::SESSION);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v1/game/player/action"s)) == Scope::SESSION);
+    CHECK(ApiHandler::GetRequestScope(MakeRequestData("/api/v2/game/state"s)) == Scope::CONCURRENT);
+    CHECK(ApiHandler::GetRequestScope(RequestData{}) == Scope::CONCURRENT);
+
+    CHECK(ApiHandler::GetRequestPriority(MakeRequestData("/api/v1/game/state?since=3"s)) == TaskPriority::READ);
+    CHECK(ApiHandler::GetRequestPriority(MakeRequestData("/api/v1/game/join"s)) == TaskPriority::MUTATION);
+    CHECK(ApiHandler::GetRequestPriority(MakeRequestData("/api/v1/game/player/action"s)) == TaskPriority::MUTATION);
+}
+
+SCENARIO("Priority strand") {
+    GIVEN("a priority strand with queue wait metrics") {
+        net::io_context ioc;
+        metrics::Registry registry;
+        PriorityStrand::Metrics metrics{registry};
+        PriorityStrand strand{net::make_strand(ioc), &metrics};
+        std::vector<std::string> order;
+
+        WHEN("reads are queued before a mutation and a tick") {
+            strand.Post(TaskPriority::READ, [&order] { order.push_back("read1"s); });
+            strand.Post(TaskPriority::READ, [&order] { order.push_back("read2"s); });
+            strand.Post(TaskPriority::MUTATION, [&order] { order.push_back("move"s); });
+            strand.Post(TaskPriority::TICK, [&order] { order.push_back("tick"s); });
+            ioc.run();
+
+            THEN("the tick and the mutation run first, reads keep their order") {
+                CHECK(order == std::vector{"tick"s, "move"s, "read1"s, "read2"s});
+                CHECK(metrics.queue_wait[0]->GetCount() == 1);
+                CHECK(metrics.queue_wait[2]->GetCount() == 2);
+            }
+        }
+
+        WHEN("a read has waited longer than the starvation limit") {
+            strand.Post(TaskPriority::READ, [&order] { order.push_back("read"s); });
+            std::this_thread::sleep_for(PriorityStrand::STARVATION_LIMIT + 20ms);
+            strand.Post(TaskPriority::TICK, [&order] { order.push_back("tick"s); });
+            ioc.run();
+
+            THEN("it runs before the newer tick") {
+                CHECK(order == std::vector{"read"s, "tick"s});
+            }
+        }
+    }
+}
+
+SCENARIO("Tick fan-out over session strands") {
+    GIVEN("an application with two active sessions") {
+        auto game = test_game::MakeGame();
+        game.AddMap(test_game::MakeMap("map2"s));
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        REQUIRE(app.JoinPlayer(model::Map::Id{"map1"s}, "dog1"s).has_value());
+        REQUIRE(app.JoinPlayer(model::Map::Id{"map2"s}, "dog2"s).has_value());
+        std::atomic<int> listener_calls{0};
+        app.AddListener(std::make_unique<CountingListener>(listener_calls));
+
+        net::io_context ioc;
+        auto strands = std::make_shared<SessionStrands>(ioc, app, net::make_strand(ioc));
+        REQUIRE(strands->FindByMap(model::Map::Id{"map1"s}) != nullptr);
+        REQUIRE(strands->FindByMap(model::Map::Id{"unknown"s}) == nullptr);
+
+        WHEN("a tick runs on several threads") {
+            net::post(strands->GetCoordinator(), [strands] {
+                strands->Tick(100ms);
+            });
+            std::vector<std::jthread> workers;
+            for (int i = 0; i < 4; ++i) {
+                workers.emplace_back([&ioc] { ioc.run(); });
+            }
+            workers.clear();
+
+            THEN("every session advances and listeners are called once") {
+                CHECK(app.GetStateVersion(model::Map::Id{"map1"s})->tick_seq == 1);
+                CHECK(app.GetStateVersion(model::Map::Id{"map2"s})->tick_seq == 1);
+                CHECK(listener_calls == 1);
+            }
+        }
+
+        WHEN("ticks arrive while the previous one is still running") {
+            net::post(strands->GetCoordinator(), [strands] {
+                strands->Tick(100ms);
+                strands->Tick(100ms);
+                strands->Tick(100ms);
+            });
+            ioc.run();
+
+            THEN("the delayed time is not lost but applied with the next tick") {
+                CHECK(app.GetStateVersion(model::Map::Id{"map1"s})->tick_seq == 1);
+                CHECK(listener_calls == 1);
+                net::post(strands->GetCoordinator(), [strands] {
+                    strands->Tick(0ms);
+                });
+                ioc.restart();
+                ioc.run();
+                CHECK(app.GetStateVersion(model::Map::Id{"map1"s})->tick_seq == 2);
+                CHECK(listener_calls == 2);
+            }
+        }
+    }
+}
+
+SCENARIO("Session snapshots") {
+    GIVEN("a player in a session") {
+        auto game = test_game::MakeGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        auto joined = app.JoinPlayer(model::Map::Id{"map1"s}, "dog1"s);
+        REQUIRE(joined.has_value());
+        const auto& token = joined->first;
+
+        THEN("the snapshot already contains the joined dog") {
+            auto snapshot = app.GetSnapshot(token);
+            REQUIRE(snapshot);
+            REQUIRE(snapshot->players.size() == 1);
+            CHECK(snapshot->players.front().second == "dog1"s);
+            CHECK(snapshot->state.players.size() == 1);
+            CHECK(app.GetSnapshot(model::Map::Id{"unknown"s}) == nullptr);
+        }
+
+        WHEN("the player moves") {
+            auto before = app.GetSnapshot(token);
+            REQUIRE(app.MovePlayer(token, model::Dog::Direction::EAST));
+
+            THEN("readers see the old snapshot until the next one is published") {
+                CHECK(app.IsSnapshotStale(model::Map::Id{"map1"s}));
+                CHECK(app.GetSnapshot(token) == before);
+                app.PublishSnapshot(model::Map::Id{"map1"s});
+                auto after = app.GetSnapshot(token);
+                CHECK(after != before);
+                CHECK(after->version > before->version);
+                CHECK(after->state.players.front().dir == model::Dog::Direction::EAST);
+                // Старый снимок остаётся целым, пока его держит читатель
+                CHECK(before->state.players.front().dir != model::Dog::Direction::EAST);
+                CHECK_FALSE(app.IsSnapshotStale(model::Map::Id{"map1"s}));
+            }
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/app/simulation.h"
+#include "../src/app/tick_governor.h"
+#include "../src/app/tick_schedule.h"
+#include "../src/db/in_memory.h"
+#include "../src/util/mpsc_queue.h"
+#include "test-game.h"
+
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+SCENARIO("MPSC queue") {
+    GIVEN("an empty queue") {
+        util::MpscQueue<int> queue;
+        CHECK_FALSE(queue.TryPop().has_value());
+
+        WHEN("values are pushed from one thread") {
+            for (int i = 0; i < 3; ++i) {
+                queue.Push(i);
+            }
+            THEN("they are popped in order") {
+                CHECK(queue.TryPop() == 0);
+                CHECK(queue.TryPop() == 1);
+                queue.Push(3);
+                CHECK(queue.TryPop() == 2);
+                CHECK(queue.TryPop() == 3);
+                CHECK_FALSE(queue.TryPop().has_value());
+            }
+        }
+
+        WHEN("several producers push concurrently") {
+            constexpr int producers = 4;
+            constexpr int per_producer = 10000;
+            std::vector<int> last(producers, -1);
+            int popped = 0;
+            bool ordered = true;
+            {
+                std::vector<std::jthread> threads;
+                for (int p = 0; p < producers; ++p) {
+                    threads.emplace_back([&queue, p] {
+                        for (int i = 0; i < per_producer; ++i) {
+                            queue.Push(p * per_producer + i);
+                        }
+                    });
+                }
+                while (popped < producers * per_producer) {
+                    if (auto value = queue.TryPop()) {
+                        const int producer = *value / per_producer;
+                        ordered = ordered && *value % per_producer == last[producer] + 1;
+                        last[producer] = *value % per_producer;
+                        ++popped;
+                    }
+                }
+            }
+            THEN("every value is popped once in the order of its producer") {
+                CHECK(ordered);
+                CHECK_FALSE(queue.TryPop().has_value());
+            }
+        }
+    }
+}
+
+SCENARIO("Simulation thread") {
+    GIVEN("an application driven by the simulation thread") {
+        auto game = test_game::MakeGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        app::Simulation simulation(app, 5ms);
+        simulation.Start();
+
+        WHEN("a player joins through the command queue") {
+            std::promise<bool> joined;
+            std::promise<bool> in_simulation_thread;
+            simulation.Push([&] {
+                in_simulation_thread.set_value(simulation.IsRunningInThisThread());
+                joined.set_value(app.JoinPlayer(model::Map::Id{"map1"s}, "dog"s).has_value());
+            });
+
+            THEN("the command is applied on the simulation thread and the session keeps ticking") {
+                CHECK(joined.get_future().get());
+                CHECK(in_simulation_thread.get_future().get());
+                CHECK_FALSE(simulation.IsRunningInThisThread());
+                std::this_thread::sleep_for(50ms);
+                simulation.Stop();
+                CHECK(app.GetStateVersion(model::Map::Id{"map1"s})->tick_seq > 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Tick schedule") {
+    GIVEN("maps with their own tick rates") {
+        model::Game::Maps maps;
+        maps.emplace_back(model::Map::Id{"base"s}, "base"s);
+        maps.emplace_back(model::Map::Id{"slow"s}, "slow"s);
+        maps.back().SetTickDivisor(3);
+        maps.emplace_back(model::Map::Id{"period"s}, "period"s);
+        maps.back().SetTickPeriod(95ms);
+        app::TickSchedule schedule(maps, 50ms);
+
+        THEN("tick periods are rounded to multiples of the base period") {
+            CHECK(schedule.GetDivisor(model::Map::Id{"base"s}) == 1);
+            CHECK(schedule.GetDivisor(model::Map::Id{"slow"s}) == 3);
+            CHECK(schedule.GetDivisor(model::Map::Id{"period"s}) == 2);
+            CHECK(schedule.GetDivisor(model::Map::Id{"unknown"s}) == 0);
+        }
+
+        WHEN("the base timer ticks") {
+            std::map<std::string, std::vector<std::chrono::milliseconds>> ticks;
+            for (int i = 0; i < 6; ++i) {
+                for (const auto& due : schedule.Advance(50ms)) {
+                    ticks[*due.map_id].push_back(due.delta);
+                }
+            }
+            THEN("each session ticks at its own rate and gets all elapsed time") {
+                CHECK(ticks["base"s].size() == 6);
+                CHECK(ticks["slow"s] == std::vector{150ms, 150ms});
+                CHECK(ticks["period"s] == std::vector{100ms, 100ms, 100ms});
+            }
+        }
+    }
+}
+
+SCENARIO("Adaptive tick period") {
+    GIVEN("a governor with period bounds") {
+        model::Game game;
+        game.AddMap(model::Map(model::Map::Id{"map1"s}, "map1"s));
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        metrics::Registry registry;
+        app::TickGovernor governor(app, {.min_period = 100ms, .max_period = 200ms, .recovery_ticks = 2}, &registry);
+
+        WHEN("ticks take most of the period") {
+            const auto first = governor.OnTick(90ms, 0);
+            const auto second = governor.OnTick(180ms, 0);
+            THEN("the period grows within bounds and optional work is shed") {
+                CHECK(first == 150ms);
+                CHECK(second == 200ms);
+                CHECK(governor.OnTick(190ms, 0) == 200ms);
+                CHECK(app.IsLoadShedding());
+                CHECK(game.GetLoadShedding().max_loot_per_tick == app::Application::LOAD_SHEDDING_MAX_LOOT_PER_TICK);
+                CHECK(registry.Render().find("game_tick_period_changes_total 2\n") != std::string::npos);
+            }
+
+            AND_WHEN("load drops") {
+                std::chrono::milliseconds period = second;
+                for (int i = 0; i < 20 && period != 100ms; ++i) {
+                    period = governor.OnTick(10ms, 0);
+                }
+                THEN("the period returns to the minimum and shedding stops") {
+                    CHECK(period == 100ms);
+                    CHECK_FALSE(app.IsLoadShedding());
+                    CHECK(game.GetLoadShedding().max_loot_per_tick == 0);
+                }
+            }
+        }
+
+        WHEN("session queues are too deep") {
+            THEN("the server is considered overloaded even with short ticks") {
+                CHECK(governor.OnTick(1ms, 5000) == 150ms);
+                CHECK(app.IsLoadShedding());
+            }
+        }
+    }
+}
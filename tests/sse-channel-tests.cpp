@@ -0,0 +1,369 @@
+#include <boost/asio/ip/tcp.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/db/in_memory.h"
+#include "../src/http/sse_channel.h"
+#include "test-game.h"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+
+using namespace std::literals;
+using namespace http_handler;
+using tcp = net::ip::tcp;
+
+namespace {
+
+const model::Map::Id MAP_ID{"map1"s};
+const auto TARGET = std::string{SseHub::PATH} + "?mapId=map1"s;
+
+model::Game MakeGame() {
+    auto game = test_game::MakeGame(1000, 60000);
+    game.SetLootGeneratorParams(1., 0.);
+    return game;
+}
+
+// Выполняет готовые обработчики, пока не выполнится условие или не истечёт timeout
+template <typename Predicate>
+bool RunUntil(net::io_context& ioc, Predicate&& done, std::chrono::milliseconds timeout = 5s) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+        ioc.restart();
+        ioc.run_one_for(10ms);
+    }
+    return done();
+}
+
+bool IsFull(const std::string& event) {
+    return event.find(R"("full":true)"sv) != std::string::npos;
+}
+
+bool HasId(const std::string& event, size_t id) {
+    return event.starts_with("id: "s + std::to_string(id) + "\n"s);
+}
+
+// Зритель, подключённый к хабу через loopback. Запрос сервер читает так же, как HTTP-сессия.
+class SseClient {
+public:
+    SseClient(net::io_context& ioc, tcp::acceptor& acceptor, SseHub& hub,
+              std::optional<std::string> last_event_id = std::nullopt)
+        : ioc_{ioc}
+        , socket_{ioc} {
+        socket_.connect(acceptor.local_endpoint());
+        auto server = std::make_shared<beast::tcp_stream>(acceptor.accept());
+        auto buffer = std::make_shared<beast::flat_buffer>();
+        auto request = std::make_shared<http::request<http::string_body>>();
+        http::async_read(*server, *buffer, *request, [this, &hub, server, buffer, request](beast::error_code ec, size_t) {
+            REQUIRE_FALSE(ec);
+            accepted_ = hub.TryAccept(*server, *request);
+        });
+        http::request<http::string_body> client_request{http::verb::get, TARGET, 11};
+        client_request.set(http::field::host, "localhost"sv);
+        if (last_event_id) {
+            client_request.set("Last-Event-ID"sv, *last_event_id);
+        }
+        http::write(socket_, client_request);
+        REQUIRE(RunUntil(ioc_, [this] { return accepted_.has_value(); }));
+        REQUIRE(*accepted_);
+    }
+
+    // Ответ сервера, если зрителю отказано в подключении
+    http::response<http::string_body> ReadResponse() {
+        http::response<http::string_body> response;
+        bool done = false;
+        beast::flat_buffer buffer;
+        http::async_read(socket_, buffer, response, [&done](beast::error_code ec, size_t) {
+            REQUIRE_FALSE(ec);
+            done = true;
+        });
+        REQUIRE(RunUntil(ioc_, [&done] { return done; }));
+        return response;
+    }
+
+    std::optional<std::string> ReadHeader() {
+        return ReadUntil("\r\n\r\n"sv, 5s);
+    }
+
+    // Следующее событие или nullopt, если его нет за timeout или сервер закрыл поток
+    std::optional<std::string> ReadEvent(std::chrono::milliseconds timeout = 5s) {
+        return ReadUntil("\n\n"sv, timeout);
+    }
+
+    bool IsClosed() const noexcept {
+        return closed_;
+    }
+
+private:
+    std::optional<std::string> ReadUntil(std::string_view delimiter, std::chrono::milliseconds timeout) {
+        const auto has_delimiter = [this, delimiter] {
+            return data_.find(delimiter) != std::string::npos;
+        };
+        while (!has_delimiter()) {
+            if (closed_) {
+                return std::nullopt;
+            }
+            if (!reading_) {
+                reading_ = true;
+                socket_.async_read_some(net::buffer(chunk_), [this](beast::error_code ec, size_t size) {
+                    reading_ = false;
+                    if (ec) {
+                        closed_ = true;
+                    } else {
+                        data_.append(chunk_.data(), size);
+                    }
+                });
+            }
+            if (!RunUntil(ioc_, [this] { return !reading_; }, timeout)) {
+                return std::nullopt;
+            }
+        }
+        const size_t end = data_.find(delimiter) + delimiter.size();
+        auto result = data_.substr(0, end);
+        data_.erase(0, end);
+        return result;
+    }
+
+    net::io_context& ioc_;
+    tcp::socket socket_;
+    std::optional<bool> accepted_;
+    std::array<char, 4096> chunk_;
+    std::string data_;
+    bool reading_ = false;
+    bool closed_ = false;
+};
+
+}  // namespace
+
+SCENARIO("Spectator event stream") {
+    GIVEN("a session with a moving player") {
+        auto game = MakeGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto [token, dog_id] = *app.JoinPlayer(MAP_ID, "dog1"s);
+        REQUIRE(app.MovePlayer(token, model::Dog::Direction::EAST));
+        net::io_context ioc;
+        auto strands = std::make_shared<SessionStrands>(ioc, app, net::make_strand(ioc));
+        const size_t max_spectators = 2;
+        auto hub = std::make_shared<SseHub>(app, strands, max_spectators);
+        tcp::acceptor acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        const auto tick = [&] {
+            app.Tick(100ms);
+            hub->OnTick();
+        };
+
+        THEN("requests to other paths are left to the HTTP handler") {
+            http::request<http::string_body> request{http::verb::get, "/api/v1/game/state"s, 11};
+            beast::tcp_stream stream{ioc};
+            CHECK_FALSE(hub->TryAccept(stream, request));
+        }
+
+        WHEN("a spectator connects") {
+            SseClient client{ioc, acceptor, *hub};
+            auto header = client.ReadHeader();
+            REQUIRE(header);
+            CHECK(header->starts_with("HTTP/1.1 200"sv));
+            CHECK(header->find("text/event-stream"sv) != std::string::npos);
+            CHECK(client.ReadEvent() == "retry: 3000\n\n"s);
+
+            THEN("the full state comes first and the changes follow each tick") {
+                auto event = client.ReadEvent();
+                REQUIRE(event);
+                CHECK(HasId(*event, 0));
+                CHECK(IsFull(*event));
+                tick();
+                event = client.ReadEvent();
+                REQUIRE(event);
+                CHECK(HasId(*event, 1));
+                CHECK_FALSE(IsFull(*event));
+            }
+
+            AND_WHEN("more spectators connect than allowed") {
+                SseClient second{ioc, acceptor, *hub};
+                REQUIRE(hub->GetSubscribersCount() == max_spectators);
+                SseClient third{ioc, acceptor, *hub};
+                THEN("the extra one is refused and told when to retry") {
+                    const auto response = third.ReadResponse();
+                    CHECK(response.result() == http::status::service_unavailable);
+                    CHECK(response[http::field::retry_after] == std::to_string(SseHub::HEARTBEAT_PERIOD.count()));
+                    CHECK(hub->GetSubscribersCount() == max_spectators);
+                }
+            }
+
+            AND_WHEN("the spectator does not keep up with the events") {
+                REQUIRE(client.ReadEvent());
+                // Обработчики не выполняются, пока события ставятся в очередь, как при медленном зрителе
+                const size_t pushed = SseConnection::MAX_QUEUED_EVENTS + 4;
+                for (size_t i = 0; i < pushed; ++i) {
+                    tick();
+                }
+                THEN("queued changes are dropped and the full state follows the next tick") {
+                    size_t received = 0;
+                    while (auto event = client.ReadEvent(200ms)) {
+                        CHECK_FALSE(IsFull(*event));
+                        ++received;
+                    }
+                    CHECK(received > 0);
+                    CHECK(received < pushed);
+                    tick();
+                    auto event = client.ReadEvent();
+                    REQUIRE(event);
+                    CHECK(HasId(*event, pushed + 1));
+                    CHECK(IsFull(*event));
+                }
+            }
+
+            AND_WHEN("a spectator reconnects after a few ticks") {
+                REQUIRE(client.ReadEvent());
+                tick();
+                tick();
+                REQUIRE(client.ReadEvent());
+                REQUIRE(client.ReadEvent());
+
+                THEN("it catches up with the changes since the last received event") {
+                    SseClient reconnected{ioc, acceptor, *hub, "1"s};
+                    REQUIRE(reconnected.ReadHeader());
+                    REQUIRE(reconnected.ReadEvent());
+                    auto event = reconnected.ReadEvent();
+                    REQUIRE(event);
+                    CHECK(HasId(*event, 2));
+                    CHECK_FALSE(IsFull(*event));
+                    CHECK(event->find(R"("players")"sv) != std::string::npos);
+                }
+                THEN("an unknown event id leads to the full state") {
+                    SseClient reconnected{ioc, acceptor, *hub, "100"s};
+                    REQUIRE(reconnected.ReadHeader());
+                    REQUIRE(reconnected.ReadEvent());
+                    auto event = reconnected.ReadEvent();
+                    REQUIRE(event);
+                    CHECK(HasId(*event, 2));
+                    CHECK(IsFull(*event));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Spectator heartbeat") {
+    GIVEN("a session where nothing changes") {
+        auto game = MakeGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        REQUIRE(app.JoinPlayer(MAP_ID, "dog1"s));
+        net::io_context ioc;
+        auto strands = std::make_shared<SessionStrands>(ioc, app, net::make_strand(ioc));
+        tcp::acceptor acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        const auto tick = [&app](SseHub& hub) {
+            app.Tick(100ms);
+            hub.OnTick();
+        };
+
+        WHEN("the heartbeat period has not passed") {
+            auto hub = std::make_shared<SseHub>(app, strands, 1);
+            SseClient client{ioc, acceptor, *hub};
+            REQUIRE(client.ReadHeader());
+            REQUIRE(client.ReadEvent());
+            REQUIRE(client.ReadEvent());
+            // Первый тик передаёт присоединившегося игрока
+            tick(*hub);
+            REQUIRE(client.ReadEvent());
+            tick(*hub);
+            THEN("no event is sent") {
+                CHECK_FALSE(client.ReadEvent(200ms));
+            }
+        }
+
+        WHEN("the heartbeat period has passed") {
+            auto hub = std::make_shared<SseHub>(app, strands, 1, 50ms);
+            SseClient client{ioc, acceptor, *hub};
+            REQUIRE(client.ReadHeader());
+            REQUIRE(client.ReadEvent());
+            REQUIRE(client.ReadEvent());
+            tick(*hub);
+            REQUIRE(client.ReadEvent());
+            std::this_thread::sleep_for(60ms);
+            tick(*hub);
+            THEN("an empty event is sent") {
+                auto event = client.ReadEvent();
+                REQUIRE(event);
+                CHECK(HasId(*event, 2));
+                CHECK_FALSE(IsFull(*event));
+                CHECK(event->find(R"("players":{})"sv) != std::string::npos);
+            }
+        }
+    }
+
+    GIVEN("a map where no session has been created yet") {
+        auto game = MakeGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        net::io_context ioc;
+        auto strands = std::make_shared<SessionStrands>(ioc, app, net::make_strand(ioc));
+        tcp::acceptor acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        auto hub = std::make_shared<SseHub>(app, strands, 1);
+        SseClient client{ioc, acceptor, *hub};
+        REQUIRE(client.ReadHeader());
+        REQUIRE(client.ReadEvent());
+        auto first = client.ReadEvent();
+        REQUIRE(first);
+        CHECK(IsFull(*first));
+
+        WHEN("ticks pass") {
+            app.Tick(100ms);
+            hub->OnTick();
+            app.Tick(100ms);
+            hub->OnTick();
+            THEN("the empty state is not sent again") {
+                CHECK_FALSE(client.ReadEvent(200ms));
+            }
+        }
+    }
+}
+
+SCENARIO("Spectator drain before handoff") {
+    GIVEN("a connected spectator") {
+        auto game = MakeGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        REQUIRE(app.JoinPlayer(MAP_ID, "dog1"s));
+        net::io_context ioc;
+        auto strands = std::make_shared<SessionStrands>(ioc, app, net::make_strand(ioc));
+        auto hub = std::make_shared<SseHub>(app, strands, 2);
+        tcp::acceptor acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        SseClient client{ioc, acceptor, *hub};
+        REQUIRE(client.ReadHeader());
+        REQUIRE(client.ReadEvent());
+        REQUIRE(client.ReadEvent());
+
+        WHEN("the hub drains") {
+            hub->Drain();
+
+            THEN("the stream is closed") {
+                CHECK_FALSE(client.ReadEvent());
+                CHECK(client.IsClosed());
+                REQUIRE(RunUntil(ioc, [&] { return hub->GetSubscribersCount() == 0; }));
+            }
+
+            AND_WHEN("a spectator connects before the handoff completes") {
+                SseClient late{ioc, acceptor, *hub};
+                THEN("its stream is closed as well") {
+                    REQUIRE(late.ReadHeader());
+                    REQUIRE(late.ReadEvent());
+                    CHECK_FALSE(late.ReadEvent());
+                    CHECK(late.IsClosed());
+                }
+            }
+
+            AND_WHEN("the handoff is cancelled") {
+                REQUIRE_FALSE(client.ReadEvent());
+                hub->Resume();
+                SseClient again{ioc, acceptor, *hub};
+                THEN("spectators receive events again") {
+                    REQUIRE(again.ReadHeader());
+                    REQUIRE(again.ReadEvent());
+                    auto event = again.ReadEvent();
+                    REQUIRE(event);
+                    CHECK(IsFull(*event));
+                }
+            }
+        }
+    }
+}
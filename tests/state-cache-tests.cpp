@@ -0,0 +1,67 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/http/state_cache.h"
+
+#include <string>
+
+using namespace std::literals;
+using namespace http_handler;
+
+SCENARIO("State cache") {
+    GIVEN("a cache with a stored body") {
+        StateCache cache;
+        const model::Map::Id map1{"map1"s};
+        const auto stored = cache.Store(map1, 1, ResponseEncoding::JSON, "state1"s);
+
+        THEN("the same version and encoding is a hit") {
+            const auto body = cache.Find(map1, 1, ResponseEncoding::JSON);
+            REQUIRE(body);
+            CHECK(body == stored);
+            CHECK(*body == "state1"s);
+        }
+
+        THEN("other encodings have their own slots") {
+            CHECK_FALSE(cache.Find(map1, 1, ResponseEncoding::BINARY));
+            cache.Store(map1, 1, ResponseEncoding::BINARY, "binary1"s);
+            CHECK(*cache.Find(map1, 1, ResponseEncoding::BINARY) == "binary1"s);
+            CHECK(*cache.Find(map1, 1, ResponseEncoding::JSON) == "state1"s);
+            CHECK_FALSE(cache.Find(map1, 1, ResponseEncoding::BINARY_FIXED));
+        }
+
+        WHEN("the session version is bumped") {
+            THEN("the old body is a miss") {
+                CHECK_FALSE(cache.Find(map1, 2, ResponseEncoding::JSON));
+            }
+
+            AND_WHEN("a body of the new version is stored") {
+                cache.Store(map1, 1, ResponseEncoding::BINARY, "binary1"s);
+                cache.Store(map1, 2, ResponseEncoding::JSON, "state2"s);
+                THEN("it replaces all bodies of the old version") {
+                    CHECK(*cache.Find(map1, 2, ResponseEncoding::JSON) == "state2"s);
+                    CHECK_FALSE(cache.Find(map1, 1, ResponseEncoding::JSON));
+                    CHECK_FALSE(cache.Find(map1, 2, ResponseEncoding::BINARY));
+                }
+            }
+        }
+
+        WHEN("a late request stores a body of an older version") {
+            cache.Store(map1, 2, ResponseEncoding::JSON, "state2"s);
+            const auto late = cache.Store(map1, 1, ResponseEncoding::JSON, "state1"s);
+            THEN("the body is returned but not cached") {
+                CHECK(*late == "state1"s);
+                CHECK(*cache.Find(map1, 2, ResponseEncoding::JSON) == "state2"s);
+            }
+        }
+
+        WHEN("a session on another map has the same version") {
+            // Номера сессий после восстановления могут совпадать, поэтому записи различаются картой
+            const model::Map::Id map2{"map2"s};
+            THEN("its body is not shared") {
+                CHECK_FALSE(cache.Find(map2, 1, ResponseEncoding::JSON));
+                cache.Store(map2, 1, ResponseEncoding::JSON, "other"s);
+                CHECK(*cache.Find(map2, 1, ResponseEncoding::JSON) == "other"s);
+                CHECK(*cache.Find(map1, 1, ResponseEncoding::JSON) == "state1"s);
+            }
+        }
+    }
+}
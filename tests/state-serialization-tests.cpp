@@ -2,9 +2,21 @@
 #include <boost/archive/text_oarchive.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_container_properties.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
 #include <sstream>
+#include <thread>
 #include <tuple>
 
+#ifdef __linux__
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+#include "../src/db/in_memory.h"
+#include "../src/model/binary_snapshot.h"
 #include "../src/model/model.h"
 #include "../src/model/model_serialization.h"
 
@@ -210,8 +222,896 @@ SCENARIO_METHOD(Fixture, "Serialization") {
             }
         }
     }
+}
+
+SCENARIO("Binary snapshot") {
+    const auto dog = [] {
+        model::Dog dog{Dog::Id{42}, "Pluto"s, {42.2, 12.5}};
+        dog.AddScore(42);
+        dog.AddLootObjectToBagpack({LootObject::Id{10}, 2u, 15u});
+        dog.AddLootObjectToBagpack({LootObject::Id{4}, 5u, 6u});
+        dog.SetDirection(model::Dog::Direction::EAST);
+        dog.SetSpeed(2.3);
+        dog.SetCoorginates({2.2, 2.5});
+        return dog;
+    }();
+    const LootObject loot_obj(LootObject::Id{7}, 6, 7);
+    const PointDouble loot_obj_coords(20.0, 15.5);
+
+    serialization::ApplicationState state;
+    {
+        model::GameSession::StateContent session;
+        session.map_id = model::Map::Id{"MapId"};
+        session.session_id = model::GameSession::Id{3};
+        session.dogs_join = 43;
+        session.objects_spawned = 8;
+        session.dogs.push_back(dog);
+        session.loot_objects.emplace_back(loot_obj, loot_obj_coords);
+        state.second.push_back(std::move(session));
+
+        app::PlayersState::value_type player;
+        player.token = app::Token{"0123456789abcdef0123456789abcdef"s};
+        player.map_id = model::Map::Id{"MapId"};
+        player.session_id = model::GameSession::Id{3};
+        player.dog_id = Dog::Id{42};
+        state.first.push_back(player);
+    }
+
+    GIVEN("A binary snapshot of the application state") {
+        const auto data = serialization::BinarySnapshot::Write(state);
+
+        THEN("it is restored without losses") {
+            const auto restored = serialization::BinarySnapshot::Read(data);
+            REQUIRE_THAT(restored.first, SizeIs(1));
+            CHECK(*restored.first.front().token == *state.first.front().token);
+            CHECK(*restored.first.front().map_id == "MapId"s);
+            CHECK(*restored.first.front().session_id == 3);
+            CHECK(*restored.first.front().dog_id == 42);
+
+            REQUIRE_THAT(restored.second, SizeIs(1));
+            const auto& session = restored.second.front();
+            CHECK(*session.map_id == "MapId"s);
+            CHECK(*session.session_id == 3);
+            CHECK(session.dogs_join == 43);
+            CHECK(session.objects_spawned == 8);
+            REQUIRE_THAT(session.dogs, SizeIs(1));
+            CheckDogs(session.dogs.front(), dog);
+            REQUIRE_THAT(session.loot_objects, SizeIs(1));
+            CHECK(session.loot_objects.front().first == loot_obj);
+            CHECK(session.loot_objects.front().second == loot_obj_coords);
+        }
+
+        THEN("it is smaller than the text archive") {
+            std::stringstream strm;
+            {
+                OutputArchive output_archive{strm};
+                output_archive << state;
+            }
+            CHECK(data.size() < strm.str().size());
+        }
+
+        THEN("its format is detected by the signature") {
+            std::stringstream binary{data};
+            CHECK(serialization::BinarySnapshot::Detect(binary));
+            // Позиция чтения не сдвигается
+            CHECK(binary.tellg() == 0);
+
+            std::stringstream text;
+            {
+                OutputArchive output_archive{text};
+                output_archive << state;
+            }
+            CHECK_FALSE(serialization::BinarySnapshot::Detect(text));
+
+            std::stringstream empty;
+            CHECK_FALSE(serialization::BinarySnapshot::Detect(empty));
+        }
+
+        THEN("a truncated snapshot is rejected") {
+            for (size_t size = 0; size < data.size(); ++size) {
+                CHECK_THROWS_AS(serialization::BinarySnapshot::Read(std::string_view{data}.substr(0, size)),
+                                std::runtime_error);
+            }
+        }
+
+        THEN("a snapshot of a newer format version is rejected") {
+            auto newer = data;
+            newer[serialization::BinarySnapshot::SIGNATURE.size()] =
+                static_cast<char>(serialization::BinarySnapshot::FORMAT_VERSION + 1);
+            CHECK_THROWS_AS(serialization::BinarySnapshot::Read(newer), std::runtime_error);
+        }
+    }
+
+    GIVEN("A snapshot with a player record of a newer version with an extra field") {
+        const auto token = "0123456789abcdef0123456789abcdef"s;
+        std::string record;
+        record.push_back(static_cast<char>(token.size()));
+        record += token;
+        record += "\x05MapId"s;
+        record.push_back(3);   // session_id
+        record.push_back(42);  // dog_id
+        record += "\x02\x01\x02"s;  // новое поле, незнакомое текущей версии
+
+        std::string data{serialization::BinarySnapshot::SIGNATURE};
+        data.push_back(static_cast<char>(serialization::BinarySnapshot::FORMAT_VERSION));
+        data.push_back(1);  // число игроков
+        data.push_back(static_cast<char>(serialization::BinarySnapshot::PLAYER_VERSION + 1));
+        data.push_back(static_cast<char>(record.size()));
+        data += record;
+        data.push_back(0);  // число сессий
+
+        THEN("the known fields are read and the unknown tail is skipped") {
+            const auto restored = serialization::BinarySnapshot::Read(data);
+            REQUIRE_THAT(restored.first, SizeIs(1));
+            CHECK(*restored.first.front().token == token);
+            CHECK(*restored.first.front().map_id == "MapId"s);
+            CHECK(*restored.first.front().session_id == 3);
+            CHECK(*restored.first.front().dog_id == 42);
+            CHECK(restored.second.empty());
+        }
+    }
+}
+
+SCENARIO("Mapped snapshot") {
+    serialization::ApplicationState state;
+    for (size_t i = 0; i < 5; ++i) {
+        model::GameSession::StateContent session;
+        session.map_id = model::Map::Id{"map"s + std::to_string(i % 2)};
+        session.session_id = model::GameSession::Id{i};
+        session.dogs_join = 10 * i;
+        session.objects_spawned = i;
+        for (size_t j = 0; j < i; ++j) {
+            model::Dog dog{Dog::Id{10 * i + j}, "Dog "s + std::to_string(j), {1.5 * j, 0.25}};
+            dog.AddScore(j);
+            for (size_t k = 0; k < j; ++k) {
+                dog.AddLootObjectToBagpack({LootObject::Id{100 * i + 10 * j + k}, k, 5 * k});
+            }
+            dog.SetDirection(model::Dog::Direction::SOUTH);
+            dog.SetSpeed(1.5);
+            dog.SetCoorginates({1.5 * j, 0.75});
+            session.dogs.push_back(std::move(dog));
+
+            app::PlayersState::value_type player;
+            player.token = app::Token{"token"s + std::to_string(10 * i + j)};
+            player.map_id = session.map_id;
+            player.session_id = session.session_id;
+            player.dog_id = Dog::Id{10 * i + j};
+            state.first.push_back(player);
+        }
+        session.loot_objects.emplace_back(LootObject{LootObject::Id{i}, 1, 2}, PointDouble{0.5 * i, 3.});
+        state.second.push_back(std::move(session));
+    }
+
+    GIVEN("a mapped snapshot of the application state") {
+        const auto data = serialization::MappedSnapshot::Write(state, 7);
+
+        THEN("it is restored without losses") {
+            uint64_t log_segment = 0;
+            const auto restored = serialization::MappedSnapshot::Read(data, &log_segment);
+            CHECK(log_segment == 7);
+            REQUIRE(restored.first.size() == state.first.size());
+            for (size_t i = 0; i < state.first.size(); ++i) {
+                CHECK(*restored.first[i].token == *state.first[i].token);
+                CHECK(*restored.first[i].map_id == *state.first[i].map_id);
+                CHECK(restored.first[i].session_id == state.first[i].session_id);
+                CHECK(restored.first[i].dog_id == state.first[i].dog_id);
+            }
+            REQUIRE(restored.second.size() == state.second.size());
+            for (size_t i = 0; i < state.second.size(); ++i) {
+                const auto& session = restored.second[i];
+                const auto& expected = state.second[i];
+                CHECK(*session.map_id == *expected.map_id);
+                CHECK(session.session_id == expected.session_id);
+                CHECK(session.dogs_join == expected.dogs_join);
+                CHECK(session.objects_spawned == expected.objects_spawned);
+                REQUIRE(session.dogs.size() == expected.dogs.size());
+                for (size_t j = 0; j < expected.dogs.size(); ++j) {
+                    CheckDogs(session.dogs[j], expected.dogs[j]);
+                }
+                REQUIRE(session.loot_objects.size() == expected.loot_objects.size());
+                CHECK(session.loot_objects.front().first == expected.loot_objects.front().first);
+                CHECK(session.loot_objects.front().second == expected.loot_objects.front().second);
+            }
+        }
+
+        THEN("its format is detected by the signature") {
+            std::stringstream mapped{data};
+            CHECK(serialization::MappedSnapshot::Detect(mapped));
+            CHECK(mapped.tellg() == 0);
+            CHECK_FALSE(serialization::BinarySnapshot::Detect(mapped));
+
+            std::stringstream binary{serialization::BinarySnapshot::Write(state)};
+            CHECK_FALSE(serialization::MappedSnapshot::Detect(binary));
+        }
+
+        THEN("a truncated snapshot is rejected") {
+            for (size_t size = 0; size < data.size(); ++size) {
+                CHECK_THROWS_AS(serialization::MappedSnapshot::Read(std::string_view{data}.substr(0, size)),
+                                std::runtime_error);
+            }
+        }
+
+        THEN("a snapshot of a newer format version is rejected") {
+            auto newer = data;
+            newer[serialization::MappedSnapshot::SIGNATURE.size()] =
+                static_cast<char>(serialization::MappedSnapshot::FORMAT_VERSION + 1);
+            CHECK_THROWS_AS(serialization::MappedSnapshot::Read(newer), std::runtime_error);
+        }
+    }
+
+    GIVEN("a game saved in the mapped format") {
+        const auto make_game = [] {
+            model::Game game;
+            for (int i = 0; i < 4; ++i) {
+                model::Map map(model::Map::Id{"map"s + std::to_string(i)}, "map"s);
+                map.SetDogSpeed(1).SetDogBagCapacity(3);
+                map.AddLootTypeWorth(1);
+                map.AddRoad(model::Road(model::Road::HORIZONTAL, {0, 0}, 10));
+                game.AddMap(std::move(map));
+            }
+            return game;
+        };
+        const auto path = std::filesystem::temp_directory_path() / "mapped_snapshot_test.bin";
+        auto game = make_game();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        for (int i = 0; i < 20; ++i) {
+            app.JoinPlayer(model::Map::Id{"map"s + std::to_string(i % 4)}, "Dog "s + std::to_string(i));
+        }
+        {
+            serialization::AppSerializator saver(app, game, path.string(), true, serialization::SnapshotFormat::MAPPED);
+            saver.Serialize();
+        }
+
+        THEN("sessions are restored from the mapped file") {
+            auto restored_game = make_game();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            serialization::AppSerializator loader(restored_app, restored_game, path.string(), true);
+            loader.Restore();
+            for (int i = 0; i < 4; ++i) {
+                const model::Map::Id map_id{"map"s + std::to_string(i)};
+                const auto* session = game.FindGameSession(map_id);
+                const auto* restored = restored_game.FindGameSession(map_id);
+                REQUIRE(restored);
+                REQUIRE(restored->GetDogs().size() == session->GetDogs().size());
+                for (const auto& dog : session->GetDogs()) {
+                    REQUIRE(restored->GetDogById(dog.GetId()));
+                    CheckDogs(dog, *restored->GetDogById(dog.GetId()));
+                }
+            }
+            CHECK(restored_app.GetPlayersState().size() == 20);
+        }
+        std::filesystem::remove(path);
+    }
+}
+
+SCENARIO("Background state saving") {
+    const auto make_game = [] {
+        model::Game game;
+        model::Map map(model::Map::Id{"map1"s}, "map1"s);
+        map.SetDogSpeed(1).SetDogBagCapacity(3);
+        map.AddLootTypeWorth(1);
+        map.AddRoad(model::Road(model::Road::HORIZONTAL, {0, 0}, 10));
+        game.AddMap(std::move(map));
+        return game;
+    };
+    const auto path = std::filesystem::temp_directory_path() / "background_save_test.txt";
+    std::filesystem::remove(path);
+
+    GIVEN("an application with players and a serializator") {
+        auto game = make_game();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        app.JoinPlayer(model::Map::Id{"map1"s}, "Pluto"s);
+        app.JoinPlayer(model::Map::Id{"map1"s}, "Goofy"s);
+        serialization::AppSerializator serializator(app, game, path.string(), true);
+
+        const auto count_restored_dogs = [&] {
+            auto restored_game = make_game();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            serialization::AppSerializator loader(restored_app, restored_game, path.string(), true);
+            loader.Restore();
+            return restored_game.GetGameSessionByMapId(model::Map::Id{"map1"s})->GetDogs().size();
+        };
+
+        WHEN("the state is saved in background") {
+            CHECK(serializator.SerializeInBackground());
+            // Модель можно изменять, пока копия записывается
+            app.JoinPlayer(model::Map::Id{"map1"s}, "Rex"s);
+            serializator.Wait();
+
+            THEN("the file contains the state at the moment of the call") {
+                CHECK(count_restored_dogs() == 2);
+                CHECK_FALSE(std::filesystem::exists(path.parent_path() / "background_save_test_buf"));
+            }
+
+            AND_WHEN("the state is saved again") {
+                CHECK(serializator.SerializeInBackground());
+                serializator.Wait();
+                THEN("the new state replaces the old one") {
+                    CHECK(count_restored_dogs() == 3);
+                }
+            }
+        }
+
+        WHEN("the state is saved synchronously after a background save") {
+            serializator.SerializeInBackground();
+            app.JoinPlayer(model::Map::Id{"map1"s}, "Rex"s);
+            serializator.Serialize();
+            serializator.Wait();
+
+            THEN("the newer state is not overwritten by the background save") {
+                CHECK(count_restored_dogs() == 3);
+            }
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+SCENARIO("Compressed state saving") {
+    const auto make_game = [] {
+        model::Game game;
+        for (int i = 0; i < 2; ++i) {
+            model::Map map(model::Map::Id{"map"s + std::to_string(i)}, "map"s);
+            map.SetDogSpeed(1).SetDogBagCapacity(3);
+            map.AddLootTypeWorth(1);
+            map.AddRoad(model::Road(model::Road::HORIZONTAL, {0, 0}, 10));
+            game.AddMap(std::move(map));
+        }
+        return game;
+    };
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto path = dir / "compressed_save_test.bin";
+    const auto plain_path = dir / "compressed_save_test_plain.bin";
 
+    GIVEN("an application with players") {
+        auto game = make_game();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        for (int i = 0; i < 100; ++i) {
+            app.JoinPlayer(model::Map::Id{"map"s + std::to_string(i % 2)}, "Dog "s + std::to_string(i));
+        }
+        app.Tick(100ms);
+
+        const auto check_restored = [&] {
+            auto restored_game = make_game();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            // Уровень сжатия при восстановлении не задаётся: формат определяется по файлу
+            serialization::AppSerializator loader(restored_app, restored_game, path.string(), true);
+            loader.Restore();
+            for (int i = 0; i < 2; ++i) {
+                const model::Map::Id map_id{"map"s + std::to_string(i)};
+                const auto* session = game.FindGameSession(map_id);
+                const auto* restored = restored_game.FindGameSession(map_id);
+                REQUIRE(restored);
+                REQUIRE(restored->GetDogs().size() == session->GetDogs().size());
+                for (const auto& dog : session->GetDogs()) {
+                    REQUIRE(restored->GetDogById(dog.GetId()));
+                    CheckDogs(dog, *restored->GetDogById(dog.GetId()));
+                }
+            }
+            CHECK(restored_app.GetPlayersState().size() == 100);
+        };
+        const auto read_file = [](const std::filesystem::path& file) {
+            std::ifstream in{file, std::ios::binary};
+            return std::string{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+        };
 
+        WHEN("the state is saved with compression in each format") {
+            THEN("the file is smaller than the uncompressed one and is restored without losses") {
+                for (auto format : {serialization::SnapshotFormat::TEXT, serialization::SnapshotFormat::BINARY,
+                                    serialization::SnapshotFormat::MAPPED}) {
+                    {
+                        serialization::AppSerializator saver(app, game, plain_path.string(), true, format);
+                        saver.Serialize();
+                    }
+                    {
+                        serialization::AppSerializator saver(app, game, path.string(), true, format);
+                        saver.SetCompressionLevel(6);
+                        saver.Serialize();
+                    }
+                    const auto data = read_file(path);
+                    CHECK(data.starts_with("\x1f\x8b"sv));
+                    CHECK(data.size() < std::filesystem::file_size(plain_path));
+                    check_restored();
+                }
+            }
+        }
+
+        WHEN("sessions are saved incrementally with compression") {
+            {
+                serialization::AppSerializator saver(app, game, path.string(), true,
+                                                     serialization::SnapshotFormat::BINARY);
+                saver.SetIncremental(true);
+                saver.SetCompressionLevel(1);
+                saver.Serialize();
+            }
+            THEN("session files are compressed and restored") {
+                size_t compressed_files = 0;
+                for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+                    if (entry.path().filename().string().starts_with("compressed_save_test_session_"s)) {
+                        compressed_files += read_file(entry.path()).starts_with("\x1f\x8b"sv);
+                    }
+                }
+                CHECK(compressed_files == 2);
+                check_restored();
+            }
+        }
 
+        WHEN("a compressed file is truncated") {
+            {
+                serialization::AppSerializator saver(app, game, path.string(), true,
+                                                     serialization::SnapshotFormat::BINARY);
+                saver.SetCompressionLevel(6);
+                saver.Serialize();
+            }
+            const auto data = read_file(path);
+            {
+                std::ofstream out{path, std::ios::binary | std::ios::trunc};
+                out.write(data.data(), data.size() / 2);
+            }
+            THEN("restore fails") {
+                auto restored_game = make_game();
+                app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+                serialization::AppSerializator loader(restored_app, restored_game, path.string(), true);
+                CHECK_THROWS_AS(loader.Restore(), std::runtime_error);
+            }
+        }
 
-}
\ No newline at end of file
+        THEN("an invalid compression level is rejected") {
+            serialization::AppSerializator saver(app, game, path.string(), true);
+            CHECK_THROWS_AS(saver.SetCompressionLevel(10), std::invalid_argument);
+        }
+    }
+    std::filesystem::remove(path);
+    std::filesystem::remove(plain_path);
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().filename().string().starts_with("compressed_save_test_session_"s)) {
+            std::filesystem::remove(entry.path());
+        }
+    }
+}
+
+SCENARIO("Incremental state saving") {
+    const auto make_game = [] {
+        model::Game game;
+        // Стоящие собаки не уходят на покой, поэтому тик без движения не изменяет сессии
+        game.SetDogRetirementTime(60000);
+        for (int i = 0; i < 3; ++i) {
+            model::Map map(model::Map::Id{"map"s + std::to_string(i)}, "map"s);
+            map.SetDogSpeed(1).SetDogBagCapacity(3);
+            map.AddLootTypeWorth(1);
+            map.AddRoad(model::Road(model::Road::HORIZONTAL, {0, 0}, 10));
+            game.AddMap(std::move(map));
+        }
+        return game;
+    };
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto path = dir / "incremental_save_test.bin";
+    const auto count_session_files = [&dir] {
+        size_t count = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            count += entry.path().filename().string().starts_with("incremental_save_test_session_"s);
+        }
+        return count;
+    };
+    std::filesystem::remove(path);
+
+    GIVEN("an application with three sessions saved incrementally") {
+        auto game = make_game();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        std::vector<app::Token> tokens;
+        for (int i = 0; i < 6; ++i) {
+            tokens.push_back(app.JoinPlayer(model::Map::Id{"map"s + std::to_string(i % 3)}, "Dog"s)->first);
+        }
+        metrics::Registry registry;
+        serialization::AppSerializator serializator(app, game, path.string(), true,
+                                                    serialization::SnapshotFormat::BINARY, &registry);
+        serializator.SetIncremental(true);
+        serializator.Serialize();
+        auto& written = registry.AddCounter("game_state_sessions_written_total"sv, ""sv);
+        auto& reused = registry.AddCounter("game_state_sessions_reused_total"sv, ""sv);
+        REQUIRE(written.Get() == 3);
+        REQUIRE(count_session_files() == 3);
+
+        const auto restore = [&](model::Game& restored_game, app::Application& restored_app) {
+            serialization::AppSerializator loader(restored_app, restored_game, path.string(), true);
+            loader.Restore();
+            for (int i = 0; i < 3; ++i) {
+                const model::Map::Id map_id{"map"s + std::to_string(i)};
+                const auto* session = game.FindGameSession(map_id);
+                const auto* restored = restored_game.FindGameSession(map_id);
+                REQUIRE(restored);
+                REQUIRE(restored->GetDogs().size() == session->GetDogs().size());
+                for (const auto& dog : session->GetDogs()) {
+                    REQUIRE(restored->GetDogById(dog.GetId()));
+                    CheckDogs(dog, *restored->GetDogById(dog.GetId()));
+                }
+            }
+            CHECK(restored_app.GetPlayersState().size() == app.GetPlayersState().size());
+        };
+
+        WHEN("nothing changes but ticks pass") {
+            app.Tick(100ms);
+            serializator.Serialize();
+            THEN("no session file is rewritten") {
+                CHECK(written.Get() == 3);
+                CHECK(reused.Get() == 3);
+                CHECK(count_session_files() == 3);
+            }
+        }
+
+        WHEN("a dog moves in one session") {
+            app.MovePlayer(tokens.front(), model::Dog::Direction::EAST);
+            app.Tick(100ms);
+            serializator.Serialize();
+
+            THEN("only its session file is rewritten and the old one is removed") {
+                CHECK(written.Get() == 4);
+                CHECK(reused.Get() == 2);
+                CHECK(count_session_files() == 3);
+            }
+
+            THEN("the base and the latest session files restore the state") {
+                auto restored_game = make_game();
+                app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+                restore(restored_game, restored_app);
+            }
+        }
+
+        WHEN("the state is restored and saved again") {
+            auto restored_game = make_game();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            metrics::Registry restored_registry;
+            serialization::AppSerializator loader(restored_app, restored_game, path.string(), true,
+                                                  serialization::SnapshotFormat::BINARY, &restored_registry);
+            loader.SetIncremental(true);
+            loader.Restore();
+            loader.Serialize();
+
+            THEN("the restored session files are kept") {
+                CHECK(restored_registry.AddCounter("game_state_sessions_written_total"sv, ""sv).Get() == 0);
+                CHECK(count_session_files() == 3);
+            }
+        }
+
+        WHEN("the restored state changes and is saved by the new process") {
+            const auto read_session_files = [&dir] {
+                std::map<std::string, std::string> files;
+                for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+                    const auto name = entry.path().filename().string();
+                    if (name.starts_with("incremental_save_test_session_"s)) {
+                        std::ifstream in{entry.path(), std::ios::binary};
+                        files[name].assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                    }
+                }
+                return files;
+            };
+            const auto before = read_session_files();
+
+            auto restored_game = make_game();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            serialization::AppSerializator loader(restored_app, restored_game, path.string(), true,
+                                                  serialization::SnapshotFormat::BINARY);
+            loader.SetIncremental(true);
+            loader.Restore();
+            restored_app.MovePlayer(tokens.front(), model::Dog::Direction::EAST);
+            loader.Serialize();
+            const auto after = read_session_files();
+
+            THEN("the changed session is written to a new file and no referenced file is rewritten") {
+                CHECK(after.size() == 3);
+                size_t new_files = 0;
+                for (const auto& [name, content] : after) {
+                    if (const auto it = before.find(name); it != before.end()) {
+                        CHECK(it->second == content);
+                    } else {
+                        ++new_files;
+                    }
+                }
+                CHECK(new_files == 1);
+            }
+        }
+
+        WHEN("the state is saved as a single file") {
+            serialization::AppSerializator single(app, game, path.string(), true);
+            single.Serialize();
+
+            THEN("session files are removed") {
+                CHECK(count_session_files() == 0);
+                auto restored_game = make_game();
+                app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+                restore(restored_game, restored_app);
+            }
+        }
+    }
+    std::filesystem::remove(path);
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().filename().string().starts_with("incremental_save_test_session_"s)) {
+            std::filesystem::remove(entry.path());
+        }
+    }
+}
+
+namespace {
+
+model::Game MakeActionLogGame() {
+    model::Game game;
+    game.SetRandomSpawn(true);
+    game.SetLootGeneratorParams(1., 0.5);
+    game.SetDogRetirementTime(2000);
+    model::Map map(model::Map::Id{"map1"s}, "map1"s);
+    map.SetDogSpeed(2.).SetDogBagCapacity(3);
+    map.AddLootTypeWorth(10);
+    map.AddLootTypeWorth(20);
+    map.AddRoad(model::Road(model::Road::HORIZONTAL, {0, 0}, 40));
+    map.AddRoad(model::Road(model::Road::VERTICAL, {0, 0}, 40));
+    game.AddMap(std::move(map));
+    return game;
+}
+
+void CheckSameSessions(model::Game& lhs, model::Game& rhs) {
+    const auto* lhs_session = lhs.FindGameSession(model::Map::Id{"map1"s});
+    const auto* rhs_session = rhs.FindGameSession(model::Map::Id{"map1"s});
+    REQUIRE(lhs_session);
+    REQUIRE(rhs_session);
+    REQUIRE(lhs_session->GetDogs().size() == rhs_session->GetDogs().size());
+    for (const auto& dog : lhs_session->GetDogs()) {
+        const auto* restored = rhs_session->GetDogById(dog.GetId());
+        REQUIRE(restored);
+        CheckDogs(dog, *restored);
+    }
+    REQUIRE(lhs_session->GetLootObjects().size() == rhs_session->GetLootObjects().size());
+    for (const auto& [id, loot] : lhs_session->GetLootObjects()) {
+        REQUIRE(rhs_session->GetLootObjects().contains(id));
+        CHECK(rhs_session->GetLootObjects().at(id) == loot);
+        CHECK(rhs_session->GetLootCoordsById(id) == lhs_session->GetLootCoordsById(id));
+    }
+}
+
+void RemoveActionLogFiles(const std::filesystem::path& state_path) {
+    for (const auto& entry : std::filesystem::directory_iterator(state_path.parent_path())) {
+        if (entry.path().filename().string().starts_with(state_path.stem().string())) {
+            std::filesystem::remove(entry.path());
+        }
+    }
+}
+
+size_t CountLogSegments(const std::filesystem::path& state_path) {
+    size_t count = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(state_path.parent_path())) {
+        if (entry.path().filename().string().starts_with(state_path.stem().string() + "_log_"s)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+}  // namespace
+
+SCENARIO("Action log records") {
+    GIVEN("records of every type") {
+        const std::vector<app::LogRecord> records{
+            app::log_record::Join{model::Map::Id{"map1"s}, model::GameSession::Id{2}, app::Token{"token"s},
+                                  model::Dog::Id{7}, "Rex"s, {1.5, 2.25}},
+            app::log_record::Move{app::Token{"token"s}, model::Dog::Direction::WEST},
+            app::log_record::Stop{app::Token{"token"s}},
+            app::log_record::Tick{model::Map::Id{"map1"s}, 50ms, {{model::LootObject::Id{3}, 1, {4., 5.5}}}},
+            app::log_record::Retire{model::Map::Id{"map1"s}, model::Dog::Id{7}},
+        };
+        std::string segment{app::ActionLog::SIGNATURE};
+        segment.push_back(static_cast<char>(app::ActionLog::FORMAT_VERSION));
+        for (const auto& record : records) {
+            segment += app::ActionLog::EncodeRecord(record);
+        }
+
+        THEN("they are read back") {
+            const auto restored = app::ActionLog::ReadSegment(segment);
+            REQUIRE(restored.size() == records.size());
+            const auto& join = std::get<app::log_record::Join>(restored[0]);
+            CHECK(*join.map_id == "map1"s);
+            CHECK(*join.session_id == 2);
+            CHECK(*join.token == "token"s);
+            CHECK(*join.dog_id == 7);
+            CHECK(join.name == "Rex"s);
+            CHECK(join.spawn_point == PointDouble{1.5, 2.25});
+            CHECK(std::get<app::log_record::Move>(restored[1]).direction == model::Dog::Direction::WEST);
+            CHECK(*std::get<app::log_record::Stop>(restored[2]).token == "token"s);
+            const auto& tick = std::get<app::log_record::Tick>(restored[3]);
+            CHECK(tick.delta == 50ms);
+            REQUIRE(tick.spawned_loot.size() == 1);
+            CHECK(*tick.spawned_loot.front().id == 3);
+            CHECK(tick.spawned_loot.front().type == 1);
+            CHECK(tick.spawned_loot.front().coords == PointDouble{4., 5.5});
+            CHECK(*std::get<app::log_record::Retire>(restored[4]).dog_id == 7);
+        }
+
+        THEN("a record torn by a crash and everything after it are dropped") {
+            auto torn = segment;
+            torn.pop_back();
+            CHECK(app::ActionLog::ReadSegment(torn).size() == records.size() - 1);
+            auto corrupted = segment;
+            corrupted.back() ^= 1;
+            CHECK(app::ActionLog::ReadSegment(corrupted).size() == records.size() - 1);
+            CHECK(app::ActionLog::ReadSegment(std::string_view{app::ActionLog::SIGNATURE}.substr(0, 3)).empty());
+        }
+    }
+}
+
+SCENARIO("Action log recovery") {
+    const auto state_path = std::filesystem::temp_directory_path() / "action_log_test_state";
+    RemoveActionLogFiles(state_path);
+
+    GIVEN("a game with random spawn and loot whose actions are logged") {
+        auto game = MakeActionLogGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        {
+            app::ActionLog log{state_path};
+            log.Recover(app, 0);
+            log.Start();
+            app.SetActionLog(&log);
+
+            auto first = app.JoinPlayer(model::Map::Id{"map1"s}, "Pluto"s);
+            auto second = app.JoinPlayer(model::Map::Id{"map1"s}, "Goofy"s);
+            app.MovePlayer(first->first, model::Dog::Direction::EAST);
+            app.MovePlayer(second->first, model::Dog::Direction::SOUTH);
+            for (int i = 0; i < 20; ++i) {
+                app.Tick(100ms);
+                if (i == 5) {
+                    app.StopPlayer(first->first);
+                    app.MovePlayer(second->first, model::Dog::Direction::NORTH);
+                }
+            }
+            // Первый игрок уходит на покой
+            for (int i = 0; i < 5; ++i) {
+                app.Tick(500ms);
+            }
+            app.SetActionLog(nullptr);
+        }
+        REQUIRE_FALSE(app.Records(0, 10).empty());
+
+        WHEN("the log is replayed into an empty game") {
+            auto restored_game = MakeActionLogGame();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            app::ActionLog log{state_path};
+            const auto replayed = log.Recover(restored_app, 0);
+
+            THEN("the game state is the same") {
+                CHECK(replayed > 25);
+                CheckSameSessions(game, restored_game);
+                CHECK(restored_app.GetPlayersState().size() == app.GetPlayersState().size());
+                // Рекорд ушедшего игрока не сохраняется повторно
+                CHECK(restored_app.Records(0, 10).empty());
+            }
+        }
+    }
+
+    GIVEN("a game saved in background while actions are logged") {
+        auto game = MakeActionLogGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        {
+            app::ActionLog log{state_path};
+            serialization::AppSerializator serializator(app, game, state_path.string(), true,
+                                                        serialization::SnapshotFormat::BINARY);
+            log.Recover(app, 0);
+            log.Start();
+            app.SetActionLog(&log);
+            serializator.SetActionLog(&log);
+
+            auto player = app.JoinPlayer(model::Map::Id{"map1"s}, "Pluto"s);
+            app.MovePlayer(player->first, model::Dog::Direction::EAST);
+            app.Tick(300ms);
+            REQUIRE(serializator.SerializeInBackground());
+            serializator.Wait();
+            app.JoinPlayer(model::Map::Id{"map1"s}, "Goofy"s);
+            app.Tick(300ms);
+            app.SetActionLog(nullptr);
+            // Сервер завершается без сохранения состояния
+        }
+
+        THEN("segments before the snapshot are removed") {
+            CHECK(CountLogSegments(state_path) == 1);
+        }
+
+        WHEN("the snapshot is restored and the rest of the log is replayed") {
+            auto restored_game = MakeActionLogGame();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            serialization::AppSerializator loader(restored_app, restored_game, state_path.string(), true);
+            loader.Restore();
+            app::ActionLog log{state_path};
+            const auto replayed = log.Recover(restored_app, loader.GetLogSegment());
+
+            THEN("the game state is the same") {
+                CHECK(loader.GetLogSegment() == 1);
+                CHECK(replayed == 2);
+                CheckSameSessions(game, restored_game);
+                CHECK(restored_app.GetPlayersState().size() == 2);
+            }
+        }
+    }
+
+#ifdef __linux__
+    GIVEN("a group commit torn by a failed write") {
+        auto game = MakeActionLogGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto segment_path = state_path.parent_path() / (state_path.stem().string() + "_log_0"s);
+        {
+            metrics::Registry registry;
+            app::ActionLog log{state_path, &registry};
+            const auto& commits = registry.AddCounter("game_action_log_commits_total"sv, ""sv);
+            const auto& errors = registry.AddCounter("game_action_log_errors_total"sv, ""sv);
+            const auto wait_for = [](const metrics::Counter& counter, uint64_t value) {
+                const auto deadline = std::chrono::steady_clock::now() + 5s;
+                while (counter.Get() < value && std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::sleep_for(1ms);
+                }
+                return counter.Get() >= value;
+            };
+            log.Recover(app, 0);
+            log.Start();
+            app.SetActionLog(&log);
+
+            auto player = app.JoinPlayer(model::Map::Id{"map1"s}, "Pluto"s);
+            app.MovePlayer(player->first, model::Dog::Direction::EAST);
+            app.Tick(100ms);
+            REQUIRE(wait_for(commits, 1));
+            const auto committed_size = std::filesystem::file_size(segment_path);
+
+            // Превышение лимита размера файла дописывает часть группы, а затем write завершается ошибкой
+            rlimit limit{};
+            REQUIRE(::getrlimit(RLIMIT_FSIZE, &limit) == 0);
+            const auto previous_handler = std::signal(SIGXFSZ, SIG_IGN);
+            rlimit small_limit = limit;
+            small_limit.rlim_cur = committed_size + 3;
+            REQUIRE(::setrlimit(RLIMIT_FSIZE, &small_limit) == 0);
+            app.JoinPlayer(model::Map::Id{"map1"s}, "Goofy"s);
+            app.Tick(100ms);
+            const bool failed = wait_for(errors, 1);
+            ::setrlimit(RLIMIT_FSIZE, &limit);
+            std::signal(SIGXFSZ, previous_handler);
+            REQUIRE(failed);
+            CHECK(std::filesystem::file_size(segment_path) == committed_size);
+
+            app.Tick(100ms);
+            REQUIRE(wait_for(commits, 2));
+            app.SetActionLog(nullptr);
+        }
+
+        WHEN("the log is replayed") {
+            auto restored_game = MakeActionLogGame();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            app::ActionLog log{state_path};
+            log.Recover(restored_app, 0);
+
+            THEN("the failed group is written again after the last complete record") {
+                CheckSameSessions(game, restored_game);
+                CHECK(restored_app.GetPlayersState().size() == 2);
+            }
+        }
+    }
+#endif
+
+    GIVEN("text snapshots saved with and without the action log") {
+        auto game = MakeActionLogGame();
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        app.JoinPlayer(model::Map::Id{"map1"s}, "Pluto"s);
+        serialization::AppSerializator serializator(app, game, state_path.string(), true,
+                                                    serialization::SnapshotFormat::TEXT);
+
+        const auto restore_log_segment = [&state_path] {
+            auto restored_game = MakeActionLogGame();
+            app::Application restored_app(restored_game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+            serialization::AppSerializator loader(restored_app, restored_game, state_path.string(), true);
+            loader.Restore();
+            return loader.GetLogSegment();
+        };
+
+        THEN("the log segment is restored only from the snapshot that has it") {
+            serializator.Serialize();
+            CHECK(restore_log_segment() == 0);
+            app::ActionLog log{state_path};
+            serializator.SetActionLog(&log);
+            serializator.Serialize();
+            CHECK(restore_log_segment() == 1);
+            serializator.SetActionLog(nullptr);
+        }
+    }
+    RemoveActionLogFiles(state_path);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "../src/model/model.h"
+
+#include <string>
+
+namespace test_game {
+
+using namespace std::literals;
+
+// Карта с одной горизонтальной дорогой от (0, road_y) длиной road_length и одним типом трофеев
+inline model::Map MakeMap(const std::string& id = "map1"s, geom::Coord road_length = 10, geom::Coord road_y = 0) {
+    model::Map map(model::Map::Id{id}, id);
+    map.SetDogSpeed(1).SetDogBagCapacity(3);
+    map.AddLootTypeWorth(1);
+    map.AddRoad(model::Road(model::Road::HORIZONTAL, {0, road_y}, road_length));
+    return map;
+}
+
+// Игра с единственной картой map1. При нулевом retirement_time собаки уходят на покой на первом же тике
+inline model::Game MakeGame(geom::Coord road_length = 10, size_t retirement_time = 0) {
+    model::Game game;
+    game.SetDogRetirementTime(retirement_time);
+    game.AddMap(MakeMap("map1"s, road_length));
+    return game;
+}
+
+}  // namespace test_game
@@ -0,0 +1,250 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/db/in_memory.h"
+#include "../src/http/ws_channel.h"
+#include "test-game.h"
+#include "ws-test-client.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+
+using namespace std::literals;
+using namespace http_handler;
+using ws_test::RunUntil;
+using ws_test::WsClient;
+using tcp = net::ip::tcp;
+
+namespace {
+
+bool IsFull(const std::string& frame) {
+    return frame.find(R"("full":true)"sv) != std::string::npos;
+}
+
+}  // namespace
+
+SCENARIO("WebSocket state frames") {
+    GIVEN("a player connected over WebSocket") {
+        auto game = test_game::MakeGame(1000, 60000);
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto [token, dog_id] = *app.JoinPlayer(model::Map::Id{"map1"s}, "dog1"s);
+        net::io_context ioc;
+        auto strands = std::make_shared<SessionStrands>(ioc, app, net::make_strand(ioc));
+        auto hub = std::make_shared<WsHub>(app, strands);
+        tcp::acceptor acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        WsClient client{ioc, acceptor, *hub, *token};
+        const auto tick = [&] {
+            app.Tick(100ms);
+            hub->OnTick();
+        };
+
+        THEN("the full state comes first") {
+            auto frame = client.Read();
+            REQUIRE(frame);
+            CHECK(IsFull(*frame));
+        }
+
+        WHEN("a tick passes") {
+            REQUIRE(client.Read());
+            tick();
+            THEN("the player receives the changes") {
+                auto frame = client.Read();
+                REQUIRE(frame);
+                CHECK_FALSE(IsFull(*frame));
+                CHECK(frame->find(R"("seq":1)"sv) != std::string::npos);
+            }
+        }
+
+        WHEN("the hub is notified but the session tick sequence has not changed") {
+            REQUIRE(client.Read());
+            hub->OnTick();
+            THEN("no frame is sent until the next session tick") {
+                CHECK_FALSE(client.Read(200ms));
+                tick();
+                auto frame = client.Read();
+                REQUIRE(frame);
+                CHECK(frame->find(R"("seq":1)"sv) != std::string::npos);
+            }
+        }
+
+        WHEN("the player does not keep up with the frames") {
+            REQUIRE(client.Read());
+            REQUIRE(app.MovePlayer(token, model::Dog::Direction::EAST));
+            // Обработчики не выполняются, пока кадры ставятся в очередь, как при медленном клиенте
+            const size_t pushed = WsConnection::MAX_QUEUED_FRAMES + 4;
+            for (size_t i = 0; i < pushed; ++i) {
+                tick();
+            }
+
+            THEN("queued changes are dropped and the full state follows the next tick") {
+                size_t received = 0;
+                while (auto frame = client.Read(200ms)) {
+                    CHECK_FALSE(IsFull(*frame));
+                    ++received;
+                }
+                CHECK(received > 0);
+                CHECK(received < pushed);
+                tick();
+                auto frame = client.Read();
+                REQUIRE(frame);
+                CHECK(IsFull(*frame));
+            }
+        }
+    }
+}
+
+SCENARIO("WebSocket actions") {
+    GIVEN("a player connected without a token in the upgrade request") {
+        auto game = test_game::MakeGame(1000, 60000);
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto [token, dog_id] = *app.JoinPlayer(model::Map::Id{"map1"s}, "dog1"s);
+        net::io_context ioc;
+        auto strands = std::make_shared<SessionStrands>(ioc, app, net::make_strand(ioc));
+        auto hub = std::make_shared<WsHub>(app, strands);
+        tcp::acceptor acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        WsClient client{ioc, acceptor, *hub, std::nullopt};
+
+        WHEN("the first frame carries the token") {
+            client.Send(R"({"authToken": ")"s + *token + R"("})"s);
+            auto frame = client.Read();
+            REQUIRE(frame);
+            CHECK(IsFull(*frame));
+
+            AND_WHEN("the player sends a move") {
+                const auto before = app.GetSnapshot(token);
+                client.Send(R"({"move": "R"})"sv);
+                REQUIRE(RunUntil(ioc, [&] { return app.GetSnapshot(token) != before; }));
+
+                THEN("it runs in the session strand, which publishes the new snapshot") {
+                    CHECK_FALSE(app.IsSnapshotStale(model::Map::Id{"map1"s}));
+                    CHECK(app.GetSnapshot(token)->state.players.front().dir == model::Dog::Direction::EAST);
+                }
+            }
+
+            AND_WHEN("the player sends a malformed action") {
+                client.Send(R"({"move": "X"})"sv);
+                THEN("an error frame is sent and the connection stays open") {
+                    auto error = client.Read();
+                    REQUIRE(error);
+                    CHECK(error->find("invalidArgument"sv) != std::string::npos);
+                    client.Send(R"({"move": "L"})"sv);
+                    REQUIRE(RunUntil(ioc, [&] {
+                        return app.GetSnapshot(token)->state.players.front().dir == model::Dog::Direction::WEST;
+                    }));
+                }
+            }
+        }
+
+        WHEN("the first frame carries an unknown token") {
+            client.Send(R"({"authToken": "0123456789abcdef0123456789abcdef"})"sv);
+            THEN("the connection is closed with an error") {
+                auto error = client.Read();
+                REQUIRE(error);
+                CHECK(error->find("unknownToken"sv) != std::string::npos);
+                CHECK_FALSE(client.Read());
+            }
+        }
+    }
+}
+
+SCENARIO("WebSocket drain before handoff") {
+    GIVEN("an authenticated player") {
+        auto game = test_game::MakeGame(1000, 60000);
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto [token, dog_id] = *app.JoinPlayer(model::Map::Id{"map1"s}, "dog1"s);
+        net::io_context ioc;
+        auto strands = std::make_shared<SessionStrands>(ioc, app, net::make_strand(ioc));
+        auto hub = std::make_shared<WsHub>(app, strands);
+        tcp::acceptor acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        WsClient client{ioc, acceptor, *hub, *token};
+        REQUIRE(client.Read());
+
+        WHEN("the hub drains") {
+            hub->Drain();
+
+            THEN("the connection is closed with going_away") {
+                CHECK_FALSE(client.Read());
+                CHECK(client.IsClosed());
+                CHECK(client.GetCloseCode() == websocket::close_code::going_away);
+                CHECK(hub->IsDraining());
+            }
+
+            AND_WHEN("a player connects before the handoff completes") {
+                WsClient late{ioc, acceptor, *hub, *token};
+                THEN("the connection is closed as well") {
+                    CHECK_FALSE(late.Read());
+                    CHECK(late.GetCloseCode() == websocket::close_code::going_away);
+                }
+            }
+
+            AND_WHEN("the handoff is cancelled") {
+                REQUIRE_FALSE(client.Read());
+                hub->Resume();
+                WsClient again{ioc, acceptor, *hub, *token};
+                THEN("players connect and act again") {
+                    auto frame = again.Read();
+                    REQUIRE(frame);
+                    CHECK(IsFull(*frame));
+                    again.Send(R"({"move": "R"})"sv);
+                    REQUIRE(RunUntil(ioc, [&] {
+                        return app.GetSnapshot(token)->state.players.front().dir == model::Dog::Direction::EAST;
+                    }));
+                    CHECK(hub->GetPendingActions() == 0);
+                }
+            }
+        }
+
+        WHEN("the hub drains while an action waits in the session strand") {
+            client.Send(R"({"move": "R"})"sv);
+            REQUIRE(RunUntil(ioc, [&] { return hub->GetPendingActions() != 0; }));
+            hub->Drain();
+
+            THEN("the action is still applied") {
+                REQUIRE(RunUntil(ioc, [&] {
+                    return app.GetSnapshot(token)->state.players.front().dir == model::Dog::Direction::EAST;
+                }));
+                CHECK(hub->GetPendingActions() == 0);
+                CHECK_FALSE(client.Read());
+                CHECK(client.GetCloseCode() == websocket::close_code::going_away);
+            }
+        }
+    }
+}
+
+SCENARIO("WebSocket players of a restored session") {
+    GIVEN("a session restored from the state file and a player who joins another map") {
+        auto game = test_game::MakeGame(1000, 60000);
+        game.AddMap(test_game::MakeMap("map2"s, 1000, 10));
+        // Восстановленная сессия сохраняет свой номер
+        REQUIRE(game.AddGameSession(model::Map::Id{"map1"s}, 0));
+        app::Application app(game, std::make_unique<in_memory::UnitOfWorkFactoryImpl>());
+        const auto [token1, dog_id1] = *app.JoinPlayer(model::Map::Id{"map1"s}, "dog1"s);
+        const auto [token2, dog_id2] = *app.JoinPlayer(model::Map::Id{"map2"s}, "dog2"s);
+        net::io_context ioc;
+        auto strands = std::make_shared<SessionStrands>(ioc, app, net::make_strand(ioc));
+        auto hub = std::make_shared<WsHub>(app, strands);
+        tcp::acceptor acceptor{ioc, {net::ip::address_v4::loopback(), 0}};
+        WsClient client1{ioc, acceptor, *hub, *token1};
+        WsClient client2{ioc, acceptor, *hub, *token2};
+        REQUIRE(client1.Read());
+        REQUIRE(client2.Read());
+
+        THEN("the new session gets its own id") {
+            CHECK(app.GetStateVersion(model::Map::Id{"map1"s})->session_id
+                  != app.GetStateVersion(model::Map::Id{"map2"s})->session_id);
+        }
+
+        WHEN("a tick passes") {
+            app.Tick(100ms);
+            hub->OnTick();
+            THEN("each player receives the state of its own map") {
+                auto frame1 = client1.Read();
+                auto frame2 = client2.Read();
+                REQUIRE(frame1);
+                REQUIRE(frame2);
+                CHECK(frame1->find(R"("pos":[0E0,0E0])"sv) != std::string::npos);
+                CHECK(frame2->find(R"("pos":[0E0,1E1])"sv) != std::string::npos);
+            }
+        }
+    }
+}
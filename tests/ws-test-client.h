@@ -0,0 +1,106 @@
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/http/ws_channel.h"
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace ws_test {
+
+using namespace std::literals;
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+using tcp = net::ip::tcp;
+
+// Выполняет готовые обработчики, пока не выполнится условие или не истечёт timeout
+template <typename Predicate>
+bool RunUntil(net::io_context& ioc, Predicate&& done, std::chrono::milliseconds timeout = 5s) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+        ioc.restart();
+        ioc.run_one_for(10ms);
+    }
+    return done();
+}
+
+// Клиент, подключённый к хабу через loopback. Запрос на upgrade сервер читает так же, как HTTP-сессия.
+class WsClient {
+public:
+    WsClient(net::io_context& ioc, tcp::acceptor& acceptor, http_handler::WsHub& hub,
+             std::optional<std::string> token)
+        : ioc_{ioc}
+        , ws_{ioc} {
+        ws_.next_layer().connect(acceptor.local_endpoint());
+        auto server = std::make_shared<beast::tcp_stream>(acceptor.accept());
+        auto buffer = std::make_shared<beast::flat_buffer>();
+        auto request = std::make_shared<http::request<http::string_body>>();
+        http::async_read(*server, *buffer, *request, [&hub, server, buffer, request](beast::error_code ec, size_t) {
+            REQUIRE_FALSE(ec);
+            hub.Accept(std::move(*server), std::move(*request));
+        });
+        if (token) {
+            ws_.set_option(websocket::stream_base::decorator([token = *token](websocket::request_type& req) {
+                req.set(http::field::authorization, "Bearer "s + token);
+            }));
+        }
+        bool done = false;
+        ws_.async_handshake("localhost"s, std::string{http_handler::WsHub::PATH}, [&done](beast::error_code ec) {
+            REQUIRE_FALSE(ec);
+            done = true;
+        });
+        REQUIRE(RunUntil(ioc_, [&done] { return done; }));
+    }
+
+    void Send(std::string_view text) {
+        ws_.text(true);
+        ws_.write(net::buffer(text));
+    }
+
+    // Следующий кадр сервера или nullopt, если его нет за timeout или соединение закрыто
+    std::optional<std::string> Read(std::chrono::milliseconds timeout = 5s) {
+        if (!reading_) {
+            reading_ = true;
+            ws_.async_read(buffer_, [this](beast::error_code ec, size_t) {
+                reading_ = false;
+                received_ = true;
+                error_ = ec;
+            });
+        }
+        if (!RunUntil(ioc_, [this] { return received_; }, timeout)) {
+            return std::nullopt;
+        }
+        received_ = false;
+        if (error_) {
+            return std::nullopt;
+        }
+        auto frame = beast::buffers_to_string(buffer_.data());
+        buffer_.consume(buffer_.size());
+        return frame;
+    }
+
+    bool IsClosed() const noexcept {
+        return error_ == websocket::error::closed;
+    }
+
+    // Код, с которым сервер закрыл соединение
+    websocket::close_code GetCloseCode() const {
+        return static_cast<websocket::close_code>(ws_.reason().code);
+    }
+
+private:
+    net::io_context& ioc_;
+    websocket::stream<beast::tcp_stream> ws_;
+    beast::flat_buffer buffer_;
+    bool reading_ = false;
+    bool received_ = false;
+    beast::error_code error_;
+};
+
+}  // namespace ws_test